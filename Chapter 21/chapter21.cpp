@@ -10,6 +10,12 @@
 #include "FrameResource.h"
 #include "ShadowMap.h"
 #include "Ssao.h"
+#include "../Common/MeshFile.h"
+#include "../Common/MappedFile.h"
+#include "../Common/Parallel.h"
+#include "../Common/TaskGraph.h"
+
+#include <chrono>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -17,6 +23,18 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Texture names and files, in the order BuildDescriptorHeaps() expects them.
+const std::pair<const char*, const wchar_t*> gTextureFiles[] =
+{
+    { "bricksDiffuseMap",   L"../Textures/bricks2.dds" },
+    { "bricksNormalMap",    L"../Textures/bricks2_nmap.dds" },
+    { "tileDiffuseMap",     L"../Textures/tile.dds" },
+    { "tileNormalMap",      L"../Textures/tile_nmap.dds" },
+    { "defaultDiffuseMap",  L"../Textures/white1x1.dds" },
+    { "defaultNormalMap",   L"../Textures/default_nmap.dds" },
+    { "skyCubeMap",         L"../Textures/sunsetcube1024.dds" }
+};
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -89,6 +107,7 @@ private:
     void UpdateShadowPassCB(const GameTimer& gt);
     void UpdateSsaoCB(const GameTimer& gt);
 
+    void PrefetchTextures();
     void LoadTextures();
     void BuildRootSignature();
     void BuildSsaoRootSignature();
@@ -96,6 +115,9 @@ private:
     void BuildShadersAndInputLayout();
     void BuildShapeGeometry();
     void BuildSkullGeometry();
+    bool BuildSkullGeometryFromMeshFile(const wchar_t* fileName);
+    bool BuildSkullGeometryFromText(const char* fileName);
+    void UploadGeometry();
     void BuildPSOs();
     void BuildFrameResources();
     void BuildMaterials();
@@ -130,6 +152,19 @@ private:
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+    // Geometry built on a worker during start-up.  UploadGeometry() creates the
+    // buffers from VertexData/IndexData and moves it to mGeometries.
+    struct PendingGeometry
+    {
+        std::unique_ptr<MeshGeometry> Geo;
+        const void* VertexData = nullptr;
+        const void* IndexData = nullptr;
+    };
+
+    PendingGeometry mShapeGeometry;
+    PendingGeometry mSkullGeometry;
+    MeshFile::View mSkullMeshFile;
+
     //  
     std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
@@ -218,6 +253,8 @@ SsaoApp::~SsaoApp()
 
 bool SsaoApp::Initialize()
 {
+    auto start = std::chrono::steady_clock::now();
+
     if (!D3DApp::Initialize())
         return false;
 
@@ -234,17 +271,32 @@ bool SsaoApp::Initialize()
         mCommandList.Get(),
         mClientWidth, mClientHeight);
 
-    LoadTextures();
-    BuildRootSignature();
-    BuildSsaoRootSignature();
-    BuildDescriptorHeaps();
-    BuildShadersAndInputLayout();
-    BuildShapeGeometry();
-    BuildSkullGeometry();
-    BuildMaterials();
-    BuildRenderItems();
-    BuildFrameResources();
-    BuildPSOs();
+    // The build steps run as a task graph.  Workers read files, compile shaders and
+    // build meshes, materials and render items; everything that records into the
+    // command list or creates device objects stays on the main lane.
+    using Lane = TaskGraph::Lane;
+    TaskGraph startup;
+
+    auto prefetchTextures = startup.Add("Prefetch textures", Lane::Worker, [&]() { PrefetchTextures(); });
+    auto shaders = startup.Add("Compile shaders", Lane::Worker, [&]() { BuildShadersAndInputLayout(); });
+    auto shapes = startup.Add("Shape geometry", Lane::Worker, [&]() { BuildShapeGeometry(); });
+    auto skull = startup.Add("Skull geometry", Lane::Worker, [&]() { BuildSkullGeometry(); });
+    auto materials = startup.Add("Materials", Lane::Worker, [&]() { BuildMaterials(); });
+
+    auto rootSignatures = startup.Add("Root signatures", Lane::Main, [&]()
+    {
+        BuildRootSignature();
+        BuildSsaoRootSignature();
+    });
+    auto textures = startup.Add("Load textures", Lane::Main, [&]() { LoadTextures(); }, { prefetchTextures });
+    startup.Add("Descriptor heaps", Lane::Main, [&]() { BuildDescriptorHeaps(); }, { textures });
+    auto uploadGeometry = startup.Add("Upload geometry", Lane::Main, [&]() { UploadGeometry(); }, { shapes, skull });
+    auto renderItems = startup.Add("Render items", Lane::Worker, [&]() { BuildRenderItems(); }, { uploadGeometry, materials });
+    startup.Add("Frame resources", Lane::Main, [&]() { BuildFrameResources(); }, { renderItems });
+    startup.Add("Pipeline states", Lane::Main, [&]() { BuildPSOs(); }, { shaders, rootSignatures });
+
+    startup.Run();
+    OutputDebugStringA(startup.Report("Start-up").c_str());
 
     mSsao->SetPSOs(mPSOs["ssao"].Get(), mPSOs["ssaoBlur"].Get());
 
@@ -256,6 +308,10 @@ bool SsaoApp::Initialize()
     // Wait until initialization is complete.
     FlushCommandQueue();
 
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::wstring text = L"Initialized in " + std::to_wstring(ms) + L" ms\n";
+    OutputDebugString(text.c_str());
+
     return true;
 }
 
@@ -723,35 +779,28 @@ void SsaoApp::UpdateSsaoCB(const GameTimer& gt)
     currSsaoCB->CopyData(0, ssaoCB);
 }
 
-void SsaoApp::LoadTextures()
+// Runs on a worker while the main thread builds the root signatures, so LoadTextures()
+// finds the files in the page cache.
+void SsaoApp::PrefetchTextures()
 {
-    std::vector<std::string> texNames =
-    {
-        "bricksDiffuseMap",
-        "bricksNormalMap",
-        "tileDiffuseMap",
-        "tileNormalMap",
-        "defaultDiffuseMap",
-        "defaultNormalMap",
-        "skyCubeMap"
-    };
-
-    std::vector<std::wstring> texFilenames =
+    Parallel::For(_countof(gTextureFiles), 1, [](size_t begin, size_t end)
     {
-        L"../Textures/bricks2.dds",
-        L"../Textures/bricks2_nmap.dds",
-        L"../Textures/tile.dds",
-        L"../Textures/tile_nmap.dds",
-        L"../Textures/white1x1.dds",
-        L"../Textures/default_nmap.dds",
-        L"../Textures/sunsetcube1024.dds"
-    };
+        for (size_t i = begin; i < end; ++i)
+        {
+            MappedFile file;
+            if (file.Open(gTextureFiles[i].second))
+                file.Prefetch();
+        }
+    });
+}
 
-    for (int i = 0; i < (int)texNames.size(); ++i)
+void SsaoApp::LoadTextures()
+{
+    for (const auto& textureFile : gTextureFiles)
     {
         auto texMap = std::make_unique<Texture>();
-        texMap->Name = texNames[i];
-        texMap->Filename = texFilenames[i];
+        texMap->Name = textureFile.first;
+        texMap->Filename = textureFile.second;
         ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
             mCommandList.Get(), texMap->Filename.c_str(),
             texMap->Resource, texMap->UploadHeap));
@@ -980,27 +1029,51 @@ void SsaoApp::BuildShadersAndInputLayout()
         NULL, NULL
     };
 
-    mShaders["standardVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["opaquePS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "PS", "ps_5_1");
+    struct ShaderDesc
+    {
+        const char* Name;
+        const wchar_t* Filename;
+        const D3D_SHADER_MACRO* Defines;
+        const char* EntryPoint;
+        const char* Target;
+    };
+
+    const ShaderDesc shaders[] =
+    {
+        { "standardVS", L"Default.hlsl", nullptr, "VS", "vs_5_1" },
+        { "opaquePS", L"Default.hlsl", nullptr, "PS", "ps_5_1" },
 
-    mShaders["shadowVS"] = d3dUtil::CompileShader(L"Shadows.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["shadowOpaquePS"] = d3dUtil::CompileShader(L"Shadows.hlsl", nullptr, "PS", "ps_5_1");
-    mShaders["shadowAlphaTestedPS"] = d3dUtil::CompileShader(L"Shadows.hlsl", alphaTestDefines, "PS", "ps_5_1");
+        { "shadowVS", L"Shadows.hlsl", nullptr, "VS", "vs_5_1" },
+        { "shadowOpaquePS", L"Shadows.hlsl", nullptr, "PS", "ps_5_1" },
+        { "shadowAlphaTestedPS", L"Shadows.hlsl", alphaTestDefines, "PS", "ps_5_1" },
 
-    mShaders["debugVS"] = d3dUtil::CompileShader(L"ShadowDebug.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["debugPS"] = d3dUtil::CompileShader(L"ShadowDebug.hlsl", nullptr, "PS", "ps_5_1");
+        { "debugVS", L"ShadowDebug.hlsl", nullptr, "VS", "vs_5_1" },
+        { "debugPS", L"ShadowDebug.hlsl", nullptr, "PS", "ps_5_1" },
 
-    mShaders["drawNormalsVS"] = d3dUtil::CompileShader(L"DrawNormals.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["drawNormalsPS"] = d3dUtil::CompileShader(L"DrawNormals.hlsl", nullptr, "PS", "ps_5_1");
+        { "drawNormalsVS", L"DrawNormals.hlsl", nullptr, "VS", "vs_5_1" },
+        { "drawNormalsPS", L"DrawNormals.hlsl", nullptr, "PS", "ps_5_1" },
 
-    mShaders["ssaoVS"] = d3dUtil::CompileShader(L"Ssao.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["ssaoPS"] = d3dUtil::CompileShader(L"Ssao.hlsl", nullptr, "PS", "ps_5_1");
+        { "ssaoVS", L"Ssao.hlsl", nullptr, "VS", "vs_5_1" },
+        { "ssaoPS", L"Ssao.hlsl", nullptr, "PS", "ps_5_1" },
+
+        { "ssaoBlurVS", L"SsaoBlur.hlsl", nullptr, "VS", "vs_5_1" },
+        { "ssaoBlurPS", L"SsaoBlur.hlsl", nullptr, "PS", "ps_5_1" },
+
+        { "skyVS", L"Sky.hlsl", nullptr, "VS", "vs_5_1" },
+        { "skyPS", L"Sky.hlsl", nullptr, "PS", "ps_5_1" },
+    };
 
-    mShaders["ssaoBlurVS"] = d3dUtil::CompileShader(L"SsaoBlur.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["ssaoBlurPS"] = d3dUtil::CompileShader(L"SsaoBlur.hlsl", nullptr, "PS", "ps_5_1");
+    // The compiler is thread-safe; errors are rethrown here once every shader has
+    // been tried.
+    const size_t numShaders = _countof(shaders);
+    std::vector<ComPtr<ID3DBlob>> bytecode(numShaders);
+    Parallel::TryEach(numShaders, [&](size_t i)
+    {
+        bytecode[i] = d3dUtil::CompileShader(shaders[i].Filename, shaders[i].Defines, shaders[i].EntryPoint, shaders[i].Target);
+    });
 
-    mShaders["skyVS"] = d3dUtil::CompileShader(L"Sky.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["skyPS"] = d3dUtil::CompileShader(L"Sky.hlsl", nullptr, "PS", "ps_5_1");
+    for (size_t i = 0; i < numShaders; ++i)
+        mShaders[shaders[i].Name] = bytecode[i];
 
     mInputLayout =
     {
@@ -1138,12 +1211,6 @@ void SsaoApp::BuildShapeGeometry()
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
     geo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1155,81 +1222,113 @@ void SsaoApp::BuildShapeGeometry()
     geo->DrawArgs["cylinder"] = cylinderSubmesh;
     geo->DrawArgs["quad"] = quadSubmesh;
 
-    mGeometries[geo->Name] = std::move(geo);
+    mShapeGeometry.VertexData = geo->VertexBufferCPU->GetBufferPointer();
+    mShapeGeometry.IndexData = geo->IndexBufferCPU->GetBufferPointer();
+    mShapeGeometry.Geo = std::move(geo);
 }
 
 void SsaoApp::BuildSkullGeometry()
 {
-    std::ifstream fin("Models/skull.txt");
+    auto start = std::chrono::steady_clock::now();
 
-    if (!fin)
+    // Models/skull.mesh is written from the text model by Tools/MeshConverter.  The
+    // text model is the fallback when the binary is missing or does not validate.
+    std::wstring source = L"Models/skull.mesh";
+    if (!BuildSkullGeometryFromMeshFile(source.c_str()))
     {
-        MessageBox(0, L"Models/skull.txt not found.", 0, 0);
-        return;
+        source = L"Models/skull.txt";
+        if (!BuildSkullGeometryFromText("Models/skull.txt"))
+            return;
     }
 
-    UINT vcount = 0;
-    UINT tcount = 0;
-    std::string ignore;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::wstring text = L"Skull geometry loaded from " + source + L" in " + std::to_wstring(ms) + L" ms\n";
+    OutputDebugString(text.c_str());
+}
 
-    fin >> ignore >> vcount;
-    fin >> ignore >> tcount;
-    fin >> ignore >> ignore >> ignore >> ignore;
+bool SsaoApp::BuildSkullGeometryFromMeshFile(const wchar_t* fileName)
+{
+    static_assert(sizeof(Vertex) == MeshFile::StandardVertexStride, "Vertex must match the mesh file layout");
 
-    XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-    XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+    // The view stays open until UploadGeometry() has copied the data.
+    MeshFile::View& view = mSkullMeshFile;
+    if (!view.Open(fileName) || view.Header().SubmeshCount == 0 ||
+        !view.HasLayout(0, MeshFile::StandardVertexLayout, _countof(MeshFile::StandardVertexLayout), sizeof(Vertex)))
+    {
+        view.Close();
+        return false;
+    }
 
-    XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-    XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+    const MeshFile::FileHeader& header = view.Header();
+    const UINT vbByteSize = (UINT)view.Stream(0).Size;
+    const UINT ibByteSize = (UINT)view.IndexDataSize();
 
-    std::vector<Vertex> vertices(vcount);
-    for (UINT i = 0; i < vcount; ++i)
-    {
-        fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-        fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+    auto geo = std::make_unique<MeshGeometry>();
+    geo->Name = "skullGeo";
 
-        vertices[i].TexC = { 0.0f, 0.0f };
+    // The upload buffers are filled straight from the mapping.  Nothing reads the
+    // system memory copies, so none are kept.
+    geo->VertexByteStride = sizeof(Vertex);
+    geo->VertexBufferByteSize = vbByteSize;
+    geo->IndexFormat = header.IndexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    geo->IndexBufferByteSize = ibByteSize;
 
-        XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
+    const MeshFile::SubmeshDesc& desc = view.Submesh(0);
+    XMVECTOR vMin = XMVectorSet(desc.BoundsMin[0], desc.BoundsMin[1], desc.BoundsMin[2], 0.0f);
+    XMVECTOR vMax = XMVectorSet(desc.BoundsMax[0], desc.BoundsMax[1], desc.BoundsMax[2], 0.0f);
 
-        XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
+    SubmeshGeometry submesh;
+    submesh.IndexCount = desc.IndexCount;
+    submesh.StartIndexLocation = desc.StartIndex;
+    submesh.BaseVertexLocation = desc.BaseVertex;
+    XMStoreFloat3(&submesh.Bounds.Center, 0.5f * (vMin + vMax));
+    XMStoreFloat3(&submesh.Bounds.Extents, 0.5f * (vMax - vMin));
 
-        // Generate a tangent vector so normal mapping works.  We aren't applying
-        // a texture map to the skull, so we just need any tangent vector so that
-        // the math works out to give us the original interpolated vertex normal.
-        XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-        if (fabsf(XMVectorGetX(XMVector3Dot(N, up))) < 1.0f - 0.001f)
-        {
-            XMVECTOR T = XMVector3Normalize(XMVector3Cross(up, N));
-            XMStoreFloat3(&vertices[i].TangentU, T);
-        }
-        else
-        {
-            up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-            XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
-            XMStoreFloat3(&vertices[i].TangentU, T);
-        }
+    geo->DrawArgs["skull"] = submesh;
 
+    mSkullGeometry.VertexData = mSkullMeshFile.StreamData(0);
+    mSkullGeometry.IndexData = mSkullMeshFile.IndexData();
+    mSkullGeometry.Geo = std::move(geo);
+    return true;
+}
 
-        vMin = XMVectorMin(vMin, P);
-        vMax = XMVectorMax(vMax, P);
+bool SsaoApp::BuildSkullGeometryFromText(const char* fileName)
+{
+    // The file is mapped and parsed on all cores straight into the vertex and index
+    // arrays; see MeshFile::ParseLegacyText.
+    static_assert(sizeof(Vertex) == MeshFile::StandardVertexStride, "Vertex must match the mesh file layout");
+
+    MeshFile::LegacyText text;
+    if (!MeshFile::OpenLegacyText(fileName, text))
+    {
+        MessageBox(0, L"Models/skull.txt not found.", 0, 0);
+        return false;
     }
 
-    BoundingBox bounds;
-    XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-    XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
+    std::vector<Vertex> vertices(text.VertexCount);
+    std::vector<std::int32_t> indices(3 * (size_t)text.TriangleCount);
+    if (!MeshFile::ParseLegacyText(text, vertices.data(), reinterpret_cast<std::uint32_t*>(indices.data())))
+    {
+        MessageBox(0, L"Models/skull.txt is malformed.", 0, 0);
+        return false;
+    }
 
-    fin >> ignore;
-    fin >> ignore;
-    fin >> ignore;
+    XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+    XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+
+    XMVECTOR vMin = XMLoadFloat3(&vMinf3);
+    XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
 
-    std::vector<std::int32_t> indices(3 * tcount);
-    for (UINT i = 0; i < tcount; ++i)
+    for (const Vertex& v : vertices)
     {
-        fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+        XMVECTOR P = XMLoadFloat3(&v.Pos);
+        vMin = XMVectorMin(vMin, P);
+        vMax = XMVectorMax(vMax, P);
     }
 
-    fin.close();
+    BoundingBox bounds;
+    XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
+    XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
 
     //
     // Pack the indices of all the meshes into one index buffer.
@@ -1248,12 +1347,6 @@ void SsaoApp::BuildSkullGeometry()
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
     geo->IndexFormat = DXGI_FORMAT_R32_UINT;
@@ -1267,7 +1360,34 @@ void SsaoApp::BuildSkullGeometry()
 
     geo->DrawArgs["skull"] = submesh;
 
-    mGeometries[geo->Name] = std::move(geo);
+    mSkullGeometry.VertexData = geo->VertexBufferCPU->GetBufferPointer();
+    mSkullGeometry.IndexData = geo->IndexBufferCPU->GetBufferPointer();
+    mSkullGeometry.Geo = std::move(geo);
+    return true;
+}
+
+void SsaoApp::UploadGeometry()
+{
+    for (PendingGeometry* pending : { &mShapeGeometry, &mSkullGeometry })
+    {
+        // The skull is missing if neither of its files could be read.
+        if (pending->Geo == nullptr)
+            continue;
+
+        MeshGeometry* geo = pending->Geo.get();
+
+        geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+            mCommandList.Get(), pending->VertexData, geo->VertexBufferByteSize, geo->VertexBufferUploader);
+
+        geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+            mCommandList.Get(), pending->IndexData, geo->IndexBufferByteSize, geo->IndexBufferUploader);
+
+        mGeometries[geo->Name] = std::move(pending->Geo);
+        *pending = PendingGeometry();
+    }
+
+    // The upload buffers hold copies of the skull data now.
+    mSkullMeshFile.Close();
 }
 
 void SsaoApp::BuildPSOs()
@@ -8,6 +8,7 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/MeshCache.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -527,11 +528,12 @@ void ShapesApp::BuildShadersAndInputLayout()
 void ShapesApp::BuildShapeGeometry()
 {
     //  
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);                // 
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);             // 
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);                 // 
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.0f, 3.0f, 20, 20); // 
+    MeshCache& meshCache = MeshCache::Global();
+    meshCache.SetDiskDirectory("MeshCache");
+    MeshCache::Mesh box = meshCache.Box(1.5f, 0.5f, 1.5f, 3);                  // 
+    MeshCache::Mesh grid = meshCache.Grid(20.0f, 30.0f, 60, 40);               // 
+    MeshCache::Mesh sphere = meshCache.Sphere(0.5f, 20, 20);                   // 
+    MeshCache::Mesh cylinder = meshCache.Cylinder(0.5f, 0.0f, 3.0f, 20, 20);   // 
 
     //
     // We are concatenating all the geometry into one big vertex/index buffer.  So
@@ -540,36 +542,36 @@ void ShapesApp::BuildShapeGeometry()
 
     // Cache the vertex offsets to each object in the concatenated vertex buffer.
     UINT boxVertexOffset = 0;
-    UINT gridVertexOffset = (UINT)box.Vertices.size();
-    UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-    UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
+    UINT gridVertexOffset = (UINT)box->Vertices.size();
+    UINT sphereVertexOffset = gridVertexOffset + (UINT)grid->Vertices.size();
+    UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere->Vertices.size();
 
     // Cache the starting index for each object in the concatenated index buffer.
     UINT boxIndexOffset = 0;
-    UINT gridIndexOffset = (UINT)box.Indices32.size();
-    UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-    UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
+    UINT gridIndexOffset = (UINT)box->Indices32.size();
+    UINT sphereIndexOffset = gridIndexOffset + (UINT)grid->Indices32.size();
+    UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere->Indices32.size();
 
     // Define the SubmeshGeometry that cover different 
     // regions of the vertex/index buffers.
 
     SubmeshGeometry boxSubmesh;
-    boxSubmesh.IndexCount = (UINT)box.Indices32.size();
+    boxSubmesh.IndexCount = (UINT)box->Indices32.size();
     boxSubmesh.StartIndexLocation = boxIndexOffset;
     boxSubmesh.BaseVertexLocation = boxVertexOffset;
 
     SubmeshGeometry gridSubmesh;
-    gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
+    gridSubmesh.IndexCount = (UINT)grid->Indices32.size();
     gridSubmesh.StartIndexLocation = gridIndexOffset;
     gridSubmesh.BaseVertexLocation = gridVertexOffset;
 
     SubmeshGeometry sphereSubmesh;
-    sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+    sphereSubmesh.IndexCount = (UINT)sphere->Indices32.size();
     sphereSubmesh.StartIndexLocation = sphereIndexOffset;
     sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
 
     SubmeshGeometry cylinderSubmesh;
-    cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
+    cylinderSubmesh.IndexCount = (UINT)cylinder->Indices32.size();
     cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
     cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
 
@@ -579,43 +581,43 @@ void ShapesApp::BuildShapeGeometry()
     //
 
     auto totalVertexCount =
-        box.Vertices.size() +
-        grid.Vertices.size() +
-        sphere.Vertices.size() +
-        cylinder.Vertices.size();
+        box->Vertices.size() +
+        grid->Vertices.size() +
+        sphere->Vertices.size() +
+        cylinder->Vertices.size();
 
     std::vector<Vertex> vertices(totalVertexCount);
 
     UINT k = 0;
-    for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+    for (size_t i = 0; i < box->Vertices.size(); ++i, ++k)
     {
-        vertices[k].Pos = box.Vertices[i].Position;
+        vertices[k].Pos = box->Vertices[i].Position;
         vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkGreen);
     }
 
-    for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
+    for (size_t i = 0; i < grid->Vertices.size(); ++i, ++k)
     {
-        vertices[k].Pos = grid.Vertices[i].Position;
+        vertices[k].Pos = grid->Vertices[i].Position;
         vertices[k].Color = XMFLOAT4(DirectX::Colors::ForestGreen);
     }
 
-    for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+    for (size_t i = 0; i < sphere->Vertices.size(); ++i, ++k)
     {
-        vertices[k].Pos = sphere.Vertices[i].Position;
+        vertices[k].Pos = sphere->Vertices[i].Position;
         vertices[k].Color = XMFLOAT4(DirectX::Colors::Crimson);
     }
 
-    for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+    for (size_t i = 0; i < cylinder->Vertices.size(); ++i, ++k)
     {
-        vertices[k].Pos = cylinder.Vertices[i].Position;
+        vertices[k].Pos = cylinder->Vertices[i].Position;
         vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
     }
 
     std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-    indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-    indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-    indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
+    indices.insert(indices.end(), std::begin(box->GetIndices16()), std::end(box->GetIndices16()));
+    indices.insert(indices.end(), std::begin(grid->GetIndices16()), std::end(grid->GetIndices16()));
+    indices.insert(indices.end(), std::begin(sphere->GetIndices16()), std::end(sphere->GetIndices16()));
+    indices.insert(indices.end(), std::begin(cylinder->GetIndices16()), std::end(cylinder->GetIndices16()));
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
     const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
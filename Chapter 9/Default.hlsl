@@ -20,6 +20,25 @@
 
 Texture2D    gDiffuseMap : register(t0);
 
+// Terrain heights as 16-bit unorm samples, and the patches to draw this frame.
+Texture2D    gHeightMap  : register(t1);
+
+struct TerrainNode
+{
+    float2 Origin;
+    float  Size;
+    float  Level;
+    float2 MorphConstants;
+    float2 Pad;
+};
+
+StructuredBuffer<TerrainNode> gTerrainNodes : register(t2);
+
+// The ocean field's mips, one after the other: halves of the height and x
+// displacement, the z displacement and x slope, and the z slope, as
+// OceanClipmap::FieldTexel lays them out.
+StructuredBuffer<uint3> gOceanField : register(t3);
+
 
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
@@ -69,6 +88,45 @@ cbuffer cbMaterial : register(b2)
     float4x4 gMatTransform;
 };
 
+// Root constants of the terrain.
+cbuffer cbTerrain : register(b3)
+{
+    float2 gTerrainOrigin;
+    float2 gTerrainExtent;
+    float2 gHeightMapInvSize;
+    float  gHeightScale;
+    float  gHeightOffset;
+    float  gTerrainSpacing;
+    float  gPatchSize;
+    uint   gTerrainNodeBase;
+};
+
+// Root constants of the waves: where vertex 0 is, the texture coordinate step per
+// column and row, the spacing, and the vertices per row.
+cbuffer cbWaves : register(b4)
+{
+    float2 gWavesOrigin;
+    float2 gWavesTexCoordStep;
+    float  gWavesSpacing;
+    uint   gWavesColumnCount;
+};
+
+// Root constants of the ocean: the clipmap level being drawn, its morph range as
+// (start, 1 / (end - start)) in cells, the mips it reads, and where the field's points
+// are.
+cbuffer cbOcean : register(b5)
+{
+    float2 gOceanLevelOrigin;
+    float  gOceanLevelSize;
+    uint   gOceanFieldMip;
+    uint   gOceanNextFieldMip;
+    float  gOceanGridSize;
+    float2 gOceanMorphConstants;
+    float2 gOceanFieldOrigin;
+    float  gOceanFieldInvSpacing;
+    uint   gOceanFieldResolution;
+};
+
 struct VertexIn
 {
     float3 PosL    : POSITION;
@@ -105,6 +163,163 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+struct TerrainVertexIn
+{
+    float2 PatchPos : POSITION;
+};
+
+float TerrainHeight(float2 posXZ)
+{
+    float2 uv = ((posXZ - gTerrainOrigin) / gTerrainSpacing + 0.5f) * gHeightMapInvSize;
+    return gHeightOffset + gHeightScale * gHeightMap.SampleLevel(gsamLinearClamp, uv, 0.0f).r;
+}
+
+VertexOut TerrainVS(TerrainVertexIn vin, uint instanceID : SV_InstanceID)
+{
+    VertexOut vout = (VertexOut)0.0f;
+
+    TerrainNode node = gTerrainNodes[gTerrainNodeBase + instanceID];
+
+    // Morph by the distance to the unmorphed vertex, which is what Terrain::Select
+    // measured against the node bounds.
+    float2 posXZ = node.Origin + vin.PatchPos * node.Size;
+    float dist = distance(gEyePosW, float3(posXZ.x, TerrainHeight(posXZ), posXZ.y));
+    float morphK = 1.0f - saturate(node.MorphConstants.x - dist * node.MorphConstants.y);
+
+    // Slide the odd vertices onto their even neighbours; fully morphed, the patch is
+    // the grid of the next level.
+    float2 oddOffset = frac(vin.PatchPos * gPatchSize * 0.5f) * 2.0f / gPatchSize;
+    posXZ -= oddOffset * node.Size * morphK;
+
+    // The parts of edge nodes past the heightfield collapse onto its border.
+    posXZ = clamp(posXZ, gTerrainOrigin, gTerrainOrigin + gTerrainExtent);
+
+    float3 posW = float3(posXZ.x, TerrainHeight(posXZ), posXZ.y);
+    vout.PosW = posW;
+
+    // Central differences at the vertex spacing of the node's level.
+    float delta = gTerrainSpacing * exp2(node.Level);
+    float hL = TerrainHeight(posXZ - float2(delta, 0.0f));
+    float hR = TerrainHeight(posXZ + float2(delta, 0.0f));
+    float hD = TerrainHeight(posXZ - float2(0.0f, delta));
+    float hU = TerrainHeight(posXZ + float2(0.0f, delta));
+    vout.NormalW = normalize(float3(hL - hR, 2.0f * delta, hD - hU));
+
+    vout.PosH = mul(float4(posW, 1.0f), gViewProj);
+
+    // The texture coordinates of a grid over the heightfield, v running against z.
+    float2 texC = float2(posXZ.x - gTerrainOrigin.x, gTerrainOrigin.y + gTerrainExtent.y - posXZ.y) / gTerrainExtent;
+    float4 texC4 = mul(float4(texC, 0.0f, 1.0f), gTexTransform);
+    vout.TexC = mul(texC4, gMatTransform).xy;
+
+    return vout;
+}
+
+// A Waves::CompactFormat() record: the half height, and the normal's x and z on the
+// octahedron |x| + |y| + |z| = 1, with the lower half folded over the upper.
+struct WavesVertexIn
+{
+    float  Height    : HEIGHT;
+    float2 OctNormal : NORMAL;
+};
+
+float3 DecodeOctahedralNormal(float2 e)
+{
+    // snorm8 has two encodings of -1.
+    e = max(e, -1.0f);
+
+    float3 n = float3(e.x, 1.0f - abs(e.x) - abs(e.y), e.y);
+    if (n.y < 0.0f)
+        n.xz = (1.0f - abs(n.zx)) * (n.xz >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
+VertexOut WavesVS(WavesVertexIn vin, uint vertexID : SV_VertexID)
+{
+    VertexOut vout = (VertexOut)0.0f;
+
+    // The grid point is the vertex's place in the buffer, row by row.
+    uint i = vertexID / gWavesColumnCount;
+    uint j = vertexID - i * gWavesColumnCount;
+    float3 posL = float3(gWavesOrigin.x + j * gWavesSpacing, vin.Height, gWavesOrigin.y - i * gWavesSpacing);
+
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
+    vout.PosW = posW.xyz;
+    vout.NormalW = mul(DecodeOctahedralNormal(vin.OctNormal), (float3x3)gWorld);
+    vout.PosH = mul(posW, gViewProj);
+
+    float4 texC = mul(float4((float2(j, i) + 0.5f) * gWavesTexCoordStep, 0.0f, 1.0f), gTexTransform);
+    vout.TexC = mul(texC, gMatTransform).xy;
+
+    return vout;
+}
+
+// The ocean field at p, in field points along x and against z, from a mip: the
+// displacement (x, height, z) and the slopes, bilinearly filtered and repeating.
+void SampleOceanField(float2 p, uint mip, out float3 displacement, out float2 slope)
+{
+    uint size = gOceanFieldResolution >> mip;
+    uint base = 4 * (gOceanFieldResolution * gOceanFieldResolution - size * size) / 3;
+
+    // Texel t of a mip averages the points from t * 2^mip to (t + 1) * 2^mip - 1.
+    float scale = exp2(-(float)mip);
+    float2 t = p * scale - 0.5f + 0.5f * scale;
+    float2 t0 = floor(t);
+    float2 w = t - t0;
+
+    displacement = 0.0f;
+    slope = 0.0f;
+
+    [unroll]
+    for (uint k = 0; k < 4; ++k)
+    {
+        uint2 corner = uint2(k & 1, k >> 1);
+        uint2 ij = uint2(int2(t0) + int2(corner)) & (size - 1);
+        uint3 texel = gOceanField[base + ij.y * size + ij.x];
+
+        float2 weights = corner ? w : 1.0f - w;
+        float weight = weights.x * weights.y;
+        displacement += weight * float3(f16tof32(texel.x >> 16), f16tof32(texel.x), f16tof32(texel.y));
+        slope += weight * float2(f16tof32(texel.y >> 16), f16tof32(texel.z));
+    }
+}
+
+VertexOut OceanVS(TerrainVertexIn vin)
+{
+    VertexOut vout = (VertexOut)0.0f;
+
+    // Morph by how far the unmorphed vertex is from the eye along x or z, in cells of
+    // the level, which is how OceanClipmap::Place keeps the levels apart.
+    float2 posXZ = gOceanLevelOrigin + vin.PatchPos * gOceanLevelSize;
+    float2 toEye = abs(posXZ - gEyePosW.xz) * (gOceanGridSize / gOceanLevelSize);
+    float morphK = saturate((max(toEye.x, toEye.y) - gOceanMorphConstants.x) * gOceanMorphConstants.y);
+
+    // Slide the odd vertices onto their even neighbours and fade to the next mip;
+    // fully morphed, the level is the next level's grid and surface.
+    float2 oddOffset = frac(vin.PatchPos * gOceanGridSize * 0.5f) * 2.0f / gOceanGridSize;
+    posXZ -= oddOffset * gOceanLevelSize * morphK;
+
+    float2 p = float2(posXZ.x - gOceanFieldOrigin.x, gOceanFieldOrigin.y - posXZ.y) * gOceanFieldInvSpacing;
+
+    float3 displacement, nextDisplacement;
+    float2 slope, nextSlope;
+    SampleOceanField(p, gOceanFieldMip, displacement, slope);
+    SampleOceanField(p, gOceanNextFieldMip, nextDisplacement, nextSlope);
+    displacement = lerp(displacement, nextDisplacement, morphK);
+    slope = lerp(slope, nextSlope, morphK);
+
+    float3 posW = float3(posXZ.x, 0.0f, posXZ.y) + displacement;
+    vout.PosW = posW;
+    vout.NormalW = normalize(float3(-slope.x, 1.0f, -slope.y));
+    vout.PosH = mul(float4(posW, 1.0f), gViewProj);
+
+    // The texture repeats with the field and stays on the undisplaced water.
+    float4 texC = mul(float4(p / gOceanFieldResolution, 0.0f, 1.0f), gTexTransform);
+    vout.TexC = mul(texC, gMatTransform).xy;
+
+    return vout;
+}
+
 float4 PS(VertexOut pin) : SV_Target
 {
     float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
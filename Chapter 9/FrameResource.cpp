@@ -1,6 +1,7 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount, UINT terrainNodeCount,
+    UINT oceanFieldTexelCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -11,7 +12,9 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
     MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
 
-    WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
+    WavesVB = std::make_unique<UploadBuffer<std::uint32_t>>(device, waveVertCount, false);
+    TerrainNodes = std::make_unique<UploadBuffer<TerrainNodeData>>(device, terrainNodeCount, false);
+    OceanField = std::make_unique<UploadBuffer<OceanClipmap::FieldTexel>>(device, oceanFieldTexelCount, false);
 }
 
 FrameResource::~FrameResource()
@@ -3,6 +3,7 @@
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
+#include "OceanClipmap.h"
 
 struct ObjectConstants
 {
@@ -43,13 +44,64 @@ struct Vertex
     DirectX::XMFLOAT2 TexC;
 };
 
+// One terrain patch instance: a node chosen by Terrain::Select, with the morph range
+// of its level as (end / (end - start), 1 / (end - start)).
+struct TerrainNodeData
+{
+    DirectX::XMFLOAT2 Origin = { 0.0f, 0.0f };
+    float Size = 0.0f;
+    float Level = 0.0f;
+    DirectX::XMFLOAT2 MorphConstants = { 0.0f, 0.0f };
+    DirectX::XMFLOAT2 Pad = { 0.0f, 0.0f };
+};
+
+// Root constants of the terrain vertex shader.
+struct TerrainConstants
+{
+    DirectX::XMFLOAT2 Origin = { 0.0f, 0.0f };
+    DirectX::XMFLOAT2 Extent = { 0.0f, 0.0f };
+    DirectX::XMFLOAT2 HeightMapInvSize = { 0.0f, 0.0f };
+    float HeightScale = 0.0f;
+    float HeightOffset = 0.0f;
+    float Spacing = 0.0f;
+    float PatchSize = 0.0f;
+    UINT NodeBase = 0;
+};
+
+// Root constants of the waves vertex shader, which places the vertices of the
+// Waves::CompactFormat() records by their index in the grid.
+struct WavesConstants
+{
+    DirectX::XMFLOAT2 Origin = { 0.0f, 0.0f };
+    DirectX::XMFLOAT2 TexCoordStep = { 0.0f, 0.0f };
+    float Spacing = 0.0f;
+    UINT ColumnCount = 0;
+};
+
+// Root constants of the ocean vertex shader: the OceanClipmap::Level being drawn,
+// with its morph range as (start, 1 / (end - start)) in cells, and the xz of field
+// point (0, 0) and the field's points per unit.
+struct OceanConstants
+{
+    DirectX::XMFLOAT2 LevelOrigin = { 0.0f, 0.0f };
+    float LevelSize = 0.0f;
+    UINT FieldMip = 0;
+    UINT NextFieldMip = 0;
+    float GridSize = 0.0f;
+    DirectX::XMFLOAT2 MorphConstants = { 0.0f, 0.0f };
+    DirectX::XMFLOAT2 FieldOrigin = { 0.0f, 0.0f };
+    float FieldInvSpacing = 0.0f;
+    UINT FieldResolution = 0;
+};
+
 // Stores the resources needed for the CPU to build the command lists
 // for a frame.  
 struct FrameResource
 {
 public:
 
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount, UINT terrainNodeCount,
+        UINT oceanFieldTexelCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -66,8 +118,16 @@ public:
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
     // We cannot update a dynamic vertex buffer until the GPU is done processing
-    // the commands that reference it.  So each frame needs their own.
-    std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+    // the commands that reference it.  So each frame needs their own.  The waves
+    // are uploaded as 4-byte Waves::CompactFormat() records.
+    std::unique_ptr<UploadBuffer<std::uint32_t>> WavesVB = nullptr;
+
+    // The terrain nodes selected for this frame, read by the vertex shader.
+    std::unique_ptr<UploadBuffer<TerrainNodeData>> TerrainNodes = nullptr;
+
+    // The ocean's fields and their mips as OceanClipmap::WriteField left them this
+    // frame, read by the vertex shader.
+    std::unique_ptr<UploadBuffer<OceanClipmap::FieldTexel>> OceanField = nullptr;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
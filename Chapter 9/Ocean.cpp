@@ -0,0 +1,808 @@
+//***************************************************************************************
+// Ocean.cpp
+//***************************************************************************************
+
+#include "Ocean.h"
+#include "../Common/JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCEAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	const float Gravity = 9.81f;
+	const float Pi = 3.14159265f;
+	const float HalfPi = 1.57079633f;
+	const float TwoPi = 6.28318531f;
+
+	// The Phillips constant of the saturation range of wind waves.
+	const float PhillipsConstant = 0.0081f;
+
+	// Height and x slope, z slope and x displacement, z displacement.
+	const int TransformCount = 3;
+
+	// Spectrum rows per task; each row is evolved and transformed along x in one go.
+	const size_t EvolveRowGrain = 8;
+
+	// Columns per task in the transforms along z.
+	const int ColumnStrip = 64;
+
+	// Rows per task when the fields are unpacked or the vertices written.
+	const size_t RowGrain = 16;
+
+	// Variance of the surface per unit area of wave vector (kx, kz), |k| = k > 0.  The
+	// energy is spread as cos^2 over the half plane the wind blows into.
+	float DirectionalSpectrum(const Ocean::Settings& settings, float windX, float windZ, float kx, float kz, float k)
+	{
+		const float cosTheta = (kx * windX + kz * windZ) / k;
+		if (cosTheta <= 0.0f)
+			return 0.0f;
+
+		const float spreading = 2.0f / Pi * cosTheta * cosTheta;
+		const float smallWaves = std::exp(-k * k * settings.SmallWaveLength * settings.SmallWaveLength);
+
+		// The spectrum over |k| alone.
+		float spectrum;
+		if (settings.Spectrum == Ocean::SpectrumModel::Phillips)
+		{
+			const float kL = k * settings.WindSpeed * settings.WindSpeed / Gravity;
+			spectrum = 0.5f * PhillipsConstant / (k * k * k) * std::exp(-1.0f / (kL * kL));
+		}
+		else
+		{
+			const float omega = std::sqrt(Gravity * k);
+			const float alpha = 0.076f * std::pow(settings.WindSpeed * settings.WindSpeed / (settings.Fetch * Gravity), 0.22f);
+			const float peak = 22.0f * std::pow(Gravity * Gravity / (settings.WindSpeed * settings.Fetch), 1.0f / 3.0f);
+			const float sigma = omega <= peak ? 0.07f : 0.09f;
+			const float r = std::exp(-(omega - peak) * (omega - peak) / (2.0f * sigma * sigma * peak * peak));
+			const float ratio = peak / omega;
+
+			// S(omega) d omega / dk.
+			const float overFrequency = alpha * Gravity * Gravity / std::pow(omega, 5.0f) *
+				std::exp(-1.25f * ratio * ratio * ratio * ratio) * std::pow(settings.PeakEnhancement, r);
+			spectrum = overFrequency * Gravity / (2.0f * omega);
+		}
+
+		return spectrum * spreading / k * smallWaves;
+	}
+
+	// Radix-2 decimation-in-frequency butterflies on 'count' pairs of points u and v:
+	// u' = u + v and v' = (u - v) * w, with a twiddle w for each pair.
+	typedef void (*ButterflyFn)(float* uRe, float* uIm, float* vRe, float* vIm,
+		const float* wRe, const float* wIm, int count);
+
+	void ButterflyScalar(float* uRe, float* uIm, float* vRe, float* vIm,
+		const float* wRe, const float* wIm, int count)
+	{
+		for (int k = 0; k < count; ++k)
+		{
+			const float dRe = uRe[k] - vRe[k];
+			const float dIm = uIm[k] - vIm[k];
+			uRe[k] += vRe[k];
+			uIm[k] += vIm[k];
+			vRe[k] = dRe * wRe[k] - dIm * wIm[k];
+			vIm[k] = dRe * wIm[k] + dIm * wRe[k];
+		}
+	}
+
+	// The same with one twiddle for every pair.
+	typedef void (*ButterflyUniformFn)(float* uRe, float* uIm, float* vRe, float* vIm,
+		float wRe, float wIm, int count);
+
+	void ButterflyUniformScalar(float* uRe, float* uIm, float* vRe, float* vIm,
+		float wRe, float wIm, int count)
+	{
+		for (int k = 0; k < count; ++k)
+		{
+			const float dRe = uRe[k] - vRe[k];
+			const float dIm = uIm[k] - vIm[k];
+			uRe[k] += vRe[k];
+			uIm[k] += vIm[k];
+			vRe[k] = dRe * wRe - dIm * wIm;
+			vIm[k] = dRe * wIm + dIm * wRe;
+		}
+	}
+
+	// The last two stages of a transform along a line of 'count' points, a group of four
+	// points at a time: spans 2 and 1, whose twiddles are 1, i and 1.
+	typedef void (*Radix4Fn)(float* re, float* im, int count);
+
+	void Radix4Scalar(float* re, float* im, int count)
+	{
+		for (int g = 0; g < count; g += 4)
+		{
+			float* r = re + g;
+			float* m = im + g;
+
+			const float a0Re = r[0] + r[2];
+			const float a0Im = m[0] + m[2];
+			const float a1Re = r[1] + r[3];
+			const float a1Im = m[1] + m[3];
+			const float a2Re = r[0] - r[2];
+			const float a2Im = m[0] - m[2];
+			const float a3Re = m[3] - m[1];
+			const float a3Im = r[1] - r[3];
+
+			r[0] = a0Re + a1Re;
+			m[0] = a0Im + a1Im;
+			r[1] = a0Re - a1Re;
+			m[1] = a0Im - a1Im;
+			r[2] = a2Re + a3Re;
+			m[2] = a2Im + a3Im;
+			r[3] = a2Re - a3Re;
+			m[3] = a2Im - a3Im;
+		}
+	}
+
+	// One row of the spectrum: its constants, and where the three transforms go.
+	struct SpectrumRow
+	{
+		const float* SumRe;
+		const float* SumIm;
+		const float* DifferenceRe;
+		const float* DifferenceIm;
+		const float* Cycles;
+		const float* InvWaveNumbers;
+		const float* WaveNumbersX;
+		float WaveNumberZ;
+		float* Re[TransformCount];
+		float* Im[TransformCount];
+	};
+
+	// Evolves the points [begin, end) of a row to 'repeats' RepeatTimes and writes
+	// the three transforms:
+	//   h = (h0 + conj(h0-)) cos(wt) - i (h0 - conj(h0-)) sin(wt)
+	//   (1 - kx) h                      = h + i (i kx h)
+	//   (kx / k) h + i kz h             = i kz h + i (-i kx / k h)
+	//   -i (kz / k) h
+	// Each pairs two fields whose transforms are real, one in each part.
+	typedef void (*EvolveRowFn)(const SpectrumRow& row, float repeats, int begin, int end);
+
+	void EvolveRowScalar(const SpectrumRow& row, float repeats, int begin, int end)
+	{
+		const float kz = row.WaveNumberZ;
+		for (int j = begin; j < end; ++j)
+		{
+			// The phase in turns, brought into [-1/2, 1/2].
+			const float turns = row.Cycles[j] * repeats;
+			float phase = turns - std::floor(turns);
+			if (phase > 0.5f)
+				phase -= 1.0f;
+
+			const float c = std::cos(TwoPi * phase);
+			const float s = std::sin(TwoPi * phase);
+			const float hRe = row.SumRe[j] * c + row.DifferenceIm[j] * s;
+			const float hIm = row.SumIm[j] * c - row.DifferenceRe[j] * s;
+
+			const float kx = row.WaveNumbersX[j];
+			const float invK = row.InvWaveNumbers[j];
+			row.Re[0][j] = (1.0f - kx) * hRe;
+			row.Im[0][j] = (1.0f - kx) * hIm;
+			row.Re[1][j] = kx * invK * hRe - kz * hIm;
+			row.Im[1][j] = kx * invK * hIm + kz * hRe;
+			row.Re[2][j] = kz * invK * hIm;
+			row.Im[2][j] = -kz * invK * hRe;
+		}
+	}
+
+#if defined(OCEAN_X86)
+	void ButterflySse2(float* uRe, float* uIm, float* vRe, float* vIm,
+		const float* wRe, const float* wIm, int count)
+	{
+		int k = 0;
+		for (; k + 4 <= count; k += 4)
+		{
+			const __m128 ur = _mm_loadu_ps(uRe + k);
+			const __m128 ui = _mm_loadu_ps(uIm + k);
+			const __m128 vr = _mm_loadu_ps(vRe + k);
+			const __m128 vi = _mm_loadu_ps(vIm + k);
+			const __m128 wr = _mm_loadu_ps(wRe + k);
+			const __m128 wi = _mm_loadu_ps(wIm + k);
+			const __m128 dr = _mm_sub_ps(ur, vr);
+			const __m128 di = _mm_sub_ps(ui, vi);
+
+			_mm_storeu_ps(uRe + k, _mm_add_ps(ur, vr));
+			_mm_storeu_ps(uIm + k, _mm_add_ps(ui, vi));
+			_mm_storeu_ps(vRe + k, _mm_sub_ps(_mm_mul_ps(dr, wr), _mm_mul_ps(di, wi)));
+			_mm_storeu_ps(vIm + k, _mm_add_ps(_mm_mul_ps(dr, wi), _mm_mul_ps(di, wr)));
+		}
+
+		ButterflyScalar(uRe + k, uIm + k, vRe + k, vIm + k, wRe + k, wIm + k, count - k);
+	}
+
+	void ButterflyUniformSse2(float* uRe, float* uIm, float* vRe, float* vIm,
+		float wRe, float wIm, int count)
+	{
+		const __m128 wr = _mm_set1_ps(wRe);
+		const __m128 wi = _mm_set1_ps(wIm);
+
+		int k = 0;
+		for (; k + 4 <= count; k += 4)
+		{
+			const __m128 ur = _mm_loadu_ps(uRe + k);
+			const __m128 ui = _mm_loadu_ps(uIm + k);
+			const __m128 vr = _mm_loadu_ps(vRe + k);
+			const __m128 vi = _mm_loadu_ps(vIm + k);
+			const __m128 dr = _mm_sub_ps(ur, vr);
+			const __m128 di = _mm_sub_ps(ui, vi);
+
+			_mm_storeu_ps(uRe + k, _mm_add_ps(ur, vr));
+			_mm_storeu_ps(uIm + k, _mm_add_ps(ui, vi));
+			_mm_storeu_ps(vRe + k, _mm_sub_ps(_mm_mul_ps(dr, wr), _mm_mul_ps(di, wi)));
+			_mm_storeu_ps(vIm + k, _mm_add_ps(_mm_mul_ps(dr, wi), _mm_mul_ps(di, wr)));
+		}
+
+		ButterflyUniformScalar(uRe + k, uIm + k, vRe + k, vIm + k, wRe, wIm, count - k);
+	}
+
+	// Four groups at a time: a 4x4 transpose puts point p of every group in lane order
+	// in one register.
+	void Radix4Sse2(float* re, float* im, int count)
+	{
+		int g = 0;
+		for (; g + 16 <= count; g += 16)
+		{
+			__m128 r0 = _mm_loadu_ps(re + g);
+			__m128 r1 = _mm_loadu_ps(re + g + 4);
+			__m128 r2 = _mm_loadu_ps(re + g + 8);
+			__m128 r3 = _mm_loadu_ps(re + g + 12);
+			__m128 m0 = _mm_loadu_ps(im + g);
+			__m128 m1 = _mm_loadu_ps(im + g + 4);
+			__m128 m2 = _mm_loadu_ps(im + g + 8);
+			__m128 m3 = _mm_loadu_ps(im + g + 12);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+			const __m128 a0Re = _mm_add_ps(r0, r2);
+			const __m128 a0Im = _mm_add_ps(m0, m2);
+			const __m128 a1Re = _mm_add_ps(r1, r3);
+			const __m128 a1Im = _mm_add_ps(m1, m3);
+			const __m128 a2Re = _mm_sub_ps(r0, r2);
+			const __m128 a2Im = _mm_sub_ps(m0, m2);
+			const __m128 a3Re = _mm_sub_ps(m3, m1);
+			const __m128 a3Im = _mm_sub_ps(r1, r3);
+
+			r0 = _mm_add_ps(a0Re, a1Re);
+			m0 = _mm_add_ps(a0Im, a1Im);
+			r1 = _mm_sub_ps(a0Re, a1Re);
+			m1 = _mm_sub_ps(a0Im, a1Im);
+			r2 = _mm_add_ps(a2Re, a3Re);
+			m2 = _mm_add_ps(a2Im, a3Im);
+			r3 = _mm_sub_ps(a2Re, a3Re);
+			m3 = _mm_sub_ps(a2Im, a3Im);
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+			_mm_storeu_ps(re + g, r0);
+			_mm_storeu_ps(re + g + 4, r1);
+			_mm_storeu_ps(re + g + 8, r2);
+			_mm_storeu_ps(re + g + 12, r3);
+			_mm_storeu_ps(im + g, m0);
+			_mm_storeu_ps(im + g + 4, m1);
+			_mm_storeu_ps(im + g + 8, m2);
+			_mm_storeu_ps(im + g + 12, m3);
+		}
+
+		Radix4Scalar(re + g, im + g, count - g);
+	}
+
+	// sin and cos of x in [-pi, pi], with the polynomials of XMScalarSinCos: beyond
+	// +-pi/2 x is reflected to pi - x or -pi - x, which flips the sign of the cosine.
+	void SinCosSse2(__m128 x, __m128& s, __m128& c)
+	{
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		const __m128 reflect = _mm_cmpgt_ps(_mm_andnot_ps(signBit, x), _mm_set1_ps(HalfPi));
+		const __m128 reflected = _mm_sub_ps(_mm_or_ps(_mm_set1_ps(Pi), _mm_and_ps(x, signBit)), x);
+		const __m128 y = _mm_or_ps(_mm_and_ps(reflect, reflected), _mm_andnot_ps(reflect, x));
+		const __m128 y2 = _mm_mul_ps(y, y);
+
+		__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-2.3889859e-08f), y2), _mm_set1_ps(2.7525562e-06f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(-0.00019840874f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.0083333310f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(-0.16666667f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(1.0f));
+		s = _mm_mul_ps(p, y);
+
+		p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-2.6051615e-07f), y2), _mm_set1_ps(2.4760495e-05f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(-0.0013888378f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.041666638f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(-0.5f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(1.0f));
+		c = _mm_xor_ps(p, _mm_and_ps(reflect, signBit));
+	}
+
+	void EvolveRowSse2(const SpectrumRow& row, float repeats, int begin, int end)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 twoPi = _mm_set1_ps(TwoPi);
+		const __m128 Repeats = _mm_set1_ps(repeats);
+		const __m128 kz = _mm_set1_ps(row.WaveNumberZ);
+
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			// The turns are never negative, so truncating floors them.
+			const __m128 turns = _mm_mul_ps(_mm_loadu_ps(row.Cycles + j), Repeats);
+			__m128 phase = _mm_sub_ps(turns, _mm_cvtepi32_ps(_mm_cvttps_epi32(turns)));
+			phase = _mm_sub_ps(phase, _mm_and_ps(_mm_cmpgt_ps(phase, half), one));
+
+			__m128 s, c;
+			SinCosSse2(_mm_mul_ps(twoPi, phase), s, c);
+
+			const __m128 hRe = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row.SumRe + j), c),
+				_mm_mul_ps(_mm_loadu_ps(row.DifferenceIm + j), s));
+			const __m128 hIm = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(row.SumIm + j), c),
+				_mm_mul_ps(_mm_loadu_ps(row.DifferenceRe + j), s));
+
+			const __m128 kx = _mm_loadu_ps(row.WaveNumbersX + j);
+			const __m128 invK = _mm_loadu_ps(row.InvWaveNumbers + j);
+			const __m128 oneMinusKx = _mm_sub_ps(one, kx);
+			const __m128 kxOverK = _mm_mul_ps(kx, invK);
+			const __m128 kzOverK = _mm_mul_ps(kz, invK);
+
+			_mm_storeu_ps(row.Re[0] + j, _mm_mul_ps(oneMinusKx, hRe));
+			_mm_storeu_ps(row.Im[0] + j, _mm_mul_ps(oneMinusKx, hIm));
+			_mm_storeu_ps(row.Re[1] + j, _mm_sub_ps(_mm_mul_ps(kxOverK, hRe), _mm_mul_ps(kz, hIm)));
+			_mm_storeu_ps(row.Im[1] + j, _mm_add_ps(_mm_mul_ps(kxOverK, hIm), _mm_mul_ps(kz, hRe)));
+			_mm_storeu_ps(row.Re[2] + j, _mm_mul_ps(kzOverK, hIm));
+			_mm_storeu_ps(row.Im[2] + j, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(kzOverK, hRe)));
+		}
+
+		EvolveRowScalar(row, repeats, j, end);
+	}
+
+	const ButterflyFn gButterfly = ButterflySse2;
+	const ButterflyUniformFn gButterflyUniform = ButterflyUniformSse2;
+	const Radix4Fn gRadix4 = Radix4Sse2;
+	const EvolveRowFn gEvolveRow = EvolveRowSse2;
+#else
+	const ButterflyFn gButterfly = ButterflyScalar;
+	const ButterflyUniformFn gButterflyUniform = ButterflyUniformScalar;
+	const Radix4Fn gRadix4 = Radix4Scalar;
+	const EvolveRowFn gEvolveRow = EvolveRowScalar;
+#endif
+
+	// Inverse transform of a line of n points in place, which leaves it in bit-reversed
+	// order.  The spans of 4 and more pair runs of consecutive points.
+	void InverseFftLine(float* re, float* im, int n, const float* twiddleRe, const float* twiddleIm)
+	{
+		for (int span = n / 2; span >= 4; span /= 2)
+		{
+			for (int block = 0; block < n; block += 2 * span)
+			{
+				gButterfly(re + block, im + block, re + block + span, im + block + span,
+					twiddleRe + span, twiddleIm + span, span);
+			}
+		}
+
+		gRadix4(re, im, n);
+	}
+
+	// Inverse transforms of the columns [begin, end) of an n x n plane in place, which
+	// leaves them in bit-reversed order.  Every butterfly pairs two runs of a row.
+	void InverseFftColumns(float* re, float* im, int n, int begin, int end, const float* twiddleRe, const float* twiddleIm)
+	{
+		for (int span = n / 2; span >= 1; span /= 2)
+		{
+			for (int block = 0; block < n; block += 2 * span)
+			{
+				for (int k = 0; k < span; ++k)
+				{
+					const size_t u = (size_t)(block + k) * n + begin;
+					const size_t v = u + (size_t)span * n;
+					gButterflyUniform(re + u, im + u, re + v, im + v, twiddleRe[span + k], twiddleIm[span + k], end - begin);
+				}
+			}
+		}
+	}
+}
+
+Ocean::Ocean(const Settings& settings)
+{
+	const int n = settings.Resolution;
+	assert(n >= 16 && n <= 1024 && (n & (n - 1)) == 0);
+
+	mSize = n;
+	mPatchSize = settings.PatchSize;
+	mSpacing = settings.PatchSize / n;
+	mChoppiness = settings.Choppiness;
+	mRepeatTime = settings.RepeatTime;
+
+	// Wave numbers in FFT order: index j stands for j cycles per patch below n / 2 and
+	// j - n from there.  Row i lies at z = PatchSize / 2 - i * spacing, so the transform
+	// along the rows runs over -z.
+	const float dk = TwoPi / mPatchSize;
+	mWaveNumbersX.resize(n);
+	mWaveNumbersZ.resize(n);
+	for (int j = 0; j < n; ++j)
+	{
+		const int cycles = j < n / 2 ? j : j - n;
+		mWaveNumbersX[j] = cycles * dk;
+		mWaveNumbersZ[j] = -cycles * dk;
+	}
+
+	float windX = settings.WindDirection.x;
+	float windZ = settings.WindDirection.y;
+	const float windLength = std::sqrt(windX * windX + windZ * windZ);
+	windX /= windLength;
+	windZ /= windLength;
+
+	// h0(k) = (a + ib) sqrt(P(k) dk^2) / 2 with a and b standard normal, so the heights
+	// have the variance of the spectrum.  The Nyquist row and column stay zero so every
+	// transform is real.
+	const size_t planeSize = (size_t)n * n;
+	std::vector<float> h0Re(planeSize);
+	std::vector<float> h0Im(planeSize);
+	std::mt19937 engine(settings.Seed);
+	std::normal_distribution<float> gauss(0.0f, 1.0f);
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			const float kx = mWaveNumbersX[j];
+			const float kz = mWaveNumbersZ[i];
+			const float k = std::sqrt(kx * kx + kz * kz);
+
+			float variance = 0.0f;
+			if (k > 0.0f && i != n / 2 && j != n / 2)
+				variance = DirectionalSpectrum(settings, windX, windZ, kx, kz, k) * dk * dk;
+
+			const float amplitude = 0.5f * settings.Amplitude * std::sqrt(variance);
+			h0Re[i * n + j] = gauss(engine) * amplitude;
+			h0Im[i * n + j] = gauss(engine) * amplitude;
+		}
+	}
+
+	// The phases of h0(k) and conj(h0(-k)) turn in opposite directions, which keeps the
+	// spectrum Hermitian.
+	const float baseFrequency = TwoPi / mRepeatTime;
+	mSumRe.resize(planeSize);
+	mSumIm.resize(planeSize);
+	mDifferenceRe.resize(planeSize);
+	mDifferenceIm.resize(planeSize);
+	mCycles.resize(planeSize);
+	mInvWaveNumbers.resize(planeSize);
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			const size_t plus = (size_t)i * n + j;
+			const size_t minus = (size_t)((n - i) & (n - 1)) * n + ((n - j) & (n - 1));
+
+			mSumRe[plus] = h0Re[plus] + h0Re[minus];
+			mSumIm[plus] = h0Im[plus] - h0Im[minus];
+			mDifferenceRe[plus] = h0Re[plus] - h0Re[minus];
+			mDifferenceIm[plus] = h0Im[plus] + h0Im[minus];
+
+			const float kx = mWaveNumbersX[j];
+			const float kz = mWaveNumbersZ[i];
+			const float k = std::sqrt(kx * kx + kz * kz);
+			mCycles[plus] = std::floor(std::sqrt(Gravity * k) / baseFrequency);
+			mInvWaveNumbers[plus] = k > 0.0f ? 1.0f / k : 0.0f;
+		}
+	}
+
+	mTwiddleRe.resize(n);
+	mTwiddleIm.resize(n);
+	for (int span = 1; span < n; span *= 2)
+	{
+		for (int k = 0; k < span; ++k)
+		{
+			const double angle = 3.14159265358979323846 * k / span;
+			mTwiddleRe[span + k] = (float)std::cos(angle);
+			mTwiddleIm[span + k] = (float)std::sin(angle);
+		}
+	}
+
+	int bits = 0;
+	while ((1 << bits) < n)
+		++bits;
+	mBitReverse.resize(n);
+	for (int j = 0; j < n; ++j)
+	{
+		int reversed = 0;
+		for (int b = 0; b < bits; ++b)
+			reversed |= ((j >> b) & 1) << (bits - 1 - b);
+		mBitReverse[j] = reversed;
+	}
+
+	mSpectra.assign(2 * TransformCount * planeSize, 0.0f);
+	mHeights.assign(planeSize, 0.0f);
+	mSlopesX.assign(planeSize, 0.0f);
+	mSlopesZ.assign(planeSize, 0.0f);
+	mDisplacementsX.assign(planeSize, 0.0f);
+	mDisplacementsZ.assign(planeSize, 0.0f);
+
+	Update(0.0f);
+}
+
+Ocean::~Ocean()
+{
+}
+
+int Ocean::RowCount()const
+{
+	return mSize + 1;
+}
+
+int Ocean::ColumnCount()const
+{
+	return mSize + 1;
+}
+
+int Ocean::VertexCount()const
+{
+	return (mSize + 1) * (mSize + 1);
+}
+
+int Ocean::TriangleCount()const
+{
+	return mSize * mSize * 2;
+}
+
+float Ocean::Width()const
+{
+	return mPatchSize;
+}
+
+float Ocean::Depth()const
+{
+	return mPatchSize;
+}
+
+int Ocean::FieldIndex(int i)const
+{
+	int row = i / (mSize + 1);
+	int col = i % (mSize + 1);
+	return (row & (mSize - 1)) * mSize + (col & (mSize - 1));
+}
+
+XMFLOAT3 Ocean::Position(int i)const
+{
+	int row = i / (mSize + 1);
+	int col = i % (mSize + 1);
+	int f = FieldIndex(i);
+
+	float halfSize = 0.5f * mPatchSize;
+	return XMFLOAT3(-halfSize + col * mSpacing + mDisplacementsX[f], mHeights[f],
+		halfSize - row * mSpacing + mDisplacementsZ[f]);
+}
+
+XMFLOAT3 Ocean::Normal(int i)const
+{
+	int f = FieldIndex(i);
+
+	XMFLOAT3 n(-mSlopesX[f], 1.0f, -mSlopesZ[f]);
+	XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+XMFLOAT3 Ocean::TangentX(int i)const
+{
+	int f = FieldIndex(i);
+
+	XMFLOAT3 tangent(1.0f, mSlopesX[f], 0.0f);
+	XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
+	return tangent;
+}
+
+void Ocean::Sample(const Waves::SampleBatch& batch)const
+{
+	assert(batch.Velocities == nullptr);
+
+	const float halfSize = 0.5f * mPatchSize;
+	const float invSpacing = 1.0f / mSpacing;
+	const int mask = mSize - 1;
+	const bool normals = batch.NormalsX || batch.NormalsY || batch.NormalsZ;
+
+	for (int k = 0; k < batch.Count; ++k)
+	{
+		// Field points along x and against z; the field repeats every mSize of them.
+		const float u = (batch.X[k] + halfSize) * invSpacing;
+		const float v = (halfSize - batch.Z[k]) * invSpacing;
+		const float u0 = std::floor(u);
+		const float v0 = std::floor(v);
+		const float wu = u - u0;
+		const float wv = v - v0;
+
+		const int col0 = (int)u0 & mask;
+		const int col1 = (col0 + 1) & mask;
+		const int row0 = ((int)v0 & mask) * mSize;
+		const int row1 = (((int)v0 + 1) & mask) * mSize;
+
+		auto filter = [&](const std::vector<float>& field)
+		{
+			return (1.0f - wv) * ((1.0f - wu) * field[row0 + col0] + wu * field[row0 + col1]) +
+				wv * ((1.0f - wu) * field[row1 + col0] + wu * field[row1 + col1]);
+		};
+
+		if (batch.Heights)
+			batch.Heights[k] = filter(mHeights);
+
+		if (normals)
+		{
+			const float slopeX = filter(mSlopesX);
+			const float slopeZ = filter(mSlopesZ);
+			const float invLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+			if (batch.NormalsX)
+				batch.NormalsX[k] = -slopeX * invLength;
+			if (batch.NormalsY)
+				batch.NormalsY[k] = invLength;
+			if (batch.NormalsZ)
+				batch.NormalsZ[k] = -slopeZ * invLength;
+		}
+	}
+}
+
+void Ocean::EvolveRows(int begin, int end)
+{
+	const size_t planeSize = (size_t)mSize * mSize;
+	const float repeats = mTime / mRepeatTime;
+
+	for (int i = begin; i < end; ++i)
+	{
+		const size_t row = (size_t)i * mSize;
+
+		SpectrumRow spectrum;
+		spectrum.SumRe = mSumRe.data() + row;
+		spectrum.SumIm = mSumIm.data() + row;
+		spectrum.DifferenceRe = mDifferenceRe.data() + row;
+		spectrum.DifferenceIm = mDifferenceIm.data() + row;
+		spectrum.Cycles = mCycles.data() + row;
+		spectrum.InvWaveNumbers = mInvWaveNumbers.data() + row;
+		spectrum.WaveNumbersX = mWaveNumbersX.data();
+		spectrum.WaveNumberZ = mWaveNumbersZ[i];
+		for (int t = 0; t < TransformCount; ++t)
+		{
+			spectrum.Re[t] = mSpectra.data() + (2 * t) * planeSize + row;
+			spectrum.Im[t] = mSpectra.data() + (2 * t + 1) * planeSize + row;
+		}
+
+		gEvolveRow(spectrum, repeats, 0, mSize);
+
+		for (int t = 0; t < TransformCount; ++t)
+			InverseFftLine(spectrum.Re[t], spectrum.Im[t], mSize, mTwiddleRe.data(), mTwiddleIm.data());
+	}
+}
+
+void Ocean::TransformColumns(int transform, int begin, int end)
+{
+	const size_t planeSize = (size_t)mSize * mSize;
+	float* re = mSpectra.data() + (2 * transform) * planeSize;
+	float* im = mSpectra.data() + (2 * transform + 1) * planeSize;
+	InverseFftColumns(re, im, mSize, begin, end, mTwiddleRe.data(), mTwiddleIm.data());
+}
+
+void Ocean::UnpackRows(int begin, int end)
+{
+	const size_t planeSize = (size_t)mSize * mSize;
+	const float* spectra = mSpectra.data();
+
+	// Both transforms left their output in bit-reversed order.
+	for (int i = begin; i < end; ++i)
+	{
+		const size_t source = (size_t)mBitReverse[i] * mSize;
+		const float* heights = spectra + source;
+		const float* slopesX = spectra + planeSize + source;
+		const float* slopesZ = spectra + 2 * planeSize + source;
+		const float* displacementsX = spectra + 3 * planeSize + source;
+		const float* displacementsZ = spectra + 4 * planeSize + source;
+
+		const size_t row = (size_t)i * mSize;
+		for (int j = 0; j < mSize; ++j)
+		{
+			const int s = mBitReverse[j];
+			mHeights[row + j] = heights[s];
+			mSlopesX[row + j] = slopesX[s];
+			mSlopesZ[row + j] = slopesZ[s];
+			mDisplacementsX[row + j] = mChoppiness * displacementsX[s];
+			mDisplacementsZ[row + j] = mChoppiness * displacementsZ[s];
+		}
+	}
+}
+
+void Ocean::WriteRow(int i, std::uint8_t* vertices, const VertexFormat& format)const
+{
+	const int columns = mSize + 1;
+	const float halfSize = 0.5f * mPatchSize;
+	const float z = halfSize - i * mSpacing;
+	const float texV = (float)i / mSize;
+
+	const size_t row = (size_t)(i & (mSize - 1)) * mSize;
+	const float* heights = mHeights.data() + row;
+	const float* slopesX = mSlopesX.data() + row;
+	const float* slopesZ = mSlopesZ.data() + row;
+	const float* displacementsX = mDisplacementsX.data() + row;
+	const float* displacementsZ = mDisplacementsZ.data() + row;
+
+	std::uint8_t* out = vertices + (size_t)i * columns * format.Stride;
+	for (int j = 0; j < columns; ++j, out += format.Stride)
+	{
+		const int f = j & (mSize - 1);
+
+		if (format.PositionOffset != Waves::NoAttribute)
+		{
+			const float position[3] = { -halfSize + j * mSpacing + displacementsX[f], heights[f], z + displacementsZ[f] };
+			std::memcpy(out + format.PositionOffset, position, sizeof(position));
+		}
+		if (format.NormalOffset != Waves::NoAttribute)
+		{
+			const float invLength = 1.0f / std::sqrt(slopesX[f] * slopesX[f] + 1.0f + slopesZ[f] * slopesZ[f]);
+			const float normal[3] = { -slopesX[f] * invLength, invLength, -slopesZ[f] * invLength };
+			std::memcpy(out + format.NormalOffset, normal, sizeof(normal));
+		}
+		if (format.HalfHeightOffset != Waves::NoAttribute)
+		{
+			const std::uint16_t height = Waves::PackHeight(heights[f]);
+			std::memcpy(out + format.HalfHeightOffset, &height, sizeof(height));
+		}
+		if (format.OctNormalOffset != Waves::NoAttribute)
+		{
+			// The octahedral encoding does not need a unit normal.
+			const std::uint16_t normal = Waves::PackNormal(-slopesX[f], 1.0f, -slopesZ[f]);
+			std::memcpy(out + format.OctNormalOffset, &normal, sizeof(normal));
+		}
+		if (format.TexCoordOffset != Waves::NoAttribute)
+		{
+			const float texC[2] = { (float)j / mSize, texV };
+			std::memcpy(out + format.TexCoordOffset, texC, sizeof(texC));
+		}
+		if (format.TangentOffset != Waves::NoAttribute)
+		{
+			const float invLength = 1.0f / std::sqrt(1.0f + slopesX[f] * slopesX[f]);
+			const float tangent[3] = { invLength, slopesX[f] * invLength, 0.0f };
+			std::memcpy(out + format.TangentOffset, tangent, sizeof(tangent));
+		}
+	}
+}
+
+void Ocean::Update(float dt)
+{
+	mTime = std::fmod(mTime + dt, mRepeatTime);
+
+	JobSystem& jobs = JobSystem::Default();
+
+	// Evolve the spectrum and transform it along x, a band of rows at a time.
+	jobs.ParallelFor(mSize, EvolveRowGrain, [this](size_t begin, size_t end)
+	{
+		EvolveRows((int)begin, (int)end);
+	});
+
+	// Transform along z, a strip of columns of one transform at a time.
+	const int strips = (mSize + ColumnStrip - 1) / ColumnStrip;
+	jobs.ParallelFor(TransformCount * strips, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t task = begin; task < end; ++task)
+		{
+			const int first = (int)(task % strips) * ColumnStrip;
+			TransformColumns((int)(task / strips), first, std::min(first + ColumnStrip, mSize));
+		}
+	});
+
+	jobs.ParallelFor(mSize, RowGrain, [this](size_t begin, size_t end)
+	{
+		UnpackRows((int)begin, (int)end);
+	});
+}
+
+void Ocean::Update(float dt, void* vertices, const VertexFormat& format)
+{
+	Update(dt);
+
+	std::uint8_t* out = static_cast<std::uint8_t*>(vertices);
+	JobSystem::Default().ParallelFor(mSize + 1, RowGrain, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			WriteRow((int)i, out, format);
+	});
+}
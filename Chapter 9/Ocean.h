@@ -0,0 +1,174 @@
+//***************************************************************************************
+// Ocean.h
+//
+// A tileable patch of open water after Tessendorf, "Simulating Ocean Water".  The
+// surface is a sum of Resolution x Resolution waves whose amplitudes are drawn from
+// a Phillips or JONSWAP spectrum and whose phases advance with the deep-water
+// dispersion relation.  Update() evolves the spectrum to the current time and
+// transforms it back to the heights, slopes and horizontal (choppy) displacements at
+// the grid points with three inverse 2D FFTs, run on the JobSystem a band of rows or
+// a strip of columns at a time.  The cost depends only on the resolution; the patch
+// repeats every PatchSize in x and z, so copies of it tile the plane.
+//
+// The interface follows Waves: the same vertex grid queries, and an Update() that
+// writes vertices in a Waves::VertexFormat, so an app can draw either.  The vertex
+// grid has Resolution + 1 points along each side, the last row and column repeating
+// the first, so neighbouring patches meet without cracks.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Waves.h"
+
+class Ocean
+{
+public:
+	using VertexFormat = Waves::VertexFormat;
+
+	enum class SpectrumModel
+	{
+		// Tessendorf's fully developed sea for the wind speed.
+		Phillips,
+
+		// A sea still growing over the fetch, with a sharper peak.
+		Jonswap
+	};
+
+	struct Settings
+	{
+		// Grid points along each side; a power of two from 16 to 1024.
+		int Resolution = 128;
+
+		// Side of the patch in metres.
+		float PatchSize = 256.0f;
+
+		SpectrumModel Spectrum = SpectrumModel::Phillips;
+
+		// Wind speed 10 m above the water in m/s, and the xz direction it blows to.
+		// The waves run within 90 degrees of it.
+		float WindSpeed = 10.0f;
+		DirectX::XMFLOAT2 WindDirection = { 1.0f, 0.0f };
+
+		// JONSWAP only: how far the wind has blown over open water, in metres, and the
+		// peak enhancement factor.
+		float Fetch = 100000.0f;
+		float PeakEnhancement = 3.3f;
+
+		// Scales the wave heights; 1 keeps the energy of the spectrum.
+		float Amplitude = 1.0f;
+
+		// Scales the horizontal displacement: 0 gives rounded crests, about 1 sharp ones,
+		// and much more makes the surface fold over itself.
+		float Choppiness = 1.0f;
+
+		// Waves much shorter than this, in metres, are damped out.
+		float SmallWaveLength = 0.5f;
+
+		// The surface repeats after this many seconds: the frequencies are rounded down
+		// to multiples of 2 pi / RepeatTime, which keeps the phases exact however long
+		// the simulation runs.
+		float RepeatTime = 200.0f;
+
+		std::uint32_t Seed = 1;
+	};
+
+public:
+	explicit Ocean(const Settings& settings);
+	Ocean(const Ocean& rhs) = delete;
+	Ocean& operator=(const Ocean& rhs) = delete;
+	~Ocean();
+
+	int RowCount()const;
+	int ColumnCount()const;
+	int VertexCount()const;
+	int TriangleCount()const;
+	float Width()const;
+	float Depth()const;
+
+	// Returns the displaced surface point at the ith vertex.
+	DirectX::XMFLOAT3 Position(int i)const;
+
+	// Returns the surface normal at the ith vertex, from the slopes.
+	DirectX::XMFLOAT3 Normal(int i)const;
+
+	// Returns the unit tangent vector at the ith vertex in the local x-axis direction.
+	DirectX::XMFLOAT3 TangentX(int i)const;
+
+	// The surface over each world position, for the patch centred on the origin and its
+	// copies: the height and the unit normal from the slopes, bilinearly interpolated
+	// between the grid points, as OceanVS places them.  The choppy displacement is not
+	// inverted, so a position takes the surface that started above it.  The ocean has
+	// no velocities; batch.Velocities must be null.
+	void Sample(const Waves::SampleBatch& batch)const;
+
+	// Seconds into the RepeatTime cycle.
+	float Time()const { return mTime; }
+
+	// The fields at the Resolution x Resolution grid points: row i (z) starts at
+	// i * RowPitch().  The displacements are already scaled by the choppiness.
+	const float* Heights()const { return mHeights.data(); }
+	const float* SlopesX()const { return mSlopesX.data(); }
+	const float* SlopesZ()const { return mSlopesZ.data(); }
+	const float* DisplacementsX()const { return mDisplacementsX.data(); }
+	const float* DisplacementsZ()const { return mDisplacementsZ.data(); }
+	int RowPitch()const { return mSize; }
+
+	// Advances the time by dt and works out the fields for it.  Any dt is fine: the
+	// surface is evaluated at the time, not stepped towards it.
+	void Update(float dt);
+
+	// Update(dt), and every vertex written to 'vertices' in grid order, as
+	// Waves::Update() does.  Texture coordinates run from 0 to 1 across the
+	// undisplaced patch, so they do not swim with the choppy displacement.  The compact
+	// attributes have no room for the displacement, and suit a Choppiness of 0.
+	void Update(float dt, void* vertices, const VertexFormat& format);
+
+private:
+	// The field index of the ith vertex.
+	int FieldIndex(int i)const;
+
+	void EvolveRows(int begin, int end);
+	void TransformColumns(int plane, int begin, int end);
+	void UnpackRows(int begin, int end);
+	void WriteRow(int i, std::uint8_t* vertices, const VertexFormat& format)const;
+
+private:
+	int mSize = 0;
+	float mPatchSize = 0.0f;
+	float mSpacing = 0.0f;
+	float mChoppiness = 0.0f;
+	float mRepeatTime = 0.0f;
+	float mTime = 0.0f;
+
+	// Per wave vector, in FFT order: h0(k) + conj(h0(-k)) and h0(k) - conj(h0(-k)),
+	// whose phases turn at the angular frequency mCycles * 2 pi / RepeatTime, and
+	// 1 / |k| (0 for k = 0).  mWaveNumbersX holds kx per column, mWaveNumbersZ kz per row.
+	std::vector<float> mSumRe;
+	std::vector<float> mSumIm;
+	std::vector<float> mDifferenceRe;
+	std::vector<float> mDifferenceIm;
+	std::vector<float> mCycles;
+	std::vector<float> mInvWaveNumbers;
+	std::vector<float> mWaveNumbersX;
+	std::vector<float> mWaveNumbersZ;
+
+	// FFT tables: e^(i pi k / h) at [h + k] for each butterfly span h, and the
+	// bit-reversed order the transforms leave their output in.
+	std::vector<float> mTwiddleRe;
+	std::vector<float> mTwiddleIm;
+	std::vector<int> mBitReverse;
+
+	// The three spectra being transformed, as real and imaginary planes: height and
+	// x slope, z slope and x displacement, z displacement.
+	std::vector<float> mSpectra;
+
+	std::vector<float> mHeights;
+	std::vector<float> mSlopesX;
+	std::vector<float> mSlopesZ;
+	std::vector<float> mDisplacementsX;
+	std::vector<float> mDisplacementsZ;
+};
@@ -0,0 +1,223 @@
+//***************************************************************************************
+// OceanClipmap.cpp
+//***************************************************************************************
+
+#include "OceanClipmap.h"
+#include "../Common/JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Height, x displacement, z displacement, x slope, z slope.
+	const int FieldCount = 5;
+
+	// Rows per task when a mip is filtered and packed.
+	const size_t RowGrain = 16;
+
+	uint32_t PackPair(float low, float high)
+	{
+		return (uint32_t)Waves::PackHeight(low) | ((uint32_t)Waves::PackHeight(high) << 16);
+	}
+
+	// The multiple of 'step' nearest to x, in steps.
+	long long NearestMultiple(float x, double step)
+	{
+		return (long long)std::floor(x / step + 0.5);
+	}
+}
+
+void OceanClipmap::Build(const Ocean& ocean, const Settings& settings)
+{
+	assert(settings.GridSize % 4 == 0 && settings.GridSize >= 16 && settings.GridSize <= 252);
+	assert(settings.LevelCount >= 1 && settings.LevelCount <= MaxLevelCount);
+
+	mGridSize = settings.GridSize;
+	mLevelCount = settings.LevelCount;
+	mFinestSpacing = settings.FinestSpacing;
+
+	mFieldResolution = (uint32)ocean.RowPitch();
+	mFieldMipCount = 1;
+	while ((mFieldResolution >> mFieldMipCount) != 0)
+		++mFieldMipCount;
+
+	const float fieldSpacing = ocean.Width() / mFieldResolution;
+	mFieldMipBias = (int)std::lround(std::log2(mFinestSpacing / fieldSpacing));
+
+	// Mip 0 is read straight from the ocean.
+	mMipOffsets.assign(mFieldMipCount, 0);
+	size_t offset = 0;
+	for (uint32 mip = 1; mip < mFieldMipCount; ++mip)
+	{
+		const size_t size = mFieldResolution >> mip;
+		mMipOffsets[mip] = offset;
+		offset += FieldCount * size * size;
+	}
+	mMips.assign(offset, 0.0f);
+}
+
+void OceanClipmap::Place(const XMFLOAT3& eye, std::vector<Level>& levels)const
+{
+	levels.resize(mLevelCount);
+
+	long long finerX = 0;
+	long long finerZ = 0;
+	for (uint32 l = 0; l < mLevelCount; ++l)
+	{
+		const double spacing = std::ldexp((double)mFinestSpacing, (int)l);
+
+		// The centre, in steps of twice the spacing.
+		const long long centreX = NearestMultiple(eye.x, 2.0 * spacing);
+		const long long centreZ = NearestMultiple(eye.z, 2.0 * spacing);
+
+		Level& level = levels[l];
+		level.X = (float)((2 * centreX - mGridSize / 2) * spacing);
+		level.Z = (float)((2 * centreZ - mGridSize / 2) * spacing);
+		level.Size = (float)(mGridSize * spacing);
+
+		// The finer centre, in steps of this spacing, is within a step of this one.
+		if (l == 0)
+		{
+			level.Hole = NoHole;
+		}
+		else
+		{
+			const long long offsetX = finerX - 2 * centreX;
+			const long long offsetZ = finerZ - 2 * centreZ;
+			assert(offsetX >= -1 && offsetX <= 1 && offsetZ >= -1 && offsetZ <= 1);
+			level.Hole = (uint32)((offsetX + 1) + 3 * (offsetZ + 1));
+		}
+
+		const int lastMip = (int)mFieldMipCount - 1;
+		level.FieldMip = (uint32)std::min(std::max((int)l + mFieldMipBias, 0), lastMip);
+		level.NextFieldMip = (uint32)std::min(std::max((int)l + 1 + mFieldMipBias, 0), lastMip);
+
+		finerX = centreX;
+		finerZ = centreZ;
+	}
+}
+
+void OceanClipmap::WriteField(const Ocean& ocean, void* texels)
+{
+	assert((uint32)ocean.RowPitch() == mFieldResolution);
+
+	const float* source[FieldCount] = { ocean.Heights(), ocean.DisplacementsX(), ocean.DisplacementsZ(),
+		ocean.SlopesX(), ocean.SlopesZ() };
+
+	JobSystem& jobs = JobSystem::Default();
+	FieldTexel* out = static_cast<FieldTexel*>(texels);
+
+	// Each row of a mip only needs two rows of the one before, so a task filters its
+	// rows and packs them while they are in cache.
+	uint32 size = mFieldResolution;
+	for (uint32 mip = 0; mip < mFieldMipCount; ++mip)
+	{
+		const float* planes[FieldCount];
+		float* target[FieldCount] = {};
+		for (int f = 0; f < FieldCount; ++f)
+		{
+			if (mip == 0)
+			{
+				planes[f] = source[f];
+			}
+			else
+			{
+				target[f] = mMips.data() + mMipOffsets[mip] + (size_t)f * size * size;
+				planes[f] = target[f];
+			}
+		}
+
+		jobs.ParallelFor(size, RowGrain, [&](size_t begin, size_t end)
+		{
+			if (mip > 0)
+				DownsampleRows(source, size, target, (int)begin, (int)end);
+			PackRows(planes, size, out, (int)begin, (int)end);
+		});
+
+		for (int f = 0; f < FieldCount; ++f)
+			source[f] = planes[f];
+
+		out += (size_t)size * size;
+		size /= 2;
+	}
+}
+
+void OceanClipmap::BuildGrid(uint32 gridSize, std::vector<XMFLOAT2>& vertices, std::vector<uint16>& indices)
+{
+	const uint32 n = gridSize + 1;
+	assert(n * n <= 0x10000);
+
+	vertices.resize(n * n);
+	for (uint32 z = 0; z < n; ++z)
+		for (uint32 x = 0; x < n; ++x)
+			vertices[z * n + x] = XMFLOAT2((float)x / gridSize, (float)z / gridSize);
+
+	indices.resize(IndexStart(gridSize, NoHole) + IndexCount(gridSize, NoHole));
+
+	size_t k = 0;
+	for (uint32 hole = 0; hole <= NoHole; ++hole)
+	{
+		// The cells [first, first + gridSize / 2) in x and z are left out.
+		const uint32 firstX = gridSize / 4 + hole % 3 - 1;
+		const uint32 firstZ = gridSize / 4 + hole / 3 - 1;
+
+		for (uint32 z = 0; z < gridSize; ++z)
+		{
+			for (uint32 x = 0; x < gridSize; ++x)
+			{
+				if (hole != NoHole && x - firstX < gridSize / 2 && z - firstZ < gridSize / 2)
+					continue;
+
+				// Same winding as Terrain::BuildPatch.
+				indices[k] = (uint16)((z + 1) * n + x);
+				indices[k + 1] = (uint16)((z + 1) * n + x + 1);
+				indices[k + 2] = (uint16)(z * n + x);
+
+				indices[k + 3] = (uint16)(z * n + x);
+				indices[k + 4] = (uint16)((z + 1) * n + x + 1);
+				indices[k + 5] = (uint16)(z * n + x + 1);
+
+				k += 6;
+			}
+		}
+	}
+	assert(k == indices.size());
+}
+
+void OceanClipmap::DownsampleRows(const float* const source[], uint32 size, float* const target[], int begin, int end)
+{
+	const uint32 sourceSize = 2 * size;
+	for (int f = 0; f < FieldCount; ++f)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			const float* row0 = source[f] + (size_t)(2 * i) * sourceSize;
+			const float* row1 = row0 + sourceSize;
+			float* out = target[f] + (size_t)i * size;
+
+			for (uint32 j = 0; j < size; ++j)
+				out[j] = 0.25f * ((row0[2 * j] + row0[2 * j + 1]) + (row1[2 * j] + row1[2 * j + 1]));
+		}
+	}
+}
+
+void OceanClipmap::PackRows(const float* const planes[], uint32 size, FieldTexel* out, int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		const size_t row = (size_t)i * size;
+		for (uint32 j = 0; j < size; ++j)
+		{
+			const size_t t = row + j;
+
+			FieldTexel texel;
+			texel.HeightDisplacementX = PackPair(planes[0][t], planes[1][t]);
+			texel.DisplacementZSlopeX = PackPair(planes[2][t], planes[3][t]);
+			texel.SlopeZ = PackPair(planes[4][t], 0.0f);
+			out[t] = texel;
+		}
+	}
+}
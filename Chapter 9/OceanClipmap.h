@@ -0,0 +1,146 @@
+//***************************************************************************************
+// OceanClipmap.h
+//
+// Open water out to the horizon at a fixed cost per frame, drawn as nested square
+// grids around the eye after Losasso and Hoppe, "Geometry Clipmaps".  Every level is
+// GridSize x GridSize cells, and each level's cells are twice the size of the one
+// inside it, so the water drawn doubles in size with each level while the vertices
+// only grow by one grid.  Level 0 is the whole grid; the others leave out the
+// square in the middle that the finer level covers.
+//
+// Place() puts each level's centre on the multiple of twice its spacing nearest the
+// eye, so its vertices stay put on the water while the eye moves inside a cell and
+// then jump by two, which the surface does not show.  The finer level then sits a
+// cell off the middle of the coarser one in x and z or not at all, and the coarser
+// one is drawn with the indices that leave out the square at that offset: nine index
+// ranges of one vertex grid, plus one for the whole grid.
+//
+// The vertex shader reads the surface from a periodic Ocean field, which
+// WriteField() uploads with a mip chain of box-filtered copies.  Level l reads the
+// mip whose texels are as far apart as its vertices, so the far levels neither
+// alias nor shimmer.  Near its outer edge a level morphs into the next: the odd
+// vertices slide onto their even neighbours and the field fades to the next mip, so
+// both levels meet on the same vertices and heights without cracks.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Ocean.h"
+
+class OceanClipmap
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	static const uint32 MaxLevelCount = 16;
+
+	// The index ranges of the grid: the square left out lies one cell towards smaller
+	// x, in the middle, or one cell towards larger x for Hole % 3 of 0, 1 or 2, and the
+	// same along z for Hole / 3.  NoHole is the whole grid.
+	static const uint32 HoleCount = 9;
+	static const uint32 NoHole = HoleCount;
+
+	struct Settings
+	{
+		// Cells along each side of every level; a multiple of 4 from 16 to 252.
+		uint32 GridSize = 64;
+
+		// Levels, each twice the side of the one before.  The water reaches about
+		// GridSize / 2 * FinestSpacing * 2^(LevelCount - 1) from the eye.
+		uint32 LevelCount = 6;
+
+		// Distance between the vertices of level 0.
+		float FinestSpacing = 1.0f;
+	};
+
+	// A level placed by Place().
+	struct Level
+	{
+		float X = 0.0f;			// world xz of the corner with the smallest coordinates
+		float Z = 0.0f;
+		float Size = 0.0f;		// side; the spacing is Size / GridSize()
+		uint32 Hole = NoHole;
+
+		// The field mip the level reads, and the one it fades to at its outer edge.
+		uint32 FieldMip = 0;
+		uint32 NextFieldMip = 0;
+	};
+
+	// One texel of the field as the vertex shader reads it: half floats of the height
+	// and the x displacement, the z displacement and the x slope, and the z slope, the
+	// first of each pair in the low 16 bits.
+	struct FieldTexel
+	{
+		uint32 HeightDisplacementX;
+		uint32 DisplacementZSlopeX;
+		uint32 SlopeZ;
+	};
+
+public:
+	OceanClipmap() = default;
+	OceanClipmap(const OceanClipmap& rhs) = delete;
+	OceanClipmap& operator=(const OceanClipmap& rhs) = delete;
+	~OceanClipmap() = default;
+
+	// Sets up the levels for the fields of 'ocean'.  No reference to it is kept.
+	void Build(const Ocean& ocean, const Settings& settings);
+
+	// Replaces levels with the LevelCount() levels to draw for an eye at 'eye', finest
+	// first.
+	void Place(const DirectX::XMFLOAT3& eye, std::vector<Level>& levels)const;
+
+	// Writes the current fields of the ocean Build() was given, and their mips, as
+	// FieldTexelCount() FieldTexels: mip m is (Resolution >> m)^2 texels row by row
+	// (z), after the mips before it, and its texel (i, j) averages the 2^m x 2^m
+	// field points from (i, j) * 2^m.  Suits mapped upload memory.
+	void WriteField(const Ocean& ocean, void* texels);
+
+	uint32 GridSize()const { return mGridSize; }
+	uint32 LevelCount()const { return mLevelCount; }
+	uint32 FieldResolution()const { return mFieldResolution; }
+	uint32 FieldMipCount()const { return mFieldMipCount; }
+	uint32 FieldTexelCount()const { return (4 * mFieldResolution * mFieldResolution - 1) / 3; }
+
+	// Where the levels morph, in cells of the level from the eye along x or z,
+	// whichever is further: from MorphStart() on, and fully at MorphEnd(), half a cell
+	// short of the nearest the outer edge comes.
+	float MorphStart()const { return 0.375f * mGridSize - 1.0f; }
+	float MorphEnd()const { return 0.5f * mGridSize - 1.5f; }
+
+	// The grid every level is drawn with: (gridSize + 1)^2 vertices over [0, 1]^2 in
+	// rows of increasing z, and the triangles of hole h, or of the whole grid for
+	// NoHole, in IndexCount(gridSize, h) indices from IndexStart(gridSize, h).
+	static void BuildGrid(uint32 gridSize, std::vector<DirectX::XMFLOAT2>& vertices, std::vector<uint16>& indices);
+	static uint32 IndexStart(uint32 gridSize, uint32 hole) { return hole * IndexCount(gridSize, 0); }
+	static uint32 IndexCount(uint32 gridSize, uint32 hole)
+	{
+		return (hole == NoHole ? gridSize * gridSize : gridSize * gridSize * 3 / 4) * 6;
+	}
+
+private:
+	// Box-filters rows [begin, end) of a size x size mip of the five fields from the
+	// mip before it, and packs rows [begin, end) of a mip into FieldTexels.
+	static void DownsampleRows(const float* const source[], uint32 size, float* const target[], int begin, int end);
+	static void PackRows(const float* const planes[], uint32 size, FieldTexel* out, int begin, int end);
+
+private:
+	uint32 mGridSize = 64;
+	uint32 mLevelCount = 0;
+	float mFinestSpacing = 1.0f;
+
+	uint32 mFieldResolution = 0;
+	uint32 mFieldMipCount = 0;
+
+	// Mip of level 0; each level up reads the next.
+	int mFieldMipBias = 0;
+
+	// The five fields of every mip from 1 on, in the order FieldTexel packs them, one
+	// plane after the other.
+	std::vector<float> mMips;
+	std::vector<size_t> mMipOffsets;
+};
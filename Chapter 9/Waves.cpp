@@ -3,17 +3,705 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../Common/JobSystem.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <cassert>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WAVES_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define WAVES_TARGET_AVX2
+#else
+#define WAVES_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 using namespace DirectX;
 
-Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
+namespace
+{
+	// Rows per task in the simulation step; also the bands of the fused pass.
+	const size_t StepRowGrain = 16;
+
+	// Rows per task when only vertices are written.
+	const size_t WriteRowGrain = 16;
+
+	// Columns per task in the column solves of the ADI step.
+	const size_t AdiColumnGrain = 256;
+
+	// Heights at or below which the water counts as at rest.
+	const float RestHeight = 1e-5f;
+
+	// Steps in a row a tile must stay at or below the rest height to stop being active.
+	const std::uint8_t SettleSteps = 8;
+
+	// Normals, tangents and compact attributes for the columns of a tile.
+	struct FrameBlock
+	{
+		float NormalX[Waves::TileSize];
+		float NormalY[Waves::TileSize];
+		float NormalZ[Waves::TileSize];
+		float TangentX[Waves::TileSize];
+		float TangentY[Waves::TileSize];
+
+		// The compact attributes: the half height in the low 16 bits, the packed
+		// normal in the high.
+		std::uint32_t Compact[Waves::TileSize];
+	};
+
+	void FlatFrames(FrameBlock& frames, int begin, int end)
+	{
+		for (int k = begin; k < end; ++k)
+		{
+			frames.NormalX[k] = 0.0f;
+			frames.NormalY[k] = 1.0f;
+			frames.NormalZ[k] = 0.0f;
+			frames.TangentX[k] = 1.0f;
+			frames.TangentY[k] = 0.0f;
+		}
+	}
+
+	// Normals (l - r, 2dx, b - t) and x tangents (2dx, r - l, 0), normalized, from the
+	// finite differences around row[begin, end) in a grid with rows 'pitch' apart.
+	typedef void (*ComputeFramesFn)(FrameBlock& frames, const float* row, int pitch, int begin, int end, float twoDx);
+
+	void ComputeFramesScalar(FrameBlock& frames, const float* row, int pitch, int begin, int end, float twoDx)
+	{
+		for (int k = begin; k < end; ++k)
+		{
+			const float dx = row[k - 1] - row[k + 1];
+			const float dz = row[k + pitch] - row[k - pitch];
+
+			float invLength = 1.0f / std::sqrt(dx * dx + twoDx * twoDx + dz * dz);
+			frames.NormalX[k] = dx * invLength;
+			frames.NormalY[k] = twoDx * invLength;
+			frames.NormalZ[k] = dz * invLength;
+
+			invLength = 1.0f / std::sqrt(twoDx * twoDx + dx * dx);
+			frames.TangentX[k] = twoDx * invLength;
+			frames.TangentY[k] = -dx * invLength;
+		}
+	}
+
+	// Rounds to the nearest half float.  Beyond the half range goes to infinity, and
+	// NaNs stay NaNs.
+	std::uint16_t HalfFromFloat(float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		const std::uint32_t sign = (bits >> 16) & 0x8000;
+		bits &= 0x7FFFFFFF;
+
+		std::uint32_t half;
+		if (bits >= 0x47800000)
+		{
+			half = bits > 0x7F800000 ? 0x7E00 : 0x7C00;
+		}
+		else if (bits < 0x38800000)
+		{
+			// Below the smallest normal half: adding 0.5 lines the half's subnormal
+			// steps up with the float's last mantissa bit, and rounds to them.
+			float shifted = value < 0.0f ? -value : value;
+			shifted += 0.5f;
+			std::memcpy(&half, &shifted, sizeof(half));
+			half -= 0x3F000000;
+		}
+		else
+		{
+			// Rebias the exponent and round the mantissa to 10 bits, ties to even.
+			half = (bits + 0xC8000FFF + ((bits >> 13) & 1)) >> 13;
+		}
+		return (std::uint16_t)(half | sign);
+	}
+
+	// x and z of the normal on the octahedron, the lower half folded over the upper,
+	// as two snorm8s.
+	std::uint16_t OctahedralFromNormal(float x, float y, float z)
+	{
+		const float invLength = 1.0f / (std::fabs(x) + std::fabs(y) + std::fabs(z));
+		float u = x * invLength;
+		float v = z * invLength;
+		if (y < 0.0f)
+		{
+			const float foldedU = std::copysign(1.0f - std::fabs(v), u);
+			v = std::copysign(1.0f - std::fabs(u), v);
+			u = foldedU;
+		}
+
+		const int qu = (int)std::lrint(u * 127.0f);
+		const int qv = (int)std::lrint(v * 127.0f);
+		return (std::uint16_t)((qu & 0xFF) | (qv & 0xFF) << 8);
+	}
+
+	// The compact attributes of flat points, whose packed normal (0, 1, 0) is 0.
+	void FlatCompact(FrameBlock& frames, const float* row, int begin, int end)
+	{
+		for (int k = begin; k < end; ++k)
+			frames.Compact[k] = HalfFromFloat(row[k]);
+	}
+
+	// The compact attributes of row[begin, end), with the normals (l - r, 2dx, b - t) of
+	// ComputeFrames.  The octahedral encoding divides by |x| + |y| + |z|, so they need
+	// not be normalized.
+	typedef void (*PackCompactFn)(FrameBlock& frames, const float* row, int pitch, int begin, int end, float twoDx);
+
+	void PackCompactScalar(FrameBlock& frames, const float* row, int pitch, int begin, int end, float twoDx)
+	{
+		for (int k = begin; k < end; ++k)
+		{
+			const float dx = row[k - 1] - row[k + 1];
+			const float dz = row[k + pitch] - row[k - pitch];
+			frames.Compact[k] = HalfFromFloat(row[k]) | (std::uint32_t)OctahedralFromNormal(dx, twoDx, dz) << 16;
+		}
+	}
+
+	// A Snapshot as the sample kernels read it: the heights point at grid point (0, 0)
+	// inside the border, and the rest is in grid units.
+	struct SampleGrid
+	{
+		const float* Heights;
+		const float* PrevHeights;
+		int Pitch;
+		float LastRow;
+		float LastColumn;
+		float OriginX;
+		float OriginZ;
+		float InvSpacing;
+		float InvTwoSpacing;
+		float InvTimeStep;
+	};
+
+	// Samples the positions [begin, end) of the batch.
+	typedef void (*SampleFn)(const SampleGrid& grid, const Waves::SampleBatch& batch, int begin, int end);
+
+	float Bilerp(float a00, float a01, float a10, float a11, float tx, float tz)
+	{
+		const float a0 = a00 + (a01 - a00) * tx;
+		const float a1 = a10 + (a11 - a10) * tx;
+		return a0 + (a1 - a0) * tz;
+	}
+
+	void SampleScalar(const SampleGrid& grid, const Waves::SampleBatch& batch, int begin, int end)
+	{
+		const int p = grid.Pitch;
+		for (int s = begin; s < end; ++s)
+		{
+			// The cell the position is in, and where in it; NaNs go to the first cell.
+			const float column = std::min(std::max(0.0f, (batch.X[s] - grid.OriginX) * grid.InvSpacing), grid.LastColumn);
+			const float row = std::min(std::max(0.0f, (grid.OriginZ - batch.Z[s]) * grid.InvSpacing), grid.LastRow);
+			const float j0 = std::min((float)(int)column, grid.LastColumn - 1.0f);
+			const float i0 = std::min((float)(int)row, grid.LastRow - 1.0f);
+			const float tx = column - j0;
+			const float tz = row - i0;
+
+			const std::ptrdiff_t corner = (std::ptrdiff_t)i0 * p + (std::ptrdiff_t)j0;
+			const float* h = grid.Heights + corner;
+			const float* q = grid.PrevHeights + corner;
+
+			if (batch.Heights)
+				batch.Heights[s] = Bilerp(h[0], h[1], h[p], h[p + 1], tx, tz);
+
+			if (batch.Velocities)
+			{
+				batch.Velocities[s] = grid.InvTimeStep *
+					Bilerp(h[0] - q[0], h[1] - q[1], h[p] - q[p], h[p + 1] - q[p + 1], tx, tz);
+			}
+
+			if (batch.NormalsX || batch.NormalsY || batch.NormalsZ)
+			{
+				// dh/dx and dh/dz at the corners, z running against the rows.
+				const float slopeX = grid.InvTwoSpacing * Bilerp(h[1] - h[-1], h[2] - h[0],
+					h[p + 1] - h[p - 1], h[p + 2] - h[p], tx, tz);
+				const float slopeZ = grid.InvTwoSpacing * Bilerp(h[-p] - h[p], h[1 - p] - h[p + 1],
+					h[0] - h[2 * p], h[1] - h[2 * p + 1], tx, tz);
+
+				const float invLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+				if (batch.NormalsX)
+					batch.NormalsX[s] = -slopeX * invLength;
+				if (batch.NormalsY)
+					batch.NormalsY[s] = invLength;
+				if (batch.NormalsZ)
+					batch.NormalsZ[s] = -slopeZ * invLength;
+			}
+		}
+	}
+
+	// Copies the rows x columns grid 'from' into 'to', inside a border of one point
+	// that repeats the grid's edge.
+	void CopyWithBorder(const float* from, int fromPitch, int rows, int columns, float* to, int toPitch)
+	{
+		for (int r = 0; r < rows + 2; ++r)
+		{
+			const float* in = from + std::min(std::max(r - 1, 0), rows - 1) * fromPitch;
+			float* out = to + r * toPitch;
+			out[0] = in[0];
+			std::memcpy(out + 1, in, columns * sizeof(float));
+			out[columns + 1] = in[columns - 1];
+		}
+	}
+
+	// The ADI right-hand side of the points [begin, end) of one interior row:
+	// k1 * prev + k2 * curr + k3 * (curr neighbours) + k4 * (prev neighbours).
+	typedef void (*AdiRightHandSideFn)(float* out, const float* prev, const float* curr, int pitch,
+		int begin, int end, const float k[4]);
+
+	void AdiRightHandSideScalar(float* out, const float* prev, const float* curr, int pitch,
+		int begin, int end, const float k[4])
+	{
+		for (int j = begin; j < end; ++j)
+		{
+			out[j] = k[0] * prev[j] + k[1] * curr[j] +
+				k[2] * (curr[j - pitch] + curr[j + pitch] + curr[j - 1] + curr[j + 1]) +
+				k[3] * (prev[j - pitch] + prev[j + pitch] + prev[j - 1] + prev[j + 1]);
+		}
+	}
+
+	// Solves the systems with 1 + 2 * alpha on the diagonal and -alpha beside it along
+	// the four lines [0, count) in place, given the factors of TridiagonalFactors().
+	// 'buffer' has room for 4 * count floats.
+	typedef void (*SolveLinesFn)(float* const lines[4], int count, const float* upper, const float* invPivot,
+		float alpha, float* buffer);
+
+	void SolveLine(float* line, int count, const float* upper, const float* invPivot, float alpha)
+	{
+		float d = 0.0f;
+		for (int k = 0; k < count; ++k)
+			line[k] = d = (line[k] + alpha * d) * invPivot[k];
+
+		float x = 0.0f;
+		for (int k = count - 1; k >= 0; --k)
+			line[k] = x = line[k] - upper[k] * x;
+	}
+
+#if !defined(WAVES_X86)
+	void SolveLinesScalar(float* const lines[4], int count, const float* upper, const float* invPivot,
+		float alpha, float* buffer)
+	{
+		for (int r = 0; r < 4; ++r)
+			SolveLine(lines[r], count, upper, invPivot, alpha);
+	}
+#endif
+
+	// Steps the points [begin, end) of one interior row in place:
+	// prev = k1 * prev + k2 * curr + k3 * (below + above + right + left).
+	// Every version adds in the same order, so they give the same heights.
+	typedef void (*StepRowFn)(float* prev, const float* curr, const float* above, const float* below,
+		int begin, int end, float k1, float k2, float k3);
+
+	void StepRowScalar(float* prev, const float* curr, const float* above, const float* below,
+		int begin, int end, float k1, float k2, float k3)
+	{
+		for (int j = begin; j < end; ++j)
+		{
+			prev[j] = k1 * prev[j] + k2 * curr[j] +
+				k3 * (below[j] + above[j] + curr[j + 1] + curr[j - 1]);
+		}
+	}
+
+#if defined(WAVES_X86)
+	void StepRowSse2(float* prev, const float* curr, const float* above, const float* below,
+		int begin, int end, float k1, float k2, float k3)
+	{
+		const __m128 K1 = _mm_set1_ps(k1);
+		const __m128 K2 = _mm_set1_ps(k2);
+		const __m128 K3 = _mm_set1_ps(k3);
+
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			__m128 sum = _mm_add_ps(_mm_loadu_ps(below + j), _mm_loadu_ps(above + j));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+			__m128 h = _mm_add_ps(_mm_mul_ps(K1, _mm_loadu_ps(prev + j)), _mm_mul_ps(K2, _mm_loadu_ps(curr + j)));
+			_mm_storeu_ps(prev + j, _mm_add_ps(h, _mm_mul_ps(K3, sum)));
+		}
+
+		StepRowScalar(prev, curr, above, below, j, end, k1, k2, k3);
+	}
+
+	WAVES_TARGET_AVX2 void StepRowAvx2(float* prev, const float* curr, const float* above, const float* below,
+		int begin, int end, float k1, float k2, float k3)
+	{
+		const __m256 K1 = _mm256_set1_ps(k1);
+		const __m256 K2 = _mm256_set1_ps(k2);
+		const __m256 K3 = _mm256_set1_ps(k3);
+
+		int j = begin;
+		for (; j + 8 <= end; j += 8)
+		{
+			__m256 sum = _mm256_add_ps(_mm256_loadu_ps(below + j), _mm256_loadu_ps(above + j));
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j + 1));
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j - 1));
+
+			__m256 h = _mm256_add_ps(_mm256_mul_ps(K1, _mm256_loadu_ps(prev + j)),
+				_mm256_mul_ps(K2, _mm256_loadu_ps(curr + j)));
+			_mm256_storeu_ps(prev + j, _mm256_add_ps(h, _mm256_mul_ps(K3, sum)));
+		}
+
+		StepRowSse2(prev, curr, above, below, j, end, k1, k2, k3);
+	}
+
+	void ComputeFramesSse2(FrameBlock& frames, const float* row, int pitch, int begin, int end, float twoDx)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 TwoDx = _mm_set1_ps(twoDx);
+		const __m128 twoDx2 = _mm_set1_ps(twoDx * twoDx);
+		const __m128 negative = _mm_set1_ps(-0.0f);
+
+		int k = begin;
+		for (; k + 4 <= end; k += 4)
+		{
+			const __m128 dx = _mm_sub_ps(_mm_loadu_ps(row + k - 1), _mm_loadu_ps(row + k + 1));
+			const __m128 dz = _mm_sub_ps(_mm_loadu_ps(row + k + pitch), _mm_loadu_ps(row + k - pitch));
+			const __m128 dx2 = _mm_mul_ps(dx, dx);
+
+			__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(dx2, twoDx2), _mm_mul_ps(dz, dz))));
+			_mm_storeu_ps(frames.NormalX + k, _mm_mul_ps(dx, invLength));
+			_mm_storeu_ps(frames.NormalY + k, _mm_mul_ps(TwoDx, invLength));
+			_mm_storeu_ps(frames.NormalZ + k, _mm_mul_ps(dz, invLength));
+
+			invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(twoDx2, dx2)));
+			_mm_storeu_ps(frames.TangentX + k, _mm_mul_ps(TwoDx, invLength));
+			_mm_storeu_ps(frames.TangentY + k, _mm_xor_ps(_mm_mul_ps(dx, invLength), negative));
+		}
+
+		ComputeFramesScalar(frames, row, pitch, k, end, twoDx);
+	}
+
+	// PackCompactScalar four points at a time, bit for bit.  The normals point up, so
+	// the octahedron is never folded.
+	void PackCompactSse2(FrameBlock& frames, const float* row, int pitch, int begin, int end, float twoDx)
+	{
+		const __m128 negative = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 snorm = _mm_set1_ps(127.0f);
+		const __m128 TwoDx = _mm_set1_ps(twoDx);
+		const __m128 subnormalMagic = _mm_set1_ps(0.5f);
+		const __m128i halfOverflow = _mm_set1_epi32(0x47800000);
+		const __m128i halfNormal = _mm_set1_epi32(0x38800000);
+		const __m128i bias = _mm_set1_epi32((int)0xC8000FFF);
+		const __m128i lowBit = _mm_set1_epi32(1);
+		const __m128i infinity = _mm_set1_epi32(0x7C00);
+		const __m128i quietBit = _mm_set1_epi32(0x0200);
+		const __m128i byteMask = _mm_set1_epi32(0xFF);
+
+		int k = begin;
+		for (; k + 4 <= end; k += 4)
+		{
+			// HalfFromFloat: the subnormal, normal and special results, then a select.
+			const __m128 h = _mm_loadu_ps(row + k);
+			const __m128 magnitude = _mm_andnot_ps(negative, h);
+			const __m128i bits = _mm_castps_si128(magnitude);
+
+			const __m128i subnormal = _mm_sub_epi32(
+				_mm_castps_si128(_mm_add_ps(magnitude, subnormalMagic)), _mm_castps_si128(subnormalMagic));
+			const __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), lowBit);
+			const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, bias), odd), 13);
+			const __m128i special = _mm_or_si128(infinity,
+				_mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(magnitude, magnitude)), quietBit));
+
+			const __m128i isSubnormal = _mm_cmpgt_epi32(halfNormal, bits);
+			const __m128i isFinite = _mm_cmpgt_epi32(halfOverflow, bits);
+			__m128i half = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+			half = _mm_or_si128(_mm_and_si128(isFinite, half), _mm_andnot_si128(isFinite, special));
+			half = _mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(_mm_and_ps(h, negative)), 16));
+
+			// OctahedralFromNormal of (dx, 2dx, dz).
+			const __m128 dx = _mm_sub_ps(_mm_loadu_ps(row + k - 1), _mm_loadu_ps(row + k + 1));
+			const __m128 dz = _mm_sub_ps(_mm_loadu_ps(row + k + pitch), _mm_loadu_ps(row + k - pitch));
+			const __m128 invLength = _mm_div_ps(one,
+				_mm_add_ps(_mm_add_ps(_mm_andnot_ps(negative, dx), TwoDx), _mm_andnot_ps(negative, dz)));
+
+			const __m128i qu = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(dx, invLength), snorm)), byteMask);
+			const __m128i qv = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(dz, invLength), snorm)), byteMask);
+			const __m128i octahedral = _mm_or_si128(qu, _mm_slli_epi32(qv, 8));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(frames.Compact + k), _mm_or_si128(half, _mm_slli_epi32(octahedral, 16)));
+		}
+
+		PackCompactScalar(frames, row, pitch, k, end, twoDx);
+	}
+
+	__m128 Gather(const float* const base[4], std::ptrdiff_t offset)
+	{
+		return _mm_setr_ps(base[0][offset], base[1][offset], base[2][offset], base[3][offset]);
+	}
+
+	__m128 Bilerp(__m128 a00, __m128 a01, __m128 a10, __m128 a11, __m128 tx, __m128 tz)
+	{
+		const __m128 a0 = _mm_add_ps(a00, _mm_mul_ps(_mm_sub_ps(a01, a00), tx));
+		const __m128 a1 = _mm_add_ps(a10, _mm_mul_ps(_mm_sub_ps(a11, a10), tx));
+		return _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(a1, a0), tz));
+	}
+
+	// SampleScalar four positions at a time.  The cells are found in the lanes, the
+	// heights around them loaded one by one, and the interpolation done in the lanes.
+	void SampleSse2(const SampleGrid& grid, const Waves::SampleBatch& batch, int begin, int end)
+	{
+		const std::ptrdiff_t p = grid.Pitch;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 lastColumn = _mm_set1_ps(grid.LastColumn);
+		const __m128 lastRow = _mm_set1_ps(grid.LastRow);
+		const __m128 lastCellColumn = _mm_set1_ps(grid.LastColumn - 1.0f);
+		const __m128 lastCellRow = _mm_set1_ps(grid.LastRow - 1.0f);
+		const __m128 originX = _mm_set1_ps(grid.OriginX);
+		const __m128 originZ = _mm_set1_ps(grid.OriginZ);
+		const __m128 invSpacing = _mm_set1_ps(grid.InvSpacing);
+		const __m128 invTwoSpacing = _mm_set1_ps(grid.InvTwoSpacing);
+		const __m128 invTimeStep = _mm_set1_ps(grid.InvTimeStep);
+		const __m128 negative = _mm_set1_ps(-0.0f);
+		const bool normals = batch.NormalsX || batch.NormalsY || batch.NormalsZ;
+
+		int s = begin;
+		for (; s + 4 <= end; s += 4)
+		{
+			const __m128 column = _mm_min_ps(_mm_max_ps(
+				_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(batch.X + s), originX), invSpacing), zero), lastColumn);
+			const __m128 row = _mm_min_ps(_mm_max_ps(
+				_mm_mul_ps(_mm_sub_ps(originZ, _mm_loadu_ps(batch.Z + s)), invSpacing), zero), lastRow);
+			const __m128 j0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(column)), lastCellColumn);
+			const __m128 i0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(row)), lastCellRow);
+			const __m128 tx = _mm_sub_ps(column, j0);
+			const __m128 tz = _mm_sub_ps(row, i0);
+
+			alignas(16) std::int32_t rows[4];
+			alignas(16) std::int32_t columns[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(rows), _mm_cvttps_epi32(i0));
+			_mm_store_si128(reinterpret_cast<__m128i*>(columns), _mm_cvttps_epi32(j0));
+
+			const float* h[4];
+			const float* q[4];
+			for (int l = 0; l < 4; ++l)
+			{
+				h[l] = grid.Heights + rows[l] * p + columns[l];
+				q[l] = grid.PrevHeights + rows[l] * p + columns[l];
+			}
+
+			const __m128 h00 = Gather(h, 0);
+			const __m128 h01 = Gather(h, 1);
+			const __m128 h10 = Gather(h, p);
+			const __m128 h11 = Gather(h, p + 1);
+
+			if (batch.Heights)
+				_mm_storeu_ps(batch.Heights + s, Bilerp(h00, h01, h10, h11, tx, tz));
+
+			if (batch.Velocities)
+			{
+				const __m128 v = Bilerp(_mm_sub_ps(h00, Gather(q, 0)), _mm_sub_ps(h01, Gather(q, 1)),
+					_mm_sub_ps(h10, Gather(q, p)), _mm_sub_ps(h11, Gather(q, p + 1)), tx, tz);
+				_mm_storeu_ps(batch.Velocities + s, _mm_mul_ps(invTimeStep, v));
+			}
+
+			if (normals)
+			{
+				const __m128 slopeX = _mm_mul_ps(invTwoSpacing, Bilerp(
+					_mm_sub_ps(h01, Gather(h, -1)), _mm_sub_ps(Gather(h, 2), h00),
+					_mm_sub_ps(h11, Gather(h, p - 1)), _mm_sub_ps(Gather(h, p + 2), h10), tx, tz));
+				const __m128 slopeZ = _mm_mul_ps(invTwoSpacing, Bilerp(
+					_mm_sub_ps(Gather(h, -p), h10), _mm_sub_ps(Gather(h, 1 - p), h11),
+					_mm_sub_ps(h00, Gather(h, 2 * p)), _mm_sub_ps(h01, Gather(h, 2 * p + 1)), tx, tz));
+
+				const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX), one), _mm_mul_ps(slopeZ, slopeZ))));
+				if (batch.NormalsX)
+					_mm_storeu_ps(batch.NormalsX + s, _mm_xor_ps(_mm_mul_ps(slopeX, invLength), negative));
+				if (batch.NormalsY)
+					_mm_storeu_ps(batch.NormalsY + s, invLength);
+				if (batch.NormalsZ)
+					_mm_storeu_ps(batch.NormalsZ + s, _mm_xor_ps(_mm_mul_ps(slopeZ, invLength), negative));
+			}
+		}
+
+		SampleScalar(grid, batch, s, end);
+	}
+
+	void AdiRightHandSideSse2(float* out, const float* prev, const float* curr, int pitch,
+		int begin, int end, const float k[4])
+	{
+		const __m128 K1 = _mm_set1_ps(k[0]);
+		const __m128 K2 = _mm_set1_ps(k[1]);
+		const __m128 K3 = _mm_set1_ps(k[2]);
+		const __m128 K4 = _mm_set1_ps(k[3]);
+
+		int j = begin;
+		for (; j + 4 <= end; j += 4)
+		{
+			__m128 currSum = _mm_add_ps(_mm_loadu_ps(curr + j - pitch), _mm_loadu_ps(curr + j + pitch));
+			currSum = _mm_add_ps(currSum, _mm_add_ps(_mm_loadu_ps(curr + j - 1), _mm_loadu_ps(curr + j + 1)));
+			__m128 prevSum = _mm_add_ps(_mm_loadu_ps(prev + j - pitch), _mm_loadu_ps(prev + j + pitch));
+			prevSum = _mm_add_ps(prevSum, _mm_add_ps(_mm_loadu_ps(prev + j - 1), _mm_loadu_ps(prev + j + 1)));
+
+			__m128 h = _mm_add_ps(_mm_mul_ps(K1, _mm_loadu_ps(prev + j)), _mm_mul_ps(K2, _mm_loadu_ps(curr + j)));
+			h = _mm_add_ps(h, _mm_add_ps(_mm_mul_ps(K3, currSum), _mm_mul_ps(K4, prevSum)));
+			_mm_storeu_ps(out + j, h);
+		}
+
+		AdiRightHandSideScalar(out, prev, curr, pitch, j, end, k);
+	}
+
+	// Solves the four lines side by side, one line per lane: four points of each line
+	// are loaded and transposed at a time, and the eliminated lanes kept in 'buffer'
+	// for the substitution back.
+	void SolveLinesSse2(float* const lines[4], int count, const float* upper, const float* invPivot,
+		float alpha, float* buffer)
+	{
+		float* l0 = lines[0];
+		float* l1 = lines[1];
+		float* l2 = lines[2];
+		float* l3 = lines[3];
+		const __m128 A = _mm_set1_ps(alpha);
+		const int full = count & ~3;
+
+		__m128 d = _mm_setzero_ps();
+		int k = 0;
+		for (; k < full; k += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(l0 + k);
+			__m128 r1 = _mm_loadu_ps(l1 + k);
+			__m128 r2 = _mm_loadu_ps(l2 + k);
+			__m128 r3 = _mm_loadu_ps(l3 + k);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			d = _mm_mul_ps(_mm_add_ps(r0, _mm_mul_ps(A, d)), _mm_set1_ps(invPivot[k]));
+			_mm_storeu_ps(buffer + 4 * k, d);
+			d = _mm_mul_ps(_mm_add_ps(r1, _mm_mul_ps(A, d)), _mm_set1_ps(invPivot[k + 1]));
+			_mm_storeu_ps(buffer + 4 * k + 4, d);
+			d = _mm_mul_ps(_mm_add_ps(r2, _mm_mul_ps(A, d)), _mm_set1_ps(invPivot[k + 2]));
+			_mm_storeu_ps(buffer + 4 * k + 8, d);
+			d = _mm_mul_ps(_mm_add_ps(r3, _mm_mul_ps(A, d)), _mm_set1_ps(invPivot[k + 3]));
+			_mm_storeu_ps(buffer + 4 * k + 12, d);
+		}
+		for (; k < count; ++k)
+		{
+			const __m128 r = _mm_setr_ps(l0[k], l1[k], l2[k], l3[k]);
+			d = _mm_mul_ps(_mm_add_ps(r, _mm_mul_ps(A, d)), _mm_set1_ps(invPivot[k]));
+			_mm_storeu_ps(buffer + 4 * k, d);
+		}
+
+		__m128 x = _mm_setzero_ps();
+		for (k = count - 1; k >= full; --k)
+		{
+			x = _mm_sub_ps(_mm_loadu_ps(buffer + 4 * k), _mm_mul_ps(_mm_set1_ps(upper[k]), x));
+
+			float lanes[4];
+			_mm_storeu_ps(lanes, x);
+			l0[k] = lanes[0];
+			l1[k] = lanes[1];
+			l2[k] = lanes[2];
+			l3[k] = lanes[3];
+		}
+		for (k = full - 4; k >= 0; k -= 4)
+		{
+			__m128 x3 = _mm_sub_ps(_mm_loadu_ps(buffer + 4 * k + 12), _mm_mul_ps(_mm_set1_ps(upper[k + 3]), x));
+			__m128 x2 = _mm_sub_ps(_mm_loadu_ps(buffer + 4 * k + 8), _mm_mul_ps(_mm_set1_ps(upper[k + 2]), x3));
+			__m128 x1 = _mm_sub_ps(_mm_loadu_ps(buffer + 4 * k + 4), _mm_mul_ps(_mm_set1_ps(upper[k + 1]), x2));
+			__m128 x0 = _mm_sub_ps(_mm_loadu_ps(buffer + 4 * k), _mm_mul_ps(_mm_set1_ps(upper[k]), x1));
+			x = x0;
+
+			_MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+			_mm_storeu_ps(l0 + k, x0);
+			_mm_storeu_ps(l1 + k, x1);
+			_mm_storeu_ps(l2 + k, x2);
+			_mm_storeu_ps(l3 + k, x3);
+		}
+	}
+
+	bool CpuHasAvx2()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (maxLeaf < 7 || !osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	StepRowFn SelectStepRow()
+	{
+#if defined(WAVES_X86)
+		return CpuHasAvx2() ? StepRowAvx2 : StepRowSse2;
+#else
+		return StepRowScalar;
+#endif
+	}
+
+	const StepRowFn gStepRow = SelectStepRow();
+
+	// out[t] is set when tile t or any of its eight neighbours is set in 'in'.
+	void DilateTiles(const std::vector<std::uint8_t>& in, std::vector<std::uint8_t>& out, int rows, int cols)
+	{
+		for (int r = 0; r < rows; ++r)
+		{
+			for (int c = 0; c < cols; ++c)
+			{
+				std::uint8_t any = 0;
+				for (int nr = std::max(r - 1, 0); nr <= std::min(r + 1, rows - 1); ++nr)
+					for (int nc = std::max(c - 1, 0); nc <= std::min(c + 1, cols - 1); ++nc)
+						any |= in[nr * cols + nc];
+				out[r * cols + c] = any;
+			}
+		}
+	}
+
+	// Forward elimination factors of the count x count system with 1 + 2 * alpha on the
+	// diagonal and -alpha beside it: upper[k] is the eliminated superdiagonal and
+	// invPivot[k] the reciprocal of the eliminated diagonal of equation k.
+	void TridiagonalFactors(int count, float alpha, std::vector<float>& upper, std::vector<float>& invPivot)
+	{
+		upper.resize(count);
+		invPivot.resize(count);
+
+		const float diagonal = 1.0f + 2.0f * alpha;
+		float previousUpper = 0.0f;
+		for (int k = 0; k < count; ++k)
+		{
+			invPivot[k] = 1.0f / (diagonal + alpha * previousUpper);
+			upper[k] = -alpha * invPivot[k];
+			previousUpper = upper[k];
+		}
+	}
+
+#if defined(WAVES_X86)
+	const ComputeFramesFn gComputeFrames = ComputeFramesSse2;
+	const PackCompactFn gPackCompact = PackCompactSse2;
+	const SampleFn gSample = SampleSse2;
+	const AdiRightHandSideFn gAdiRightHandSide = AdiRightHandSideSse2;
+	const SolveLinesFn gSolveLines = SolveLinesSse2;
+#else
+	const ComputeFramesFn gComputeFrames = ComputeFramesScalar;
+	const PackCompactFn gPackCompact = PackCompactScalar;
+	const SampleFn gSample = SampleScalar;
+	const AdiRightHandSideFn gAdiRightHandSide = AdiRightHandSideScalar;
+	const SolveLinesFn gSolveLines = SolveLinesScalar;
+#endif
+}
+
+Waves::Waves(int m, int n, float dx, float dt, float speed, float damping, Solver solver)
 {
 	mNumRows = m;
 	mNumCols = n;
+	mRowPitch = (n + 7) & ~7;
 
 	mVertexCount = m * n;
 	mTriangleCount = (m - 1) * (n - 1) * 2;
@@ -27,34 +715,66 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 	mK2 = (4.0f - 8.0f * e) / d;
 	mK3 = (2.0f * e) / d;
 
-	mPrevSolution.resize(m * n);
-	mCurrSolution.resize(m * n);
-	mNormals.resize(m * n);
-	mTangentX.resize(m * n);
-
-	// Generate grid vertices in system memory.
-
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
-	for (int i = 0; i < m; ++i)
+	mSolver = solver;
+	if (solver == Solver::Adi)
 	{
-		float z = halfDepth - i * dx;
-		for (int j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j * dx;
+		// The Laplacian L is weighted 1/4, 1/2, 1/4 over the next, current and previous
+		// heights, with the damping centred as above:
+		//   a * next - (e / 4) * L(next) = 2 * curr - b * prev + (e / 2) * L(curr) + (e / 4) * L(prev)
+		// with a = 1 + damping * dt / 2 and b = 1 - damping * dt / 2.  Dividing by a and
+		// factoring 1 - alpha * L into (1 - alpha * Lx)(1 - alpha * Lz) gives a
+		// tridiagonal system along each row and then each column.
+		float a = 1.0f + 0.5f * damping * dt;
+		float b = 1.0f - 0.5f * damping * dt;
+		mAdiK1 = -(b + e) / a;
+		mAdiK2 = (2.0f - 2.0f * e) / a;
+		mAdiK3 = (0.5f * e) / a;
+		mAdiK4 = (0.25f * e) / a;
+		mAdiAlpha = (0.25f * e) / a;
 
-			mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		}
+		TridiagonalFactors(n - 2, mAdiAlpha, mAdiRowUpper, mAdiRowInvPivot);
+		TridiagonalFactors(m - 2, mAdiAlpha, mAdiColumnUpper, mAdiColumnInvPivot);
+		mAdiScratch.assign((size_t)m * mRowPitch, 0.0f);
 	}
+
+	// Flat water is at rest, except that the ADI solver steps everything.
+	mTileRows = (m + TileSize - 1) / TileSize;
+	mTileCols = (n + TileSize - 1) / TileSize;
+	const size_t tileCount = (size_t)mTileRows * mTileCols;
+	mTileActive.assign(tileCount, solver == Solver::Adi ? 1 : 0);
+	mTileQuietSteps.assign(tileCount, SettleSteps);
+	mTileStepped.assign(tileCount, 0);
+	mTileAtRest.assign(tileCount, 0);
+	PrepareTiles();
+
+	// Two grids of flat water, plus room to start the first on a 32-byte boundary.
+	const size_t gridSize = (size_t)m * mRowPitch;
+	mHeightStorage.assign(2 * gridSize + 8, 0.0f);
+
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(mHeightStorage.data());
+	mPrevSolution = mHeightStorage.data() + ((32 - address % 32) % 32) / sizeof(float);
+	mCurrSolution = mPrevSolution + gridSize;
 }
 
 Waves::~Waves()
 {
 }
 
+Waves::VertexFormat Waves::CompactFormat()
+{
+	return { 2 * sizeof(std::uint16_t), NoAttribute, NoAttribute, NoAttribute, NoAttribute, 0, sizeof(std::uint16_t) };
+}
+
+std::uint16_t Waves::PackHeight(float height)
+{
+	return HalfFromFloat(height);
+}
+
+std::uint16_t Waves::PackNormal(float x, float y, float z)
+{
+	return OctahedralFromNormal(x, y, z);
+}
+
 int Waves::RowCount()const
 {
 	return mNumRows;
@@ -85,73 +805,518 @@ float Waves::Depth()const
 	return mNumRows * mSpatialStep;
 }
 
-void Waves::Update(float dt)
+XMFLOAT3 Waves::Position(int i)const
 {
-	static float t = 0;
+	int row = i / mNumCols;
+	int col = i % mNumCols;
 
+	float halfWidth = (mNumCols - 1) * mSpatialStep * 0.5f;
+	float halfDepth = (mNumRows - 1) * mSpatialStep * 0.5f;
+	return XMFLOAT3(-halfWidth + col * mSpatialStep, Height(row, col), halfDepth - row * mSpatialStep);
+}
+
+XMFLOAT3 Waves::Normal(int i)const
+{
+	int row = i / mNumCols;
+	int col = i % mNumCols;
+
+	// The boundary is held flat.
+	if (row == 0 || row == mNumRows - 1 || col == 0 || col == mNumCols - 1)
+		return XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+	// Finite differences of the neighbouring heights.
+	float l = Height(row, col - 1);
+	float r = Height(row, col + 1);
+	float t = Height(row - 1, col);
+	float b = Height(row + 1, col);
+
+	XMFLOAT3 n(-r + l, 2.0f * mSpatialStep, b - t);
+	XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+XMFLOAT3 Waves::TangentX(int i)const
+{
+	int row = i / mNumCols;
+	int col = i % mNumCols;
+
+	if (row == 0 || row == mNumRows - 1 || col == 0 || col == mNumCols - 1)
+		return XMFLOAT3(1.0f, 0.0f, 0.0f);
+
+	float l = Height(row, col - 1);
+	float r = Height(row, col + 1);
+
+	XMFLOAT3 tangent(2.0f * mSpatialStep, r - l, 0.0f);
+	XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
+	return tangent;
+}
+
+int Waves::StepsDue(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mTime += dt;
 
-	// Only update the simulation at the specified time step.
-	if (t >= mTimeStep)
+	// Only update the simulation at the specified time step.  After a long frame
+	// the simulation falls behind rather than taking ever more steps to catch up.
+	int steps = (int)(mTime / mTimeStep);
+	if (steps > MaxStepsPerUpdate)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows-1; ++i)
+		mTime = 0.0f;
+		return MaxStepsPerUpdate;
+	}
+
+	mTime -= steps * mTimeStep;
+	return steps;
+}
+
+void Waves::PrepareTiles()
+{
+	// A wave moves less than a grid point per step, so it can only reach the tiles
+	// next to the active ones.  The tiles around those stay flat.
+	std::vector<std::uint8_t> moving(mTileActive.size());
+	DilateTiles(mTileActive, mTileStepped, mTileRows, mTileCols);
+	DilateTiles(mTileStepped, moving, mTileRows, mTileCols);
+	for (size_t t = 0; t < moving.size(); ++t)
+		mTileAtRest[t] = !moving[t];
+}
+
+void Waves::Step()
+{
+	if (mSolver == Solver::Adi)
+	{
+		StepAdi();
+	}
+	else
+	{
+		PrepareTiles();
+		JobSystem::Default().ParallelFor(mNumRows - 2, StepRowGrain, [this](size_t begin, size_t end)
+		{
+			StepRows(1 + (int)begin, 1 + (int)end);
+		});
+	}
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevSolution, mCurrSolution);
+
+	SettleTiles();
+}
+
+void Waves::StepRows(int begin, int end)
+{
+	// Only update interior points; we use zero boundary conditions.  After this
+	// update we will be discarding the old previous buffer, so the new heights
+	// overwrite it in place: prev_ij is read only by the point that replaces it.
+	//
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k).  Moreover, our +z axis
+	// goes "down"; this is just to keep consistent with our row indices going down.
+	//
+	// Tiles that are not stepped are zero in both grids, as are their neighbours, so
+	// they would stay zero.
+	for (int i = begin; i < end; ++i)
+	{
+		const float* curr = mCurrSolution + i * mRowPitch;
+		float* prev = mPrevSolution + i * mRowPitch;
+		const std::uint8_t* stepped = mTileStepped.data() + (i / TileSize) * mTileCols;
+
+		// Step each run of stepped tiles along the row.
+		for (int t = 0; t < mTileCols; )
+		{
+			if (!stepped[t])
+			{
+				++t;
+				continue;
+			}
+
+			const int firstTile = t;
+			while (t < mTileCols && stepped[t])
+				++t;
+
+			const int first = std::max(firstTile * TileSize, 1);
+			const int last = std::min(t * TileSize, mNumCols - 1);
+			gStepRow(prev, curr, curr - mRowPitch, curr + mRowPitch, first, last, mK1, mK2, mK3);
+		}
+	}
+}
+
+void Waves::SettleTiles()
+{
+	if (mSolver == Solver::Adi)
+		return;
+
+	// A stepped tile stays active until its heights at the last two steps have been
+	// at or below the rest height for SettleSteps steps in a row.  A single quiet step
+	// is often just a wave crossing zero.
+	JobSystem::Default().ParallelFor(mTileRows, 1, [this](size_t begin, size_t end)
+	{
+		for (int r = (int)begin; r < (int)end; ++r)
+		{
+			const int firstRow = r * TileSize;
+			const int lastRow = std::min(firstRow + TileSize, mNumRows);
+
+			for (int c = 0; c < mTileCols; ++c)
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
+				const size_t t = (size_t)r * mTileCols + c;
+				if (!mTileStepped[t])
+					continue;
+
+				const int first = c * TileSize;
+				const int count = std::min(first + TileSize, mNumCols) - first;
+
+				float peak = 0.0f;
+				for (int i = firstRow; i < lastRow; ++i)
 				{
-					// After this update we will be discarding the old previous
-					// buffer, so overwrite that buffer with the new update.
-					// Note how we can do this inplace (read/write to same element) 
-					// because we won't need prev_ij again and the assignment happens last.
-
-					// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-					// Moreover, our +z axis goes "down"; this is just to 
-					// keep consistent with our row indices going down.
-
-					mPrevSolution[i * mNumCols + j].y =
-						mK1 * mPrevSolution[i * mNumCols + j].y +
-						mK2 * mCurrSolution[i * mNumCols + j].y +
-						mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-							mCurrSolution[(i - 1) * mNumCols + j].y +
-							mCurrSolution[i * mNumCols + j + 1].y +
-							mCurrSolution[i * mNumCols + j - 1].y);
+					const float* curr = mCurrSolution + i * mRowPitch + first;
+					const float* prev = mPrevSolution + i * mRowPitch + first;
+					for (int j = 0; j < count; ++j)
+						peak = std::max(peak, std::max(std::fabs(curr[j]), std::fabs(prev[j])));
 				}
-			});
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+				std::uint8_t& quiet = mTileQuietSteps[t];
+				quiet = peak > RestHeight ? 0 : (std::uint8_t)std::min(quiet + 1, (int)SettleSteps);
+				mTileActive[t] = quiet < SettleSteps;
+			}
+		}
+	});
 
-		t = 0.0f; // reset time
+	// An inactive tile next to an active one is left as it is: it holds the front of
+	// a wave coming in, far below the rest height at first, and zeroing it every step
+	// would hold the wave back.  The rest go back to rest at exactly zero.
+	JobSystem::Default().ParallelFor(mTileRows, 1, [this](size_t begin, size_t end)
+	{
+		for (int r = (int)begin; r < (int)end; ++r)
+		{
+			const int firstRow = r * TileSize;
+			const int lastRow = std::min(firstRow + TileSize, mNumRows);
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows - 1; ++i)
+			for (int c = 0; c < mTileCols; ++c)
 			{
-				for (int j = 1; j < mNumCols - 1; ++j)
+				const size_t t = (size_t)r * mTileCols + c;
+				if (!mTileStepped[t] || mTileActive[t])
+					continue;
+
+				bool nearActive = false;
+				for (int nr = std::max(r - 1, 0); nr <= std::min(r + 1, mTileRows - 1); ++nr)
+					for (int nc = std::max(c - 1, 0); nc <= std::min(c + 1, mTileCols - 1); ++nc)
+						nearActive = nearActive || mTileActive[(size_t)nr * mTileCols + nc];
+				if (nearActive)
+					continue;
+
+				const int first = c * TileSize;
+				const int count = std::min(first + TileSize, mNumCols) - first;
+				for (int i = firstRow; i < lastRow; ++i)
 				{
-					float l = mCurrSolution[i * mNumCols + j - 1].y;
-					float r = mCurrSolution[i * mNumCols + j + 1].y;
-					float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-					float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-					mNormals[i * mNumCols + j].x = -r + l;
-					mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-					mNormals[i * mNumCols + j].z = b - t;
-
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-					XMStoreFloat3(&mNormals[i * mNumCols + j], n);
-
-					mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-					XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
+					std::fill_n(mCurrSolution + i * mRowPitch + first, count, 0.0f);
+					std::fill_n(mPrevSolution + i * mRowPitch + first, count, 0.0f);
 				}
-			});
+			}
+		}
+	});
+}
+
+Waves::TrackedBuffer& Waves::Track(const void* vertices, const VertexFormat& format)
+{
+	++mWriteCount;
+
+	TrackedBuffer* oldest = nullptr;
+	for (TrackedBuffer& buffer : mTrackedBuffers)
+	{
+		if (buffer.Vertices == vertices && std::memcmp(&buffer.Format, &format, sizeof(format)) == 0)
+		{
+			buffer.LastWrite = mWriteCount;
+			return buffer;
+		}
+		if (oldest == nullptr || buffer.LastWrite < oldest->LastWrite)
+			oldest = &buffer;
 	}
+
+	// A new buffer, or a new format for one: nothing in it is known to be at rest.
+	if ((int)mTrackedBuffers.size() < MaxTrackedBuffers)
+	{
+		mTrackedBuffers.emplace_back();
+		oldest = &mTrackedBuffers.back();
+	}
+	oldest->Vertices = vertices;
+	oldest->Format = format;
+	oldest->RestTiles.assign(mTileActive.size(), 0);
+	oldest->LastWrite = mWriteCount;
+	return *oldest;
+}
+
+void Waves::StepAdi()
+{
+	JobSystem& jobs = JobSystem::Default();
+
+	const int pitch = mRowPitch;
+	const int lastColumn = mNumCols - 1;
+	const int lastRow = mNumRows - 1;
+	const float k[4] = { mAdiK1, mAdiK2, mAdiK3, mAdiK4 };
+	const float alpha = mAdiAlpha;
+
+	// The boundary of every grid stays zero, which is also what the solves take the
+	// heights beyond the first and last interior point to be.
+	float* scratch = mAdiScratch.data();
+
+	// Work out the right-hand side of each interior row into the scratch grid and
+	// solve along the rows (x), four at a time.
+	jobs.ParallelFor(mNumRows - 2, StepRowGrain, [&](size_t begin, size_t end)
+	{
+		const int first = 1 + (int)begin;
+		const int last = 1 + (int)end;
+		const int count = mNumCols - 2;
+
+		for (int i = first; i < last; ++i)
+		{
+			gAdiRightHandSide(scratch + i * pitch, mPrevSolution + i * pitch, mCurrSolution + i * pitch, pitch,
+				1, lastColumn, k);
+		}
+
+		std::vector<float> buffer(4 * (size_t)count);
+		int i = first;
+		for (; i + 4 <= last; i += 4)
+		{
+			float* const lines[4] =
+			{
+				scratch + i * pitch + 1,
+				scratch + (i + 1) * pitch + 1,
+				scratch + (i + 2) * pitch + 1,
+				scratch + (i + 3) * pitch + 1
+			};
+			gSolveLines(lines, count, mAdiRowUpper.data(), mAdiRowInvPivot.data(), alpha, buffer.data());
+		}
+		for (; i < last; ++i)
+			SolveLine(scratch + i * pitch + 1, count, mAdiRowUpper.data(), mAdiRowInvPivot.data(), alpha);
+	});
+
+	// Solve along each column (z), a block of columns at a time so the rows are read
+	// in runs: eliminate down the scratch grid in place, then substitute back up into
+	// the previous heights, which are no longer needed.
+	jobs.ParallelFor(mNumCols - 2, AdiColumnGrain, [&](size_t begin, size_t end)
+	{
+		const int first = 1 + (int)begin;
+		const int last = 1 + (int)end;
+
+		for (int i = 1; i < lastRow; ++i)
+		{
+			float* line = scratch + i * pitch;
+			const float* above = line - pitch;
+			const float invPivot = mAdiColumnInvPivot[i - 1];
+			for (int j = first; j < last; ++j)
+				line[j] = (line[j] + alpha * above[j]) * invPivot;
+		}
+
+		for (int i = lastRow - 1; i > 0; --i)
+		{
+			const float* line = scratch + i * pitch;
+			float* next = mPrevSolution + i * pitch;
+			const float* below = next + pitch;
+			const float upper = mAdiColumnUpper[i - 1];
+			for (int j = first; j < last; ++j)
+				next[j] = line[j] - upper * below[j];
+		}
+	});
+}
+
+void Waves::WriteRow(const float* heights, int i, std::uint8_t* vertices, const VertexFormat& format,
+	const std::uint8_t* restInBuffer)const
+{
+	const float halfWidth = (mNumCols - 1) * mSpatialStep * 0.5f;
+	const float halfDepth = (mNumRows - 1) * mSpatialStep * 0.5f;
+	const float z = halfDepth - i * mSpatialStep;
+	const float texV = 0.5f - z / Depth();
+	const float width = Width();
+
+	const float* row = heights + i * mRowPitch;
+	const bool boundaryRow = i == 0 || i == mNumRows - 1;
+
+	// The compact attributes are packed from the heights, without the frames.  Records
+	// of nothing else are copied a tile at a time.
+	const bool frames = format.NormalOffset != NoAttribute || format.TangentOffset != NoAttribute;
+	const bool compact = format.HalfHeightOffset != NoAttribute || format.OctNormalOffset != NoAttribute;
+	const VertexFormat compactFormat = CompactFormat();
+	const bool compactOnly = std::memcmp(&format, &compactFormat, sizeof(format)) == 0;
+
+	const size_t tileRow = (size_t)(i / TileSize) * mTileCols;
+	const std::uint8_t* atRest = mTileAtRest.data() + tileRow;
+	restInBuffer += tileRow;
+
+	std::uint8_t* out = vertices + (size_t)i * mNumCols * format.Stride;
+
+	// Normals and tangents are worked out for a tile at a time, then interleaved with
+	// the positions and texture coordinates.  Tiles at rest are flat, and are skipped
+	// if the buffer already holds them so.
+	alignas(16) FrameBlock block;
+	for (int t = 0; t < mTileCols; ++t)
+	{
+		const int begin = t * TileSize;
+		const int end = std::min(begin + TileSize, mNumCols);
+		const bool flat = boundaryRow || atRest[t];
+
+		if (atRest[t] && restInBuffer[t])
+		{
+			out += (size_t)(end - begin) * format.Stride;
+			continue;
+		}
+
+		if (frames)
+		{
+			if (flat)
+				FlatFrames(block, 0, end - begin);
+			else
+				gComputeFrames(block, row + begin, mRowPitch, 0, end - begin, 2.0f * mSpatialStep);
+
+			// The boundary is held flat.
+			if (begin == 0)
+				FlatFrames(block, 0, 1);
+			if (end == mNumCols)
+				FlatFrames(block, end - 1 - begin, end - begin);
+		}
+
+		if (compact)
+		{
+			if (flat)
+				FlatCompact(block, row + begin, 0, end - begin);
+			else
+				gPackCompact(block, row + begin, mRowPitch, 0, end - begin, 2.0f * mSpatialStep);
+
+			if (begin == 0)
+				FlatCompact(block, row + begin, 0, 1);
+			if (end == mNumCols)
+				FlatCompact(block, row + begin, end - 1 - begin, end - begin);
+		}
+
+		if (compactOnly)
+		{
+			std::memcpy(out, block.Compact, (size_t)(end - begin) * sizeof(std::uint32_t));
+			out += (size_t)(end - begin) * format.Stride;
+			continue;
+		}
+
+		for (int j = begin; j < end; ++j, out += format.Stride)
+		{
+			const int k = j - begin;
+			const float x = -halfWidth + j * mSpatialStep;
+
+			if (format.PositionOffset != NoAttribute)
+			{
+				const float position[3] = { x, row[j], z };
+				std::memcpy(out + format.PositionOffset, position, sizeof(position));
+			}
+			if (format.NormalOffset != NoAttribute)
+			{
+				const float normal[3] = { block.NormalX[k], block.NormalY[k], block.NormalZ[k] };
+				std::memcpy(out + format.NormalOffset, normal, sizeof(normal));
+			}
+			if (format.TexCoordOffset != NoAttribute)
+			{
+				const float texC[2] = { 0.5f + x / width, texV };
+				std::memcpy(out + format.TexCoordOffset, texC, sizeof(texC));
+			}
+			if (format.TangentOffset != NoAttribute)
+			{
+				const float tangent[3] = { block.TangentX[k], block.TangentY[k], 0.0f };
+				std::memcpy(out + format.TangentOffset, tangent, sizeof(tangent));
+			}
+			if (format.HalfHeightOffset != NoAttribute)
+			{
+				const std::uint16_t height = (std::uint16_t)block.Compact[k];
+				std::memcpy(out + format.HalfHeightOffset, &height, sizeof(height));
+			}
+			if (format.OctNormalOffset != NoAttribute)
+			{
+				const std::uint16_t normal = (std::uint16_t)(block.Compact[k] >> 16);
+				std::memcpy(out + format.OctNormalOffset, &normal, sizeof(normal));
+			}
+		}
+	}
+}
+
+void Waves::WriteRows(std::uint8_t* vertices, const VertexFormat& format)
+{
+	PrepareTiles();
+	TrackedBuffer& buffer = Track(vertices, format);
+	const std::uint8_t* restInBuffer = buffer.RestTiles.data();
+
+	JobSystem::Default().ParallelFor(mNumRows, WriteRowGrain, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			WriteRow(mCurrSolution, (int)i, vertices, format, restInBuffer);
+	});
+
+	buffer.RestTiles = mTileAtRest;
+}
+
+void Waves::Update(float dt)
+{
+	for (int steps = StepsDue(dt); steps > 0; --steps)
+		Step();
+}
+
+void Waves::Update(float dt, void* vertices, const VertexFormat& format)
+{
+	std::uint8_t* out = static_cast<std::uint8_t*>(vertices);
+
+	int steps = StepsDue(dt);
+	if (mSolver == Solver::Adi || steps == 0)
+	{
+		for (; steps > 0; --steps)
+			Step();
+
+		WriteRows(out, format);
+		return;
+	}
+
+	for (; steps > 1; --steps)
+		Step();
+
+	// The tiles at rest before the step are still flat after it.
+	PrepareTiles();
+	TrackedBuffer& buffer = Track(out, format);
+	const std::uint8_t* restInBuffer = buffer.RestTiles.data();
+
+	// Each band of interior rows [first, last) is stepped one row ahead of the rows
+	// being written, so a row is written right after its lower neighbour is stepped.
+	// The new heights are in mPrevSolution until the swap.
+	const int interiorRows = mNumRows - 2;
+	JobSystem::Default().ParallelFor(interiorRows, StepRowGrain, [&](size_t begin, size_t end)
+	{
+		const int first = 1 + (int)begin;
+		const int last = 1 + (int)end;
+		for (int i = first; i < last; ++i)
+		{
+			StepRows(i, i + 1);
+			if (i - 1 > first)
+				WriteRow(mPrevSolution, i - 1, out, format, restInBuffer);
+		}
+	});
+
+	std::swap(mPrevSolution, mCurrSolution);
+
+	// The rows left: the grid boundary, and the first and last row of each band.
+	const int bandCount = (interiorRows + (int)StepRowGrain - 1) / (int)StepRowGrain;
+	JobSystem::Default().ParallelFor(bandCount + 1, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t band = begin; band < end; ++band)
+		{
+			const int first = 1 + (int)band * (int)StepRowGrain;
+			const int last = std::min(first + (int)StepRowGrain, 1 + interiorRows);
+
+			if (band == (size_t)bandCount)
+			{
+				WriteRow(mCurrSolution, 0, out, format, restInBuffer);
+				WriteRow(mCurrSolution, mNumRows - 1, out, format, restInBuffer);
+				continue;
+			}
+
+			WriteRow(mCurrSolution, first, out, format, restInBuffer);
+			if (last - 1 > first)
+				WriteRow(mCurrSolution, last - 1, out, format, restInBuffer);
+		}
+	});
+
+	buffer.RestTiles = mTileAtRest;
+	SettleTiles();
 }
 
 void Waves::Disturb(int i, int j, float magnitude)
@@ -163,10 +1328,63 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f * magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i * mNumCols + j].y += magnitude;
-	mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-	mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-	mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-	mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
+	mCurrSolution[i * mRowPitch + j] += magnitude;
+	mCurrSolution[i * mRowPitch + j + 1] += halfMag;
+	mCurrSolution[i * mRowPitch + j - 1] += halfMag;
+	mCurrSolution[(i + 1) * mRowPitch + j] += halfMag;
+	mCurrSolution[(i - 1) * mRowPitch + j] += halfMag;
+
+	for (int r = i - 1; r <= i + 1; ++r)
+		for (int c = j - 1; c <= j + 1; ++c)
+		{
+			const size_t t = (size_t)(r / TileSize) * mTileCols + c / TileSize;
+			mTileActive[t] = 1;
+			mTileQuietSteps[t] = 0;
+		}
+}
+
+int Waves::ActiveTileCount()const
+{
+	return (int)std::count(mTileActive.begin(), mTileActive.end(), 1);
+}
+
+void Waves::ForgetVertexBuffers()
+{
+	mTrackedBuffers.clear();
+}
+
+void Waves::TakeSnapshot(Snapshot& snapshot)const
+{
+	snapshot.mRowCount = mNumRows;
+	snapshot.mColumnCount = mNumCols;
+	snapshot.mPitch = mNumCols + 2;
+	snapshot.mOriginX = -0.5f * (mNumCols - 1) * mSpatialStep;
+	snapshot.mOriginZ = 0.5f * (mNumRows - 1) * mSpatialStep;
+	snapshot.mSpacing = mSpatialStep;
+	snapshot.mTimeStep = mTimeStep;
+
+	const size_t size = (size_t)(mNumRows + 2) * snapshot.mPitch;
+	snapshot.mHeights.resize(size);
+	snapshot.mPrevHeights.resize(size);
+	CopyWithBorder(mCurrSolution, mRowPitch, mNumRows, mNumCols, snapshot.mHeights.data(), snapshot.mPitch);
+	CopyWithBorder(mPrevSolution, mRowPitch, mNumRows, mNumCols, snapshot.mPrevHeights.data(), snapshot.mPitch);
 }
 
+void Waves::Snapshot::Sample(const SampleBatch& batch)const
+{
+	assert(!Empty());
+
+	SampleGrid grid;
+	grid.Heights = mHeights.data() + mPitch + 1;
+	grid.PrevHeights = mPrevHeights.data() + mPitch + 1;
+	grid.Pitch = mPitch;
+	grid.LastRow = (float)(mRowCount - 1);
+	grid.LastColumn = (float)(mColumnCount - 1);
+	grid.OriginX = mOriginX;
+	grid.OriginZ = mOriginZ;
+	grid.InvSpacing = 1.0f / mSpacing;
+	grid.InvTwoSpacing = 0.5f / mSpacing;
+	grid.InvTimeStep = 1.0f / mTimeStep;
+
+	gSample(grid, batch, 0, batch.Count);
+}
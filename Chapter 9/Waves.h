@@ -4,22 +4,130 @@
 // Performs the calculations for the wave simulation.  After the simulation has been
 // updated, the client must copy the current solution into vertex buffers for rendering.
 // This class only does the calculations, it does not do any drawing.
+//
+// Only the heights are simulated.  They are kept in two 32-byte aligned float grids
+// whose rows are padded to a multiple of 8, and stepped 8 (AVX2) or 4 (SSE2) points
+// at a time; x and z follow from the grid indices.  Positions, normals and tangents
+// are worked out from the heights when they are asked for.
+//
+// Solver::Explicit is the book's scheme, which is only stable while
+// speed * dt / dx < 1 / sqrt(2).  Solver::Adi evaluates the Laplacian at a weighted
+// average of the three time levels, which is stable for any time step, and factors
+// the implicit part into a tridiagonal solve along every row and then every column
+// (alternating direction implicit).  A step costs several explicit ones, but can
+// step at the frame rate however fine the grid or fast the waves.  Large steps damp
+// and slow the shortest waves.
+//
+// The explicit solver only works where the water moves.  The grid is split into
+// TileSize x TileSize tiles, and a tile stays active until its heights, now and a
+// step ago, have stayed at or below a small rest height for several steps in a row.
+// A step updates the active tiles and their neighbours, which a wave can reach, and
+// puts the inactive ones with no active neighbour back to rest at exactly zero, so
+// the faint front of a wave keeps growing until it wakes the tile it is in.  Normals
+// are only worked out near active tiles, and writes skip tiles that the destination
+// already holds at rest.  So the cost follows the disturbed area rather than the
+// grid.  The ADI solver couples whole rows and columns and keeps every tile active.
 //***************************************************************************************
 
 #ifndef WAVES_H
 #define WAVES_H
 
+#include <cstdint>
 #include <vector>
 #include <DirectXMath.h>
 
 class Waves
 {
 public:
-    Waves(int m, int n, float dx, float dt, float speed, float damping);
+    static const std::uint32_t NoAttribute = 0xFFFFFFFF;
+
+    // Side of the tiles whose activity is tracked, in grid points.
+    static const int TileSize = 16;
+
+    enum class Solver
+    {
+        Explicit,
+        Adi
+    };
+
+    // Byte offsets of the float3 position, float3 normal, float2 texture coordinates and
+    // float3 x tangent in the vertex records Update() writes, and of the two compact
+    // attributes: the height as a half float and the normal as PackNormal() encodes it.
+    // NoAttribute leaves one out.
+    struct VertexFormat
+    {
+        std::uint32_t Stride;
+        std::uint32_t PositionOffset;
+        std::uint32_t NormalOffset;
+        std::uint32_t TexCoordOffset;
+        std::uint32_t TangentOffset;
+        std::uint32_t HalfHeightOffset;
+        std::uint32_t OctNormalOffset;
+    };
+
+    // Positions to sample, in the space of the grid, and where to put the results, one
+    // array per component.  Outputs left null are not worked out.
+    struct SampleBatch
+    {
+        int Count = 0;
+        const float* X = nullptr;
+        const float* Z = nullptr;
+        float* Heights = nullptr;
+        float* NormalsX = nullptr;
+        float* NormalsY = nullptr;
+        float* NormalsZ = nullptr;
+        float* Velocities = nullptr;
+    };
+
+    // A copy of the solution taken by TakeSnapshot().  Any number of threads can sample
+    // it while the waves step on.
+    class Snapshot
+    {
+    public:
+        // The surface over each position, bilinearly interpolated between the grid
+        // points: the height, the unit normal from the interpolated central differences,
+        // and the vertical velocity over the last step.  Positions off the grid take the
+        // values at its nearest edge.  Four positions are sampled at a time.
+        void Sample(const SampleBatch& batch)const;
+
+        bool Empty()const { return mRowCount == 0; }
+
+    private:
+        friend class Waves;
+
+        int mRowCount = 0;
+        int mColumnCount = 0;
+        int mPitch = 0;
+        float mOriginX = 0.0f;
+        float mOriginZ = 0.0f;
+        float mSpacing = 0.0f;
+        float mTimeStep = 0.0f;
+
+        // The heights now and a step ago, with a border of one point around the grid
+        // repeating its edge, so every grid point has all four neighbours.
+        std::vector<float> mHeights;
+        std::vector<float> mPrevHeights;
+    };
+
+public:
+    Waves(int m, int n, float dx, float dt, float speed, float damping, Solver solver = Solver::Explicit);
     Waves(const Waves& rhs) = delete;
     Waves& operator=(const Waves& rhs) = delete;
     ~Waves();
 
+    // The 4-byte record of the half height at 0 and the packed normal at 2, an eighth
+    // of a float position, normal and texture coordinates.  x, z and the texture
+    // coordinates are left to the vertex shader, which works them out from the vertex
+    // index and the grid's RowCount(), ColumnCount(), Width() and Depth().
+    static VertexFormat CompactFormat();
+
+    // The compact attributes of one vertex.  PackHeight() rounds to the nearest half
+    // float.  PackNormal() projects the normal onto the octahedron |x| + |y| + |z| = 1,
+    // folds the lower half over the upper, and stores x and z as two snorm8s; decode
+    // with n = (x, 1 - |x| - |z|, z), unfold where n.y < 0, and normalize.
+    static std::uint16_t PackHeight(float height);
+    static std::uint16_t PackNormal(float x, float y, float z);
+
     int RowCount()const;
     int ColumnCount()const;
     int VertexCount()const;
@@ -28,20 +136,75 @@ public:
     float Depth()const;
 
     // Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+    DirectX::XMFLOAT3 Position(int i)const;
 
     // Returns the solution normal at the ith grid point.
-    const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+    DirectX::XMFLOAT3 Normal(int i)const;
 
     // Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-    const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+    DirectX::XMFLOAT3 TangentX(int i)const;
+
+    // The current heights: row i (z) starts at Heights() + i * RowPitch().
+    const float* Heights()const { return mCurrSolution; }
+    int RowPitch()const { return mRowPitch; }
 
+    // Adds dt to the time not yet simulated and takes as many steps of the time step
+    // as fit, at most MaxStepsPerUpdate; time beyond that is dropped.
     void Update(float dt);
+
+    // Update(dt), and every vertex written to 'vertices' in grid order.  With the
+    // explicit solver the last step and the writing are one pass: each band of rows is
+    // stepped and its vertices written while it is still in cache, and only the first
+    // and last row of each band, which need the next band's heights, are written
+    // afterwards.  Texture coordinates are (0.5 + x / Width(), 0.5 - z / Depth()).  The
+    // vertices are written even when no step was due.  Suits mapped upload memory:
+    // every record is written whole, in order within a row, and never read.
+    void Update(float dt, void* vertices, const VertexFormat& format);
+
     void Disturb(int i, int j, float magnitude);
 
+    // Copies the solution into 'snapshot', reusing its memory.  It must not run during
+    // an Update(), but the copy can then be sampled during the next one.
+    void TakeSnapshot(Snapshot& snapshot)const;
+
+    // The tiles in which the water is moving.
+    int ActiveTileCount()const;
+
+    // Update(dt, vertices, format) remembers which tiles it left at rest in each of the
+    // last few buffers it wrote, and skips them while they stay at rest.  Call this when
+    // a buffer is freed or written by anything else.
+    void ForgetVertexBuffers();
+
+private:
+    float Height(int i, int j)const { return mCurrSolution[i * mRowPitch + j]; }
+
+    static const int MaxStepsPerUpdate = 4;
+    static const int MaxTrackedBuffers = 4;
+
+    // The tiles at rest in a buffer Update() wrote.
+    struct TrackedBuffer
+    {
+        const void* Vertices = nullptr;
+        VertexFormat Format = {};
+        std::vector<std::uint8_t> RestTiles;
+        std::uint64_t LastWrite = 0;
+    };
+
+    int StepsDue(float dt);
+    void PrepareTiles();
+    void Step();
+    void StepRows(int begin, int end);
+    void StepAdi();
+    void SettleTiles();
+    TrackedBuffer& Track(const void* vertices, const VertexFormat& format);
+    void WriteRow(const float* heights, int i, std::uint8_t* vertices, const VertexFormat& format,
+        const std::uint8_t* restInBuffer)const;
+    void WriteRows(std::uint8_t* vertices, const VertexFormat& format);
+
 private:
     int mNumRows = 0;
     int mNumCols = 0;
+    int mRowPitch = 0;
 
     int mVertexCount = 0;
     int mTriangleCount = 0;
@@ -54,10 +217,46 @@ private:
     float mTimeStep = 0.0f;
     float mSpatialStep = 0.0f;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
-    std::vector<DirectX::XMFLOAT3> mNormals;
-    std::vector<DirectX::XMFLOAT3> mTangentX;
+    // Time not yet simulated.
+    float mTime = 0.0f;
+
+    Solver mSolver = Solver::Explicit;
+
+    // ADI constants: the right-hand side is
+    // k1 * prev + k2 * curr + k3 * (curr neighbours) + k4 * (prev neighbours),
+    // the tridiagonal systems have -alpha off the diagonal, and their forward
+    // elimination factors along the rows (x) and columns (z) are the same for every line.
+    float mAdiK1 = 0.0f;
+    float mAdiK2 = 0.0f;
+    float mAdiK3 = 0.0f;
+    float mAdiK4 = 0.0f;
+    float mAdiAlpha = 0.0f;
+    std::vector<float> mAdiRowUpper;
+    std::vector<float> mAdiRowInvPivot;
+    std::vector<float> mAdiColumnUpper;
+    std::vector<float> mAdiColumnInvPivot;
+
+    // The result of the row solves, with the same layout as the heights.
+    std::vector<float> mAdiScratch;
+
+    // Per tile, row by row: whether the water in it moves, how many steps in a row
+    // it has been at or below the rest height (counting stops where it stops being
+    // active), whether the next step updates it (it or a neighbour is active), and
+    // whether it is at rest (flat, and no tile next to it is stepped).
+    int mTileRows = 0;
+    int mTileCols = 0;
+    std::vector<std::uint8_t> mTileActive;
+    std::vector<std::uint8_t> mTileQuietSteps;
+    std::vector<std::uint8_t> mTileStepped;
+    std::vector<std::uint8_t> mTileAtRest;
+
+    std::vector<TrackedBuffer> mTrackedBuffers;
+    std::uint64_t mWriteCount = 0;
+
+    // Both grids live in mHeightStorage; the pointers are swapped after each step.
+    std::vector<float> mHeightStorage;
+    float* mPrevSolution = nullptr;
+    float* mCurrSolution = nullptr;
 };
 
-#endif // WAVES_H
\ No newline at end of file
+#endif // WAVES_H
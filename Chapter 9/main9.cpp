@@ -6,7 +6,11 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/MeshCache.h"
+#include "../Common/Terrain.h"
 #include "FrameResource.h"
+#include "Ocean.h"
+#include "OceanClipmap.h"
 #include "Waves.h"
 
 using Microsoft::WRL::ComPtr;
@@ -18,6 +22,10 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Terrain patch instances per frame: whole nodes plus one per drawn quadrant of the
+// rest.
+const UINT gMaxTerrainNodes = 2048;
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -84,24 +92,30 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateFloatingBox(const GameTimer& gt);
+	void UpdateTerrain(const GameTimer& gt);
+	void UpdateOcean(const GameTimer& gt);
 
 	void LoadTextures();
 	void BuildRootSignature();
 	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
-	void BuildLandGeometry();
+	void BuildTerrain();
 	void BuildWavesGeometry();
+	void BuildOceanGeometry();
 	void BuildBoxGeometry();
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
 	void BuildRenderItems();
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void DrawTerrain(ID3D12GraphicsCommandList* cmdList);
+	void DrawWaves(ID3D12GraphicsCommandList* cmdList);
+	void DrawOcean(ID3D12GraphicsCommandList* cmdList);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
 	float GetHillsHeight(float x, float z)const;
-	XMFLOAT3 GetHillsNormal(float x, float z)const;
 
 private:
 
@@ -122,8 +136,12 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mTerrainInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mWavesInputLayout;
 
 	RenderItem* mWavesRitem = nullptr;
+	RenderItem* mTerrainRitem = nullptr;
+	RenderItem* mOceanRitem = nullptr;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
@@ -132,6 +150,38 @@ private:
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
 	std::unique_ptr<Waves> mWaves;
+	WavesConstants mWavesConstants;
+
+	// The water as the last UpdateWaves left it, which the crate floats on in the pond.
+	// On the open sea it floats on mOcean, and the pond stays as it was.
+	Waves::Snapshot mWavesSnapshot;
+	RenderItem* mBoxRitem = nullptr;
+	XMFLOAT3 mBoxPosition = { 3.0f, 2.0f, -9.0f };
+
+	// The land: CDLOD patches over the hills heightfield.  Draw 0 is the whole nodes,
+	// draw 1 + q quadrant q of the others.
+	struct TerrainDraw
+	{
+		UINT IndexCount = 0;
+		UINT StartIndexLocation = 0;
+		UINT BaseInstance = 0;
+		UINT InstanceCount = 0;
+	};
+
+	Heightfield mHeightfield;
+	Terrain mTerrain;
+	TerrainConstants mTerrainConstants;
+	std::vector<Terrain::Node> mTerrainSelection;
+	TerrainDraw mTerrainDraws[5];
+
+	// The open sea the O key swaps in for the pond: clipmap levels around the eye over
+	// the ocean's tileable patch, drawn out to the far plane.
+	std::unique_ptr<Ocean> mOcean;
+	OceanClipmap mOceanClipmap;
+	OceanConstants mOceanConstants;
+	std::vector<OceanClipmap::Level> mOceanLevels;
+	bool mOpenSea = false;
+	bool mOceanKeyDown = false;
 
 	PassConstants mMainPassCB;
 
@@ -194,12 +244,20 @@ bool TexWavesApp::Initialize()
 
 	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
 
+	Ocean::Settings oceanSettings;
+	oceanSettings.Resolution = 128;
+	oceanSettings.PatchSize = 128.0f;
+	oceanSettings.WindSpeed = 8.0f;
+	mOcean = std::make_unique<Ocean>(oceanSettings);
+
 	LoadTextures();
+	BuildTerrain();
 	BuildRootSignature();
 	BuildDescriptorHeaps();
 	BuildShadersAndInputLayout();
-	BuildLandGeometry();
+	MeshCache::Global().SetDiskDirectory("MeshCache");
 	BuildWavesGeometry();
+	BuildOceanGeometry();
 	BuildBoxGeometry();
 	BuildMaterials();
 	BuildRenderItems();
@@ -246,10 +304,15 @@ void TexWavesApp::Update(const GameTimer& gt)
 	}
 
 	AnimateMaterials(gt);
+	UpdateFloatingBox(gt);
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateWaves(gt);
+	if (mOpenSea)
+		UpdateOcean(gt);
+	else
+		UpdateWaves(gt);
+	UpdateTerrain(gt);
 }
 
 void TexWavesApp::Draw(const GameTimer& gt)
@@ -287,6 +350,11 @@ void TexWavesApp::Draw(const GameTimer& gt)
 	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+	DrawTerrain(mCommandList.Get());
+	if (mOpenSea)
+		DrawOcean(mCommandList.Get());
+	else
+		DrawWaves(mCommandList.Get());
 
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -359,6 +427,11 @@ void TexWavesApp::OnMouseMove(WPARAM btnState, int x, int y)
 
 void TexWavesApp::OnKeyboardInput(const GameTimer& gt)
 {
+	// O swaps between the pond and the open sea.
+	const bool oceanKeyDown = (GetAsyncKeyState('O') & 0x8000) != 0;
+	if (oceanKeyDown && !mOceanKeyDown)
+		mOpenSea = !mOpenSea;
+	mOceanKeyDown = oceanKeyDown;
 }
 
 void TexWavesApp::UpdateCamera(const GameTimer& gt)
@@ -502,28 +575,103 @@ void TexWavesApp::UpdateWaves(const GameTimer& gt)
 		mWaves->Disturb(i, j, r);
 	}
 
-	// Update the wave simulation.
-	mWaves->Update(gt.DeltaTime());
-
-	// Update the wave vertex buffer with the new solution.
+	// Step the wave simulation and write its heights and normals straight into this
+	// frame's mapped vertex buffer, in one pass over the grid.  WavesVS places them.
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for (int i = 0; i < mWaves->VertexCount(); ++i)
+	mWaves->Update(gt.DeltaTime(), currWavesVB->MappedData(), Waves::CompactFormat());
+
+	// Set the dynamic VB of the wave renderitem to the current frame VB.
+	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+
+	mWaves->TakeSnapshot(mWavesSnapshot);
+}
+
+void TexWavesApp::UpdateFloatingBox(const GameTimer& gt)
+{
+	if (!mOpenSea && mWavesSnapshot.Empty())
+		return;
+
+	// The water under the corners of the crate's base: its mean height lifts the
+	// crate, and its slopes tilt it.
+	const float halfSize = 4.0f;
+	const float cornersX[4] = { mBoxPosition.x - halfSize, mBoxPosition.x + halfSize, mBoxPosition.x - halfSize, mBoxPosition.x + halfSize };
+	const float cornersZ[4] = { mBoxPosition.z - halfSize, mBoxPosition.z - halfSize, mBoxPosition.z + halfSize, mBoxPosition.z + halfSize };
+	float heights[4];
+
+	Waves::SampleBatch batch;
+	batch.Count = 4;
+	batch.X = cornersX;
+	batch.Z = cornersZ;
+	batch.Heights = heights;
+	if (mOpenSea)
+		mOcean->Sample(batch);
+	else
+		mWavesSnapshot.Sample(batch);
+
+	const float height = 0.25f * (heights[0] + heights[1] + heights[2] + heights[3]);
+	const float slopeX = (heights[1] + heights[3] - heights[0] - heights[2]) / (4.0f * halfSize);
+	const float slopeZ = (heights[2] + heights[3] - heights[0] - heights[1]) / (4.0f * halfSize);
+
+	// Turn y onto the normal (-slopeX, 1, -slopeZ), about the axis y x normal.
+	XMMATRIX tilt = XMMatrixIdentity();
+	XMVECTOR axis = XMVectorSet(-slopeZ, 0.0f, slopeX, 0.0f);
+	if (XMVectorGetX(XMVector3LengthSq(axis)) > 1e-12f)
+	{
+		const float angle = std::atan(std::sqrt(slopeX * slopeX + slopeZ * slopeZ));
+		tilt = XMMatrixRotationAxis(axis, angle);
+	}
+
+	XMMATRIX world = tilt * XMMatrixTranslation(mBoxPosition.x, mBoxPosition.y + height, mBoxPosition.z);
+	XMStoreFloat4x4(&mBoxRitem->World, world);
+	mBoxRitem->NumFramesDirty = gNumFrameResources;
+}
+
+void TexWavesApp::UpdateTerrain(const GameTimer& gt)
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&mView), XMLoadFloat4x4(&mProj)));
+
+	mTerrain.Select(mEyePos, Terrain::FrustumFromMatrix(viewProj), mTerrainSelection);
+
+	// Group the instances by draw: whole nodes first, then each quadrant.
+	auto currTerrainNodes = mCurrFrameResource->TerrainNodes.get();
+	UINT instance = 0;
+	for (UINT draw = 0; draw < 5; ++draw)
 	{
-		Vertex v;
+		mTerrainDraws[draw].BaseInstance = instance;
+
+		for (const Terrain::Node& node : mTerrainSelection)
+		{
+			const bool whole = node.QuadrantMask == Terrain::AllQuadrants;
+			if (draw == 0 ? !whole : (whole || (node.QuadrantMask & (1u << (draw - 1))) == 0))
+				continue;
+
+			if (instance == gMaxTerrainNodes)
+				break;
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
+			const float morphStart = mTerrain.MorphStart(node.Level);
+			const float morphEnd = mTerrain.MorphEnd(node.Level);
 
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
+			TerrainNodeData data;
+			data.Origin = XMFLOAT2(node.X, node.Z);
+			data.Size = node.Size;
+			data.Level = (float)node.Level;
+			data.MorphConstants = XMFLOAT2(morphEnd / (morphEnd - morphStart), 1.0f / (morphEnd - morphStart));
 
-		currWavesVB->CopyData(i, v);
+			currTerrainNodes->CopyData(instance++, data);
+		}
+
+		mTerrainDraws[draw].InstanceCount = instance - mTerrainDraws[draw].BaseInstance;
 	}
+}
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+void TexWavesApp::UpdateOcean(const GameTimer& gt)
+{
+	// The field costs the same however far the water reaches, and so do the levels:
+	// each is one grid, placed around the eye.
+	mOcean->Update(gt.DeltaTime());
+	mOceanClipmap.WriteField(*mOcean, mCurrFrameResource->OceanField->MappedData());
+	mOceanClipmap.Place(mEyePos, mOceanLevels);
 }
 
 void TexWavesApp::LoadTextures()
@@ -559,8 +707,11 @@ void TexWavesApp::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE texTable;
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
+	CD3DX12_DESCRIPTOR_RANGE heightMapTable;
+	heightMapTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[10];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
@@ -568,10 +719,22 @@ void TexWavesApp::BuildRootSignature()
 	slotRootParameter[2].InitAsConstantBufferView(1);
 	slotRootParameter[3].InitAsConstantBufferView(2);
 
+	// Terrain: the heightmap, the node instances and the terrain constants.
+	slotRootParameter[4].InitAsDescriptorTable(1, &heightMapTable, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[5].InitAsShaderResourceView(2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[6].InitAsConstants(sizeof(TerrainConstants) / 4, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	// The grid the compact wave vertices are placed on.
+	slotRootParameter[7].InitAsConstants(sizeof(WavesConstants) / 4, 4, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	// The ocean: its field and the clipmap level being drawn.
+	slotRootParameter[8].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[9].InitAsConstants(sizeof(OceanConstants) / 4, 5, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
 	auto staticSamplers = GetStaticSamplers();
 
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(10, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -600,7 +763,7 @@ void TexWavesApp::BuildDescriptorHeaps()
 	// Create the SRV heap.
 	//
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;
+	srvHeapDesc.NumDescriptors = 4;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -613,6 +776,7 @@ void TexWavesApp::BuildDescriptorHeaps()
 	auto grassTex = mTextures["grassTex"]->Resource;
 	auto waterTex = mTextures["waterTex"]->Resource;
 	auto fenceTex = mTextures["fenceTex"]->Resource;
+	auto heightMap = mTextures["heightMap"]->Resource;
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -633,12 +797,21 @@ void TexWavesApp::BuildDescriptorHeaps()
 
 	srvDesc.Format = fenceTex->GetDesc().Format;
 	md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
+
+	// next descriptor
+	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+
+	srvDesc.Format = heightMap->GetDesc().Format;
+	md3dDevice->CreateShaderResourceView(heightMap.Get(), &srvDesc, hDescriptor);
 }
 
 void TexWavesApp::BuildShadersAndInputLayout()
 {
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "PS", "ps_5_1");
+	mShaders["terrainVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "TerrainVS", "vs_5_1");
+	mShaders["wavesVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "WavesVS", "vs_5_1");
+	mShaders["oceanVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "OceanVS", "vs_5_1");
 
 	mInputLayout =
 	{
@@ -646,36 +819,95 @@ void TexWavesApp::BuildShadersAndInputLayout()
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	mTerrainInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	// Waves::CompactFormat(): a half height and an octahedral normal.
+	mWavesInputLayout =
+	{
+		{ "HEIGHT", 0, DXGI_FORMAT_R16_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R8G8_SNORM, 0, 2, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
-void TexWavesApp::BuildLandGeometry()
+void TexWavesApp::BuildTerrain()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	// The hills of the old land grid, 160 x 160 units, sampled every 0.156 units.
+	const UINT heightfieldSize = 1025;
+	mHeightfield.Generate(heightfieldSize, heightfieldSize, 160.0f / (heightfieldSize - 1),
+		[this](float x, float z) { return GetHillsHeight(x, z); });
+
+	Terrain::Settings settings;
+	settings.PatchSize = 32;
+	settings.FinestLodDistance = 12.0f;
+	mTerrain.Build(mHeightfield, settings);
+
+	mTerrainConstants.Origin = XMFLOAT2(mHeightfield.OriginX(), mHeightfield.OriginZ());
+	mTerrainConstants.Extent = XMFLOAT2(mHeightfield.ExtentX(), mHeightfield.ExtentZ());
+	mTerrainConstants.HeightMapInvSize = XMFLOAT2(1.0f / mHeightfield.Width(), 1.0f / mHeightfield.Depth());
+	mTerrainConstants.HeightScale = mHeightfield.HeightScale() * 65535.0f;
+	mTerrainConstants.HeightOffset = mHeightfield.HeightOffset();
+	mTerrainConstants.Spacing = mHeightfield.Spacing();
+	mTerrainConstants.PatchSize = (float)mTerrain.PatchSize();
 
 	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  In addition, color the vertices based on their height so we have
-	// sandy looking beaches, grassy low hills, and snow mountain peaks.
+	// The heightmap the vertex shader reads the heights from.
 	//
+	auto heightMap = std::make_unique<Texture>();
+	heightMap->Name = "heightMap";
+
+	D3D12_RESOURCE_DESC texDesc;
+	ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
+	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	texDesc.Alignment = 0;
+	texDesc.Width = mHeightfield.Width();
+	texDesc.Height = mHeightfield.Depth();
+	texDesc.DepthOrArraySize = 1;
+	texDesc.MipLevels = 1;
+	texDesc.Format = DXGI_FORMAT_R16_UNORM;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&heightMap->Resource)));
+
+	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(heightMap->Resource.Get(), 0, 1);
+	heightMap->UploadHeap = d3dUtil::CreateUploadBuffer(md3dDevice.Get(), uploadBufferSize);
+
+	D3D12_SUBRESOURCE_DATA subResourceData = {};
+	subResourceData.pData = mHeightfield.Samples();
+	subResourceData.RowPitch = (LONG_PTR)mHeightfield.Width() * sizeof(std::uint16_t);
+	subResourceData.SlicePitch = subResourceData.RowPitch * mHeightfield.Depth();
+
+	UpdateSubresources(mCommandList.Get(), heightMap->Resource.Get(), heightMap->UploadHeap.Get(),
+		0, 0, 1, &subResourceData);
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(heightMap->Resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+	mTextures[heightMap->Name] = std::move(heightMap);
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for (size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
-		vertices[i].Normal = GetHillsNormal(p.x, p.z);
-		vertices[i].TexC = grid.Vertices[i].TexC;
-	}
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	//
+	// The patch every node is drawn with.
+	//
+	std::vector<XMFLOAT2> vertices;
+	std::vector<std::uint16_t> indices;
+	Terrain::BuildPatch(mTerrain.PatchSize(), vertices, indices);
 
-	std::vector<std::uint16_t> indices = grid.GetIndices16();
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(XMFLOAT2);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "landGeo";
+	geo->Name = "terrainGeo";
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
@@ -689,19 +921,29 @@ void TexWavesApp::BuildLandGeometry()
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexByteStride = sizeof(XMFLOAT2);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
+	const UINT quadrantIndexCount = Terrain::QuadrantIndexCount(mTerrain.PatchSize());
+
 	SubmeshGeometry submesh;
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
-	geo->DrawArgs["grid"] = submesh;
+	geo->DrawArgs["patch"] = submesh;
+
+	mTerrainDraws[0].IndexCount = submesh.IndexCount;
+	mTerrainDraws[0].StartIndexLocation = 0;
+	for (UINT q = 0; q < 4; ++q)
+	{
+		mTerrainDraws[1 + q].IndexCount = quadrantIndexCount;
+		mTerrainDraws[1 + q].StartIndexLocation = q * quadrantIndexCount;
+	}
 
-	mGeometries["landGeo"] = std::move(geo);
+	mGeometries["terrainGeo"] = std::move(geo);
 }
 
 void TexWavesApp::BuildWavesGeometry()
@@ -729,9 +971,19 @@ void TexWavesApp::BuildWavesGeometry()
 		}
 	}
 
-	UINT vbByteSize = mWaves->VertexCount() * sizeof(Vertex);
+	const Waves::VertexFormat format = Waves::CompactFormat();
+	UINT vbByteSize = mWaves->VertexCount() * format.Stride;
 	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
+	// Vertex (i, j) is at ((j - (n - 1) / 2) * dx, h, ((m - 1) / 2 - i) * dx) with
+	// texture coordinates ((j + 0.5) / n, (i + 0.5) / m), as Waves::Update would write
+	// them; Width() and Depth() are n * dx and m * dx.
+	const float spacing = mWaves->Width() / n;
+	mWavesConstants.Origin = XMFLOAT2(-0.5f * (n - 1) * spacing, 0.5f * (m - 1) * spacing);
+	mWavesConstants.TexCoordStep = XMFLOAT2(1.0f / n, 1.0f / m);
+	mWavesConstants.Spacing = spacing;
+	mWavesConstants.ColumnCount = n;
+
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
 
@@ -745,7 +997,7 @@ void TexWavesApp::BuildWavesGeometry()
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexByteStride = format.Stride;
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
@@ -760,23 +1012,81 @@ void TexWavesApp::BuildWavesGeometry()
 	mGeometries["waterGeo"] = std::move(geo);
 }
 
+void TexWavesApp::BuildOceanGeometry()
+{
+	// Six levels of 64 x 64 cells from 1 unit apart reach 1024 units from the eye,
+	// past the far plane.
+	OceanClipmap::Settings settings;
+	settings.GridSize = 64;
+	settings.LevelCount = 6;
+	settings.FinestSpacing = 1.0f;
+	mOceanClipmap.Build(*mOcean, settings);
+
+	// Field point (i, j) is at (j - n / 2, n / 2 - i) * spacing.
+	const float fieldSpacing = mOcean->Width() / mOceanClipmap.FieldResolution();
+	mOceanConstants.GridSize = (float)mOceanClipmap.GridSize();
+	mOceanConstants.MorphConstants = XMFLOAT2(mOceanClipmap.MorphStart(),
+		1.0f / (mOceanClipmap.MorphEnd() - mOceanClipmap.MorphStart()));
+	mOceanConstants.FieldOrigin = XMFLOAT2(-0.5f * mOcean->Width(), 0.5f * mOcean->Depth());
+	mOceanConstants.FieldInvSpacing = 1.0f / fieldSpacing;
+	mOceanConstants.FieldResolution = mOceanClipmap.FieldResolution();
+
+	//
+	// The grid every level is drawn with.
+	//
+	std::vector<XMFLOAT2> vertices;
+	std::vector<std::uint16_t> indices;
+	OceanClipmap::BuildGrid(mOceanClipmap.GridSize(), vertices, indices);
+
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(XMFLOAT2);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "oceanGeo";
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+
+	geo->VertexByteStride = sizeof(XMFLOAT2);
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = OceanClipmap::IndexCount(mOceanClipmap.GridSize(), OceanClipmap::NoHole);
+	submesh.StartIndexLocation = OceanClipmap::IndexStart(mOceanClipmap.GridSize(), OceanClipmap::NoHole);
+	submesh.BaseVertexLocation = 0;
+
+	geo->DrawArgs["grid"] = submesh;
+
+	mGeometries["oceanGeo"] = std::move(geo);
+}
+
 void TexWavesApp::BuildBoxGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(8.0f, 8.0f, 8.0f, 3);
+	MeshCache::Mesh box = MeshCache::Global().Box(8.0f, 8.0f, 8.0f, 3);
 
-	std::vector<Vertex> vertices(box.Vertices.size());
-	for (size_t i = 0; i < box.Vertices.size(); ++i)
+	std::vector<Vertex> vertices(box->Vertices.size());
+	for (size_t i = 0; i < box->Vertices.size(); ++i)
 	{
-		auto& p = box.Vertices[i].Position;
+		auto& p = box->Vertices[i].Position;
 		vertices[i].Pos = p;
-		vertices[i].Normal = box.Vertices[i].Normal;
-		vertices[i].TexC = box.Vertices[i].TexC;
+		vertices[i].Normal = box->Vertices[i].Normal;
+		vertices[i].TexC = box->Vertices[i].TexC;
 	}
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-	std::vector<std::uint16_t> indices = box.GetIndices16();
+	std::vector<std::uint16_t> indices = box->GetIndices16();
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
@@ -840,6 +1150,42 @@ void TexWavesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	//
+	// PSO for the terrain patches.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC terrainPsoDesc = opaquePsoDesc;
+	terrainPsoDesc.InputLayout = { mTerrainInputLayout.data(), (UINT)mTerrainInputLayout.size() };
+	terrainPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["terrainVS"]->GetBufferPointer()),
+		mShaders["terrainVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&terrainPsoDesc, IID_PPV_ARGS(&mPSOs["terrain"])));
+
+	//
+	// PSO for the compact wave vertices.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesPsoDesc = opaquePsoDesc;
+	wavesPsoDesc.InputLayout = { mWavesInputLayout.data(), (UINT)mWavesInputLayout.size() };
+	wavesPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["wavesVS"]->GetBufferPointer()),
+		mShaders["wavesVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesPsoDesc, IID_PPV_ARGS(&mPSOs["waves"])));
+
+	//
+	// PSO for the ocean clipmap levels.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC oceanPsoDesc = opaquePsoDesc;
+	oceanPsoDesc.InputLayout = { mTerrainInputLayout.data(), (UINT)mTerrainInputLayout.size() };
+	oceanPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["oceanVS"]->GetBufferPointer()),
+		mShaders["oceanVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&oceanPsoDesc, IID_PPV_ARGS(&mPSOs["ocean"])));
 }
 
 void TexWavesApp::BuildFrameResources()
@@ -847,7 +1193,8 @@ void TexWavesApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount(), gMaxTerrainNodes,
+			mOceanClipmap.FieldTexelCount()));
 	}
 }
 
@@ -897,25 +1244,40 @@ void TexWavesApp::BuildRenderItems()
 	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 
+	// Drawn by DrawWaves, with the PSO that places the compact vertices.
 	mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
-
-	auto gridRitem = std::make_unique<RenderItem>();
-	gridRitem->World = MathHelper::Identity4x4();
-	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
-	gridRitem->ObjCBIndex = 1;
-	gridRitem->Mat = mMaterials["grass"].get();
-	gridRitem->Geo = mGeometries["landGeo"].get();
-	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
-
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
+	// Drawn by DrawTerrain, which places the patches itself; the render item holds
+	// the texture transform and material.
+	auto terrainRitem = std::make_unique<RenderItem>();
+	terrainRitem->World = MathHelper::Identity4x4();
+	XMStoreFloat4x4(&terrainRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
+	terrainRitem->ObjCBIndex = 1;
+	terrainRitem->Mat = mMaterials["grass"].get();
+	terrainRitem->Geo = mGeometries["terrainGeo"].get();
+	terrainRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	terrainRitem->IndexCount = terrainRitem->Geo->DrawArgs["patch"].IndexCount;
+	terrainRitem->StartIndexLocation = terrainRitem->Geo->DrawArgs["patch"].StartIndexLocation;
+	terrainRitem->BaseVertexLocation = terrainRitem->Geo->DrawArgs["patch"].BaseVertexLocation;
+
+	mTerrainRitem = terrainRitem.get();
+
+	// Drawn by DrawOcean, a level at a time; the texture repeats with the ocean patch.
+	auto oceanRitem = std::make_unique<RenderItem>();
+	oceanRitem->World = MathHelper::Identity4x4();
+	XMStoreFloat4x4(&oceanRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
+	oceanRitem->ObjCBIndex = 3;
+	oceanRitem->Mat = mMaterials["water"].get();
+	oceanRitem->Geo = mGeometries["oceanGeo"].get();
+	oceanRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	oceanRitem->IndexCount = oceanRitem->Geo->DrawArgs["grid"].IndexCount;
+	oceanRitem->StartIndexLocation = oceanRitem->Geo->DrawArgs["grid"].StartIndexLocation;
+	oceanRitem->BaseVertexLocation = oceanRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+
+	mOceanRitem = oceanRitem.get();
 
 	auto boxRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation(3.0f, 2.0f, -9.0f));
+	XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation(mBoxPosition.x, mBoxPosition.y, mBoxPosition.z));
 	boxRitem->ObjCBIndex = 2;
 	boxRitem->Mat = mMaterials["wirefence"].get();
 	boxRitem->Geo = mGeometries["boxGeo"].get();
@@ -924,11 +1286,14 @@ void TexWavesApp::BuildRenderItems()
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
 
+	mBoxRitem = boxRitem.get();
+
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
 
 	mAllRitems.push_back(std::move(wavesRitem));
-	mAllRitems.push_back(std::move(gridRitem));
+	mAllRitems.push_back(std::move(terrainRitem));
 	mAllRitems.push_back(std::move(boxRitem));
+	mAllRitems.push_back(std::move(oceanRitem));
 }
 
 void TexWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -962,6 +1327,126 @@ void TexWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std:
 	}
 }
 
+void TexWavesApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	auto terrainNodes = mCurrFrameResource->TerrainNodes->Resource();
+
+	auto ri = mTerrainRitem;
+
+	cmdList->SetPipelineState(mPSOs["terrain"].Get());
+
+	cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE heightMap(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	heightMap.Offset(3, mCbvSrvDescriptorSize);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+	D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+
+	cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
+	cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+	cmdList->SetGraphicsRootDescriptorTable(4, heightMap);
+	cmdList->SetGraphicsRootShaderResourceView(5, terrainNodes->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRoot32BitConstants(6, sizeof(TerrainConstants) / 4, &mTerrainConstants, 0);
+
+	// SV_InstanceID starts from 0 in every draw, so the shader is told where the
+	// draw's instances begin.
+	const UINT nodeBaseConstant = offsetof(TerrainConstants, NodeBase) / 4;
+	for (const TerrainDraw& draw : mTerrainDraws)
+	{
+		if (draw.InstanceCount == 0)
+			continue;
+
+		cmdList->SetGraphicsRoot32BitConstant(6, draw.BaseInstance, nodeBaseConstant);
+		cmdList->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.StartIndexLocation, 0, 0);
+	}
+}
+
+void TexWavesApp::DrawWaves(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+
+	auto ri = mWavesRitem;
+
+	cmdList->SetPipelineState(mPSOs["waves"].Get());
+
+	cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+	D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+
+	cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
+	cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+	cmdList->SetGraphicsRoot32BitConstants(7, sizeof(WavesConstants) / 4, &mWavesConstants, 0);
+
+	// SV_VertexID is the index plus the base vertex, which is 0: the grid index.
+	cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+}
+
+void TexWavesApp::DrawOcean(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	auto oceanField = mCurrFrameResource->OceanField->Resource();
+
+	auto ri = mOceanRitem;
+
+	cmdList->SetPipelineState(mPSOs["ocean"].Get());
+
+	cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+	D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+
+	cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
+	cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+	cmdList->SetGraphicsRootShaderResourceView(8, oceanField->GetGPUVirtualAddress());
+
+	// One draw per level, with the indices that leave out the finer level's square.
+	const UINT gridSize = mOceanClipmap.GridSize();
+	for (const OceanClipmap::Level& level : mOceanLevels)
+	{
+		mOceanConstants.LevelOrigin = XMFLOAT2(level.X, level.Z);
+		mOceanConstants.LevelSize = level.Size;
+		mOceanConstants.FieldMip = level.FieldMip;
+		mOceanConstants.NextFieldMip = level.NextFieldMip;
+		cmdList->SetGraphicsRoot32BitConstants(9, sizeof(OceanConstants) / 4, &mOceanConstants, 0);
+
+		cmdList->DrawIndexedInstanced(OceanClipmap::IndexCount(gridSize, level.Hole), 1,
+			OceanClipmap::IndexStart(gridSize, level.Hole), 0, 0);
+	}
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> TexWavesApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
@@ -1023,17 +1508,3 @@ float TexWavesApp::GetHillsHeight(float x, float z)const
 {
 	return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
 }
-
-XMFLOAT3 TexWavesApp::GetHillsNormal(float x, float z)const
-{
-	// n = (-df/dx, 1, -df/dz)
-	XMFLOAT3 n(
-		-0.03f * z * cosf(0.1f * x) - 0.3f * cosf(0.1f * z),
-		1.0f,
-		-0.3f * sinf(0.1f * x) + 0.03f * x * sinf(0.1f * z));
-
-	XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-	XMStoreFloat3(&n, unitNormal);
-
-	return n;
-}
@@ -0,0 +1,1030 @@
+//***************************************************************************************
+// BlockCompression.cpp
+//***************************************************************************************
+
+#include "BlockCompression.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BC_TARGET_AVX2
+#else
+#define BC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace BlockCompression
+{
+namespace
+{
+	// 16 pixels with each channel stored contiguously, so the kernels can load 4 or 8
+	// pixels of one channel at a time.
+	struct Block
+	{
+		alignas(32) float C[4][16];
+	};
+
+	struct Palette
+	{
+		int Count = 0;
+		float C[16][4];
+	};
+
+	const int gBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	//-----------------------------------------------------------------------------------
+	// Nearest-palette search.  Writes the index of the closest entry for every pixel
+	// (weighted squared distance over the first 'channels' channels) and returns the
+	// summed error.  Ties keep the lowest index in every version.
+	//
+	// Every version adds weights[c] * (e * e) to the distance channel by channel and
+	// sums the pixel errors with SumErrors, so they return the same bits and the
+	// encoders make the same choices whichever runs.
+	//-----------------------------------------------------------------------------------
+	typedef float (*SelectIndicesFn)(const Block& block, int channels, const float weights[4],
+		const Palette& palette, uint8_t indices[16]);
+
+	// Pairwise: errors 0 + 1, 2 + 3, ..., then those pairs in turn.
+	float SumErrors(const float errors[16])
+	{
+		float sums[16];
+		std::memcpy(sums, errors, sizeof(sums));
+		for (int n = 8; n > 0; n /= 2)
+		{
+			for (int i = 0; i < n; ++i)
+				sums[i] = sums[2 * i] + sums[2 * i + 1];
+		}
+		return sums[0];
+	}
+
+	float SelectIndicesScalar(const Block& block, int channels, const float weights[4],
+		const Palette& palette, uint8_t indices[16])
+	{
+		float errors[16];
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = FLT_MAX;
+			int bestIndex = 0;
+			for (int k = 0; k < palette.Count; ++k)
+			{
+				float d = 0.0f;
+				for (int c = 0; c < channels; ++c)
+				{
+					float e = block.C[c][i] - palette.C[k][c];
+					d += weights[c] * (e * e);
+				}
+				if (d < best)
+				{
+					best = d;
+					bestIndex = k;
+				}
+			}
+			indices[i] = (uint8_t)bestIndex;
+			errors[i] = best;
+		}
+		return SumErrors(errors);
+	}
+
+#if defined(BC_X86)
+	float SelectIndicesSse2(const Block& block, int channels, const float weights[4],
+		const Palette& palette, uint8_t indices[16])
+	{
+		alignas(16) float errors[16];
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128 x[4];
+			for (int c = 0; c < channels; ++c)
+				x[c] = _mm_load_ps(&block.C[c][i]);
+
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int k = 0; k < palette.Count; ++k)
+			{
+				__m128 d = _mm_setzero_ps();
+				for (int c = 0; c < channels; ++c)
+				{
+					__m128 e = _mm_sub_ps(x[c], _mm_set1_ps(palette.C[k][c]));
+					d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(weights[c]), _mm_mul_ps(e, e)));
+				}
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+			}
+
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+			for (int j = 0; j < 4; ++j)
+				indices[i + j] = (uint8_t)lanes[j];
+
+			_mm_store_ps(&errors[i], best);
+		}
+		return SumErrors(errors);
+	}
+
+	BC_TARGET_AVX2 float SelectIndicesAvx2(const Block& block, int channels, const float weights[4],
+		const Palette& palette, uint8_t indices[16])
+	{
+		alignas(32) float errors[16];
+		for (int i = 0; i < 16; i += 8)
+		{
+			__m256 x[4];
+			for (int c = 0; c < channels; ++c)
+				x[c] = _mm256_load_ps(&block.C[c][i]);
+
+			__m256 best = _mm256_set1_ps(FLT_MAX);
+			__m256i bestIndex = _mm256_setzero_si256();
+			for (int k = 0; k < palette.Count; ++k)
+			{
+				__m256 d = _mm256_setzero_ps();
+				for (int c = 0; c < channels; ++c)
+				{
+					__m256 e = _mm256_sub_ps(x[c], _mm256_set1_ps(palette.C[k][c]));
+					d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(weights[c]), _mm256_mul_ps(e, e)));
+				}
+
+				__m256i closer = _mm256_castps_si256(_mm256_cmp_ps(d, best, _CMP_LT_OQ));
+				best = _mm256_min_ps(d, best);
+				bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(k), closer);
+			}
+
+			alignas(32) int32_t lanes[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), bestIndex);
+			for (int j = 0; j < 8; ++j)
+				indices[i + j] = (uint8_t)lanes[j];
+
+			_mm256_store_ps(&errors[i], best);
+		}
+		return SumErrors(errors);
+	}
+#endif
+
+	Isa DetectIsa()
+	{
+#if defined(BC_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return Isa::Avx2;
+		}
+		return sse2 ? Isa::Sse2 : Isa::Scalar;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return Isa::Avx2;
+		return __builtin_cpu_supports("sse2") ? Isa::Sse2 : Isa::Scalar;
+#endif
+#else
+		return Isa::Scalar;
+#endif
+	}
+
+	const Isa gDetectedIsa = DetectIsa();
+	std::atomic<int> gActiveIsa((int)gDetectedIsa);
+
+	SelectIndicesFn GetSelectIndices()
+	{
+#if defined(BC_X86)
+		switch ((Isa)gActiveIsa.load(std::memory_order_relaxed))
+		{
+		case Isa::Avx2: return SelectIndicesAvx2;
+		case Isa::Sse2: return SelectIndicesSse2;
+		default: break;
+		}
+#endif
+		return SelectIndicesScalar;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Endpoint fitting helpers.
+	//-----------------------------------------------------------------------------------
+
+	// Principal axis of the block's colours in the first 'channels' channels, by power
+	// iteration on the covariance matrix.
+	void PrincipalAxis(const Block& block, int channels, float mean[4], float axis[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			mean[c] = 0.0f;
+			axis[c] = 0.0f;
+		}
+
+		for (int c = 0; c < channels; ++c)
+		{
+			for (int i = 0; i < 16; ++i)
+				mean[c] += block.C[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float cov[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float d[4];
+			for (int c = 0; c < channels; ++c)
+				d[c] = block.C[c][i] - mean[c];
+			for (int a = 0; a < channels; ++a)
+				for (int b = a; b < channels; ++b)
+					cov[a][b] += d[a] * d[b];
+		}
+		for (int a = 0; a < channels; ++a)
+			for (int b = 0; b < a; ++b)
+				cov[a][b] = cov[b][a];
+
+		// Start from the channel with the largest spread.
+		int widest = 0;
+		for (int c = 1; c < channels; ++c)
+			if (cov[c][c] > cov[widest][widest])
+				widest = c;
+
+		float v[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int c = 0; c < channels; ++c)
+			v[c] = cov[widest][c];
+
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int a = 0; a < channels; ++a)
+				for (int b = 0; b < channels; ++b)
+					next[a] += cov[a][b] * v[b];
+
+			float length = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				length = std::max(length, std::fabs(next[c]));
+			if (length < 1e-12f)
+				break;
+
+			for (int c = 0; c < channels; ++c)
+				v[c] = next[c] / length;
+		}
+
+		float length = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			length += v[c] * v[c];
+
+		if (length > 1e-12f)
+		{
+			length = std::sqrt(length);
+			for (int c = 0; c < channels; ++c)
+				axis[c] = v[c] / length;
+		}
+	}
+
+	// Endpoints at the extremes of the block's projection onto its principal axis.
+	void FitEndpoints(const Block& block, int channels, float e0[4], float e1[4])
+	{
+		float mean[4], axis[4];
+		PrincipalAxis(block, channels, mean, axis);
+
+		float tMin = FLT_MAX, tMax = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (block.C[c][i] - mean[c]) * axis[c];
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		for (int c = 0; c < 4; ++c)
+		{
+			e0[c] = std::min(std::max(mean[c] + tMin * axis[c], 0.0f), 255.0f);
+			e1[c] = std::min(std::max(mean[c] + tMax * axis[c], 0.0f), 255.0f);
+		}
+	}
+
+	// Least-squares endpoints for fixed indices, where index k blends the endpoints
+	// with weight blend[k] on e1.  Returns false if the system is singular.
+	bool RefineEndpoints(const Block& block, int channels, const uint8_t indices[16], const float* blend,
+		float e0[4], float e1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float b = blend[indices[i]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channels; ++c)
+			{
+				ax[c] += a * block.C[c][i];
+				bx[c] += b * block.C[c][i];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+			return false;
+
+		float inv = 1.0f / det;
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) * inv, 0.0f), 255.0f);
+			e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) * inv, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Bit packing.
+	//-----------------------------------------------------------------------------------
+	struct BitWriter
+	{
+		uint8_t* Out;
+		int Position = 0;
+
+		void Write(uint32_t value, int bits)
+		{
+			for (int i = 0; i < bits; ++i, ++Position)
+			{
+				if (value & (1u << i))
+					Out[Position >> 3] |= (uint8_t)(1u << (Position & 7));
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* In;
+		int Position = 0;
+
+		uint32_t Read(int bits)
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < bits; ++i, ++Position)
+				value |= (uint32_t)((In[Position >> 3] >> (Position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	//-----------------------------------------------------------------------------------
+	// BC1 colour block (also the colour half of BC3).
+	//-----------------------------------------------------------------------------------
+	uint16_t Pack565(const float c[4])
+	{
+		int r = (int)(c[0] * (31.0f / 255.0f) + 0.5f);
+		int g = (int)(c[1] * (63.0f / 255.0f) + 0.5f);
+		int b = (int)(c[2] * (31.0f / 255.0f) + 0.5f);
+		r = std::min(std::max(r, 0), 31);
+		g = std::min(std::max(g, 0), 63);
+		b = std::min(std::max(b, 0), 31);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint16_t v, int rgb[3])
+	{
+		int r = (v >> 11) & 31;
+		int g = (v >> 5) & 63;
+		int b = v & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Palette exactly as DecodeColorBlock reconstructs it.
+	void ColorPalette(uint16_t c0, uint16_t c1, bool fourColor, Palette& palette)
+	{
+		int a[3], b[3];
+		Unpack565(c0, a);
+		Unpack565(c1, b);
+
+		palette.Count = fourColor ? 4 : 3;
+		for (int c = 0; c < 3; ++c)
+		{
+			palette.C[0][c] = (float)a[c];
+			palette.C[1][c] = (float)b[c];
+			if (fourColor)
+			{
+				palette.C[2][c] = (float)((2 * a[c] + b[c]) / 3);
+				palette.C[3][c] = (float)((a[c] + 2 * b[c]) / 3);
+			}
+			else
+			{
+				palette.C[2][c] = (float)((a[c] + b[c]) / 2);
+			}
+		}
+	}
+
+	void EncodeColorBlock(const uint8_t rgba[64], uint8_t out[8], bool allowTransparent, unsigned flags)
+	{
+		const SelectIndicesFn selectIndices = GetSelectIndices();
+
+		// Pixels below half alpha become transparent black in the 3-colour mode.
+		bool transparent[16];
+		bool anyTransparent = false;
+		for (int i = 0; i < 16; ++i)
+		{
+			transparent[i] = allowTransparent && rgba[i * 4 + 3] < 128;
+			anyTransparent |= transparent[i];
+		}
+
+		Block block;
+		int numOpaque = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				block.C[c][i] = rgba[i * 4 + c];
+			block.C[3][i] = 0.0f;
+			numOpaque += transparent[i] ? 0 : 1;
+		}
+
+		if (numOpaque == 0)
+		{
+			// c0 <= c1 selects the 3-colour mode; index 3 is transparent.
+			std::memset(out, 0, 4);
+			std::memset(out + 4, 0xFF, 4);
+			return;
+		}
+
+		// Fit on the opaque pixels only by replacing the transparent ones with an
+		// opaque pixel of the block.
+		Block fitBlock = block;
+		if (anyTransparent)
+		{
+			int donor = 0;
+			while (transparent[donor])
+				++donor;
+			for (int i = 0; i < 16; ++i)
+				if (transparent[i])
+					for (int c = 0; c < 3; ++c)
+						fitBlock.C[c][i] = block.C[c][donor];
+		}
+
+		const float perceptual[4] = { 0.299f * 3.0f, 0.587f * 3.0f, 0.114f * 3.0f, 0.0f };
+		const float uniform[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+		const float* weights = (flags & EncodePerceptual) ? perceptual : uniform;
+
+		const bool fourColor = !anyTransparent;
+		const float blend4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		const float blend3[3] = { 0.0f, 1.0f, 0.5f };
+		const float* blend = fourColor ? blend4 : blend3;
+
+		float e0[4], e1[4];
+		FitEndpoints(fitBlock, 3, e0, e1);
+
+		uint16_t bestC0 = 0, bestC1 = 0;
+		uint8_t bestIndices[16];
+		float bestError = FLT_MAX;
+
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			uint16_t c0 = Pack565(e1);
+			uint16_t c1 = Pack565(e0);
+
+			Palette palette;
+			ColorPalette(c0, c1, fourColor, palette);
+
+			uint8_t indices[16];
+			float error = selectIndices(fitBlock, 3, weights, palette, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				bestC0 = c0;
+				bestC1 = c1;
+				std::memcpy(bestIndices, indices, 16);
+			}
+
+			if (error == 0.0f)
+				break;
+
+			// Palette index k is blend[k] of the way from c0 (e1 here) to c1 (e0).
+			float r0[4] = {}, r1[4] = {};
+			if (!RefineEndpoints(fitBlock, 3, indices, blend, r1, r0))
+				break;
+			std::memcpy(e0, r0, sizeof(e0));
+			std::memcpy(e1, r1, sizeof(e1));
+		}
+
+		// Order the endpoints for the mode: c0 > c1 means 4 colours, c0 <= c1 means 3.
+		if (fourColor)
+		{
+			if (bestC0 < bestC1)
+			{
+				std::swap(bestC0, bestC1);
+				for (int i = 0; i < 16; ++i)
+					bestIndices[i] = (uint8_t)(bestIndices[i] ^ 1);
+			}
+			else if (bestC0 == bestC1)
+			{
+				std::memset(bestIndices, 0, 16);
+			}
+		}
+		else
+		{
+			if (bestC0 > bestC1)
+			{
+				std::swap(bestC0, bestC1);
+				for (int i = 0; i < 16; ++i)
+					if (bestIndices[i] < 2)
+						bestIndices[i] = (uint8_t)(bestIndices[i] ^ 1);
+			}
+
+			for (int i = 0; i < 16; ++i)
+				if (transparent[i])
+					bestIndices[i] = 3;
+		}
+
+		out[0] = (uint8_t)(bestC0 & 0xFF);
+		out[1] = (uint8_t)(bestC0 >> 8);
+		out[2] = (uint8_t)(bestC1 & 0xFF);
+		out[3] = (uint8_t)(bestC1 >> 8);
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (uint32_t)bestIndices[i] << (2 * i);
+		out[4] = (uint8_t)(bits);
+		out[5] = (uint8_t)(bits >> 8);
+		out[6] = (uint8_t)(bits >> 16);
+		out[7] = (uint8_t)(bits >> 24);
+	}
+
+	void DecodeColorBlock(const uint8_t in[8], uint8_t rgba[64], bool alwaysFourColor)
+	{
+		uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+		uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+		bool fourColor = alwaysFourColor || c0 > c1;
+
+		Palette palette;
+		ColorPalette(c0, c1, fourColor, palette);
+
+		uint32_t bits = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = (bits >> (2 * i)) & 3;
+			uint8_t* p = rgba + i * 4;
+			if (index == 3 && !fourColor)
+			{
+				p[0] = p[1] = p[2] = p[3] = 0;
+			}
+			else
+			{
+				p[0] = (uint8_t)palette.C[index][0];
+				p[1] = (uint8_t)palette.C[index][1];
+				p[2] = (uint8_t)palette.C[index][2];
+				p[3] = 255;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC4 single channel block (BC3 alpha, BC4, both halves of BC5).
+	//-----------------------------------------------------------------------------------
+	void ChannelPalette(int r0, int r1, Palette& palette)
+	{
+		palette.Count = 8;
+		palette.C[0][0] = (float)r0;
+		palette.C[1][0] = (float)r1;
+		if (r0 > r1)
+		{
+			for (int i = 2; i < 8; ++i)
+				palette.C[i][0] = (float)(((8 - i) * r0 + (i - 1) * r1) / 7);
+		}
+		else
+		{
+			for (int i = 2; i < 6; ++i)
+				palette.C[i][0] = (float)(((6 - i) * r0 + (i - 1) * r1) / 5);
+			palette.C[6][0] = 0.0f;
+			palette.C[7][0] = 255.0f;
+		}
+	}
+
+	void EncodeChannelBlock(const uint8_t* pixels, int stride, uint8_t out[8])
+	{
+		const SelectIndicesFn selectIndices = GetSelectIndices();
+		const float weights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+		Block block;
+		int lo = 255, hi = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int v = pixels[i * stride];
+			block.C[0][i] = (float)v;
+			lo = std::min(lo, v);
+			hi = std::max(hi, v);
+		}
+
+		uint8_t bestIndices[16] = {};
+		int bestR0 = hi, bestR1 = lo;
+
+		if (hi > lo)
+		{
+			// 8-value mode (r0 > r1): index k sits (k - 1) / 7 of the way from r0 to r1.
+			const float blend[8] = { 0.0f, 1.0f, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+			float bestError = FLT_MAX;
+			int r0 = hi, r1 = lo;
+
+			for (int iteration = 0; iteration < 3; ++iteration)
+			{
+				Palette palette;
+				ChannelPalette(r0, r1, palette);
+
+				uint8_t indices[16];
+				float error = selectIndices(block, 1, weights, palette, indices);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestR0 = r0;
+					bestR1 = r1;
+					std::memcpy(bestIndices, indices, 16);
+				}
+
+				if (error == 0.0f)
+					break;
+
+				float e0[4] = {}, e1[4] = {};
+				if (!RefineEndpoints(block, 1, indices, blend, e0, e1))
+					break;
+
+				int n0 = (int)(e0[0] + 0.5f);
+				int n1 = (int)(e1[0] + 0.5f);
+				if (n0 <= n1)
+					break;
+				if (n0 == r0 && n1 == r1)
+					break;
+				r0 = n0;
+				r1 = n1;
+			}
+		}
+
+		out[0] = (uint8_t)bestR0;
+		out[1] = (uint8_t)bestR1;
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (uint64_t)bestIndices[i] << (3 * i);
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = (uint8_t)(bits >> (8 * i));
+	}
+
+	void DecodeChannelBlock(const uint8_t in[8], uint8_t* pixels, int stride)
+	{
+		Palette palette;
+		ChannelPalette(in[0], in[1], palette);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= (uint64_t)in[2 + i] << (8 * i);
+
+		for (int i = 0; i < 16; ++i)
+			pixels[i * stride] = (uint8_t)palette.C[(bits >> (3 * i)) & 7][0];
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC7 mode 6.
+	//-----------------------------------------------------------------------------------
+	void Mode6Palette(const int v0[4], const int v1[4], Palette& palette)
+	{
+		palette.Count = 16;
+		for (int k = 0; k < 16; ++k)
+		{
+			int w = gBC7Weights4[k];
+			for (int c = 0; c < 4; ++c)
+				palette.C[k][c] = (float)(((64 - w) * v0[c] + w * v1[c] + 32) >> 6);
+		}
+	}
+
+	// Quantizes an endpoint to 7 bits plus the given p-bit.
+	void QuantizeMode6(const float e[4], int pbit, int q[4], int v[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			int value = (int)std::floor((e[c] - pbit) * 0.5f + 0.5f);
+			q[c] = std::min(std::max(value, 0), 127);
+			v[c] = (q[c] << 1) | pbit;
+		}
+	}
+
+	void EncodeBC7Block(const uint8_t rgba[64], uint8_t out[16], unsigned flags)
+	{
+		const SelectIndicesFn selectIndices = GetSelectIndices();
+
+		Block block;
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 4; ++c)
+				block.C[c][i] = rgba[i * 4 + c];
+
+		const float perceptual[4] = { 0.299f * 3.0f, 0.587f * 3.0f, 0.114f * 3.0f, 1.0f };
+		const float uniform[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		const float* weights = (flags & EncodePerceptual) ? perceptual : uniform;
+
+		float blend[16];
+		for (int k = 0; k < 16; ++k)
+			blend[k] = gBC7Weights4[k] / 64.0f;
+
+		float e0[4], e1[4];
+		FitEndpoints(block, 4, e0, e1);
+
+		int bestQ0[4] = {}, bestQ1[4] = {};
+		int bestP0 = 0, bestP1 = 0;
+		uint8_t bestIndices[16] = {};
+		float bestError = FLT_MAX;
+
+		for (int iteration = 0; iteration < 2; ++iteration)
+		{
+			uint8_t roundIndices[16] = {};
+			float roundError = FLT_MAX;
+
+			for (int pbits = 0; pbits < 4; ++pbits)
+			{
+				int p0 = pbits & 1, p1 = pbits >> 1;
+				int q0[4], q1[4], v0[4], v1[4];
+				QuantizeMode6(e0, p0, q0, v0);
+				QuantizeMode6(e1, p1, q1, v1);
+
+				Palette palette;
+				Mode6Palette(v0, v1, palette);
+
+				uint8_t indices[16];
+				float error = selectIndices(block, 4, weights, palette, indices);
+				if (error < roundError)
+				{
+					roundError = error;
+					std::memcpy(roundIndices, indices, 16);
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					std::memcpy(bestQ0, q0, sizeof(q0));
+					std::memcpy(bestQ1, q1, sizeof(q1));
+					bestP0 = p0;
+					bestP1 = p1;
+					std::memcpy(bestIndices, indices, 16);
+				}
+			}
+
+			if (bestError == 0.0f || !RefineEndpoints(block, 4, roundIndices, blend, e0, e1))
+				break;
+		}
+
+		// The anchor (pixel 0) index is stored without its top bit.
+		if (bestIndices[0] & 8)
+		{
+			std::swap(bestQ0, bestQ1);
+			std::swap(bestP0, bestP1);
+			for (int i = 0; i < 16; ++i)
+				bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer = { out };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Write(bestQ0[c], 7);
+			writer.Write(bestQ1[c], 7);
+		}
+		writer.Write(bestP0, 1);
+		writer.Write(bestP1, 1);
+		writer.Write(bestIndices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.Write(bestIndices[i], 4);
+	}
+
+	bool DecodeBC7Block(const uint8_t in[16], uint8_t rgba[64])
+	{
+		// Mode 6 blocks start with six zero bits followed by a one.
+		if ((in[0] & 0x7F) != 0x40)
+		{
+			std::memset(rgba, 0, 64);
+			return false;
+		}
+
+		BitReader reader = { in, 7 };
+		int q0[4], q1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			q0[c] = (int)reader.Read(7);
+			q1[c] = (int)reader.Read(7);
+		}
+		int p0 = (int)reader.Read(1);
+		int p1 = (int)reader.Read(1);
+
+		int v0[4], v1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			v0[c] = (q0[c] << 1) | p0;
+			v1[c] = (q1[c] << 1) | p1;
+		}
+
+		Palette palette;
+		Mode6Palette(v0, v1, palette);
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = (int)reader.Read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; ++c)
+				rgba[i * 4 + c] = (uint8_t)palette.C[index][c];
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Image helpers.
+	//-----------------------------------------------------------------------------------
+	void LoadBlock(const uint8_t* pixels, size_t width, size_t height, size_t rowPitch,
+		size_t bx, size_t by, bool bgra, uint8_t rgba[64])
+	{
+		for (size_t y = 0; y < 4; ++y)
+		{
+			const uint8_t* row = pixels + std::min(by * 4 + y, height - 1) * rowPitch;
+			for (size_t x = 0; x < 4; ++x)
+			{
+				const uint8_t* p = row + std::min(bx * 4 + x, width - 1) * 4;
+				uint8_t* q = rgba + (y * 4 + x) * 4;
+				q[0] = bgra ? p[2] : p[0];
+				q[1] = p[1];
+				q[2] = bgra ? p[0] : p[2];
+				q[3] = p[3];
+			}
+		}
+	}
+
+	void StoreBlock(const uint8_t rgba[64], size_t bx, size_t by, size_t width, size_t height,
+		uint8_t* pixels, size_t rowPitch)
+	{
+		for (size_t y = 0; y < 4 && by * 4 + y < height; ++y)
+		{
+			uint8_t* row = pixels + (by * 4 + y) * rowPitch;
+			for (size_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+				std::memcpy(row + (bx * 4 + x) * 4, rgba + (y * 4 + x) * 4, 4);
+		}
+	}
+}
+
+size_t BlockSize(Format format)
+{
+	return (format == Format::BC1 || format == Format::BC4) ? 8 : 16;
+}
+
+size_t RowPitch(Format format, size_t width)
+{
+	return std::max<size_t>((width + 3) / 4, 1) * BlockSize(format);
+}
+
+size_t ImageSize(Format format, size_t width, size_t height)
+{
+	return RowPitch(format, width) * std::max<size_t>((height + 3) / 4, 1);
+}
+
+void EncodeBlock(Format format, const uint8_t rgba[64], uint8_t* block, unsigned flags)
+{
+	switch (format)
+	{
+	case Format::BC1:
+		EncodeColorBlock(rgba, block, true, flags);
+		break;
+
+	case Format::BC3:
+		EncodeChannelBlock(rgba + 3, 4, block);
+		EncodeColorBlock(rgba, block + 8, false, flags);
+		break;
+
+	case Format::BC4:
+		EncodeChannelBlock(rgba, 4, block);
+		break;
+
+	case Format::BC5:
+		EncodeChannelBlock(rgba, 4, block);
+		EncodeChannelBlock(rgba + 1, 4, block + 8);
+		break;
+
+	case Format::BC7:
+		EncodeBC7Block(rgba, block, flags);
+		break;
+	}
+}
+
+bool DecodeBlock(Format format, const uint8_t* block, uint8_t rgba[64])
+{
+	switch (format)
+	{
+	case Format::BC1:
+		DecodeColorBlock(block, rgba, false);
+		return true;
+
+	case Format::BC3:
+		DecodeColorBlock(block + 8, rgba, true);
+		DecodeChannelBlock(block, rgba + 3, 4);
+		return true;
+
+	case Format::BC4:
+		DecodeChannelBlock(block, rgba, 4);
+		for (int i = 0; i < 16; ++i)
+		{
+			rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+			rgba[i * 4 + 3] = 255;
+		}
+		return true;
+
+	case Format::BC5:
+		DecodeChannelBlock(block, rgba, 4);
+		DecodeChannelBlock(block + 8, rgba + 1, 4);
+		for (int i = 0; i < 16; ++i)
+		{
+			rgba[i * 4 + 2] = 0;
+			rgba[i * 4 + 3] = 255;
+		}
+		return true;
+
+	case Format::BC7:
+		return DecodeBC7Block(block, rgba);
+	}
+	return false;
+}
+
+void Encode(Format format, const uint8_t* pixels, size_t width, size_t height, size_t pixelRowPitch,
+	uint8_t* blocks, size_t blockRowPitch, unsigned flags, unsigned maxThreads)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	const size_t blocksWide = (width + 3) / 4;
+	const size_t blocksHigh = (height + 3) / 4;
+	const size_t blockSize = BlockSize(format);
+	if (blockRowPitch == 0)
+		blockRowPitch = blocksWide * blockSize;
+
+	const bool bgra = (flags & EncodeBgra) != 0;
+
+	Parallel::For(blocksHigh, 1, [&](size_t begin, size_t end)
+	{
+		uint8_t rgba[64];
+		for (size_t by = begin; by < end; ++by)
+		{
+			uint8_t* out = blocks + by * blockRowPitch;
+			for (size_t bx = 0; bx < blocksWide; ++bx, out += blockSize)
+			{
+				LoadBlock(pixels, width, height, pixelRowPitch, bx, by, bgra, rgba);
+				EncodeBlock(format, rgba, out, flags);
+			}
+		}
+	}, maxThreads);
+}
+
+bool Decode(Format format, const uint8_t* blocks, size_t width, size_t height,
+	uint8_t* pixels, size_t pixelRowPitch, size_t blockRowPitch, unsigned maxThreads)
+{
+	if (width == 0 || height == 0)
+		return true;
+
+	const size_t blocksWide = (width + 3) / 4;
+	const size_t blocksHigh = (height + 3) / 4;
+	const size_t blockSize = BlockSize(format);
+	if (blockRowPitch == 0)
+		blockRowPitch = blocksWide * blockSize;
+
+	std::atomic<bool> ok(true);
+	Parallel::For(blocksHigh, 1, [&](size_t begin, size_t end)
+	{
+		uint8_t rgba[64];
+		for (size_t by = begin; by < end; ++by)
+		{
+			const uint8_t* in = blocks + by * blockRowPitch;
+			for (size_t bx = 0; bx < blocksWide; ++bx, in += blockSize)
+			{
+				if (!DecodeBlock(format, in, rgba))
+					ok.store(false, std::memory_order_relaxed);
+				StoreBlock(rgba, bx, by, width, height, pixels, pixelRowPitch);
+			}
+		}
+	}, maxThreads);
+
+	return ok.load();
+}
+
+Isa ActiveIsa()
+{
+	return (Isa)gActiveIsa.load(std::memory_order_relaxed);
+}
+
+void ForceIsa(Isa isa)
+{
+	gActiveIsa.store((int)std::min(isa, gDetectedIsa), std::memory_order_relaxed);
+}
+}
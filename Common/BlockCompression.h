@@ -0,0 +1,76 @@
+//***************************************************************************************
+// BlockCompression.h
+//
+// CPU encoder and decoder for the BC1, BC3, BC4, BC5 and BC7 block formats.
+//
+// Sources are 8-bit RGBA (or BGRA) images of any size; partial blocks at the right
+// and bottom edges repeat the last row/column.  The nearest-palette search, which is
+// the hot loop, has SSE2 and AVX2 kernels selected at run time that write the same
+// blocks as the scalar code, and images are processed a block row at a time on all
+// cores.
+//
+// BC4 encodes the red channel and BC5 the red and green channels.  BC7 uses mode 6
+// only (one subset, RGBA 7.7.7.7 endpoints with p-bits, 4-bit indices): the decoder
+// handles mode 6 blocks and returns false for blocks written in the other modes.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace BlockCompression
+{
+	enum class Format
+	{
+		BC1,
+		BC3,
+		BC4,
+		BC5,
+		BC7
+	};
+
+	enum EncodeFlags : unsigned
+	{
+		EncodeDefault = 0,
+
+		// Source pixels are stored B, G, R, A.
+		EncodeBgra = 0x1,
+
+		// Weight the colour error by perceptual luminance (BC1, BC3, BC7).  Leave it
+		// off for data such as normal maps.
+		EncodePerceptual = 0x2,
+	};
+
+	enum class Isa
+	{
+		Scalar,
+		Sse2,
+		Avx2
+	};
+
+	// Bytes per 4x4 block: 8 for BC1 and BC4, 16 for the others.
+	size_t BlockSize(Format format);
+
+	// Bytes of one row of blocks and of the whole image.
+	size_t RowPitch(Format format, size_t width);
+	size_t ImageSize(Format format, size_t width, size_t height);
+
+	// Compresses width x height pixels.  blockRowPitch is the distance between rows of
+	// blocks in 'blocks' (0 = tightly packed).  maxThreads = 0 uses every core.
+	void Encode(Format format, const std::uint8_t* pixels, size_t width, size_t height, size_t pixelRowPitch,
+		std::uint8_t* blocks, size_t blockRowPitch = 0, unsigned flags = EncodeDefault, unsigned maxThreads = 0);
+
+	// Expands blocks back to RGBA8.  Returns false if a block uses an unsupported BC7 mode.
+	bool Decode(Format format, const std::uint8_t* blocks, size_t width, size_t height,
+		std::uint8_t* pixels, size_t pixelRowPitch, size_t blockRowPitch = 0, unsigned maxThreads = 0);
+
+	// Single block versions.  'rgba' is 16 pixels in row order, 4 bytes each.
+	void EncodeBlock(Format format, const std::uint8_t rgba[64], std::uint8_t* block, unsigned flags = EncodeDefault);
+	bool DecodeBlock(Format format, const std::uint8_t* block, std::uint8_t rgba[64]);
+
+	// The instruction set used by the kernels.  ForceIsa lowers it (for comparisons);
+	// requests above what the CPU supports are clamped.
+	Isa ActiveIsa();
+	void ForceIsa(Isa isa);
+}
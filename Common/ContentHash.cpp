@@ -0,0 +1,114 @@
+//***************************************************************************************
+// ContentHash.cpp
+//***************************************************************************************
+
+#include "ContentHash.h"
+
+#include <cstring>
+
+namespace
+{
+	const std::uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+	const std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+	const std::uint64_t Prime3 = 0x165667B19E3779F9ull;
+	const std::uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+	const std::uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+	inline std::uint64_t RotateLeft(std::uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	// Unaligned little-endian loads; every target of this code is little-endian.
+	inline std::uint64_t Read64(const std::uint8_t* p)
+	{
+		std::uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline std::uint32_t Read32(const std::uint8_t* p)
+	{
+		std::uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline std::uint64_t Round(std::uint64_t acc, std::uint64_t input)
+	{
+		acc += input * Prime2;
+		acc = RotateLeft(acc, 31);
+		return acc * Prime1;
+	}
+
+	inline std::uint64_t MergeRound(std::uint64_t acc, std::uint64_t val)
+	{
+		acc ^= Round(0, val);
+		return acc * Prime1 + Prime4;
+	}
+}
+
+std::uint64_t ContentHash::Hash64(const void* data, size_t size, std::uint64_t seed)
+{
+	const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+	const std::uint8_t* end = p + size;
+	std::uint64_t h;
+
+	if (size >= 32)
+	{
+		// Four independent lanes over 32-byte stripes.
+		std::uint64_t v1 = seed + Prime1 + Prime2;
+		std::uint64_t v2 = seed + Prime2;
+		std::uint64_t v3 = seed;
+		std::uint64_t v4 = seed - Prime1;
+
+		const std::uint8_t* limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + Prime5;
+	}
+
+	h += (std::uint64_t)size;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= Round(0, Read64(p));
+		h = RotateLeft(h, 27) * Prime1 + Prime4;
+	}
+
+	if (p + 4 <= end)
+	{
+		h ^= (std::uint64_t)Read32(p) * Prime1;
+		h = RotateLeft(h, 23) * Prime2 + Prime3;
+		p += 4;
+	}
+
+	for (; p < end; ++p)
+	{
+		h ^= (*p) * Prime5;
+		h = RotateLeft(h, 11) * Prime1;
+	}
+
+	h ^= h >> 33;
+	h *= Prime2;
+	h ^= h >> 29;
+	h *= Prime3;
+	h ^= h >> 32;
+
+	return h;
+}
@@ -0,0 +1,25 @@
+//***************************************************************************************
+// ContentHash.h
+//
+// 64-bit non-cryptographic hash of a byte range (the XXH64 algorithm), used to spot
+// assets with identical contents.  Meshes, which are in memory anyway, are compared
+// byte for byte before they are shared; texture files are shared on an equal hash and
+// size, so that the other file is not read again.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ContentHash
+{
+	std::uint64_t Hash64(const void* data, size_t size, std::uint64_t seed = 0);
+
+	// Hash of 'size' bytes continuing from a previous hash, for keys made of several
+	// buffers.
+	inline std::uint64_t Combine(std::uint64_t hash, const void* data, size_t size)
+	{
+		return Hash64(data, size, hash);
+	}
+}
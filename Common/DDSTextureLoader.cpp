@@ -21,9 +21,13 @@
 #include <assert.h>
 #include <algorithm>
 #include <memory>
+#include <vector>
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "BlockCompression.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
 
 using namespace Microsoft::WRL;
 
@@ -269,6 +273,94 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
 }
 
 
+//--------------------------------------------------------------------------------------
+// Validates the magic number and headers of an in-memory DDS image and returns pointers
+// into it.  Sizes are 64-bit so mapped files larger than 4 GB are accepted.
+//--------------------------------------------------------------------------------------
+static HRESULT ParseDDSHeader( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                               _In_ uint64_t ddsDataSize,
+                               const DDS_HEADER** header,
+                               const uint8_t** bitData,
+                               size_t* bitSize
+                             )
+{
+    if (!header || !bitData || !bitSize)
+    {
+        return E_POINTER;
+    }
+
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (!ddsData || ddsDataSize < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // The whole image must be addressable by the upload step
+    if (ddsDataSize > static_cast<uint64_t>( SIZE_MAX ))
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+    // DDS files always start with the same magic number ("DDS ")
+    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto hdr = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+
+    // Verify header to validate DDS file
+    if (hdr->size != sizeof(DDS_HEADER) ||
+        hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    // Check for DX10 extension
+    bool bDXT10Header = false;
+    if ((hdr->ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC( 'D', 'X', '1', '0' ) == hdr->ddspf.fourCC))
+    {
+        // Must be long enough for both headers and magic value
+        if (ddsDataSize < ( sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10) ) )
+        {
+            return E_FAIL;
+        }
+
+        bDXT10Header = true;
+    }
+
+    size_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER )
+                    + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
+
+    *header = hdr;
+    *bitData = ddsData + offset;
+    *bitSize = static_cast<size_t>( ddsDataSize ) - offset;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Maps the file instead of reading it into a heap buffer.  The returned pointers stay
+// valid for as long as 'file' is open, which must cover the UpdateSubresources call.
+//--------------------------------------------------------------------------------------
+static HRESULT LoadTextureDataFromMappedFile( _In_z_ const wchar_t* fileName,
+                                              MappedFile& file,
+                                              const DDS_HEADER** header,
+                                              const uint8_t** bitData,
+                                              size_t* bitSize
+                                            )
+{
+    if (!file.Open( fileName ))
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    return ParseDDSHeader( file.Data(), file.Size(), header, bitData, bitSize );
+}
+
+
 //--------------------------------------------------------------------------------------
 // Return the BPP for a particular format
 //--------------------------------------------------------------------------------------
@@ -953,8 +1045,8 @@ static HRESULT FillInitData12(_In_ size_t width,
 				assert(index < mipCount * arraySize);
 				_Analysis_assume_(index < mipCount * arraySize);
 				initData[index]./*pSysMem*/pData = (const void*)pSrcBits;
-				initData[index]./*SysMemPitch*/RowPitch = static_cast<UINT>(RowBytes);
-				initData[index]./*SysMemSlicePitch*/SlicePitch = static_cast<UINT>(NumBytes);
+				initData[index]./*SysMemPitch*/RowPitch = static_cast<LONG_PTR>(RowBytes);
+				initData[index]./*SysMemSlicePitch*/SlicePitch = static_cast<LONG_PTR>(NumBytes);
 				++index;
 			}
 			else if (!j)
@@ -1669,16 +1761,18 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
     return hr;
 }
 
-static HRESULT CreateTextureFromDDS12(
-	_In_ ID3D12Device* device,
-	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+//--------------------------------------------------------------------------------------
+// Decodes the header into a resource description and fills one D3D12_SUBRESOURCE_DATA per
+// subresource, pointing into bitData.  Shared by the loaders and GetDDSTextureLayout12.
+//--------------------------------------------------------------------------------------
+static HRESULT DescribeTextureFromDDS12(
 	_In_ const DDS_HEADER* header,
 	_In_reads_bytes_(bitSize) const uint8_t* bitData,
 	_In_ size_t bitSize,
 	_In_ size_t maxsize,
-	_In_ bool forceSRGB,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	D3D12_RESOURCE_DESC& texDesc,
+	bool& isCubeMap,
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]>& initData)
 {
 	HRESULT hr = S_OK;
 
@@ -1689,7 +1783,7 @@ static HRESULT CreateTextureFromDDS12(
 	uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
 	UINT arraySize = 1;
 	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-	bool isCubeMap = false;
+	isCubeMap = false;
 
 	size_t mipCount = header->mipMapCount;
 	if (0 == mipCount) mipCount = 1;
@@ -1836,7 +1930,7 @@ static HRESULT CreateTextureFromDDS12(
 	}
 
 	// Create the texture
-	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData(
+	initData.reset(
 		new (std::nothrow) D3D12_SUBRESOURCE_DATA[mipCount * arraySize]
 		);
 
@@ -1857,13 +1951,286 @@ static HRESULT CreateTextureFromDDS12(
 
 	if (SUCCEEDED(hr))
 	{
+		ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
+		texDesc.Dimension = static_cast<D3D12_RESOURCE_DIMENSION>(resDim);
+		texDesc.Alignment = 0;
+		texDesc.Width = twidth;
+		texDesc.Height = static_cast<UINT>(theight);
+		texDesc.DepthOrArraySize = (resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? static_cast<UINT16>(tdepth) : static_cast<UINT16>(arraySize);
+		texDesc.MipLevels = static_cast<UINT16>(mipCount - skipMip);
+		texDesc.Format = format;
+		texDesc.SampleDesc.Count = 1;
+		texDesc.SampleDesc.Quality = 0;
+		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	}
+
+	return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// Applies DDS_LOADER_MIP_AUTOGEN: builds levels 1..n of every array slice into
+// 'storage' and replaces initData with the full chain.  Fails with ERROR_INVALID_DATA
+// if a block-compressed slice can not be decoded; texDesc and initData are only
+// changed on success.
+static HRESULT GenerateMipSubresources12(
+	_Inout_ D3D12_RESOURCE_DESC& texDesc,
+	_Inout_ std::unique_ptr<D3D12_SUBRESOURCE_DATA[]>& initData,
+	_In_ unsigned int loadFlags,
+	std::unique_ptr<uint8_t[]>& storage)
+{
+	if (texDesc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || texDesc.MipLevels != 1)
+		return S_OK;
+
+	MipGenerator::Options options;
+	options.MipFilter = (loadFlags & DirectX::DDS_LOADER_MIP_KAISER) ? MipGenerator::Filter::Kaiser : MipGenerator::Filter::Box;
+	if (loadFlags & DirectX::DDS_LOADER_MIP_SRGB)
+		options.Flags |= MipGenerator::Srgb;
+	if (loadFlags & DirectX::DDS_LOADER_MIP_NORMAL_MAP)
+		options.Flags |= MipGenerator::NormalMap;
+	if (loadFlags & DirectX::DDS_LOADER_MIP_ALPHA_COVERAGE)
+	{
+		options.Flags |= MipGenerator::PreserveAlphaCoverage;
+		options.AlphaReference = 0.1f;
+	}
+
+	// Block-compressed sources are decoded to RGBA8 for filtering.
+	bool isBlockCompressed = true;
+	BlockCompression::Format bcFormat = BlockCompression::Format::BC1;
+	switch (texDesc.Format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		options.Flags |= MipGenerator::Srgb;
+		isBlockCompressed = false;
+		break;
+
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+		isBlockCompressed = false;
+		break;
+
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		options.Flags |= MipGenerator::Srgb;
+		bcFormat = BlockCompression::Format::BC1;
+		break;
+
+	case DXGI_FORMAT_BC1_UNORM:
+		bcFormat = BlockCompression::Format::BC1;
+		break;
+
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		options.Flags |= MipGenerator::Srgb;
+		bcFormat = BlockCompression::Format::BC3;
+		break;
+
+	case DXGI_FORMAT_BC3_UNORM:
+		bcFormat = BlockCompression::Format::BC3;
+		break;
+
+	case DXGI_FORMAT_BC4_UNORM:
+		bcFormat = BlockCompression::Format::BC4;
+		break;
+
+	case DXGI_FORMAT_BC5_UNORM:
+		bcFormat = BlockCompression::Format::BC5;
+		break;
+
+	default:
+		return S_OK;
+	}
+
+	const size_t width = static_cast<size_t>(texDesc.Width);
+	const size_t height = texDesc.Height;
+	const unsigned mipCount = MipGenerator::CountMips(width, height);
+	if (mipCount < 2)
+		return S_OK;
+
+	const size_t arraySize = texDesc.DepthOrArraySize;
+
+	// Generated levels are RGBA8; for BC sources they are encoded into 'storage' after.
+	std::vector<std::vector<uint8_t>> rgbaLevels(isBlockCompressed ? mipCount : 0);
+	std::vector<MipGenerator::Image> images(mipCount - 1);
+	std::vector<uint8_t> decoded;
+
+	size_t storageSize = 0;
+	for (unsigned mip = 1; mip < mipCount; ++mip)
+	{
+		const size_t w = std::max<size_t>(width >> mip, 1);
+		const size_t h = std::max<size_t>(height >> mip, 1);
+		storageSize += isBlockCompressed ? BlockCompression::ImageSize(bcFormat, w, h) : w * h * 4;
+		if (isBlockCompressed)
+			rgbaLevels[mip].resize(w * h * 4);
+	}
+	storageSize *= arraySize;
+
+	storage.reset(new (std::nothrow) uint8_t[storageSize]);
+	if (!storage)
+		return E_OUTOFMEMORY;
+
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> chain(new (std::nothrow) D3D12_SUBRESOURCE_DATA[arraySize * mipCount]);
+	if (!chain)
+		return E_OUTOFMEMORY;
+
+	uint8_t* dest = storage.get();
+	for (size_t item = 0; item < arraySize; ++item)
+	{
+		const D3D12_SUBRESOURCE_DATA& top = initData[item];
+		chain[item * mipCount] = top;
+
+		const uint8_t* pixels = static_cast<const uint8_t*>(top.pData);
+		size_t rowPitch = static_cast<size_t>(top.RowPitch);
+		if (isBlockCompressed)
+		{
+			decoded.resize(width * height * 4);
+			if (!BlockCompression::Decode(bcFormat, pixels, width, height, decoded.data(), width * 4, rowPitch))
+				return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+			pixels = decoded.data();
+			rowPitch = width * 4;
+		}
+
+		for (unsigned mip = 1; mip < mipCount; ++mip)
+		{
+			const size_t w = std::max<size_t>(width >> mip, 1);
+			const size_t h = std::max<size_t>(height >> mip, 1);
+
+			D3D12_SUBRESOURCE_DATA& level = chain[item * mipCount + mip];
+			level.pData = dest;
+			if (isBlockCompressed)
+			{
+				images[mip - 1] = { rgbaLevels[mip].data(), w, h, w * 4 };
+				level.RowPitch = static_cast<LONG_PTR>(BlockCompression::RowPitch(bcFormat, w));
+				level.SlicePitch = static_cast<LONG_PTR>(BlockCompression::ImageSize(bcFormat, w, h));
+			}
+			else
+			{
+				images[mip - 1] = { dest, w, h, w * 4 };
+				level.RowPitch = static_cast<LONG_PTR>(w * 4);
+				level.SlicePitch = static_cast<LONG_PTR>(w * h * 4);
+			}
+			dest += level.SlicePitch;
+		}
+
+		MipGenerator::Generate(pixels, width, height, rowPitch, images.data(), mipCount - 1, options);
+
+		if (isBlockCompressed)
+		{
+			for (unsigned mip = 1; mip < mipCount; ++mip)
+			{
+				const D3D12_SUBRESOURCE_DATA& level = chain[item * mipCount + mip];
+				BlockCompression::Encode(bcFormat, images[mip - 1].Pixels, images[mip - 1].Width, images[mip - 1].Height,
+					images[mip - 1].RowPitch, static_cast<uint8_t*>(const_cast<void*>(level.pData)), static_cast<size_t>(level.RowPitch));
+			}
+		}
+	}
+
+	initData = std::move(chain);
+	texDesc.MipLevels = static_cast<UINT16>(mipCount);
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Applies the DDS_LOADER_COMPRESS_* option: compresses every subresource into
+// 'compressed' and repoints initData and texDesc at the result.
+static HRESULT CompressSubresources12(
+	_Inout_ D3D12_RESOURCE_DESC& texDesc,
+	_Inout_ D3D12_SUBRESOURCE_DATA* initData,
+	_In_ unsigned int loadFlags,
+	std::unique_ptr<uint8_t[]>& compressed)
+{
+	if (texDesc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+		return S_OK;
+
+	const DXGI_FORMAT bcFormat = DirectX::GetDDSCompressedFormat12(texDesc.Format, texDesc.Width, texDesc.Height, loadFlags);
+	if (bcFormat == DXGI_FORMAT_UNKNOWN)
+		return S_OK;
+
+	const BlockCompression::Format format = static_cast<BlockCompression::Format>(
+		(loadFlags & DirectX::DDS_LOADER_COMPRESS_MASK) - DirectX::DDS_LOADER_COMPRESS_BC1);
+
+	size_t totalSize = 0;
+	for (UINT mip = 0; mip < texDesc.MipLevels; ++mip)
+	{
+		totalSize += BlockCompression::ImageSize(format,
+			std::max<size_t>(static_cast<size_t>(texDesc.Width >> mip), 1),
+			std::max<size_t>(texDesc.Height >> mip, 1));
+	}
+	totalSize *= texDesc.DepthOrArraySize;
+
+	compressed.reset(new (std::nothrow) uint8_t[totalSize]);
+	if (!compressed)
+		return E_OUTOFMEMORY;
+
+	uint8_t* dest = compressed.get();
+	size_t index = 0;
+	for (UINT item = 0; item < texDesc.DepthOrArraySize; ++item)
+	{
+		for (UINT mip = 0; mip < texDesc.MipLevels; ++mip, ++index)
+		{
+			const UINT64 width = std::max<UINT64>(texDesc.Width >> mip, 1);
+			const UINT height = std::max<UINT>(texDesc.Height >> mip, 1);
+			const size_t rowPitch = BlockCompression::RowPitch(format, static_cast<size_t>(width));
+			const size_t imageSize = BlockCompression::ImageSize(format, static_cast<size_t>(width), height);
+
+			HRESULT hr = DirectX::CompressDDSSubresource12(initData[index], texDesc.Format,
+				width, height, loadFlags, dest, rowPitch);
+			if (FAILED(hr))
+				return hr;
+
+			initData[index].pData = dest;
+			initData[index].RowPitch = static_cast<LONG_PTR>(rowPitch);
+			initData[index].SlicePitch = static_cast<LONG_PTR>(imageSize);
+			dest += imageSize;
+		}
+	}
+
+	texDesc.Format = bcFormat;
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS12(
+	_In_ ID3D12Device* device,
+	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+	_In_ const DDS_HEADER* header,
+	_In_reads_bytes_(bitSize) const uint8_t* bitData,
+	_In_ size_t bitSize,
+	_In_ size_t maxsize,
+	_In_ bool forceSRGB,
+	_In_ unsigned int loadFlags,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap)
+{
+	D3D12_RESOURCE_DESC texDesc;
+	bool isCubeMap = false;
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData;
+	std::unique_ptr<uint8_t[]> generatedMips;
+	std::unique_ptr<uint8_t[]> compressed;
+
+	HRESULT hr = DescribeTextureFromDDS12(header, bitData, bitSize, maxsize, texDesc, isCubeMap, initData);
+
+	if (SUCCEEDED(hr) && (loadFlags & DirectX::DDS_LOADER_MIP_AUTOGEN))
+	{
+		hr = GenerateMipSubresources12(texDesc, initData, loadFlags, generatedMips);
+	}
+
+	if (SUCCEEDED(hr) && (loadFlags & DirectX::DDS_LOADER_COMPRESS_MASK))
+	{
+		hr = CompressSubresources12(texDesc, initData.get(), loadFlags, compressed);
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		const bool isVolume = (texDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D);
+
 		hr = CreateD3DResources12(
 			device, cmdList,
-			resDim, twidth, theight, tdepth,
-			mipCount - skipMip,
-			arraySize,
-			format,
-			false, // forceSRGB
+			texDesc.Dimension, static_cast<size_t>(texDesc.Width), texDesc.Height,
+			isVolume ? texDesc.DepthOrArraySize : 1,
+			texDesc.MipLevels,
+			isVolume ? 1 : texDesc.DepthOrArraySize,
+			texDesc.Format,
+			forceSRGB,
 			isCubeMap,
 			initData.get(),
 			texture, 
@@ -1928,6 +2295,23 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 	_In_ size_t maxsize,
 	_Out_opt_ DDS_ALPHA_MODE* alphaMode
 	)
+{
+	return CreateDDSTextureFromMemory12Ex(device, cmdList, ddsData, ddsDataSize, texture, textureUploadHeap,
+		DDS_LOADER_MIP_AUTOGEN, maxsize, alphaMode);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::CreateDDSTextureFromMemory12Ex(
+	ID3D12Device* device,
+	_In_ ID3D12GraphicsCommandList* cmdList,
+	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+	_In_ size_t ddsDataSize,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	_In_ unsigned int loadFlags,
+	_In_ size_t maxsize,
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode
+	)
 {
 	if (alphaMode)
 		(*alphaMode) = DDS_ALPHA_MODE_UNKNOWN;
@@ -1937,47 +2321,25 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 		return E_INVALIDARG;
 	}
 
-	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
-	if (dwMagicNumber != DDS_MAGIC)
-	{
-		return E_FAIL;
-	}
-
-	auto header = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
-
-	// Verify header to validate DDS file
-	if (header->size != sizeof(DDS_HEADER) ||
-		header->ddspf.size != sizeof(DDS_PIXELFORMAT))
-	{
-		return E_FAIL;
-	}
+	const DDS_HEADER* header = nullptr;
+	const uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
 
-	// Check for DX10 extension
-	bool bDXT10Header = false;
-	if ((header->ddspf.flags & DDS_FOURCC) &&
-		(MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC))
+	HRESULT hr = ParseDDSHeader(ddsData, ddsDataSize, &header, &bitData, &bitSize);
+	if (FAILED(hr))
 	{
-		// Must be long enough for both headers and magic value
-		if (ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
-		{
-			return E_FAIL;
-		}
-
-		bDXT10Header = true;
+		return hr;
 	}
 
-	ptrdiff_t offset = sizeof(uint32_t)
-		+ sizeof(DDS_HEADER)
-		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
-
-	HRESULT hr = CreateTextureFromDDS12(
+	hr = CreateTextureFromDDS12(
 		device,
 		cmdList,
 		header,
-		ddsData + offset,
-		ddsDataSize - offset,
+		bitData,
+		bitSize,
 		maxsize,
 		false,
+		loadFlags,
 		texture,
 		textureUploadHeap
 		);
@@ -2134,6 +2496,133 @@ HRESULT DirectX::CreateDDSTextureFromFile( ID3D11Device* d3dDevice,
                                        texture, textureView, alphaMode );
 }
 
+HRESULT DirectX::GetDDSTextureLayout12(
+	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+	_In_ size_t ddsDataSize,
+	_Out_ D3D12_RESOURCE_DESC* desc,
+	_Out_writes_opt_(maxSubresources) D3D12_SUBRESOURCE_DATA* subresources,
+	_In_ size_t maxSubresources,
+	_Out_opt_ bool* isCubeMap
+	)
+{
+	if (!desc)
+	{
+		return E_INVALIDARG;
+	}
+
+	const DDS_HEADER* header = nullptr;
+	const uint8_t* bitData = nullptr;
+	size_t bitSize = 0;
+
+	HRESULT hr = ParseDDSHeader(ddsData, ddsDataSize, &header, &bitData, &bitSize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	bool cubeMap = false;
+	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData;
+	hr = DescribeTextureFromDDS12(header, bitData, bitSize, 0, *desc, cubeMap, initData);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (isCubeMap)
+		(*isCubeMap) = cubeMap;
+
+	if (subresources)
+	{
+		const size_t arraySize = (desc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? 1 : desc->DepthOrArraySize;
+		const size_t count = desc->MipLevels * arraySize;
+		if (maxSubresources < count)
+		{
+			return E_INVALIDARG;
+		}
+
+		std::copy(initData.get(), initData.get() + count, subresources);
+	}
+
+	return S_OK;
+}
+
+DXGI_FORMAT DirectX::GetDDSCompressedFormat12(
+	_In_ DXGI_FORMAT srcFormat,
+	_In_ UINT64 width,
+	_In_ UINT height,
+	_In_ unsigned int loadFlags
+	)
+{
+	// Resources in a BC format need a top level that is a whole number of blocks.
+	if ((width % 4) != 0 || (height % 4) != 0)
+		return DXGI_FORMAT_UNKNOWN;
+
+	bool srgb = false;
+	switch (srcFormat)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+		break;
+
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		srgb = true;
+		break;
+
+	default:
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	switch (loadFlags & DDS_LOADER_COMPRESS_MASK)
+	{
+	case DDS_LOADER_COMPRESS_BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case DDS_LOADER_COMPRESS_BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case DDS_LOADER_COMPRESS_BC4: return DXGI_FORMAT_BC4_UNORM;
+	case DDS_LOADER_COMPRESS_BC5: return DXGI_FORMAT_BC5_UNORM;
+	case DDS_LOADER_COMPRESS_BC7: return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	default: return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+HRESULT DirectX::CompressDDSSubresource12(
+	_In_ const D3D12_SUBRESOURCE_DATA& src,
+	_In_ DXGI_FORMAT srcFormat,
+	_In_ UINT64 width,
+	_In_ UINT height,
+	_In_ unsigned int loadFlags,
+	_Out_ void* dest,
+	_In_ size_t destRowPitch
+	)
+{
+	const unsigned int compress = loadFlags & DDS_LOADER_COMPRESS_MASK;
+	if (!src.pData || !dest || compress < DDS_LOADER_COMPRESS_BC1 || compress > DDS_LOADER_COMPRESS_BC7)
+	{
+		return E_INVALIDARG;
+	}
+
+	unsigned int encodeFlags = BlockCompression::EncodeDefault;
+	switch (srcFormat)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		break;
+
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		encodeFlags |= BlockCompression::EncodeBgra;
+		break;
+
+	default:
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	BlockCompression::Encode(static_cast<BlockCompression::Format>(compress - DDS_LOADER_COMPRESS_BC1),
+		static_cast<const uint8_t*>(src.pData), static_cast<size_t>(width), height, static_cast<size_t>(src.RowPitch),
+		static_cast<uint8_t*>(dest), destRowPitch, encodeFlags);
+
+	return S_OK;
+}
+
 HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	_In_ ID3D12GraphicsCommandList* cmdList,
 	_In_z_ const wchar_t* szFileName,
@@ -2141,6 +2630,19 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 	_Out_ ComPtr<ID3D12Resource>& textureUploadHeap,
 	_In_ size_t maxsize,
 	_Out_opt_ DDS_ALPHA_MODE* alphaMode)
+{
+	return CreateDDSTextureFromFile12Ex(device, cmdList, szFileName, texture, textureUploadHeap,
+		DDS_LOADER_MIP_AUTOGEN, maxsize, alphaMode);
+}
+
+HRESULT DirectX::CreateDDSTextureFromFile12Ex(_In_ ID3D12Device* device,
+	_In_ ID3D12GraphicsCommandList* cmdList,
+	_In_z_ const wchar_t* szFileName,
+	_Out_ ComPtr<ID3D12Resource>& texture,
+	_Out_ ComPtr<ID3D12Resource>& textureUploadHeap,
+	_In_ unsigned int loadFlags,
+	_In_ size_t maxsize,
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode)
 {
 	if (texture)
 	{
@@ -2160,19 +2662,21 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 		return E_INVALIDARG;
 	}
 
-	DDS_HEADER* header = nullptr;
-	uint8_t* bitData = nullptr;
+	const DDS_HEADER* header = nullptr;
+	const uint8_t* bitData = nullptr;
 	size_t bitSize = 0;
 
-	std::unique_ptr<uint8_t[]> ddsData;
-	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	// The subresource pointers handed to UpdateSubresources point straight into the
+	// mapped view, so the only copy of the texel data is the one into the upload heap.
+	MappedFile ddsFile;
+	HRESULT hr = LoadTextureDataFromMappedFile(szFileName, ddsFile, &header, &bitData, &bitSize);
 	if (FAILED(hr))
 	{
 		return hr;
 	}
 
 	hr = CreateTextureFromDDS12(device, cmdList, header,
-		bitData, bitSize, maxsize, false, texture, textureUploadHeap);
+		bitData, bitSize, maxsize, false, loadFlags, texture, textureUploadHeap);
 
 	if (SUCCEEDED(hr))
 	{
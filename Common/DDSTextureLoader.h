@@ -55,6 +55,33 @@ namespace DirectX
         DDS_ALPHA_MODE_CUSTOM        = 4,
     };
 
+    // Load-time processing for the Direct3D 12 loaders.  The COMPRESS values are
+    // exclusive of each other and apply to 2D R8G8B8A8/B8G8R8A8 images whose size is a
+    // multiple of 4; every other texture loads unchanged.  BC4 keeps the red channel
+    // and BC5 red and green (normal maps).
+    //
+    // MIP_AUTOGEN builds the full mip chain for 2D textures stored with a single level,
+    // in R8G8B8A8/B8G8R8A8 or BC1/BC3/BC4/BC5 (BC levels are decoded, filtered and
+    // re-encoded).  The MIP_* options pick the filter and how the data is treated:
+    // _SRGB formats are always filtered in linear space, MIP_SRGB does the same for
+    // UNORM files holding sRGB colour, and MIP_ALPHA_COVERAGE keeps the fraction of
+    // texels passing the samples' alpha test (clip(alpha - 0.1)) constant.
+    enum DDS_LOADER_FLAGS
+    {
+        DDS_LOADER_DEFAULT            = 0,
+        DDS_LOADER_COMPRESS_BC1       = 0x1,
+        DDS_LOADER_COMPRESS_BC3       = 0x2,
+        DDS_LOADER_COMPRESS_BC4       = 0x3,
+        DDS_LOADER_COMPRESS_BC5       = 0x4,
+        DDS_LOADER_COMPRESS_BC7       = 0x5,
+        DDS_LOADER_COMPRESS_MASK      = 0xF,
+        DDS_LOADER_MIP_AUTOGEN        = 0x10,
+        DDS_LOADER_MIP_KAISER         = 0x20,
+        DDS_LOADER_MIP_SRGB           = 0x40,
+        DDS_LOADER_MIP_NORMAL_MAP     = 0x80,
+        DDS_LOADER_MIP_ALPHA_COVERAGE = 0x100,
+    };
+
     // Standard version
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
@@ -92,6 +119,64 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// CreateDDSTextureFromMemory12 with DDS_LOADER_FLAGS.  ddsData only has to stay valid
+	// for the call: the texels are copied into the upload heap before it returns.
+	HRESULT CreateDDSTextureFromMemory12Ex(_In_ ID3D12Device* device,
+		                                   _In_ ID3D12GraphicsCommandList* cmdList,
+		                                   _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		                                   _In_ size_t ddsDataSize,
+		                                   _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                                   _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap,
+		                                   _In_ unsigned int loadFlags,
+		                                   _In_ size_t maxsize = 0,
+		                                   _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+		                                   );
+
+	// CreateDDSTextureFromFile12 with DDS_LOADER_FLAGS.  CreateDDSTextureFromFile12 and
+	// CreateDDSTextureFromMemory12 pass DDS_LOADER_MIP_AUTOGEN, so single-level files
+	// get a mip chain.  A single-level block-compressed file the CPU decoder can not read
+	// (BC7 outside mode 6) then fails with HRESULT_FROM_WIN32(ERROR_INVALID_DATA); load
+	// it without the flag to keep its one level.
+	HRESULT CreateDDSTextureFromFile12Ex(_In_ ID3D12Device* device,
+		                                 _In_ ID3D12GraphicsCommandList* cmdList,
+		                                 _In_z_ const wchar_t* szFileName,
+		                                 _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                                 _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap,
+		                                 _In_ unsigned int loadFlags,
+		                                 _In_ size_t maxsize = 0,
+		                                 _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+		                                 );
+
+	// The block-compressed format loadFlags turn a width x height image of srcFormat
+	// into, or DXGI_FORMAT_UNKNOWN if no compression applies.
+	DXGI_FORMAT GetDDSCompressedFormat12(_In_ DXGI_FORMAT srcFormat,
+		                                 _In_ UINT64 width,
+		                                 _In_ UINT height,
+		                                 _In_ unsigned int loadFlags
+		                                 );
+
+	// Compresses one subresource (a mip of the image GetDDSCompressedFormat12 accepted)
+	// into dest, writing rows of blocks destRowPitch bytes apart.
+	HRESULT CompressDDSSubresource12(_In_ const D3D12_SUBRESOURCE_DATA& src,
+		                             _In_ DXGI_FORMAT srcFormat,
+		                             _In_ UINT64 width,
+		                             _In_ UINT height,
+		                             _In_ unsigned int loadFlags,
+		                             _Out_ void* dest,
+		                             _In_ size_t destRowPitch
+		                             );
+
+	// Describes an in-memory DDS image without creating any resources.  Call with
+	// subresources == nullptr to query the description, then again with an array of
+	// MipLevels * ArraySize entries.  The returned pointers reference ddsData.
+	HRESULT GetDDSTextureLayout12(_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		                          _In_ size_t ddsDataSize,
+		                          _Out_ D3D12_RESOURCE_DESC* desc,
+		                          _Out_writes_opt_(maxSubresources) D3D12_SUBRESOURCE_DATA* subresources = nullptr,
+		                          _In_ size_t maxSubresources = 0,
+		                          _Out_opt_ bool* isCubeMap = nullptr
+		                          );
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
@@ -71,6 +71,8 @@ struct SsaoConstants
     float SurfaceEpsilon = 0.05f;
 };
 
+const UINT NoTextureSlice = 0xFFFFFFFF;
+
 struct MaterialData
 {
     DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
@@ -82,8 +84,11 @@ struct MaterialData
 
     UINT DiffuseMapIndex = 0;
     UINT NormalMapIndex = 0;
-    UINT MaterialPad1;
-    UINT MaterialPad2;
+
+    // Slices of the packed texture arrays the indices above refer to, or
+    // NoTextureSlice when they index the plain texture table.
+    UINT DiffuseMapSlice = NoTextureSlice;
+    UINT NormalMapSlice = NoTextureSlice;
 };
 
 struct Vertex
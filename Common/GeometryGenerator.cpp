@@ -4,402 +4,325 @@
 
 #include "GeometryGenerator.h"
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define GEOMETRY_SSE 1
+#include <emmintrin.h>
+#endif
 
 using namespace DirectX;
 
-GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
+namespace
 {
-    MeshData meshData;
-
-    //
-	// Create the vertices.
-	//
-
-	Vertex v[24];
-
-	float w2 = 0.5f*width;
-	float h2 = 0.5f*height;
-	float d2 = 0.5f*depth;
-    
-	// Fill in the front face vertex data.
-	v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[2] = Vertex(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	v[3] = Vertex(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Fill in the back face vertex data.
-	v[4] = Vertex(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-	v[5] = Vertex(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[6] = Vertex(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[7] = Vertex(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-	// Fill in the top face vertex data.
-	v[8]  = Vertex(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[9]  = Vertex(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[10] = Vertex(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	v[11] = Vertex(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Fill in the bottom face vertex data.
-	v[12] = Vertex(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-	v[13] = Vertex(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[14] = Vertex(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[15] = Vertex(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-	// Fill in the left face vertex data.
-	v[16] = Vertex(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
-	v[17] = Vertex(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
-	v[18] = Vertex(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
-	v[19] = Vertex(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
-
-	// Fill in the right face vertex data.
-	v[20] = Vertex(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
-	v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
-	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	meshData.Vertices.assign(&v[0], &v[24]);
- 
-	//
-	// Create the indices.
-	//
-
-	uint32 i[36];
-
-	// Fill in the front face index data
-	i[0] = 0; i[1] = 1; i[2] = 2;
-	i[3] = 0; i[4] = 2; i[5] = 3;
-
-	// Fill in the back face index data
-	i[6] = 4; i[7]  = 5; i[8]  = 6;
-	i[9] = 4; i[10] = 6; i[11] = 7;
-
-	// Fill in the top face index data
-	i[12] = 8; i[13] =  9; i[14] = 10;
-	i[15] = 8; i[16] = 10; i[17] = 11;
-
-	// Fill in the bottom face index data
-	i[18] = 12; i[19] = 13; i[20] = 14;
-	i[21] = 12; i[22] = 14; i[23] = 15;
-
-	// Fill in the left face index data
-	i[24] = 16; i[25] = 17; i[26] = 18;
-	i[27] = 16; i[28] = 18; i[29] = 19;
-
-	// Fill in the right face index data
-	i[30] = 20; i[31] = 21; i[32] = 22;
-	i[33] = 20; i[34] = 22; i[35] = 23;
-
-	meshData.Indices32.assign(&i[0], &i[36]);
+	// The generator's own Vertex, which carries every attribute.
+	using MeshDataLayout = GeometryGenerator::VertexLayout<GeometryGenerator::Vertex,
+		&GeometryGenerator::Vertex::Position,
+		&GeometryGenerator::Vertex::Normal,
+		&GeometryGenerator::Vertex::TexC,
+		&GeometryGenerator::Vertex::TangentU>;
+
+	// The icosahedron CreateGeosphere subdivides.
+	constexpr float IcosahedronX = 0.525731f;
+	constexpr float IcosahedronZ = 0.850651f;
+
+	constexpr float IcosahedronPositions[12][3] =
+	{
+		{ -IcosahedronX, 0.0f, IcosahedronZ },  { IcosahedronX, 0.0f, IcosahedronZ },
+		{ -IcosahedronX, 0.0f, -IcosahedronZ }, { IcosahedronX, 0.0f, -IcosahedronZ },
+		{ 0.0f, IcosahedronZ, IcosahedronX },   { 0.0f, IcosahedronZ, -IcosahedronX },
+		{ 0.0f, -IcosahedronZ, IcosahedronX },  { 0.0f, -IcosahedronZ, -IcosahedronX },
+		{ IcosahedronZ, IcosahedronX, 0.0f },   { -IcosahedronZ, IcosahedronX, 0.0f },
+		{ IcosahedronZ, -IcosahedronX, 0.0f },  { -IcosahedronZ, -IcosahedronX, 0.0f }
+	};
 
-    // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+	constexpr GeometryGenerator::uint32 IcosahedronIndices[60] =
+	{
+		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
+		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
+		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
+	};
 
-    for(uint32 i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
+	GeometryGenerator::MeshData AllocateMeshData(GeometryGenerator::MeshSize size)
+	{
+		GeometryGenerator::MeshData meshData;
+		meshData.Vertices.resize(size.VertexCount);
+		meshData.Indices32.resize(size.IndexCount);
+		return meshData;
+	}
+}
 
-    return meshData;
+void GeometryGenerator::CheckSphereCounts(uint32 sliceCount, uint32 stackCount)
+{
+	// With fewer the ring and stack counts below wrap around.
+	if (sliceCount < 1 || stackCount < 2)
+		throw std::invalid_argument("GeometryGenerator: a sphere needs at least 1 slice and 2 stacks");
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
 {
-	MeshData meshData;
+	CheckSphereCounts(sliceCount, stackCount);
+
+	// Two poles and stackCount-1 rings of sliceCount+1 vertices; a fan of sliceCount
+	// triangles at each pole and two triangles per slice of each inner stack.
+	MeshSize size;
+	size.VertexCount = 2 + (stackCount - 1) * (sliceCount + 1);
+	size.IndexCount = 6 * sliceCount + 6 * sliceCount * (stackCount - 2);
+	return size;
+}
 
-	//
-	// Compute the vertices stating at the top pole and moving down the stacks.
-	//
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	// stackCount+1 side rings and two caps, each a ring plus its center vertex.
+	MeshSize size;
+	size.VertexCount = (stackCount + 1) * (sliceCount + 1) + 2 * (sliceCount + 2);
+	size.IndexCount = 6 * sliceCount * stackCount + 6 * sliceCount;
+	return size;
+}
 
-	// Poles: note that there will be texture coordinate distortion as there is
-	// not a unique point on the texture map to assign to the pole when mapping
-	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+void GeometryGenerator::EvaluateSphereRing(float radius, float phi, float thetaStep, const float* sinTheta,
+	const float* cosTheta, uint32 first, uint32 count, VertexBlock& block)
+{
+	// Position (r sin(phi) cos(theta), r cos(phi), r sin(phi) sin(theta)), its partial
+	// derivative with respect to theta as the tangent, and both normalized the way
+	// XMVector3Normalize does it: v / sqrt((x*x + y*y) + z*z), zero for zero length.
+	// Both paths use only correctly rounded operations in the same order, so they
+	// give the same bits.
+	float rs = radius * sinf(phi);
+	float y = radius * cosf(phi);
 
-	meshData.Vertices.push_back(topVertex);
+	uint32 k = 0;
 
-	float phiStep = XM_PI / stackCount;
-	float thetaStep = 2.0f * XM_PI / sliceCount;
+#if defined(GEOMETRY_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 rsv = _mm_set1_ps(rs);
+	const __m128 yv = _mm_set1_ps(y);
+	const __m128 yy = _mm_mul_ps(yv, yv);
+	const __m128 thetaStepv = _mm_set1_ps(thetaStep);
+	const __m128 twoPi = _mm_set1_ps(XM_2PI);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for (uint32 i = 1; i <= stackCount - 1; ++i)
+	for(; k + 4 <= count; k += 4)
 	{
-		float phi = i * phiStep;
-
-		// Vertices of ring.
-		for (uint32 j = 0; j <= sliceCount; ++j)
-		{
-			float theta = j * thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius * sinf(phi) * cosf(theta);
-			v.Position.y = radius * cosf(phi);
-			v.Position.z = radius * sinf(phi) * sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius * sinf(phi) * sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius * sinf(phi) * cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
-
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back(v);
-		}
+		__m128 sinT = _mm_loadu_ps(sinTheta + k);
+		__m128 cosT = _mm_loadu_ps(cosTheta + k);
+
+		__m128 x = _mm_mul_ps(rsv, cosT);
+		__m128 z = _mm_mul_ps(rsv, sinT);
+
+		// Normal.
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), yy), _mm_mul_ps(z, z)));
+		__m128 nonZero = _mm_cmpneq_ps(length, zero);
+		_mm_storeu_ps(block.NormalX + k, _mm_and_ps(_mm_div_ps(x, length), nonZero));
+		_mm_storeu_ps(block.NormalY + k, _mm_and_ps(_mm_div_ps(yv, length), nonZero));
+		_mm_storeu_ps(block.NormalZ + k, _mm_and_ps(_mm_div_ps(z, length), nonZero));
+
+		// Tangent (-z, 0, x).
+		__m128 tx = _mm_xor_ps(z, signBit);
+		length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), zero), _mm_mul_ps(x, x)));
+		nonZero = _mm_cmpneq_ps(length, zero);
+		_mm_storeu_ps(block.TangentX + k, _mm_and_ps(_mm_div_ps(tx, length), nonZero));
+		_mm_storeu_ps(block.TangentZ + k, _mm_and_ps(_mm_div_ps(x, length), nonZero));
+
+		_mm_storeu_ps(block.PositionX + k, x);
+		_mm_storeu_ps(block.PositionY + k, yv);
+		_mm_storeu_ps(block.PositionZ + k, z);
+
+		// theta = j * thetaStep for the column index j.
+		__m128i j = _mm_add_epi32(_mm_set1_epi32((int)(first + k)), _mm_set_epi32(3, 2, 1, 0));
+		__m128 theta = _mm_mul_ps(_mm_cvtepi32_ps(j), thetaStepv);
+		_mm_storeu_ps(block.U + k, _mm_div_ps(theta, twoPi));
 	}
+#endif
 
-	meshData.Vertices.push_back(bottomVertex);
-
-	//auto vec = meshData.Vertices;
-	//for (int i = vec.size() - 1, j = 0; i >= 0; --i, ++j)
-	//{
-	//	meshData.Vertices[j] = vec[i];
-	//}
-
-	//
-	// Compute indices for top stack.  The top stack was written first to the vertex buffer
-	// and connects the top pole to the first ring.
-	//
-
-	for (uint32 i = 1; i <= sliceCount; ++i)
+	for(; k < count; ++k)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i + 1);
-		meshData.Indices32.push_back(i);
-	}
+		float x = rs * cosTheta[k];
+		float z = rs * sinTheta[k];
 
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
+		float length = sqrtf((x*x + y*y) + z*z);
+		block.NormalX[k] = length != 0.0f ? x / length : 0.0f;
+		block.NormalY[k] = length != 0.0f ? y / length : 0.0f;
+		block.NormalZ[k] = length != 0.0f ? z / length : 0.0f;
 
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-	uint32 baseIndex = 1;
-	uint32 ringVertexCount = sliceCount + 1;
-	for (uint32 i = 0; i < stackCount - 2; ++i)
-	{
-		for (uint32 j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+		float tx = -z;
+		length = sqrtf((tx*tx + 0.0f) + x*x);
+		block.TangentX[k] = length != 0.0f ? tx / length : 0.0f;
+		block.TangentZ[k] = length != 0.0f ? x / length : 0.0f;
 
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
-		}
+		block.PositionX[k] = x;
+		block.PositionY[k] = y;
+		block.PositionZ[k] = z;
+
+		float theta = (first + k) * thetaStep;
+		block.U[k] = theta / XM_2PI;
 	}
+}
 
-	//
-	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-	// and connects the bottom pole to the bottom ring.
-	//
+GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
+{
+    MeshData meshData = AllocateMeshData(BoxSize());
+	WriteBox<MeshDataLayout>(width, height, depth, meshData.Vertices.data(), meshData.Indices32.data());
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size() - 1;
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
+    Subdivide(meshData, numSubdivisions);
 
-	for (uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i + 1);
-	}
+    return meshData;
+}
 
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	MeshData meshData = AllocateMeshData(SphereSize(sliceCount, stackCount));
+	WriteSphere<MeshDataLayout>(radius, sliceCount, stackCount, meshData.Vertices.data(), meshData.Indices32.data());
 	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateSkysphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
-    MeshData meshData;
-
-	//
-	// Compute the vertices stating at the top pole and moving down the stacks.
-	//
+	MeshData meshData = AllocateMeshData(SkysphereSize(sliceCount, stackCount));
+	WriteSkysphere<MeshDataLayout>(radius, sliceCount, stackCount, meshData.Vertices.data(), meshData.Indices32.data());
+	return meshData;
+}
+ 
+void GeometryGenerator::Subdivide(MeshData& meshData, uint32 numSubdivisions)
+{
+	if(numSubdivisions == 0)
+		return;
 
-	// Poles: note that there will be texture coordinate distortion as there is
-	// not a unique point on the texture map to assign to the pole when mapping
-	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	//       v1
+	//       *
+	//      / \
+	//     /   \
+	//  m0*-----*m1
+	//   / \   / \
+	//  /   \ /   \
+	// *-----*-----*
+	// v0    m2     v2
 
-	meshData.Vertices.push_back( topVertex );
+	// Each level keeps the vertices of the previous one and appends one midpoint per
+	// edge, so the vertex array only grows in place.  Triangles that share an edge
+	// share its midpoint, found through an open-addressing table keyed by the edge's
+	// vertex indices.
+	//
+	// Per level, V' = V + E, E' = 2E + 3F and F' = 4F.  Counting the edges of the input
+	// gives every size up front; the counts are exact for meshes without degenerate
+	// triangles and upper bounds otherwise.
+	const uint32 emptySlot = 0xffffffff;
 
-	float phiStep   = XM_PI/stackCount;
-	float thetaStep = 2.0f*XM_PI/sliceCount;
+	std::vector<std::uint64_t> edgeKeys;
+	std::vector<uint32> edgeMids;
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
+	auto edgeKey = [](uint32 a, uint32 b)
 	{
-		float phi = i*phiStep;
-
-		// Vertices of ring.
-        for(uint32 j = 0; j <= sliceCount; ++j)
-		{
-			float theta = j*thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
-
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
-		}
-	}
-
-	meshData.Vertices.push_back( bottomVertex );
-
-	//auto vec = meshData.Vertices;
-	//for (int i = vec.size() - 1, j = 0; i >= 0; --i, ++j)
-	//{
-	//	meshData.Vertices[j] = vec[i];
-	//}
-
-	//
-	// Compute indices for top stack.  The top stack was written first to the vertex buffer
-	// and connects the top pole to the first ring.
-	//
+		return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a;
+	};
 
-    for(uint32 i = 1; i <= sliceCount; ++i)
+	auto resetTable = [&](size_t numEdges)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
-	}
-	
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
+		size_t capacity = 16;
+		while(capacity < 2 * numEdges)
+			capacity *= 2;
+
+		edgeKeys.assign(capacity, 0);
+		edgeMids.assign(capacity, emptySlot);
+	};
 
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-    uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
+	// Returns the slot of the edge, claiming it with 'mid' if it is new.
+	auto findEdge = [&](std::uint64_t key, uint32 mid, bool& inserted) -> size_t
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		const size_t mask = edgeKeys.size() - 1;
+		size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+		for(;;)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			if(edgeMids[slot] == emptySlot)
+			{
+				edgeKeys[slot] = key;
+				edgeMids[slot] = mid;
+				inserted = true;
+				return slot;
+			}
+
+			if(edgeKeys[slot] == key)
+			{
+				inserted = false;
+				return slot;
+			}
+
+			slot = (slot + 1) & mask;
 		}
-	}
-
-	//
-	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-	// and connects the bottom pole to the bottom ring.
-	//
+	};
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
+	size_t numTris = meshData.Indices32.size() / 3;
 
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
-	
-	for(uint32 i = 0; i < sliceCount; ++i)
+	// Edges of the input.
+	resetTable(3 * numTris);
+	size_t numEdges = 0;
+	for(size_t i = 0; i < 3 * numTris; i += 3)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		const uint32* tri = &meshData.Indices32[i];
+		bool inserted;
+		findEdge(edgeKey(tri[0], tri[1]), 0, inserted); numEdges += inserted;
+		findEdge(edgeKey(tri[1], tri[2]), 0, inserted); numEdges += inserted;
+		findEdge(edgeKey(tri[2], tri[0]), 0, inserted); numEdges += inserted;
 	}
 
-	auto vec2 = meshData.Indices32;
-	for (int i = vec2.size() - 1, j = 0; i >= 0; --i, ++j)
+	size_t finalVertices = meshData.Vertices.size();
+	size_t finalTris = numTris;
+	size_t lastLevelEdges = numEdges;
+	for(uint32 level = 0; level < numSubdivisions; ++level)
 	{
-		meshData.Indices32[j] = vec2[i];
+		lastLevelEdges = numEdges;
+		finalVertices += numEdges;
+		numEdges = 2 * numEdges + 3 * finalTris;
+		finalTris *= 4;
 	}
 
-    return meshData;
-}
- 
-void GeometryGenerator::Subdivide(MeshData& meshData)
-{
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	meshData.Vertices.reserve(finalVertices);
+	resetTable(lastLevelEdges);
 
+	// Each level reads one index buffer and writes the other.
+	std::vector<uint32> input;
+	std::vector<uint32>& output = meshData.Indices32;
+	input.reserve(3 * finalTris);
+	output.reserve(3 * finalTris);
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
-	//       v1
-	//       *
-	//      / \
-	//     /   \
-	//  m0*-----*m1
-	//   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-	// v0    m2     v2
-
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
+	for(uint32 level = 0; level < numSubdivisions; ++level)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+		input.swap(output);
+		output.resize(4 * input.size());
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+		if(level > 0)
+			std::fill(edgeMids.begin(), edgeMids.end(), emptySlot);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		auto midPoint = [&](uint32 a, uint32 b)
+		{
+			bool inserted;
+			size_t slot = findEdge(edgeKey(a, b), (uint32)meshData.Vertices.size(), inserted);
+			if(inserted)
+				meshData.Vertices.push_back(MidPoint(meshData.Vertices[a], meshData.Vertices[b]));
+			return edgeMids[slot];
+		};
+
+		for(size_t i = 0; i < input.size(); i += 3)
+		{
+			uint32 v0 = input[i + 0];
+			uint32 v1 = input[i + 1];
+			uint32 v2 = input[i + 2];
+
+			uint32 m0 = midPoint(v0, v1);
+			uint32 m1 = midPoint(v1, v2);
+			uint32 m2 = midPoint(v0, v2);
+
+			uint32* out = &output[4 * i];
+			out[0] = v0; out[1]  = m0; out[2]  = m2;
+			out[3] = m0; out[4]  = m1; out[5]  = m2;
+			out[6] = m2; out[7]  = m1; out[8]  = v2;
+			out[9] = m0; out[10] = v1; out[11] = m1;
+		}
 	}
 }
 
@@ -441,36 +364,16 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
 	// Approximate a sphere by tessellating an icosahedron.
-
-	const float X = 0.525731f; 
-	const float Z = 0.850651f;
-
-	XMFLOAT3 pos[12] = 
-	{
-		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),  
-		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),    
-		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X), 
-		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),    
-		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f), 
-		XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
-	};
-
-    uint32 k[60] =
-	{
-		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,    
-		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,    
-		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 
-		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
-	};
-
     meshData.Vertices.resize(12);
-    meshData.Indices32.assign(&k[0], &k[60]);
+    meshData.Indices32.assign(&IcosahedronIndices[0], &IcosahedronIndices[60]);
 
 	for(uint32 i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
+	{
+		const float* p = IcosahedronPositions[i];
+		meshData.Vertices[i].Position = XMFLOAT3(p[0], p[1], p[2]);
+	}
 
-	for(uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+	Subdivide(meshData, numSubdivisions);
 
 	// Project vertices onto sphere and scale.
 	for(uint32 i = 0; i < meshData.Vertices.size(); ++i)
@@ -510,277 +413,22 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
-    MeshData meshData;
-
-	//
-	// Build Stacks.
-	// 
-
-	float stackHeight = height / stackCount;
-
-	// Amount to increment radius as we move up each stack level from bottom to top.
-	float radiusStep = (topRadius - bottomRadius) / stackCount;
-
-	uint32 ringCount = stackCount+1;
-
-	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(uint32 i = 0; i < ringCount; ++i)
-	{
-		float y = -0.5f*height + i*stackHeight;
-		float r = bottomRadius + i*radiusStep;
-
-		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(uint32 j = 0; j <= sliceCount; ++j)
-		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
-		}
-	}
-
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	uint32 ringVertexCount = sliceCount+1;
-
-	// Compute indices for each stack.
-	for(uint32 i = 0; i < stackCount; ++i)
-	{
-		for(uint32 j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
-		}
-	}
-
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-
-    return meshData;
-}
-
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
-{
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-
-	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI/sliceCount;
-
-	// Duplicate cap ring vertices because the texture coordinates and normals differ.
-	for(uint32 i = 0; i <= sliceCount; ++i)
-	{
-		float x = topRadius*cosf(i*dTheta);
-		float z = topRadius*sinf(i*dTheta);
-
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x/height + 0.5f;
-		float v = z/height + 0.5f;
-
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
-	}
-
-	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
-
-	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
-	}
-}
-
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-											   uint32 sliceCount, uint32 stackCount, MeshData& meshData)
-{
-	// 
-	// Build bottom cap.
-	//
-
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-	float y = -0.5f*height;
-
-	// vertices of ring
-	float dTheta = 2.0f*XM_PI/sliceCount;
-	for(uint32 i = 0; i <= sliceCount; ++i)
-	{
-		float x = bottomRadius*cosf(i*dTheta);
-		float z = bottomRadius*sinf(i*dTheta);
-
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x/height + 0.5f;
-		float v = z/height + 0.5f;
-
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
-	}
-
-	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
-
-	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
-	}
+	MeshData meshData = AllocateMeshData(CylinderSize(sliceCount, stackCount));
+	WriteCylinder<MeshDataLayout>(bottomRadius, topRadius, height, sliceCount, stackCount,
+		meshData.Vertices.data(), meshData.Indices32.data());
+	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
-    MeshData meshData;
-
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
-
-	//
-	// Create the vertices.
-	//
-
-	float halfWidth = 0.5f*width;
-	float halfDepth = 0.5f*depth;
-
-	float dx = width / (n-1);
-	float dz = depth / (m-1);
-
-	float du = 1.0f / (n-1);
-	float dv = 1.0f / (m-1);
-
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
-		}
-	}
- 
-    //
-	// Create the indices.
-	//
-
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
-	{
-		for(uint32 j = 0; j < n-1; ++j)
-		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
-
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
-		}
-	}
-
-    return meshData;
+	MeshData meshData = AllocateMeshData(GridSize(m, n));
+	WriteGrid<MeshDataLayout>(width, depth, m, n, meshData.Vertices.data(), meshData.Indices32.data());
+	return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
 {
-    MeshData meshData;
-
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
-
-	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
-        x, y - h, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
-
-	meshData.Vertices[1] = Vertex(
-		x, y, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
-
-	meshData.Vertices[2] = Vertex(
-		x+w, y, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
-
-	meshData.Vertices[3] = Vertex(
-		x+w, y-h, depth,
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
-
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
-
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
-
-    return meshData;
+	MeshData meshData = AllocateMeshData(QuadSize());
+	WriteQuad<MeshDataLayout>(x, y, w, h, depth, meshData.Vertices.data(), meshData.Indices32.data());
+	return meshData;
 }
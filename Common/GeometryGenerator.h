@@ -14,10 +14,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <DirectXMath.h>
 #include <vector>
 
+#include "Parallel.h"
+
 class GeometryGenerator
 {
 public:
@@ -70,10 +74,51 @@ public:
 			return mIndices16;
         }
 
+		// For shared meshes (MeshCache), whose 16-bit indices are built before sharing.
+		const std::vector<uint16>& GetIndices16()const
+		{
+			assert(mIndices16.size() == Indices32.size());
+			return mIndices16;
+		}
+
 	private:
 		std::vector<uint16> mIndices16;
 	};
 
+	// Vertex and index counts of a mesh, known before it is generated.
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
+	};
+
+	///<summary>
+	/// Maps the generated attributes onto members of a caller's vertex type at compile
+	/// time, for example VertexLayout<Vertex, &Vertex::Pos, &Vertex::Normal, &Vertex::TexC>.
+	/// Attributes mapped to nullptr are not written.
+	///</summary>
+	template<typename V,
+		DirectX::XMFLOAT3 V::* PositionMember,
+		DirectX::XMFLOAT3 V::* NormalMember = nullptr,
+		DirectX::XMFLOAT2 V::* TexCMember = nullptr,
+		DirectX::XMFLOAT3 V::* TangentMember = nullptr>
+	struct VertexLayout
+	{
+		using VertexType = V;
+
+		static void Write(V& v, const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal,
+			const DirectX::XMFLOAT3& tangent, const DirectX::XMFLOAT2& texC)
+		{
+			v.*PositionMember = position;
+			if(NormalMember != nullptr)
+				v.*NormalMember = normal;
+			if(TexCMember != nullptr)
+				v.*TexCMember = texC;
+			if(TangentMember != nullptr)
+				v.*TangentMember = tangent;
+		}
+	};
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
@@ -116,10 +161,551 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	//
+	// The same meshes written straight into caller memory (a mapped upload buffer, for
+	// instance): size the arrays with the matching *Size() function, then Write*() fills
+	// them in one pass without reading them back.  Nothing is allocated beyond a table of
+	// the sphere's slice angles.  Layout is a VertexLayout; Index is uint16 or uint32.
+	// The Create* functions above are built on these, so both give the same vertices
+	// and indices.  Boxes are written without subdivision, and geospheres need the
+	// MeshData path, since subdividing keeps a table of the shared edges.
+	//
+	// Spheres and grids of more than ParallelVertices vertices are split into bands of
+	// rings or rows that are generated on all cores; sphere rings are evaluated four
+	// vertices at a time with SSE.  The output does not depend on the split.
+	//
+	// A sphere needs at least one slice and two stacks; SphereSize() and the sphere
+	// writers throw std::invalid_argument for fewer.
+	//
+
+	static const uint32 ParallelVertices = 16384;
+
+	static MeshSize BoxSize() { return { 24, 36 }; }
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize SkysphereSize(uint32 sliceCount, uint32 stackCount) { return SphereSize(sliceCount, stackCount); }
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n) { return { m*n, (m-1)*(n-1)*6 }; }
+	static MeshSize QuadSize() { return { 4, 6 }; }
+
+	template<typename Layout, typename Index>
+	static void WriteBox(float width, float height, float depth,
+		typename Layout::VertexType* vertices, Index* indices);
+
+	template<typename Layout, typename Index>
+	static void WriteSphere(float radius, uint32 sliceCount, uint32 stackCount,
+		typename Layout::VertexType* vertices, Index* indices);
+
+	// The sphere with the winding reversed.
+	template<typename Layout, typename Index>
+	static void WriteSkysphere(float radius, uint32 sliceCount, uint32 stackCount,
+		typename Layout::VertexType* vertices, Index* indices);
+
+	template<typename Layout, typename Index>
+	static void WriteCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+		typename Layout::VertexType* vertices, Index* indices);
+
+	template<typename Layout, typename Index>
+	static void WriteGrid(float width, float depth, uint32 m, uint32 n,
+		typename Layout::VertexType* vertices, Index* indices);
+
+	template<typename Layout, typename Index>
+	static void WriteQuad(float x, float y, float w, float h, float depth,
+		typename Layout::VertexType* vertices, Index* indices);
+
 private:
-	void Subdivide(MeshData& meshData);
+	// Splits every triangle into four, numSubdivisions times.  Midpoints are shared
+	// between the triangles on either side of an edge.
+	void Subdivide(MeshData& meshData, uint32 numSubdivisions);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+
+	// Up to Capacity vertices of one sphere ring in structure-of-arrays form, evaluated
+	// by EvaluateSphereRing and then written out through the caller's layout.
+	struct VertexBlock
+	{
+		static const uint32 Capacity = 64;
+
+		float PositionX[Capacity], PositionY[Capacity], PositionZ[Capacity];
+		float NormalX[Capacity], NormalY[Capacity], NormalZ[Capacity];
+		float TangentX[Capacity], TangentZ[Capacity];	// the tangent has no y
+		float U[Capacity];
+	};
+
+	// Vertices first..first+count-1 of the ring at angle phi from the north pole, given
+	// the sines and cosines of their theta angles.  Vectorized where SSE2 is available;
+	// the scalar path computes the same values.
+	static void EvaluateSphereRing(float radius, float phi, float thetaStep, const float* sinTheta,
+		const float* cosTheta, uint32 first, uint32 count, VertexBlock& block);
+
+	// Rows (or rings) per parallel task for rows of rowVertexCount vertices.
+	static size_t RowsPerTask(uint32 rowVertexCount)
+	{
+		return std::max<size_t>(1, ParallelVertices / std::max<uint32>(rowVertexCount, 1));
+	}
+
+	// Throws std::invalid_argument unless the counts describe a sphere.
+	static void CheckSphereCounts(uint32 sliceCount, uint32 stackCount);
+
+	// Sphere vertices and the indices in either winding; reversed writes index k at
+	// count-1-k.
+	template<typename Layout>
+	static void WriteSphereVertices(float radius, uint32 sliceCount, uint32 stackCount, typename Layout::VertexType* vertices);
+	template<typename Index>
+	static void WriteSphereIndices(uint32 sliceCount, uint32 stackCount, bool reversed, Index* indices);
+
+	// Writes a cap ring and its center vertex at baseIndex, and the cap triangles.
+	template<typename Layout, typename Index>
+	static void WriteCylinderCap(float radius, float y, float normalY, float height, uint32 sliceCount,
+		uint32 baseIndex, typename Layout::VertexType* vertices, Index* indices);
 };
 
+//
+// Template definitions.
+//
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteBox(float width, float height, float depth,
+	typename Layout::VertexType* vertices, Index* indices)
+{
+	using DirectX::XMFLOAT2;
+	using DirectX::XMFLOAT3;
+
+	float w2 = 0.5f*width;
+	float h2 = 0.5f*height;
+	float d2 = 0.5f*depth;
+
+	// Four vertices per face: position, normal, tangent and texture coordinates.
+	const float v[24][11] =
+	{
+		// Front face.
+		{ -w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+		{ -w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+		{ +w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+		{ +w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+
+		// Back face.
+		{ -w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+		{ +w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+		{ +w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+		{ -w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+
+		// Top face.
+		{ -w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+		{ -w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+		{ +w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+		{ +w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+
+		// Bottom face.
+		{ -w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+		{ +w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+		{ +w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+		{ -w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+
+		// Left face.
+		{ -w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f },
+		{ -w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f },
+		{ -w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f },
+		{ -w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f },
+
+		// Right face.
+		{ +w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f },
+		{ +w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f },
+		{ +w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f },
+		{ +w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f }
+	};
+
+	for(uint32 i = 0; i < 24; ++i)
+	{
+		Layout::Write(vertices[i],
+			XMFLOAT3(v[i][0], v[i][1], v[i][2]),
+			XMFLOAT3(v[i][3], v[i][4], v[i][5]),
+			XMFLOAT3(v[i][6], v[i][7], v[i][8]),
+			XMFLOAT2(v[i][9], v[i][10]));
+	}
+
+	// Two triangles per face.
+	for(uint32 face = 0; face < 6; ++face)
+	{
+		uint32 base = 4*face;
+		Index* out = &indices[6*face];
+		out[0] = (Index)base; out[1] = (Index)(base+1); out[2] = (Index)(base+2);
+		out[3] = (Index)base; out[4] = (Index)(base+2); out[5] = (Index)(base+3);
+	}
+}
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteSphere(float radius, uint32 sliceCount, uint32 stackCount,
+	typename Layout::VertexType* vertices, Index* indices)
+{
+	WriteSphereVertices<Layout>(radius, sliceCount, stackCount, vertices);
+	WriteSphereIndices(sliceCount, stackCount, false, indices);
+}
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteSkysphere(float radius, uint32 sliceCount, uint32 stackCount,
+	typename Layout::VertexType* vertices, Index* indices)
+{
+	WriteSphereVertices<Layout>(radius, sliceCount, stackCount, vertices);
+	WriteSphereIndices(sliceCount, stackCount, true, indices);
+}
+
+template<typename Layout>
+void GeometryGenerator::WriteSphereVertices(float radius, uint32 sliceCount, uint32 stackCount,
+	typename Layout::VertexType* vertices)
+{
+	using namespace DirectX;
+
+	CheckSphereCounts(sliceCount, stackCount);
+
+	//
+	// Compute the vertices stating at the top pole and moving down the stacks.
+	//
+
+	// Poles: note that there will be texture coordinate distortion as there is
+	// not a unique point on the texture map to assign to the pole when mapping
+	// a rectangular texture onto a sphere.
+	Layout::Write(vertices[0], XMFLOAT3(0.0f, +radius, 0.0f), XMFLOAT3(0.0f, +1.0f, 0.0f),
+		XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f));
+
+	float phiStep = XM_PI / stackCount;
+	float thetaStep = 2.0f * XM_PI / sliceCount;
+
+	// Every ring has the same theta angles.
+	uint32 ringVertexCount = sliceCount + 1;
+	std::vector<float> sinTheta(ringVertexCount);
+	std::vector<float> cosTheta(ringVertexCount);
+	for(uint32 j = 0; j <= sliceCount; ++j)
+	{
+		float theta = j * thetaStep;
+		sinTheta[j] = sinf(theta);
+		cosTheta[j] = cosf(theta);
+	}
+
+	// Compute vertices for each stack ring (do not count the poles as rings).
+	Parallel::For(stackCount - 1, RowsPerTask(ringVertexCount), [&](size_t begin, size_t end)
+	{
+		VertexBlock block;
+		for(size_t ring = begin; ring < end; ++ring)
+		{
+			uint32 i = (uint32)ring + 1;
+			typename Layout::VertexType* out = vertices + 1 + ring * ringVertexCount;
+
+			for(uint32 first = 0; first < ringVertexCount; first += VertexBlock::Capacity)
+			{
+				uint32 count = ringVertexCount - first;
+				if(count > VertexBlock::Capacity)
+					count = VertexBlock::Capacity;
+				EvaluateSphereRing(radius, i * phiStep, thetaStep, &sinTheta[first], &cosTheta[first], first, count, block);
+
+				float v = (i * phiStep) / XM_PI;
+				for(uint32 k = 0; k < count; ++k)
+				{
+					Layout::Write(out[first + k],
+						XMFLOAT3(block.PositionX[k], block.PositionY[k], block.PositionZ[k]),
+						XMFLOAT3(block.NormalX[k], block.NormalY[k], block.NormalZ[k]),
+						XMFLOAT3(block.TangentX[k], 0.0f, block.TangentZ[k]),
+						XMFLOAT2(block.U[k], v));
+				}
+			}
+		}
+	});
+
+	Layout::Write(vertices[1 + (stackCount - 1) * ringVertexCount], XMFLOAT3(0.0f, -radius, 0.0f),
+		XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 1.0f));
+}
+
+template<typename Index>
+void GeometryGenerator::WriteSphereIndices(uint32 sliceCount, uint32 stackCount, bool reversed, Index* indices)
+{
+	const MeshSize size = SphereSize(sliceCount, stackCount);
+	const uint32 last = size.IndexCount - 1;
+	auto put = [&](uint32 k, uint32 index)
+	{
+		indices[reversed ? last - k : k] = (Index)index;
+	};
+
+	//
+	// Compute indices for top stack.  The top stack was written first to the vertex buffer
+	// and connects the top pole to the first ring.
+	//
+
+	for(uint32 i = 1; i <= sliceCount; ++i)
+	{
+		uint32 k = 3 * (i - 1);
+		put(k + 0, 0);
+		put(k + 1, i + 1);
+		put(k + 2, i);
+	}
+
+	//
+	// Compute indices for inner stacks (not connected to poles).
+	//
+
+	// Offset the indices to the index of the first vertex in the first ring.
+	// This is just skipping the top pole vertex.
+	uint32 baseIndex = 1;
+	uint32 ringVertexCount = sliceCount + 1;
+	Parallel::For(stackCount - 2, RowsPerTask(ringVertexCount), [&](size_t begin, size_t end)
+	{
+		for(uint32 i = (uint32)begin; i < (uint32)end; ++i)
+		{
+			uint32 k = 3 * sliceCount + 6 * sliceCount * i;
+			for(uint32 j = 0; j < sliceCount; ++j, k += 6)
+			{
+				put(k + 0, baseIndex + i * ringVertexCount + j);
+				put(k + 1, baseIndex + i * ringVertexCount + j + 1);
+				put(k + 2, baseIndex + (i + 1) * ringVertexCount + j);
+
+				put(k + 3, baseIndex + (i + 1) * ringVertexCount + j);
+				put(k + 4, baseIndex + i * ringVertexCount + j + 1);
+				put(k + 5, baseIndex + (i + 1) * ringVertexCount + j + 1);
+			}
+		}
+	});
+
+	//
+	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+	// and connects the bottom pole to the bottom ring.
+	//
+
+	// South pole vertex was added last.
+	uint32 southPoleIndex = size.VertexCount - 1;
+
+	// Offset the indices to the index of the first vertex in the last ring.
+	baseIndex = southPoleIndex - ringVertexCount;
+
+	for(uint32 i = 0; i < sliceCount; ++i)
+	{
+		uint32 k = size.IndexCount - 3 * sliceCount + 3 * i;
+		put(k + 0, southPoleIndex);
+		put(k + 1, baseIndex + i);
+		put(k + 2, baseIndex + i + 1);
+	}
+}
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+	typename Layout::VertexType* vertices, Index* indices)
+{
+	using namespace DirectX;
+
+	//
+	// Build Stacks.
+	// 
+
+	float stackHeight = height / stackCount;
+
+	// Amount to increment radius as we move up each stack level from bottom to top.
+	float radiusStep = (topRadius - bottomRadius) / stackCount;
+
+	uint32 ringCount = stackCount+1;
+
+	// Compute vertices for each stack ring starting at the bottom and moving up.
+	uint32 k = 0;
+	for(uint32 i = 0; i < ringCount; ++i)
+	{
+		float y = -0.5f*height + i*stackHeight;
+		float r = bottomRadius + i*radiusStep;
+
+		// vertices of ring
+		float dTheta = 2.0f*XM_PI/sliceCount;
+		for(uint32 j = 0; j <= sliceCount; ++j)
+		{
+			float c = cosf(j*dTheta);
+			float s = sinf(j*dTheta);
+
+			// Cylinder can be parameterized as follows, where we introduce v
+			// parameter that goes in the same direction as the v tex-coord
+			// so that the bitangent goes in the same direction as the v tex-coord.
+			//   Let r0 be the bottom radius and let r1 be the top radius.
+			//   y(v) = h - hv for v in [0,1].
+			//   r(v) = r1 + (r0-r1)v
+			//
+			//   x(t, v) = r(v)*cos(t)
+			//   y(t, v) = h - hv
+			//   z(t, v) = r(v)*sin(t)
+			// 
+			//  dx/dt = -r(v)*sin(t)
+			//  dy/dt = 0
+			//  dz/dt = +r(v)*cos(t)
+			//
+			//  dx/dv = (r0-r1)*cos(t)
+			//  dy/dv = -h
+			//  dz/dv = (r0-r1)*sin(t)
+
+			// This is unit length.
+			XMFLOAT3 tangent(-s, 0.0f, c);
+
+			float dr = bottomRadius-topRadius;
+			XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+			XMVECTOR T = XMLoadFloat3(&tangent);
+			XMVECTOR B = XMLoadFloat3(&bitangent);
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, XMVector3Normalize(XMVector3Cross(T, B)));
+
+			Layout::Write(vertices[k++], XMFLOAT3(r*c, y, r*s), normal, tangent,
+				XMFLOAT2((float)j/sliceCount, 1.0f - (float)i/stackCount));
+		}
+	}
+
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount+1;
+
+	// Compute indices for each stack.
+	Index* out = indices;
+	for(uint32 i = 0; i < stackCount; ++i)
+	{
+		for(uint32 j = 0; j < sliceCount; ++j)
+		{
+			*out++ = (Index)(i*ringVertexCount + j);
+			*out++ = (Index)((i+1)*ringVertexCount + j);
+			*out++ = (Index)((i+1)*ringVertexCount + j+1);
+
+			*out++ = (Index)(i*ringVertexCount + j);
+			*out++ = (Index)((i+1)*ringVertexCount + j+1);
+			*out++ = (Index)(i*ringVertexCount + j+1);
+		}
+	}
+
+	// Each cap has its own ring plus a center vertex, and sliceCount triangles.
+	uint32 capVertexCount = sliceCount + 2;
+	WriteCylinderCap<Layout>(topRadius, 0.5f*height, 1.0f, height, sliceCount, k,
+		vertices + k, out);
+	WriteCylinderCap<Layout>(bottomRadius, -0.5f*height, -1.0f, height, sliceCount, k + capVertexCount,
+		vertices + k + capVertexCount, out + 3*sliceCount);
+}
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteCylinderCap(float radius, float y, float normalY, float height, uint32 sliceCount,
+	uint32 baseIndex, typename Layout::VertexType* vertices, Index* indices)
+{
+	using namespace DirectX;
+
+	const XMFLOAT3 normal(0.0f, normalY, 0.0f);
+	const XMFLOAT3 tangent(1.0f, 0.0f, 0.0f);
+
+	// Duplicate cap ring vertices because the texture coordinates and normals differ.
+	float dTheta = 2.0f*XM_PI/sliceCount;
+	for(uint32 i = 0; i <= sliceCount; ++i)
+	{
+		float x = radius*cosf(i*dTheta);
+		float z = radius*sinf(i*dTheta);
+
+		// Scale down by the height to try and make top cap texture coord area
+		// proportional to base.
+		float u = x/height + 0.5f;
+		float v = z/height + 0.5f;
+
+		Layout::Write(vertices[i], XMFLOAT3(x, y, z), normal, tangent, XMFLOAT2(u, v));
+	}
+
+	// Cap center vertex.
+	Layout::Write(vertices[sliceCount + 1], XMFLOAT3(0.0f, y, 0.0f), normal, tangent, XMFLOAT2(0.5f, 0.5f));
+
+	// Index of center vertex.
+	uint32 centerIndex = baseIndex + sliceCount + 1;
+
+	// The top cap faces up and the bottom cap down, so their windings are opposite.
+	for(uint32 i = 0; i < sliceCount; ++i)
+	{
+		uint32 a = normalY > 0.0f ? i+1 : i;
+		uint32 b = normalY > 0.0f ? i : i+1;
+
+		indices[3*i + 0] = (Index)centerIndex;
+		indices[3*i + 1] = (Index)(baseIndex + a);
+		indices[3*i + 2] = (Index)(baseIndex + b);
+	}
+}
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteGrid(float width, float depth, uint32 m, uint32 n,
+	typename Layout::VertexType* vertices, Index* indices)
+{
+	using namespace DirectX;
+
+	//
+	// Create the vertices.
+	//
+
+	float halfWidth = 0.5f*width;
+	float halfDepth = 0.5f*depth;
+
+	float dx = width / (n-1);
+	float dz = depth / (m-1);
+
+	float du = 1.0f / (n-1);
+	float dv = 1.0f / (m-1);
+
+	const XMFLOAT3 normal(0.0f, 1.0f, 0.0f);
+	const XMFLOAT3 tangent(1.0f, 0.0f, 0.0f);
+
+	// Rows are independent, so large grids split them across threads.  The bodies take
+	// copies so that the stores to the vertices can not alias the parameters.
+	const size_t rowsPerTask = RowsPerTask(n);
+	Parallel::For(m, rowsPerTask, [=](size_t begin, size_t end)
+	{
+		for(uint32 i = (uint32)begin; i < (uint32)end; ++i)
+		{
+			float z = halfDepth - i*dz;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				// Stretch texture over grid.
+				Layout::Write(vertices[i*n+j], XMFLOAT3(x, 0.0f, z), normal, tangent, XMFLOAT2(j*du, i*dv));
+			}
+		}
+	});
+
+	//
+	// Create the indices.
+	//
+
+	// Iterate over each quad and compute indices.
+	Parallel::For(m-1, rowsPerTask, [=](size_t begin, size_t end)
+	{
+		for(uint32 i = (uint32)begin; i < (uint32)end; ++i)
+		{
+			uint32 k = i*(n-1)*6;
+			for(uint32 j = 0; j < n-1; ++j)
+			{
+				indices[k]   = (Index)(i*n+j);
+				indices[k+1] = (Index)(i*n+j+1);
+				indices[k+2] = (Index)((i+1)*n+j);
+
+				indices[k+3] = (Index)((i+1)*n+j);
+				indices[k+4] = (Index)(i*n+j+1);
+				indices[k+5] = (Index)((i+1)*n+j+1);
+
+				k += 6; // next quad
+			}
+		}
+	});
+}
+
+template<typename Layout, typename Index>
+void GeometryGenerator::WriteQuad(float x, float y, float w, float h, float depth,
+	typename Layout::VertexType* vertices, Index* indices)
+{
+	using DirectX::XMFLOAT2;
+	using DirectX::XMFLOAT3;
+
+	const XMFLOAT3 normal(0.0f, 0.0f, -1.0f);
+	const XMFLOAT3 tangent(1.0f, 0.0f, 0.0f);
+
+	// Position coordinates specified in NDC space.
+	Layout::Write(vertices[0], XMFLOAT3(x, y - h, depth), normal, tangent, XMFLOAT2(0.0f, 1.0f));
+	Layout::Write(vertices[1], XMFLOAT3(x, y, depth), normal, tangent, XMFLOAT2(0.0f, 0.0f));
+	Layout::Write(vertices[2], XMFLOAT3(x+w, y, depth), normal, tangent, XMFLOAT2(1.0f, 0.0f));
+	Layout::Write(vertices[3], XMFLOAT3(x+w, y-h, depth), normal, tangent, XMFLOAT2(1.0f, 1.0f));
+
+	indices[0] = 0;
+	indices[1] = 1;
+	indices[2] = 2;
+
+	indices[3] = 0;
+	indices[4] = 2;
+	indices[5] = 3;
+}
+
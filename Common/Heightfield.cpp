@@ -0,0 +1,121 @@
+//***************************************************************************************
+// Heightfield.cpp
+//***************************************************************************************
+
+#include "Heightfield.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// Rows per task when sampling the height function.
+	const size_t GenerateGrain = 16;
+}
+
+void Heightfield::Generate(uint32 width, uint32 depth, float spacing,
+	const std::function<float(float x, float z)>& height)
+{
+	mFile.Close();
+
+	mWidth = width;
+	mDepth = depth;
+	mSpacing = spacing;
+	mGenerated.resize((size_t)width * depth);
+	mSamples = mGenerated.data();
+
+	const float originX = OriginX();
+	const float originZ = OriginZ();
+
+	// First pass: the range of the function over the grid, one entry per row.
+	std::vector<float> rowMin(depth, FLT_MAX);
+	std::vector<float> rowMax(depth, -FLT_MAX);
+	Parallel::For(depth, GenerateGrain, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; ++z)
+		{
+			const float worldZ = originZ + z * spacing;
+			for (uint32 x = 0; x < width; ++x)
+			{
+				const float h = height(originX + x * spacing, worldZ);
+				rowMin[z] = std::min(rowMin[z], h);
+				rowMax[z] = std::max(rowMax[z], h);
+			}
+		}
+	});
+
+	float minHeight = depth > 0 ? *std::min_element(rowMin.begin(), rowMin.end()) : 0.0f;
+	float maxHeight = depth > 0 ? *std::max_element(rowMax.begin(), rowMax.end()) : 0.0f;
+
+	mHeightOffset = minHeight;
+	mHeightScale = maxHeight > minHeight ? (maxHeight - minHeight) / 65535.0f : 1.0f;
+
+	// Second pass: quantize to the full 16-bit range.
+	const float invScale = 1.0f / mHeightScale;
+	Parallel::For(depth, GenerateGrain, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; ++z)
+		{
+			const float worldZ = originZ + z * spacing;
+			uint16* row = &mGenerated[z * width];
+			for (uint32 x = 0; x < width; ++x)
+			{
+				const float h = (height(originX + x * spacing, worldZ) - minHeight) * invScale;
+				row[x] = (uint16)std::min(std::max(h + 0.5f, 0.0f), 65535.0f);
+			}
+		}
+	});
+}
+
+bool Heightfield::LoadRaw16(const char* fileName, uint32 width, uint32 depth, float spacing,
+	float heightScale, float heightOffset)
+{
+	MappedFile file;
+	if (!file.Open(fileName) || file.Size() != (std::uint64_t)width * depth * sizeof(uint16))
+		return false;
+
+	mFile = std::move(file);
+	mGenerated.clear();
+	mGenerated.shrink_to_fit();
+
+	mWidth = width;
+	mDepth = depth;
+	mSpacing = spacing;
+	mHeightScale = heightScale;
+	mHeightOffset = heightOffset;
+	mSamples = reinterpret_cast<const uint16*>(mFile.Data());
+
+	return true;
+}
+
+Heightfield::uint16 Heightfield::Sample(int x, int z)const
+{
+	x = std::min(std::max(x, 0), (int)mWidth - 1);
+	z = std::min(std::max(z, 0), (int)mDepth - 1);
+	return mSamples[(size_t)z * mWidth + x];
+}
+
+float Heightfield::Height(float x, float z)const
+{
+	const float gridX = (x - OriginX()) / mSpacing;
+	const float gridZ = (z - OriginZ()) / mSpacing;
+
+	const float floorX = std::floor(gridX);
+	const float floorZ = std::floor(gridZ);
+	const float s = gridX - floorX;
+	const float t = gridZ - floorZ;
+
+	const int x0 = (int)floorX;
+	const int z0 = (int)floorZ;
+
+	const float h00 = Sample(x0, z0);
+	const float h10 = Sample(x0 + 1, z0);
+	const float h01 = Sample(x0, z0 + 1);
+	const float h11 = Sample(x0 + 1, z0 + 1);
+
+	const float h0 = h00 + (h10 - h00) * s;
+	const float h1 = h01 + (h11 - h01) * s;
+	return mHeightOffset + (h0 + (h1 - h0) * t) * mHeightScale;
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// Heightfield.h
+//
+// A regular grid of 16-bit height samples centred on the world origin.  Sample (x, z)
+// lies at Origin() + (x, z) * Spacing() in the xz-plane, and a stored value h is the
+// height HeightOffset() + h * HeightScale().
+//
+// The samples come from a height function, quantized to its range over the grid, or
+// from a raw 16-bit little-endian heightmap file (.r16/.raw, rows of increasing z, no
+// header).  A file is used straight from its memory-mapped view, so a 16k x 16k map
+// (512 MB) is never copied.  A GPU texture holds at most 16384 samples per side.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "MappedFile.h"
+
+class Heightfield
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+public:
+	Heightfield() = default;
+	Heightfield(const Heightfield& rhs) = delete;
+	Heightfield& operator=(const Heightfield& rhs) = delete;
+	~Heightfield() = default;
+
+	// Samples height(x, z) at every grid point on all cores.  The function is called
+	// twice per sample, once to find the range and once to quantize, so the grid is
+	// never held as floats.
+	void Generate(uint32 width, uint32 depth, float spacing,
+		const std::function<float(float x, float z)>& height);
+
+	// Maps a width x depth file of samples.  Returns false if the file can not be
+	// opened or is not exactly width * depth * 2 bytes long.
+	bool LoadRaw16(const char* fileName, uint32 width, uint32 depth, float spacing,
+		float heightScale, float heightOffset);
+
+	uint32 Width()const { return mWidth; }
+	uint32 Depth()const { return mDepth; }
+	float Spacing()const { return mSpacing; }
+	float HeightScale()const { return mHeightScale; }
+	float HeightOffset()const { return mHeightOffset; }
+
+	// World xz of sample (0, 0), and the extent of the grid along x and z.
+	float OriginX()const { return -0.5f * ExtentX(); }
+	float OriginZ()const { return -0.5f * ExtentZ(); }
+	float ExtentX()const { return (mWidth > 0 ? mWidth - 1 : 0) * mSpacing; }
+	float ExtentZ()const { return (mDepth > 0 ? mDepth - 1 : 0) * mSpacing; }
+
+	// Row-major, Width() samples per row.
+	const uint16* Samples()const { return mSamples; }
+
+	// Sample (x, z), clamped to the grid.
+	uint16 Sample(int x, int z)const;
+
+	// Bilinearly filtered height at world (x, z), clamped to the grid.
+	float Height(float x, float z)const;
+
+private:
+	uint32 mWidth = 0;
+	uint32 mDepth = 0;
+	float mSpacing = 1.0f;
+	float mHeightScale = 1.0f;
+	float mHeightOffset = 0.0f;
+
+	const uint16* mSamples = nullptr;
+
+	// Exactly one of these backs mSamples.
+	std::vector<uint16> mGenerated;
+	MappedFile mFile;
+};
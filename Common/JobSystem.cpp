@@ -0,0 +1,330 @@
+//***************************************************************************************
+// JobSystem.cpp
+//***************************************************************************************
+
+#include "JobSystem.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+
+struct JobSystem::Job
+{
+	std::function<void()> Work;
+	TaskGroup* Group = nullptr;
+
+	// Tasks still to finish before this job can be queued, plus one while Run() is
+	// still adding them.
+	std::atomic<size_t> Blockers{ 1 };
+
+	// Jobs waiting for this one; once Finished is set nothing more is added.
+	std::mutex Lock;
+	bool Finished = false;
+	std::vector<Job*> Continuations;
+};
+
+struct JobSystem::Worker
+{
+	JobSystem* System = nullptr;
+	unsigned Index = 0;
+	std::mutex Lock;
+	std::deque<Job*> Jobs;
+	std::thread Thread;
+};
+
+namespace
+{
+	// The worker the current thread is, if it belongs to a pool.
+	thread_local void* tCurrentWorker = nullptr;
+
+	// Failed attempts to find a job before a worker goes to sleep.
+	const int IdleSpins = 64;
+}
+
+JobSystem::TaskGroup::TaskGroup(JobSystem& system)
+	: mSystem(system)
+{
+}
+
+JobSystem::TaskGroup::~TaskGroup()
+{
+	// Jobs refer to the group, so they must all be done before it goes away.
+	while (mUnfinished.load(std::memory_order_acquire) > 0)
+	{
+		if (!mSystem.RunOne())
+			std::this_thread::yield();
+	}
+}
+
+JobSystem::Task JobSystem::TaskGroup::Run(std::function<void()> work, std::initializer_list<Task> after)
+{
+	Job* job;
+	{
+		std::lock_guard<std::mutex> lock(mJobsLock);
+		mJobs.emplace_back();
+		job = &mJobs.back();
+	}
+
+	job->Work = std::move(work);
+	job->Group = this;
+	mUnfinished.fetch_add(1, std::memory_order_relaxed);
+
+	for (const Task& task : after)
+	{
+		Job* dependency = task.mJob;
+		assert(dependency != nullptr && dependency->Group == this);
+
+		std::lock_guard<std::mutex> lock(dependency->Lock);
+		if (!dependency->Finished)
+		{
+			job->Blockers.fetch_add(1, std::memory_order_relaxed);
+			dependency->Continuations.push_back(job);
+		}
+	}
+
+	if (job->Blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		mSystem.Push(job);
+
+	return Task(job);
+}
+
+void JobSystem::TaskGroup::Wait()
+{
+	while (mUnfinished.load(std::memory_order_acquire) > 0)
+	{
+		if (!mSystem.RunOne())
+			std::this_thread::yield();
+	}
+
+	mJobs.clear();
+	mFailed.store(false, std::memory_order_relaxed);
+
+	if (mError)
+	{
+		std::exception_ptr error = mError;
+		mError = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+	mWorkers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i)
+	{
+		mWorkers.push_back(std::make_unique<Worker>());
+		mWorkers.back()->System = this;
+		mWorkers.back()->Index = i;
+	}
+
+	// Start the threads once every deque exists, since they steal from each other.
+	for (auto& worker : mWorkers)
+		worker->Thread = std::thread(&JobSystem::WorkerLoop, this, worker.get());
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker->Thread.join();
+}
+
+JobSystem& JobSystem::Default()
+{
+	static JobSystem system(Parallel::HardwareThreads() - 1);
+	return system;
+}
+
+void JobSystem::ParallelForRanges(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+
+	if (count <= grain || mWorkers.empty())
+	{
+		for (size_t begin = 0; begin < count; begin += grain)
+			body(begin, std::min(begin + grain, count));
+		return;
+	}
+
+	// Queue the upper half of the range and keep going with the lower half, so a thief
+	// always takes the largest piece left.  Halves are split on chunk boundaries.
+	// The queued halves call split, so it is declared before the group: if body throws
+	// here, the group's destructor finishes them while split still exists.
+	std::function<void(size_t, size_t)> split;
+	TaskGroup group(*this);
+	split = [&](size_t begin, size_t end)
+	{
+		while (end - begin > grain)
+		{
+			const size_t chunks = (end - begin + grain - 1) / grain;
+			const size_t middle = begin + (chunks + 1) / 2 * grain;
+			group.Run([&split, middle, end]() { split(middle, end); });
+			end = middle;
+		}
+		body(begin, end);
+	};
+
+	split(0, count);
+	group.Wait();
+}
+
+void JobSystem::Push(Job* job)
+{
+	Worker* worker = static_cast<Worker*>(tCurrentWorker);
+	if (worker != nullptr && worker->System == this)
+	{
+		std::lock_guard<std::mutex> lock(worker->Lock);
+		worker->Jobs.push_back(job);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(mSharedLock);
+		mShared.push_back(job);
+	}
+
+	// A worker going to sleep counts itself before it checks mQueued, so one of the two
+	// sides sees the other.
+	mQueued.fetch_add(1);
+	if (mSleepers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+		mWake.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::Pop()
+{
+	if (mQueued.load(std::memory_order_relaxed) == 0)
+		return nullptr;
+
+	Worker* self = static_cast<Worker*>(tCurrentWorker);
+	if (self != nullptr && self->System != this)
+		self = nullptr;
+
+	Job* job = nullptr;
+
+	// Newest of our own jobs first: its data is likely still in cache.
+	if (self != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(self->Lock);
+		if (!self->Jobs.empty())
+		{
+			job = self->Jobs.back();
+			self->Jobs.pop_back();
+		}
+	}
+
+	// Then the oldest job of another worker, starting after our own index so the
+	// thieves spread out.
+	const size_t workerCount = mWorkers.size();
+	const size_t first = self != nullptr ? self->Index + 1 : 0;
+	for (size_t i = 0; job == nullptr && i < workerCount; ++i)
+	{
+		Worker* victim = mWorkers[(first + i) % workerCount].get();
+		if (victim == self)
+			continue;
+
+		std::lock_guard<std::mutex> lock(victim->Lock);
+		if (!victim->Jobs.empty())
+		{
+			job = victim->Jobs.front();
+			victim->Jobs.pop_front();
+		}
+	}
+
+	if (job == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mSharedLock);
+		if (!mShared.empty())
+		{
+			job = mShared.front();
+			mShared.pop_front();
+		}
+	}
+
+	if (job != nullptr)
+		mQueued.fetch_sub(1);
+	return job;
+}
+
+bool JobSystem::RunOne()
+{
+	Job* job = Pop();
+	if (job == nullptr)
+		return false;
+
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	TaskGroup* group = job->Group;
+
+	if (!group->mFailed.load(std::memory_order_relaxed))
+	{
+		try
+		{
+			job->Work();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(group->mJobsLock);
+			if (!group->mError)
+				group->mError = std::current_exception();
+			group->mFailed.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	std::vector<Job*> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->Lock);
+		job->Finished = true;
+		continuations.swap(job->Continuations);
+	}
+
+	for (Job* continuation : continuations)
+		if (continuation->Blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Push(continuation);
+
+	// The last touch of the job and the group: Wait() may return right after.
+	group->mUnfinished.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::WorkerLoop(Worker* worker)
+{
+	tCurrentWorker = worker;
+
+	int idle = 0;
+	for (;;)
+	{
+		if (RunOne())
+		{
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < IdleSpins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepLock);
+		mSleepers.fetch_add(1);
+		mWake.wait(lock, [this]() { return mStop || mQueued.load() > 0; });
+		mSleepers.fetch_sub(1);
+
+		if (mStop)
+			return;
+		idle = 0;
+	}
+}
@@ -0,0 +1,134 @@
+//***************************************************************************************
+// JobSystem.h
+//
+// A persistent pool of worker threads with work stealing: the one scheduler behind the
+// per-frame work, Parallel::For's asset loops and TaskGraph's start-up graphs.
+//
+// Every worker owns a deque of jobs: it pushes and pops its own jobs at the back, and
+// when it runs out it steals from the front of the other workers' deques, then from a
+// shared queue that takes the jobs submitted by threads outside the pool.  Idle
+// workers sleep until a job is queued.
+//
+// A TaskGroup collects jobs and Wait()s for them.  Run() can name earlier jobs of the
+// group that a job must wait for: the job is queued by whichever thread finishes the
+// last of them, so a graph of jobs unfolds without anybody polling it.  Waiting
+// threads run queued jobs instead of blocking, so groups can be nested inside jobs.
+//
+// ParallelFor() splits a range in halves, queueing one half and keeping the other,
+// down to 'grain' items; idle workers steal the large halves first.  Uses std::thread
+// only.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+private:
+	struct Job;
+	struct Worker;
+
+public:
+	class TaskGroup;
+
+	// A job added to a TaskGroup, for later jobs of the same group to wait for.
+	class Task
+	{
+	public:
+		Task() = default;
+
+	private:
+		friend class JobSystem;
+		friend class TaskGroup;
+		explicit Task(Job* job) : mJob(job) {}
+
+		Job* mJob = nullptr;
+	};
+
+	class TaskGroup
+	{
+	public:
+		explicit TaskGroup(JobSystem& system);
+		TaskGroup(const TaskGroup& rhs) = delete;
+		TaskGroup& operator=(const TaskGroup& rhs) = delete;
+		~TaskGroup();
+
+		// Queues work once every task in 'after' has finished.  Safe to call from any
+		// thread, including from jobs of this group, but not concurrently with Wait().
+		Task Run(std::function<void()> work, std::initializer_list<Task> after = {});
+
+		// Runs queued jobs until every job of the group has finished, then makes the
+		// group reusable.  If a job threw, the jobs that had not started are skipped
+		// and the first exception is rethrown here.
+		void Wait();
+
+	private:
+		friend class JobSystem;
+
+		JobSystem& mSystem;
+		std::mutex mJobsLock;
+		std::deque<Job> mJobs;
+		std::atomic<size_t> mUnfinished{ 0 };
+		std::atomic<bool> mFailed{ false };
+		std::exception_ptr mError;
+	};
+
+public:
+	// Starts workerCount threads; the thread that waits is the extra one.
+	explicit JobSystem(unsigned workerCount);
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+	~JobSystem();
+
+	// The process-wide pool, with a worker for every hardware thread but one.
+	static JobSystem& Default();
+
+	// Workers plus the waiting thread.
+	unsigned ThreadCount()const { return (unsigned)mWorkers.size() + 1; }
+
+	// Calls body(begin, end) for chunks of at most 'grain' items covering [0, count) and
+	// returns when all are done.  body must be safe to call concurrently.  If it throws,
+	// the exception is rethrown once no chunk is left running.
+	template<typename Body>
+	void ParallelFor(size_t count, size_t grain, const Body& body)
+	{
+		ParallelForRanges(count, grain, std::function<void(size_t, size_t)>(std::cref(body)));
+	}
+
+	// Runs one queued job on the calling thread, if there is one.  For threads that wait
+	// on something other than a TaskGroup and can help meanwhile.
+	bool RunOne();
+
+private:
+	void ParallelForRanges(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	void Push(Job* job);
+	Job* Pop();
+	void Execute(Job* job);
+	void WorkerLoop(Worker* worker);
+
+private:
+	std::vector<std::unique_ptr<Worker>> mWorkers;
+
+	// Jobs submitted by threads outside the pool.
+	std::mutex mSharedLock;
+	std::deque<Job*> mShared;
+
+	// Jobs in all queues, and workers asleep waiting for one.
+	std::atomic<size_t> mQueued{ 0 };
+	std::atomic<unsigned> mSleepers{ 0 };
+	std::mutex mSleepLock;
+	std::condition_variable mWake;
+	bool mStop = false;
+};
@@ -0,0 +1,234 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+{
+	*this = std::move(rhs);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		Close();
+
+		std::swap(mData, rhs.mData);
+		std::swap(mSize, rhs.mSize);
+#ifdef _WIN32
+		std::swap(mFile, rhs.mFile);
+		std::swap(mMapping, rhs.mMapping);
+#else
+		std::swap(mFd, rhs.mFd);
+#endif
+	}
+
+	return *this;
+}
+
+void MappedFile::Prefetch()const
+{
+	// No larger than the page size of any supported platform, so no page is skipped.
+	const std::uint64_t step = 4096;
+
+	volatile std::uint8_t sink = 0;
+	for (std::uint64_t offset = 0; offset < mSize; offset += step)
+		sink = sink + mData[offset];
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::IsOpen()const
+{
+	return mFile != nullptr;
+}
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	Close();
+
+	HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	mFile = file;
+	return MapOpenedFile();
+}
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	mFile = file;
+	return MapOpenedFile();
+}
+
+bool MappedFile::MapOpenedFile()
+{
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(mFile, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	mSize = static_cast<std::uint64_t>(fileSize.QuadPart);
+
+	// A zero-length file can not be mapped, but it is still a valid (empty) file.
+	if (mSize == 0)
+		return true;
+
+	// A 32-bit process can not address a view larger than its address space.
+	if (mSize > static_cast<std::uint64_t>(SIZE_MAX))
+	{
+		Close();
+		SetLastError(ERROR_FILE_TOO_LARGE);
+		return false;
+	}
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr)
+	{
+		DWORD error = GetLastError();
+		Close();
+		SetLastError(error);
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = nullptr;
+	mSize = 0;
+}
+
+#else
+
+bool MappedFile::IsOpen()const
+{
+	return mFd >= 0;
+}
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	std::size_t length = std::wcstombs(nullptr, fileName, 0);
+	if (length == static_cast<std::size_t>(-1))
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	std::string narrow(length, '\0');
+	std::wcstombs(&narrow[0], fileName, length);
+
+	return Open(narrow.c_str());
+}
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	mFd = ::open(fileName, O_RDONLY);
+	if (mFd < 0)
+		return false;
+
+	return MapOpenedFile();
+}
+
+bool MappedFile::MapOpenedFile()
+{
+	struct stat info;
+	if (::fstat(mFd, &info) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	mSize = static_cast<std::uint64_t>(info.st_size);
+
+	// A zero-length file can not be mapped, but it is still a valid (empty) file.
+	if (mSize == 0)
+		return true;
+
+	if (mSize > static_cast<std::uint64_t>(SIZE_MAX))
+	{
+		Close();
+		errno = EFBIG;
+		return false;
+	}
+
+	void* view = ::mmap(nullptr, static_cast<std::size_t>(mSize), PROT_READ, MAP_PRIVATE, mFd, 0);
+	if (view == MAP_FAILED)
+	{
+		int error = errno;
+		Close();
+		errno = error;
+		return false;
+	}
+
+	// Loaders walk the file front to back exactly once.
+	::madvise(view, static_cast<std::size_t>(mSize), MADV_SEQUENTIAL);
+
+	mData = static_cast<const std::uint8_t*>(view);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		::munmap(const_cast<std::uint8_t*>(mData), static_cast<std::size_t>(mSize));
+	if (mFd >= 0)
+		::close(mFd);
+
+	mData = nullptr;
+	mFd = -1;
+	mSize = 0;
+}
+
+#endif
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory-mapped view of a whole file.  Loaders hand pointers into the view
+// straight to the upload step, so the file contents are never copied into an
+// intermediate heap allocation.  Sizes are 64-bit on every platform.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	MappedFile(MappedFile&& rhs) noexcept;
+	MappedFile& operator=(MappedFile&& rhs) noexcept;
+	~MappedFile();
+
+	// Maps the whole file.  Returns false if the file can not be opened or mapped
+	// (on Windows GetLastError() holds the reason, errno elsewhere).  An empty file
+	// opens successfully with Data() == nullptr.
+	bool Open(const wchar_t* fileName);
+	bool Open(const char* fileName);
+	void Close();
+
+	bool IsOpen()const;
+	const std::uint8_t* Data()const { return mData; }
+	std::uint64_t Size()const { return mSize; }
+
+	// Reads one byte of every page, so the whole file is in the page cache before a
+	// loader gets to it.  Start-up code calls this on a worker thread for files the
+	// main thread will open later.
+	void Prefetch()const;
+
+private:
+	bool MapOpenedFile();
+
+private:
+	const std::uint8_t* mData = nullptr;
+	std::uint64_t mSize = 0;
+
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#else
+	int mFd = -1;
+#endif
+};
@@ -0,0 +1,248 @@
+//***************************************************************************************
+// MeshCache.cpp
+//***************************************************************************************
+
+#include "MeshCache.h"
+#include "ContentHash.h"
+#include "MeshFile.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+	using MeshData = GeometryGenerator::MeshData;
+	using GeneratorVertex = GeometryGenerator::Vertex;
+
+	// GeometryGenerator::Vertex as it is stored in the disk files.
+	const MeshFile::Attribute GeneratorVertexLayout[4] =
+	{
+		{ MeshFile::Semantic::Position, MeshFile::AttributeFormat::Float3, offsetof(GeneratorVertex, Position) },
+		{ MeshFile::Semantic::Normal, MeshFile::AttributeFormat::Float3, offsetof(GeneratorVertex, Normal) },
+		{ MeshFile::Semantic::Tangent, MeshFile::AttributeFormat::Float3, offsetof(GeneratorVertex, TangentU) },
+		{ MeshFile::Semantic::TexCoord, MeshFile::AttributeFormat::Float2, offsetof(GeneratorVertex, TexC) }
+	};
+	const std::uint32_t GeneratorVertexStride = sizeof(GeneratorVertex);
+
+	static_assert(sizeof(GeneratorVertex) == 44, "GeometryGenerator::Vertex is stored as 11 floats");
+
+	void AppendParameter(std::string& key, float value)
+	{
+		key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	void AppendParameter(std::string& key, std::uint32_t value)
+	{
+		key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	// The generator name, a terminator, then the raw bytes of each parameter.
+	template<typename... Parameters>
+	std::string MakeKey(const char* generator, Parameters... parameters)
+	{
+		std::string key = generator;
+		key.push_back('\0');
+
+		int expand[] = { 0, (AppendParameter(key, parameters), 0)... };
+		(void)expand;
+
+		return key;
+	}
+
+	std::string DiskFileName(const std::string& directory, const std::string& key)
+	{
+		std::uint64_t hash = ContentHash::Hash64(key.data(), key.size(), MeshCache::GeneratorVersion);
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)hash);
+		return directory + "/" + name;
+	}
+
+	bool LoadMesh(const std::string& fileName, MeshData& meshData)
+	{
+		MeshFile::View view;
+		if (!view.Open(fileName.c_str()))
+			return false;
+
+		const MeshFile::FileHeader& header = view.Header();
+		if (header.StreamCount != 1 || !view.HasLayout(0, GeneratorVertexLayout, 4, GeneratorVertexStride))
+			return false;
+
+		meshData.Vertices.resize(header.VertexCount);
+		std::memcpy(meshData.Vertices.data(), view.StreamData(0), (size_t)header.VertexCount * GeneratorVertexStride);
+
+		meshData.Indices32.resize(header.IndexCount);
+		if (header.IndexSize == 4)
+		{
+			std::memcpy(meshData.Indices32.data(), view.IndexData(), (size_t)header.IndexCount * 4);
+		}
+		else
+		{
+			const std::uint16_t* indices = static_cast<const std::uint16_t*>(view.IndexData());
+			for (std::uint32_t i = 0; i < header.IndexCount; ++i)
+				meshData.Indices32[i] = indices[i];
+		}
+
+		return true;
+	}
+
+	void SaveMesh(const std::string& fileName, const MeshData& meshData)
+	{
+		MeshFile::Mesh mesh;
+		mesh.VertexCount = (std::uint32_t)meshData.Vertices.size();
+
+		MeshFile::Mesh::Stream stream;
+		stream.Attributes.assign(GeneratorVertexLayout, GeneratorVertexLayout + 4);
+		stream.Stride = GeneratorVertexStride;
+		stream.Data.resize(meshData.Vertices.size() * GeneratorVertexStride);
+		std::memcpy(stream.Data.data(), meshData.Vertices.data(), stream.Data.size());
+		mesh.Streams.push_back(std::move(stream));
+
+		mesh.Indices = meshData.Indices32;
+
+		MeshFile::Mesh::Submesh submesh;
+		submesh.Name = "generated";
+		submesh.IndexCount = (std::uint32_t)meshData.Indices32.size();
+		mesh.Submeshes.push_back(submesh);
+
+		// A file that fails to write is regenerated next time.
+		MeshFile::Write(fileName.c_str(), mesh);
+	}
+}
+
+MeshCache& MeshCache::Global()
+{
+	static MeshCache cache;
+	return cache;
+}
+
+void MeshCache::SetDiskDirectory(const std::string& directory)
+{
+	if (!directory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mDiskDirectory = directory;
+}
+
+template<typename Generate>
+MeshCache::Mesh MeshCache::Find(const std::string& key, bool useDisk, Generate generate)
+{
+	std::string directory;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto match = mMeshes.find(key);
+		if (match != mMeshes.end())
+		{
+			mStats.MemoryHits++;
+			return match->second;
+		}
+
+		if (useDisk)
+			directory = mDiskDirectory;
+	}
+
+	// Loaded or generated without the lock.  Two threads asking for the same new mesh
+	// both build it; the first to finish is kept.
+	auto meshData = std::make_shared<MeshData>();
+
+	const std::string fileName = directory.empty() ? std::string() : DiskFileName(directory, key);
+	const bool fromDisk = !fileName.empty() && LoadMesh(fileName, *meshData);
+	if (!fromDisk)
+	{
+		*meshData = generate();
+		if (!fileName.empty() && meshData->Vertices.size() >= DiskMinVertices)
+			SaveMesh(fileName, *meshData);
+	}
+
+	// Nothing writes to a shared mesh, so the lazily built 16-bit indices are built now.
+	if (meshData->Vertices.size() <= 0x10000)
+		meshData->GetIndices16();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto inserted = mMeshes.emplace(key, std::move(meshData));
+	if (!inserted.second)
+		mStats.MemoryHits++;
+	else if (fromDisk)
+		mStats.DiskHits++;
+	else
+		mStats.Generated++;
+
+	return inserted.first->second;
+}
+
+MeshCache::Mesh MeshCache::Box(float width, float height, float depth, uint32 numSubdivisions)
+{
+	return Find(MakeKey("Box", width, height, depth, numSubdivisions), true, [&]()
+	{
+		return GeometryGenerator().CreateBox(width, height, depth, numSubdivisions);
+	});
+}
+
+MeshCache::Mesh MeshCache::Sphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	return Find(MakeKey("Sphere", radius, sliceCount, stackCount), true, [&]()
+	{
+		return GeometryGenerator().CreateSphere(radius, sliceCount, stackCount);
+	});
+}
+
+MeshCache::Mesh MeshCache::Skysphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	return Find(MakeKey("Skysphere", radius, sliceCount, stackCount), true, [&]()
+	{
+		return GeometryGenerator().CreateSkysphere(radius, sliceCount, stackCount);
+	});
+}
+
+MeshCache::Mesh MeshCache::Geosphere(float radius, uint32 numSubdivisions)
+{
+	return Find(MakeKey("Geosphere", radius, numSubdivisions), true, [&]()
+	{
+		return GeometryGenerator().CreateGeosphere(radius, numSubdivisions);
+	});
+}
+
+MeshCache::Mesh MeshCache::Cylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
+{
+	return Find(MakeKey("Cylinder", bottomRadius, topRadius, height, sliceCount, stackCount), true, [&]()
+	{
+		return GeometryGenerator().CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount);
+	});
+}
+
+MeshCache::Mesh MeshCache::Grid(float width, float depth, uint32 m, uint32 n)
+{
+	return Find(MakeKey("Grid", width, depth, m, n), false, [&]()
+	{
+		return GeometryGenerator().CreateGrid(width, depth, m, n);
+	});
+}
+
+MeshCache::Mesh MeshCache::Quad(float x, float y, float w, float h, float depth)
+{
+	return Find(MakeKey("Quad", x, y, w, h, depth), false, [&]()
+	{
+		return GeometryGenerator().CreateQuad(x, y, w, h, depth);
+	});
+}
+
+MeshCache::Stats MeshCache::GetStats()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+void MeshCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mMeshes.clear();
+}
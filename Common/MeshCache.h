@@ -0,0 +1,78 @@
+//***************************************************************************************
+// MeshCache.h
+//
+// Memoizes GeometryGenerator meshes by generator name and parameters.  The first
+// request for a mesh generates it; later requests, from any thread, get the same
+// immutable MeshData, with its 16-bit indices already built when they fit.
+//
+// With a disk directory set, subdivided and trigonometric meshes (boxes, spheres,
+// geospheres, cylinders) of at least DiskMinVertices vertices are also kept there as
+// MeshFiles and mapped back on later runs, so subdivision and trigonometry are not
+// repeated across runs either.  Grids, quads and smaller meshes are cheaper to
+// generate than to read.  Files are named after a hash of the key and
+// GeneratorVersion; a file that does not validate or does not match the generator's
+// vertex layout is regenerated.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "GeometryGenerator.h"
+
+class MeshCache
+{
+public:
+	using Mesh = std::shared_ptr<const GeometryGenerator::MeshData>;
+	using uint32 = std::uint32_t;
+
+	// Bump when a generator changes its output, so old disk files are not used.
+	static const uint32 GeneratorVersion = 1;
+	static const uint32 DiskMinVertices = 4096;
+
+	struct Stats
+	{
+		uint32 MemoryHits = 0;
+		uint32 DiskHits = 0;
+		uint32 Generated = 0;
+	};
+
+public:
+	MeshCache() = default;
+	MeshCache(const MeshCache& rhs) = delete;
+	MeshCache& operator=(const MeshCache& rhs) = delete;
+	~MeshCache() = default;
+
+	// The process-wide cache.
+	static MeshCache& Global();
+
+	// Created if it does not exist.  An empty name turns the disk cache off.
+	void SetDiskDirectory(const std::string& directory);
+
+	Mesh Box(float width, float height, float depth, uint32 numSubdivisions);
+	Mesh Sphere(float radius, uint32 sliceCount, uint32 stackCount);
+	Mesh Skysphere(float radius, uint32 sliceCount, uint32 stackCount);
+	Mesh Geosphere(float radius, uint32 numSubdivisions);
+	Mesh Cylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+	Mesh Grid(float width, float depth, uint32 m, uint32 n);
+	Mesh Quad(float x, float y, float w, float h, float depth);
+
+	Stats GetStats()const;
+
+	// Drops the memory cache; meshes still referenced elsewhere stay alive.
+	void Clear();
+
+private:
+	template<typename Generate>
+	Mesh Find(const std::string& key, bool useDisk, Generate generate);
+
+private:
+	mutable std::mutex mMutex;
+	std::unordered_map<std::string, Mesh> mMeshes;
+	std::string mDiskDirectory;
+	Stats mStats;
+};
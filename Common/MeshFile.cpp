@@ -0,0 +1,773 @@
+//***************************************************************************************
+// MeshFile.cpp
+//***************************************************************************************
+
+#include "MeshFile.h"
+#include "Parallel.h"
+#include "TangentSpace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+using namespace MeshFile;
+
+const Attribute MeshFile::StandardVertexLayout[4] =
+{
+	{ Semantic::Position, AttributeFormat::Float3, 0 },
+	{ Semantic::Normal, AttributeFormat::Float3, 12 },
+	{ Semantic::TexCoord, AttributeFormat::Float2, 24 },
+	{ Semantic::Tangent, AttributeFormat::Float3, 32 },
+};
+
+namespace
+{
+	std::uint32_t FormatSize(AttributeFormat format)
+	{
+		switch (format)
+		{
+		case AttributeFormat::Float2: return 8;
+		case AttributeFormat::Float3: return 12;
+		case AttributeFormat::Float4: return 16;
+		}
+		return 0;
+	}
+
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// The smallest and largest of count > 0 indices of 'indexSize' bytes from 'first'.
+	void IndexRange(const std::uint8_t* indices, std::uint32_t indexSize, std::uint64_t first, std::uint64_t count,
+		std::uint32_t& minIndex, std::uint32_t& maxIndex)
+	{
+		minIndex = UINT32_MAX;
+		maxIndex = 0;
+		for (std::uint64_t i = first; i < first + count; ++i)
+		{
+			std::uint32_t index = 0;
+			std::memcpy(&index, indices + i * indexSize, indexSize);
+			minIndex = std::min(minIndex, index);
+			maxIndex = std::max(maxIndex, index);
+		}
+	}
+
+	// Moves 'from' over 'to' in one step, so that a reader finds either the old file or
+	// the whole new one.
+	bool ReplaceFile(const char* from, const char* to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(from, to) == 0;
+#endif
+	}
+
+	void ResetBounds(float boundsMin[3], float boundsMax[3])
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			boundsMin[i] = +INFINITY;
+			boundsMax[i] = -INFINITY;
+		}
+	}
+
+	void GrowBounds(float boundsMin[3], float boundsMax[3], const float p[3])
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			boundsMin[i] = std::min(boundsMin[i], p[i]);
+			boundsMax[i] = std::max(boundsMax[i], p[i]);
+		}
+	}
+
+	// The first attribute of the stream with this semantic and format, or null.
+	const Attribute* FindAttribute(const Mesh::Stream& stream, Semantic semantic, AttributeFormat format)
+	{
+		for (const Attribute& attribute : stream.Attributes)
+			if (attribute.AttributeSemantic == semantic && attribute.Format == format)
+				return &attribute;
+		return nullptr;
+	}
+
+	TangentSpace::VertexFormat StandardTangentFormat()
+	{
+		TangentSpace::VertexFormat format;
+		format.Stride = StandardVertexStride;
+		format.PositionOffset = StandardVertexLayout[0].Offset;
+		format.NormalOffset = StandardVertexLayout[1].Offset;
+		format.TexCoordOffset = StandardVertexLayout[2].Offset;
+		format.TangentOffset = StandardVertexLayout[3].Offset;
+		return format;
+	}
+
+	// Legacy text lists are split into chunks of about this many bytes.
+	const size_t LegacyChunkSize = 64 * 1024;
+
+	inline bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool IsSpace(char c)
+	{
+		return IsBlank(c) || c == '\n';
+	}
+
+	// Offsets of chunk boundaries in [begin, end), each just past a newline.
+	std::vector<size_t> SplitAtLines(const char* data, size_t begin, size_t end)
+	{
+		std::vector<size_t> bounds(1, begin);
+		size_t next = begin + LegacyChunkSize;
+		while (next < end)
+		{
+			const void* newline = std::memchr(data + next, '\n', end - next);
+			if (newline == nullptr)
+				break;
+
+			size_t boundary = (const char*)newline - data + 1;
+			bounds.push_back(boundary);
+			next = boundary + LegacyChunkSize;
+		}
+		bounds.push_back(end);
+		return bounds;
+	}
+
+	// Lines holding anything but whitespace.
+	size_t CountRecords(const char* p, const char* end)
+	{
+		size_t count = 0;
+		bool content = false;
+		for (; p < end; ++p)
+		{
+			if (*p == '\n')
+			{
+				count += content;
+				content = false;
+			}
+			else if (!IsBlank(*p))
+			{
+				content = true;
+			}
+		}
+		return count + content;
+	}
+
+	// Reads one line of exactly 'count' numbers.  Returns the position after the line's
+	// newline, or nullptr if the line is malformed.
+	template<typename T>
+	const char* ParseRecord(const char* p, const char* end, T* values, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			while (p < end && IsBlank(*p))
+				++p;
+
+			auto result = std::from_chars(p, end, values[i]);
+			if (result.ec != std::errc())
+				return nullptr;
+			p = result.ptr;
+		}
+
+		while (p < end && IsBlank(*p))
+			++p;
+
+		if (p < end && *p != '\n')
+			return nullptr;
+
+		return p < end ? p + 1 : p;
+	}
+
+	// Runs parse(chunkBegin, chunkEnd, firstRecord) for every chunk of [begin, end),
+	// after a counting pass gives each chunk the index of its first record.
+	template<typename Parse>
+	bool ParseChunks(const char* data, size_t begin, size_t end, size_t expectedRecords,
+		const Parse& parse, unsigned maxThreads)
+	{
+		std::vector<size_t> bounds = SplitAtLines(data, begin, end);
+		const size_t numChunks = bounds.size() - 1;
+
+		std::vector<size_t> first(numChunks + 1, 0);
+		Parallel::For(numChunks, 1, [&](size_t b, size_t e)
+		{
+			for (size_t c = b; c < e; ++c)
+				first[c + 1] = CountRecords(data + bounds[c], data + bounds[c + 1]);
+		}, maxThreads);
+
+		for (size_t c = 0; c < numChunks; ++c)
+			first[c + 1] += first[c];
+
+		if (first[numChunks] != expectedRecords)
+			return false;
+
+		std::atomic<bool> failed(false);
+		Parallel::For(numChunks, 1, [&](size_t b, size_t e)
+		{
+			for (size_t c = b; c < e && !failed.load(std::memory_order_relaxed); ++c)
+				if (!parse(data + bounds[c], data + bounds[c + 1], first[c]))
+					failed = true;
+		}, maxThreads);
+
+		return !failed;
+	}
+
+	// Finds 'label' at or after p and reads the unsigned number following it.
+	const char* ReadCount(const char* p, const char* end, const char* label, std::uint32_t& value)
+	{
+		const size_t length = std::strlen(label);
+		const char* found = std::search(p, end, label, label + length);
+		if (found == end)
+			return nullptr;
+
+		p = found + length;
+		while (p < end && IsSpace(*p))
+			++p;
+
+		auto result = std::from_chars(p, end, value);
+		return result.ec == std::errc() ? result.ptr : nullptr;
+	}
+
+	// Byte range between the next '{' and its '}' at or after p.
+	bool FindList(const char* data, const char* p, const char* end, size_t& listBegin, size_t& listEnd)
+	{
+		const char* open = std::find(p, end, '{');
+		if (open == end)
+			return false;
+
+		const char* close = std::find(open + 1, end, '}');
+		if (close == end)
+			return false;
+
+		listBegin = open + 1 - data;
+		listEnd = close - data;
+		return true;
+	}
+
+	bool LocateLegacyLists(MeshFile::LegacyText& text)
+	{
+		const char* data = reinterpret_cast<const char*>(text.File.Data());
+		const char* end = data + text.File.Size();
+
+		const char* p = ReadCount(data, end, "VertexCount:", text.VertexCount);
+		if (p == nullptr)
+			return false;
+
+		p = ReadCount(p, end, "TriangleCount:", text.TriangleCount);
+		if (p == nullptr || !FindList(data, p, end, text.VertexBegin, text.VertexEnd))
+			return false;
+
+		return FindList(data, data + text.VertexEnd + 1, end, text.TriangleBegin, text.TriangleEnd);
+	}
+
+	// Empty bounds are written as a zero box rather than +-infinity.
+	void FinishBounds(float boundsMin[3], float boundsMax[3])
+	{
+		if (boundsMin[0] > boundsMax[0])
+		{
+			for (int i = 0; i < 3; ++i)
+				boundsMin[i] = boundsMax[i] = 0.0f;
+		}
+	}
+}
+
+bool MeshFile::Write(const char* fileName, const Mesh& mesh)
+{
+	// Check the mesh before laying anything out.
+	for (const Mesh::Stream& stream : mesh.Streams)
+	{
+		if (stream.Attributes.size() > MaxAttributes || stream.Stride == 0 ||
+			stream.Data.size() != (size_t)mesh.VertexCount * stream.Stride)
+			return false;
+
+		for (const Attribute& attribute : stream.Attributes)
+			if (attribute.Offset + FormatSize(attribute.Format) > stream.Stride)
+				return false;
+	}
+
+	std::uint32_t maxIndex = 0;
+	for (const Mesh::Submesh& submesh : mesh.Submeshes)
+	{
+		if (submesh.Name.size() >= MaxNameLength ||
+			(std::uint64_t)submesh.StartIndex + submesh.IndexCount > mesh.Indices.size())
+			return false;
+
+		for (std::uint32_t i = 0; i < submesh.IndexCount; ++i)
+		{
+			std::uint32_t index = mesh.Indices[submesh.StartIndex + i];
+			std::int64_t vertex = (std::int64_t)index + submesh.BaseVertex;
+			if (vertex < 0 || vertex >= mesh.VertexCount)
+				return false;
+		}
+	}
+
+	for (std::uint32_t index : mesh.Indices)
+		maxIndex = std::max(maxIndex, index);
+
+	// Positions for the bounds come from the first Float3 Position attribute.
+	const std::uint8_t* positions = nullptr;
+	std::uint32_t positionStride = 0;
+	for (const Mesh::Stream& stream : mesh.Streams)
+	{
+		for (const Attribute& attribute : stream.Attributes)
+		{
+			if (positions == nullptr && attribute.AttributeSemantic == Semantic::Position &&
+				attribute.Format == AttributeFormat::Float3)
+			{
+				positions = stream.Data.data() + attribute.Offset;
+				positionStride = stream.Stride;
+			}
+		}
+	}
+
+	auto position = [&](std::uint32_t vertex, float p[3])
+	{
+		std::memcpy(p, positions + (size_t)vertex * positionStride, 3 * sizeof(float));
+	};
+
+	// Layout: header, stream table, submesh table, then aligned index and vertex blocks.
+	FileHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.VertexCount = mesh.VertexCount;
+	header.IndexCount = (std::uint32_t)mesh.Indices.size();
+	header.IndexSize = maxIndex <= 0xFFFF ? 2 : 4;
+	header.StreamCount = (std::uint32_t)mesh.Streams.size();
+	header.SubmeshCount = (std::uint32_t)mesh.Submeshes.size();
+	header.StreamTableOffset = sizeof(FileHeader);
+	header.SubmeshTableOffset = header.StreamTableOffset + header.StreamCount * sizeof(StreamDesc);
+	header.IndexOffset = AlignUp(header.SubmeshTableOffset + header.SubmeshCount * sizeof(SubmeshDesc), DataAlignment);
+
+	std::uint64_t offset = AlignUp(header.IndexOffset + (std::uint64_t)header.IndexCount * header.IndexSize, DataAlignment);
+
+	std::vector<StreamDesc> streams(mesh.Streams.size());
+	for (size_t s = 0; s < mesh.Streams.size(); ++s)
+	{
+		const Mesh::Stream& stream = mesh.Streams[s];
+		StreamDesc& desc = streams[s];
+		std::memset(&desc, 0, sizeof(desc));
+		desc.Stride = stream.Stride;
+		desc.AttributeCount = (std::uint32_t)stream.Attributes.size();
+		std::copy(stream.Attributes.begin(), stream.Attributes.end(), desc.Attributes);
+		desc.Offset = offset;
+		desc.Size = stream.Data.size();
+		offset = AlignUp(offset + desc.Size, DataAlignment);
+	}
+	header.FileSize = offset;
+
+	ResetBounds(header.BoundsMin, header.BoundsMax);
+	if (positions != nullptr)
+	{
+		float p[3];
+		for (std::uint32_t v = 0; v < mesh.VertexCount; ++v)
+		{
+			position(v, p);
+			GrowBounds(header.BoundsMin, header.BoundsMax, p);
+		}
+	}
+	FinishBounds(header.BoundsMin, header.BoundsMax);
+
+	std::vector<SubmeshDesc> submeshes(mesh.Submeshes.size());
+	for (size_t s = 0; s < mesh.Submeshes.size(); ++s)
+	{
+		const Mesh::Submesh& submesh = mesh.Submeshes[s];
+		SubmeshDesc& desc = submeshes[s];
+		std::memset(&desc, 0, sizeof(desc));
+		std::memcpy(desc.Name, submesh.Name.c_str(), submesh.Name.size());
+		desc.IndexCount = submesh.IndexCount;
+		desc.StartIndex = submesh.StartIndex;
+		desc.BaseVertex = submesh.BaseVertex;
+
+		ResetBounds(desc.BoundsMin, desc.BoundsMax);
+		if (positions != nullptr)
+		{
+			float p[3];
+			for (std::uint32_t i = 0; i < submesh.IndexCount; ++i)
+			{
+				position(mesh.Indices[submesh.StartIndex + i] + submesh.BaseVertex, p);
+				GrowBounds(desc.BoundsMin, desc.BoundsMax, p);
+			}
+		}
+		FinishBounds(desc.BoundsMin, desc.BoundsMax);
+	}
+
+	// Build the image in memory and write it in one call.
+	std::vector<std::uint8_t> image((size_t)header.FileSize, 0);
+	std::memcpy(image.data(), &header, sizeof(header));
+	if (!streams.empty())
+		std::memcpy(image.data() + header.StreamTableOffset, streams.data(), streams.size() * sizeof(StreamDesc));
+	if (!submeshes.empty())
+		std::memcpy(image.data() + header.SubmeshTableOffset, submeshes.data(), submeshes.size() * sizeof(SubmeshDesc));
+
+	std::uint8_t* indices = image.data() + header.IndexOffset;
+	for (std::uint32_t i = 0; i < header.IndexCount; ++i)
+	{
+		if (header.IndexSize == 2)
+		{
+			std::uint16_t index = (std::uint16_t)mesh.Indices[i];
+			std::memcpy(indices + i * 2, &index, 2);
+		}
+		else
+		{
+			std::memcpy(indices + i * 4, &mesh.Indices[i], 4);
+		}
+	}
+
+	for (size_t s = 0; s < mesh.Streams.size(); ++s)
+		if (!mesh.Streams[s].Data.empty())
+			std::memcpy(image.data() + streams[s].Offset, mesh.Streams[s].Data.data(), mesh.Streams[s].Data.size());
+
+	// Written next to the destination and moved over it, so an interrupted write never
+	// leaves a truncated file under the real name.
+	const std::string tempName = std::string(fileName) + ".tmp";
+	FILE* file = std::fopen(tempName.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	bool written = std::fwrite(image.data(), 1, image.size(), file) == image.size();
+	written = std::fclose(file) == 0 && written;
+	if (!written || !ReplaceFile(tempName.c_str(), fileName))
+	{
+		std::remove(tempName.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::GenerateTangents(Mesh& mesh, unsigned maxThreads)
+{
+	for (Mesh::Stream& stream : mesh.Streams)
+	{
+		const Attribute* position = FindAttribute(stream, Semantic::Position, AttributeFormat::Float3);
+		const Attribute* normal = FindAttribute(stream, Semantic::Normal, AttributeFormat::Float3);
+		const Attribute* texCoord = FindAttribute(stream, Semantic::TexCoord, AttributeFormat::Float2);
+		const Attribute* tangent = FindAttribute(stream, Semantic::Tangent, AttributeFormat::Float3);
+		const Attribute* tangentSign = FindAttribute(stream, Semantic::Tangent, AttributeFormat::Float4);
+		if (tangent == nullptr)
+			tangent = tangentSign;
+
+		if (position == nullptr || normal == nullptr || texCoord == nullptr || tangent == nullptr ||
+			stream.Data.size() != (size_t)mesh.VertexCount * stream.Stride)
+			continue;
+
+		// The generator wants absolute vertex numbers, so fold in each submesh's base.
+		std::vector<std::uint32_t> indices;
+		for (const Mesh::Submesh& submesh : mesh.Submeshes)
+		{
+			if ((std::uint64_t)submesh.StartIndex + submesh.IndexCount > mesh.Indices.size())
+				return false;
+
+			const std::uint32_t count = submesh.IndexCount - submesh.IndexCount % 3;
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				std::int64_t vertex = (std::int64_t)mesh.Indices[submesh.StartIndex + i] + submesh.BaseVertex;
+				if (vertex < 0 || vertex >= mesh.VertexCount)
+					return false;
+				indices.push_back((std::uint32_t)vertex);
+			}
+		}
+
+		TangentSpace::VertexFormat format;
+		format.Stride = stream.Stride;
+		format.PositionOffset = position->Offset;
+		format.NormalOffset = normal->Offset;
+		format.TexCoordOffset = texCoord->Offset;
+		format.TangentOffset = tangent->Offset;
+
+		// A Float4 tangent carries the bitangent sign in w.
+		std::vector<float> signs;
+		if (tangent->Format == AttributeFormat::Float4)
+			signs.resize(mesh.VertexCount);
+
+		TangentSpace::Generate(stream.Data.data(), mesh.VertexCount, format, indices.data(), indices.size(),
+			signs.empty() ? nullptr : signs.data(), maxThreads);
+
+		for (size_t v = 0; v < signs.size(); ++v)
+			std::memcpy(stream.Data.data() + v * stream.Stride + tangent->Offset + 12, &signs[v], sizeof(float));
+
+		return true;
+	}
+
+	return false;
+}
+
+void MeshFile::ReadMesh(const View& view, Mesh& mesh)
+{
+	const FileHeader& header = view.Header();
+
+	mesh = Mesh();
+	mesh.VertexCount = header.VertexCount;
+
+	for (std::uint32_t s = 0; s < header.StreamCount; ++s)
+	{
+		const StreamDesc& desc = view.Stream(s);
+		const std::uint8_t* data = static_cast<const std::uint8_t*>(view.StreamData(s));
+
+		Mesh::Stream stream;
+		stream.Attributes.assign(desc.Attributes, desc.Attributes + desc.AttributeCount);
+		stream.Stride = desc.Stride;
+		stream.Data.assign(data, data + desc.Size);
+		mesh.Streams.push_back(std::move(stream));
+	}
+
+	mesh.Indices.resize(header.IndexCount);
+	if (header.IndexSize == 2)
+	{
+		const std::uint16_t* indices = static_cast<const std::uint16_t*>(view.IndexData());
+		std::copy(indices, indices + header.IndexCount, mesh.Indices.begin());
+	}
+	else
+	{
+		std::memcpy(mesh.Indices.data(), view.IndexData(), (size_t)view.IndexDataSize());
+	}
+
+	for (std::uint32_t i = 0; i < header.SubmeshCount; ++i)
+	{
+		const SubmeshDesc& desc = view.Submesh(i);
+
+		Mesh::Submesh submesh;
+		submesh.Name = desc.Name;
+		submesh.IndexCount = desc.IndexCount;
+		submesh.StartIndex = desc.StartIndex;
+		submesh.BaseVertex = desc.BaseVertex;
+		mesh.Submeshes.push_back(submesh);
+	}
+}
+
+bool MeshFile::OpenLegacyText(const wchar_t* fileName, LegacyText& text)
+{
+	text = LegacyText();
+	return text.File.Open(fileName) && text.File.Size() > 0 && LocateLegacyLists(text);
+}
+
+bool MeshFile::OpenLegacyText(const char* fileName, LegacyText& text)
+{
+	text = LegacyText();
+	return text.File.Open(fileName) && text.File.Size() > 0 && LocateLegacyLists(text);
+}
+
+bool MeshFile::ParseLegacyText(const LegacyText& text, void* vertices, std::uint32_t* indices, unsigned maxThreads)
+{
+	const char* data = reinterpret_cast<const char*>(text.File.Data());
+	std::uint8_t* vertexBytes = static_cast<std::uint8_t*>(vertices);
+
+	bool parsed = ParseChunks(data, text.VertexBegin, text.VertexEnd, text.VertexCount,
+		[&](const char* p, const char* end, size_t vertex)
+	{
+		while (p < end)
+		{
+			if (IsSpace(*p))
+			{
+				++p;
+				continue;
+			}
+
+			float v[11] = {};
+			p = ParseRecord(p, end, v, 6);
+			if (p == nullptr)
+				return false;
+
+			std::memcpy(vertexBytes + vertex * StandardVertexStride, v, sizeof(v));
+			++vertex;
+		}
+		return true;
+	}, maxThreads);
+
+	if (!parsed)
+		return false;
+
+	const std::uint32_t vertexCount = text.VertexCount;
+	parsed = ParseChunks(data, text.TriangleBegin, text.TriangleEnd, text.TriangleCount,
+		[&](const char* p, const char* end, size_t triangle)
+	{
+		while (p < end)
+		{
+			if (IsSpace(*p))
+			{
+				++p;
+				continue;
+			}
+
+			std::uint32_t* tri = indices + triangle * 3;
+			p = ParseRecord(p, end, tri, 3);
+			if (p == nullptr || tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+				return false;
+
+			++triangle;
+		}
+		return true;
+	}, maxThreads);
+
+	if (!parsed)
+		return false;
+
+	// The models have no texture coordinates, so every vertex ends up with the
+	// perpendicular fallback; going through the generator keeps one code path for
+	// models that gain them.
+	TangentSpace::Generate(vertices, vertexCount, StandardTangentFormat(), indices, 3 * (size_t)text.TriangleCount,
+		nullptr, maxThreads);
+	return true;
+}
+
+bool MeshFile::ImportLegacyText(const char* fileName, const std::string& submeshName, Mesh& mesh)
+{
+	LegacyText text;
+	if (!OpenLegacyText(fileName, text))
+		return false;
+
+	Mesh::Stream stream;
+	stream.Attributes.assign(std::begin(StandardVertexLayout), std::end(StandardVertexLayout));
+	stream.Stride = StandardVertexStride;
+	stream.Data.resize((size_t)text.VertexCount * StandardVertexStride);
+
+	std::vector<std::uint32_t> indices(3 * (size_t)text.TriangleCount);
+	if (!ParseLegacyText(text, stream.Data.data(), indices.data()))
+		return false;
+
+	mesh = Mesh();
+	mesh.VertexCount = text.VertexCount;
+	mesh.Streams.push_back(std::move(stream));
+	mesh.Indices = std::move(indices);
+
+	Mesh::Submesh submesh;
+	submesh.Name = submeshName;
+	submesh.IndexCount = (std::uint32_t)mesh.Indices.size();
+	mesh.Submeshes.push_back(submesh);
+
+	return true;
+}
+
+bool View::Open(const wchar_t* fileName)
+{
+	Close();
+	if (mFile.Open(fileName) && Validate())
+		return true;
+
+	Close();
+	return false;
+}
+
+bool View::Open(const char* fileName)
+{
+	Close();
+	if (mFile.Open(fileName) && Validate())
+		return true;
+
+	Close();
+	return false;
+}
+
+void View::Close()
+{
+	mFile.Close();
+	mHeader = nullptr;
+	mStreams = nullptr;
+	mSubmeshes = nullptr;
+}
+
+bool View::Validate()
+{
+	const std::uint64_t fileSize = mFile.Size();
+	auto inFile = [&](std::uint64_t offset, std::uint64_t size)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	};
+
+	if (fileSize < sizeof(FileHeader))
+		return false;
+
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(mFile.Data());
+	if (header->Magic != Magic || header->Version != Version || header->FileSize != fileSize ||
+		(header->IndexSize != 2 && header->IndexSize != 4))
+		return false;
+
+	// The tables are read in place, so they must be aligned for their members.
+	if (header->StreamTableOffset % 8 != 0 || header->SubmeshTableOffset % 8 != 0 ||
+		!inFile(header->StreamTableOffset, (std::uint64_t)header->StreamCount * sizeof(StreamDesc)) ||
+		!inFile(header->SubmeshTableOffset, (std::uint64_t)header->SubmeshCount * sizeof(SubmeshDesc)) ||
+		header->IndexOffset % DataAlignment != 0 ||
+		!inFile(header->IndexOffset, (std::uint64_t)header->IndexCount * header->IndexSize))
+		return false;
+
+	const StreamDesc* streams = reinterpret_cast<const StreamDesc*>(mFile.Data() + header->StreamTableOffset);
+	for (std::uint32_t s = 0; s < header->StreamCount; ++s)
+	{
+		const StreamDesc& stream = streams[s];
+		if (stream.AttributeCount > MaxAttributes || stream.Stride == 0 ||
+			stream.Size != (std::uint64_t)header->VertexCount * stream.Stride ||
+			stream.Offset % DataAlignment != 0 || !inFile(stream.Offset, stream.Size))
+			return false;
+
+		for (std::uint32_t a = 0; a < stream.AttributeCount; ++a)
+		{
+			std::uint32_t size = FormatSize(stream.Attributes[a].Format);
+			if (size == 0 || stream.Attributes[a].Offset + size > stream.Stride)
+				return false;
+		}
+	}
+
+	// Every index must name a vertex, also once its submesh's BaseVertex is added, or
+	// drawing the mesh reads outside the vertex buffer.
+	const std::uint8_t* indices = mFile.Data() + header->IndexOffset;
+	std::uint32_t minIndex = 0;
+	std::uint32_t maxIndex = 0;
+	if (header->IndexCount > 0)
+	{
+		IndexRange(indices, header->IndexSize, 0, header->IndexCount, minIndex, maxIndex);
+		if (maxIndex >= header->VertexCount)
+			return false;
+	}
+
+	const SubmeshDesc* submeshes = reinterpret_cast<const SubmeshDesc*>(mFile.Data() + header->SubmeshTableOffset);
+	for (std::uint32_t s = 0; s < header->SubmeshCount; ++s)
+	{
+		const SubmeshDesc& submesh = submeshes[s];
+		if (std::memchr(submesh.Name, 0, MaxNameLength) == nullptr ||
+			(std::uint64_t)submesh.StartIndex + submesh.IndexCount > header->IndexCount)
+			return false;
+
+		if (submesh.IndexCount > 0)
+		{
+			IndexRange(indices, header->IndexSize, submesh.StartIndex, submesh.IndexCount, minIndex, maxIndex);
+			if ((std::int64_t)minIndex + submesh.BaseVertex < 0 ||
+				(std::int64_t)maxIndex + submesh.BaseVertex >= (std::int64_t)header->VertexCount)
+				return false;
+		}
+	}
+
+	mHeader = header;
+	mStreams = streams;
+	mSubmeshes = submeshes;
+	return true;
+}
+
+bool View::HasLayout(std::uint32_t stream, const Attribute* attributes, std::uint32_t count, std::uint32_t stride)const
+{
+	if (mHeader == nullptr || stream >= mHeader->StreamCount)
+		return false;
+
+	const StreamDesc& desc = mStreams[stream];
+	if (desc.Stride != stride || desc.AttributeCount != count)
+		return false;
+
+	for (std::uint32_t a = 0; a < count; ++a)
+	{
+		if (desc.Attributes[a].AttributeSemantic != attributes[a].AttributeSemantic ||
+			desc.Attributes[a].Format != attributes[a].Format ||
+			desc.Attributes[a].Offset != attributes[a].Offset)
+			return false;
+	}
+
+	return true;
+}
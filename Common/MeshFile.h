@@ -0,0 +1,203 @@
+//***************************************************************************************
+// MeshFile.h
+//
+// Binary mesh container that is used straight from a memory-mapped file.
+//
+// A file holds a header, a table of vertex streams, a table of submeshes, then the
+// index data and one interleaved buffer per stream.  Every data block starts on a
+// DataAlignment boundary, so pointers into the mapping can be handed to the upload
+// step as they are.  Indices are 16-bit when every vertex can be addressed with 16
+// bits, 32-bit otherwise.  The header and each submesh carry axis-aligned bounds
+// computed when the file was written.  All values are little-endian.
+//
+// Write() builds a file from a Mesh; View opens one and validates it.
+// OpenLegacyText()/ParseLegacyText() read the text models shipped with the book
+// samples ("VertexCount: n", "TriangleCount: n", a vertex list of positions and
+// normals, a triangle list) into the Pos/Normal/TexC/TangentU layout of the sample
+// Vertex.  The file is mapped, each list is split into chunks at line boundaries, and
+// the chunks are parsed with std::from_chars on all cores straight into the caller's
+// arrays.  ImportLegacyText() wraps the two for the converter.  GenerateTangents()
+// recomputes the tangents of a mesh with texture coordinates, and ReadMesh() turns a
+// View back into a Mesh so the converter can do that to existing binaries.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace MeshFile
+{
+	const std::uint32_t Magic = 0x3148534D;	// "MSH1"
+	const std::uint32_t Version = 1;
+	const std::uint32_t DataAlignment = 256;
+	const std::uint32_t MaxAttributes = 8;
+	const std::uint32_t MaxNameLength = 32;
+
+	enum class Semantic : std::uint16_t
+	{
+		Position,
+		Normal,
+		TexCoord,
+		Tangent,
+		Color
+	};
+
+	enum class AttributeFormat : std::uint16_t
+	{
+		Float2,
+		Float3,
+		Float4
+	};
+
+	struct Attribute
+	{
+		Semantic AttributeSemantic;
+		AttributeFormat Format;
+		std::uint32_t Offset;
+	};
+
+	struct FileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint32_t VertexCount;
+		std::uint32_t IndexCount;
+		std::uint32_t IndexSize;		// 2 or 4
+		std::uint32_t StreamCount;
+		std::uint32_t SubmeshCount;
+		std::uint32_t Reserved;
+		float BoundsMin[3];
+		float BoundsMax[3];
+		std::uint64_t StreamTableOffset;
+		std::uint64_t SubmeshTableOffset;
+		std::uint64_t IndexOffset;
+		std::uint64_t FileSize;
+	};
+
+	struct StreamDesc
+	{
+		std::uint32_t Stride;
+		std::uint32_t AttributeCount;
+		Attribute Attributes[MaxAttributes];
+		std::uint64_t Offset;
+		std::uint64_t Size;
+	};
+
+	struct SubmeshDesc
+	{
+		char Name[MaxNameLength];	// zero-terminated
+		std::uint32_t IndexCount;
+		std::uint32_t StartIndex;
+		std::int32_t BaseVertex;
+		std::uint32_t Reserved;
+		float BoundsMin[3];
+		float BoundsMax[3];
+	};
+
+	static_assert(sizeof(Attribute) == 8, "MeshFile::Attribute layout");
+	static_assert(sizeof(FileHeader) == 88, "MeshFile::FileHeader layout");
+	static_assert(sizeof(StreamDesc) == 88, "MeshFile::StreamDesc layout");
+	static_assert(sizeof(SubmeshDesc) == 72, "MeshFile::SubmeshDesc layout");
+
+	// In-memory mesh for writing.  Bounds are computed by Write() from the first
+	// Float3 Position attribute.
+	struct Mesh
+	{
+		struct Stream
+		{
+			std::vector<Attribute> Attributes;
+			std::uint32_t Stride = 0;
+			std::vector<std::uint8_t> Data;
+		};
+
+		struct Submesh
+		{
+			std::string Name;
+			std::uint32_t IndexCount = 0;
+			std::uint32_t StartIndex = 0;
+			std::int32_t BaseVertex = 0;
+		};
+
+		std::uint32_t VertexCount = 0;
+		std::vector<Stream> Streams;
+		std::vector<std::uint32_t> Indices;
+		std::vector<Submesh> Submeshes;
+	};
+
+	// The Pos/Normal/TexC/TangentU layout (44 bytes) of the samples' Vertex struct.
+	extern const Attribute StandardVertexLayout[4];
+	const std::uint32_t StandardVertexStride = 44;
+
+	bool Write(const char* fileName, const Mesh& mesh);
+
+	// Regenerates the tangents of the first stream with Float3 Position, Float3 Normal,
+	// Float2 TexCoord and Float3 or Float4 Tangent attributes from the triangles of all
+	// submeshes (see TangentSpace.h); a Float4 tangent gets the bitangent sign in w.
+	// Returns false if no stream has them or an index is out of range.
+	bool GenerateTangents(Mesh& mesh, unsigned maxThreads = 0);
+
+	// A legacy text model mapped into memory, with its counts read and its vertex and
+	// triangle lists located (byte ranges inside the braces).
+	struct LegacyText
+	{
+		MappedFile File;
+		std::uint32_t VertexCount = 0;
+		std::uint32_t TriangleCount = 0;
+		size_t VertexBegin = 0;
+		size_t VertexEnd = 0;
+		size_t TriangleBegin = 0;
+		size_t TriangleEnd = 0;
+	};
+
+	bool OpenLegacyText(const wchar_t* fileName, LegacyText& text);
+	bool OpenLegacyText(const char* fileName, LegacyText& text);
+
+	// Writes text.VertexCount vertices in StandardVertexLayout (zero texture
+	// coordinates, tangents from TangentSpace::Generate) and 3 * text.TriangleCount
+	// indices.  Each line must hold one vertex or one triangle.  Returns false on
+	// malformed numbers, count mismatches or out-of-range indices.  maxThreads = 0 uses
+	// every core.
+	bool ParseLegacyText(const LegacyText& text, void* vertices, std::uint32_t* indices, unsigned maxThreads = 0);
+
+	// Returns false if the file can not be read or is not in the expected format.  A
+	// single submesh named submeshName covers the whole model.
+	bool ImportLegacyText(const char* fileName, const std::string& submeshName, Mesh& mesh);
+
+	class View
+	{
+	public:
+		// Maps the file and checks the header, tables, block ranges and that every index
+		// names a vertex.
+		bool Open(const wchar_t* fileName);
+		bool Open(const char* fileName);
+		void Close();
+
+		const FileHeader& Header()const { return *mHeader; }
+		const StreamDesc& Stream(std::uint32_t index)const { return mStreams[index]; }
+		const SubmeshDesc& Submesh(std::uint32_t index)const { return mSubmeshes[index]; }
+
+		const void* StreamData(std::uint32_t index)const { return mFile.Data() + mStreams[index].Offset; }
+		const void* IndexData()const { return mFile.Data() + mHeader->IndexOffset; }
+		std::uint64_t IndexDataSize()const { return (std::uint64_t)mHeader->IndexCount * mHeader->IndexSize; }
+
+		// True if the stream has exactly these attributes and stride.
+		bool HasLayout(std::uint32_t stream, const Attribute* attributes, std::uint32_t count, std::uint32_t stride)const;
+
+	private:
+		bool Validate();
+
+	private:
+		MappedFile mFile;
+		const FileHeader* mHeader = nullptr;
+		const StreamDesc* mStreams = nullptr;
+		const SubmeshDesc* mSubmeshes = nullptr;
+	};
+
+	// Copies an opened file back into a Mesh, to be changed and written again.
+	void ReadMesh(const View& view, Mesh& mesh);
+}
@@ -0,0 +1,403 @@
+//***************************************************************************************
+// MipGenerator.cpp
+//***************************************************************************************
+
+#include "MipGenerator.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MIP_SSE 1
+#include <emmintrin.h>
+#endif
+
+using std::uint8_t;
+
+namespace MipGenerator
+{
+namespace
+{
+	// Float RGBA image, 4 floats per texel, rows packed.
+	struct FloatImage
+	{
+		size_t Width = 0;
+		size_t Height = 0;
+		std::vector<float> Texels;
+
+		void Resize(size_t width, size_t height)
+		{
+			Width = width;
+			Height = height;
+			Texels.resize(width * height * 4);
+		}
+
+		float* Row(size_t y) { return Texels.data() + y * Width * 4; }
+		const float* Row(size_t y)const { return Texels.data() + y * Width * 4; }
+	};
+
+	// Source taps of every destination texel along one axis.
+	struct FilterTable
+	{
+		std::vector<size_t> First;		// Per destination texel, offset into Index and Weight.
+		std::vector<size_t> Count;
+		std::vector<size_t> Index;		// Source texel, already clamped to the edge.
+		std::vector<float> Weight;
+	};
+
+	// Modified Bessel function of the first kind, order 0.
+	double BesselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			double t = x / (2.0 * k);
+			term *= t * t;
+			sum += term;
+			if (term < sum * 1e-12)
+				break;
+		}
+		return sum;
+	}
+
+	const double gKaiserRadius = 3.0;
+	const double gKaiserAlpha = 4.0;
+
+	double KaiserSinc(double t)
+	{
+		const double pi = 3.14159265358979323846;
+		if (std::fabs(t) >= gKaiserRadius)
+			return 0.0;
+
+		double sinc = (t == 0.0) ? 1.0 : std::sin(pi * t) / (pi * t);
+		double r = t / gKaiserRadius;
+		return sinc * BesselI0(gKaiserAlpha * std::sqrt(1.0 - r * r)) / BesselI0(gKaiserAlpha);
+	}
+
+	FilterTable BuildFilterTable(size_t srcSize, size_t dstSize, Filter filter)
+	{
+		FilterTable table;
+		table.First.resize(dstSize);
+		table.Count.resize(dstSize);
+
+		const double scale = double(srcSize) / double(dstSize);
+		std::vector<double> weights;
+
+		for (size_t x = 0; x < dstSize; ++x)
+		{
+			table.First[x] = table.Index.size();
+
+			// Footprint of the destination texel in source texel units.
+			const double lo = x * scale;
+			const double hi = (x + 1) * scale;
+
+			long long first, last;
+			weights.clear();
+
+			if (filter == Filter::Box || srcSize == dstSize)
+			{
+				first = (long long)std::floor(lo);
+				last = (long long)std::ceil(hi) - 1;
+				for (long long i = first; i <= last; ++i)
+					weights.push_back(std::min<double>(hi, double(i + 1)) - std::max<double>(lo, double(i)));
+			}
+			else
+			{
+				const double center = (lo + hi) * 0.5;
+				first = (long long)std::floor(center - gKaiserRadius * scale);
+				last = (long long)std::ceil(center + gKaiserRadius * scale);
+				for (long long i = first; i <= last; ++i)
+					weights.push_back(KaiserSinc((i + 0.5 - center) / scale));
+			}
+
+			double sum = 0.0;
+			for (double w : weights)
+				sum += w;
+
+			for (long long i = first; i <= last; ++i)
+			{
+				double w = weights[size_t(i - first)];
+				if (w == 0.0)
+					continue;
+
+				long long clamped = std::min<long long>(std::max<long long>(i, 0), (long long)srcSize - 1);
+				table.Index.push_back(size_t(clamped));
+				table.Weight.push_back(float(w / sum));
+			}
+			table.Count[x] = table.Index.size() - table.First[x];
+		}
+		return table;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// sRGB conversion.
+	//-----------------------------------------------------------------------------------
+	struct SrgbTables
+	{
+		float ToLinear[256];
+
+		// Linear value halfway between consecutive sRGB codes; a linear value maps to
+		// the number of thresholds below it.
+		float Thresholds[256];
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; ++i)
+				ToLinear[i] = float(Decode(i / 255.0));
+
+			for (int i = 0; i < 255; ++i)
+				Thresholds[i] = float(Decode((i + 0.5) / 255.0));
+			Thresholds[255] = 2.0f;
+		}
+
+		static double Decode(double c)
+		{
+			return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+		}
+
+		uint8_t FromLinear(float v)const
+		{
+			// Branch-free binary search over the 255 thresholds.
+			int code = 0;
+			for (int step = 128; step > 0; step >>= 1)
+				code += (v >= Thresholds[code + step - 1]) ? step : 0;
+			return uint8_t(code);
+		}
+	};
+
+	const SrgbTables& GetSrgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	uint8_t ToUnorm8(float v)
+	{
+		v = std::min(std::max(v, 0.0f), 1.0f);
+		return uint8_t(v * 255.0f + 0.5f);
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Filtering passes.
+	//-----------------------------------------------------------------------------------
+
+	// Resamples each row of src to table.First.size() texels.
+	void FilterRows(const FloatImage& src, FloatImage& dst, const FilterTable& table, unsigned maxThreads)
+	{
+		Parallel::For(src.Height, 16, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; ++y)
+			{
+				const float* in = src.Row(y);
+				float* out = dst.Row(y);
+				for (size_t x = 0; x < dst.Width; ++x)
+				{
+					const size_t first = table.First[x];
+					const size_t count = table.Count[x];
+#if defined(MIP_SSE)
+					__m128 sum = _mm_setzero_ps();
+					for (size_t t = 0; t < count; ++t)
+					{
+						__m128 texel = _mm_loadu_ps(in + table.Index[first + t] * 4);
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(table.Weight[first + t]), texel));
+					}
+					_mm_storeu_ps(out + x * 4, sum);
+#else
+					float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (size_t t = 0; t < count; ++t)
+					{
+						const float* texel = in + table.Index[first + t] * 4;
+						const float w = table.Weight[first + t];
+						for (int c = 0; c < 4; ++c)
+							sum[c] += w * texel[c];
+					}
+					for (int c = 0; c < 4; ++c)
+						out[x * 4 + c] = sum[c];
+#endif
+				}
+			}
+		}, maxThreads);
+	}
+
+	// Resamples each column of src to table.First.size() texels, a whole row at a time.
+	void FilterColumns(const FloatImage& src, FloatImage& dst, const FilterTable& table, unsigned maxThreads)
+	{
+		const size_t rowFloats = src.Width * 4;
+
+		Parallel::For(dst.Height, 8, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; ++y)
+			{
+				float* out = dst.Row(y);
+				std::fill(out, out + rowFloats, 0.0f);
+
+				for (size_t t = 0; t < table.Count[y]; ++t)
+				{
+					const float* in = src.Row(table.Index[table.First[y] + t]);
+					const float w = table.Weight[table.First[y] + t];
+
+					size_t i = 0;
+#if defined(MIP_SSE)
+					const __m128 weight = _mm_set1_ps(w);
+					for (; i + 16 <= rowFloats; i += 16)
+					{
+						_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(weight, _mm_loadu_ps(in + i))));
+						_mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(weight, _mm_loadu_ps(in + i + 4))));
+						_mm_storeu_ps(out + i + 8, _mm_add_ps(_mm_loadu_ps(out + i + 8), _mm_mul_ps(weight, _mm_loadu_ps(in + i + 8))));
+						_mm_storeu_ps(out + i + 12, _mm_add_ps(_mm_loadu_ps(out + i + 12), _mm_mul_ps(weight, _mm_loadu_ps(in + i + 12))));
+					}
+					for (; i < rowFloats; i += 4)
+						_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(weight, _mm_loadu_ps(in + i))));
+#else
+					for (; i < rowFloats; ++i)
+						out[i] += w * in[i];
+#endif
+				}
+			}
+		}, maxThreads);
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Conversion to and from 8 bits.
+	//-----------------------------------------------------------------------------------
+	void LoadSource(const uint8_t* pixels, size_t rowPitch, FloatImage& image, const Options& options, unsigned maxThreads)
+	{
+		const SrgbTables& srgb = GetSrgbTables();
+		const bool isSrgb = (options.Flags & Srgb) && !(options.Flags & NormalMap);
+		const bool isNormal = (options.Flags & NormalMap) != 0;
+
+		Parallel::For(image.Height, 32, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; ++y)
+			{
+				const uint8_t* in = pixels + y * rowPitch;
+				float* out = image.Row(y);
+				for (size_t i = 0; i < image.Width * 4; ++i)
+				{
+					const bool color = (i & 3) != 3;
+					if (color && isSrgb)
+						out[i] = srgb.ToLinear[in[i]];
+					else if (color && isNormal)
+						out[i] = in[i] * (2.0f / 255.0f) - 1.0f;
+					else
+						out[i] = in[i] * (1.0f / 255.0f);
+				}
+			}
+		}, maxThreads);
+	}
+
+	float AlphaCoverage(const FloatImage& image, float reference, float scale)
+	{
+		size_t covered = 0;
+		const size_t count = image.Width * image.Height;
+		for (size_t i = 0; i < count; ++i)
+			covered += (image.Texels[i * 4 + 3] * scale > reference) ? 1 : 0;
+		return float(covered) / float(count);
+	}
+
+	// Alpha scale that makes the level's coverage closest to 'target'.
+	float FindCoverageScale(const FloatImage& image, float reference, float target)
+	{
+		float lo = 0.0f, hi = 4.0f;
+		for (int i = 0; i < 12; ++i)
+		{
+			float mid = (lo + hi) * 0.5f;
+			if (AlphaCoverage(image, reference, mid) < target)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		return (lo + hi) * 0.5f;
+	}
+
+	void StoreLevel(const FloatImage& image, const Image& dst, const Options& options, float alphaScale, unsigned maxThreads)
+	{
+		const SrgbTables& srgb = GetSrgbTables();
+		const bool isSrgb = (options.Flags & Srgb) && !(options.Flags & NormalMap);
+		const bool isNormal = (options.Flags & NormalMap) != 0;
+
+		Parallel::For(image.Height, 32, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; ++y)
+			{
+				const float* in = image.Row(y);
+				uint8_t* out = dst.Pixels + y * dst.RowPitch;
+				for (size_t x = 0; x < image.Width; ++x, in += 4, out += 4)
+				{
+					if (isNormal)
+					{
+						float length = std::sqrt(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+						float s = length > 1e-6f ? 1.0f / length : 0.0f;
+						for (int c = 0; c < 3; ++c)
+							out[c] = ToUnorm8(in[c] * s * 0.5f + 0.5f);
+					}
+					else if (isSrgb)
+					{
+						for (int c = 0; c < 3; ++c)
+							out[c] = srgb.FromLinear(in[c]);
+					}
+					else
+					{
+						for (int c = 0; c < 3; ++c)
+							out[c] = ToUnorm8(in[c]);
+					}
+					out[3] = ToUnorm8(in[3] * alphaScale);
+				}
+			}
+		}, maxThreads);
+	}
+}
+
+unsigned CountMips(size_t width, size_t height)
+{
+	unsigned count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max<size_t>(width >> 1, 1);
+		height = std::max<size_t>(height >> 1, 1);
+		++count;
+	}
+	return count;
+}
+
+void Generate(const uint8_t* pixels, size_t width, size_t height, size_t rowPitch,
+	const Image* mips, unsigned numMips, const Options& options, unsigned maxThreads)
+{
+	if (numMips == 0 || width == 0 || height == 0)
+		return;
+
+	FloatImage current, rows, next;
+	current.Resize(width, height);
+	LoadSource(pixels, rowPitch, current, options, maxThreads);
+
+	const bool preserveCoverage = (options.Flags & PreserveAlphaCoverage) != 0;
+	const float targetCoverage = preserveCoverage ? AlphaCoverage(current, options.AlphaReference, 1.0f) : 0.0f;
+
+	for (unsigned level = 0; level < numMips; ++level)
+	{
+		const size_t dstWidth = std::max<size_t>(current.Width >> 1, 1);
+		const size_t dstHeight = std::max<size_t>(current.Height >> 1, 1);
+
+		const FilterTable horizontal = BuildFilterTable(current.Width, dstWidth, options.MipFilter);
+		const FilterTable vertical = BuildFilterTable(current.Height, dstHeight, options.MipFilter);
+
+		rows.Resize(dstWidth, current.Height);
+		FilterRows(current, rows, horizontal, maxThreads);
+
+		next.Resize(dstWidth, dstHeight);
+		FilterColumns(rows, next, vertical, maxThreads);
+
+		// The float chain keeps the unscaled alpha so each level's scale is found
+		// from filtered data rather than compounding.
+		float alphaScale = 1.0f;
+		if (preserveCoverage)
+			alphaScale = FindCoverageScale(next, options.AlphaReference, targetCoverage);
+
+		StoreLevel(next, mips[level], options, alphaScale, maxThreads);
+
+		std::swap(current, next);
+	}
+}
+}
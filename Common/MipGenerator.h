@@ -0,0 +1,70 @@
+//***************************************************************************************
+// MipGenerator.h
+//
+// CPU mip chain generation for 8-bit RGBA (or BGRA) images.
+//
+// Levels are filtered in 32-bit float with a separable box or Kaiser-windowed sinc
+// filter, each level from the one above it.  Odd sizes are handled by weighting the
+// source texels by how much of the destination footprint they cover.  sRGB colour is
+// converted to linear before filtering and back after, normal maps are renormalized,
+// and alpha can be rescaled per level so alpha-tested cutouts keep the coverage of
+// the top level instead of thinning out.  Rows of a level are filtered on all cores.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MipGenerator
+{
+	enum class Filter
+	{
+		// Average of the covered texels.  Cheapest, slightly blurry.
+		Box,
+
+		// Kaiser-windowed sinc over 3 destination texels each side.  Sharper and with
+		// less aliasing than Box.
+		Kaiser
+	};
+
+	enum Flags : unsigned
+	{
+		FlagsDefault = 0,
+
+		// The colour channels hold sRGB-encoded values.
+		Srgb = 0x1,
+
+		// The colour channels hold a unit vector mapped to [0,1]; each output texel is
+		// renormalized.
+		NormalMap = 0x2,
+
+		// Scale alpha in every level so the fraction of texels with alpha above
+		// Options::AlphaReference matches the source.
+		PreserveAlphaCoverage = 0x4,
+	};
+
+	struct Options
+	{
+		Filter MipFilter = Filter::Box;
+		unsigned Flags = FlagsDefault;
+		float AlphaReference = 0.5f;
+	};
+
+	struct Image
+	{
+		std::uint8_t* Pixels;
+		size_t Width;
+		size_t Height;
+		size_t RowPitch;
+	};
+
+	// Levels in a full chain down to 1x1, counting the top level.
+	unsigned CountMips(size_t width, size_t height);
+
+	// Writes levels 1..numMips of the source into mips[0..numMips-1].  The caller sets
+	// up each Image; level n must be max(1, width >> n) by max(1, height >> n).
+	// maxThreads = 0 uses every core.
+	void Generate(const std::uint8_t* pixels, size_t width, size_t height, size_t rowPitch,
+		const Image* mips, unsigned numMips, const Options& options = Options(), unsigned maxThreads = 0);
+}
@@ -0,0 +1,95 @@
+//***************************************************************************************
+// Parallel.h
+//
+// Minimal data-parallel loop for CPU-side asset processing (block compression, mip
+// generation, mesh parsing), run on the shared JobSystem pool.  Uses std::thread only,
+// so it also builds for tools, which compile JobSystem.cpp with it.
+//***************************************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace Parallel
+{
+	inline unsigned HardwareThreads()
+	{
+		unsigned count = std::thread::hardware_concurrency();
+		return count > 0 ? count : 1;
+	}
+
+	// Calls body(begin, end) for chunks of at most 'grain' items covering [0, count) on
+	// JobSystem::Default(), whose threads stay up between calls; the calling thread takes
+	// part and the call returns when every chunk is done.  At most maxThreads threads
+	// run body at once (0 = as many as the pool has); 1 runs the chunks on the calling
+	// thread in order.  body must be safe to call concurrently.
+	template<typename Body>
+	void For(size_t count, size_t grain, const Body& body, unsigned maxThreads = 0)
+	{
+		grain = std::max<size_t>(grain, 1);
+
+		if (maxThreads == 1)
+		{
+			for (size_t begin = 0; begin < count; begin += grain)
+				body(begin, std::min(begin + grain, count));
+			return;
+		}
+
+		if (maxThreads == 0)
+		{
+			JobSystem::Default().ParallelFor(count, grain, body);
+			return;
+		}
+
+		// maxThreads lanes, each a pool job that takes chunks in turn until none is left.
+		const size_t numChunks = (count + grain - 1) / grain;
+		std::atomic<size_t> nextChunk(0);
+		JobSystem::Default().ParallelFor(std::min<size_t>(maxThreads, numChunks), 1, [&](size_t, size_t)
+		{
+			for (;;)
+			{
+				size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= numChunks)
+					return;
+
+				size_t begin = chunk * grain;
+				body(begin, std::min(begin + grain, count));
+			}
+		});
+	}
+
+	// Calls body(i) for every i in [0, count) on all cores.  An exception does not stop
+	// the other calls; once every call has been made, the one body(i) threw for the
+	// lowest i is rethrown.  For batches of independent jobs such as shader compiles.
+	template<typename Body>
+	void TryEach(size_t count, const Body& body)
+	{
+		std::vector<std::exception_ptr> errors(count);
+
+		For(count, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				try
+				{
+					body(i);
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			}
+		});
+
+		for (const std::exception_ptr& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+	}
+}
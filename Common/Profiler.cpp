@@ -0,0 +1,217 @@
+//***************************************************************************************
+// Profiler.cpp
+//***************************************************************************************
+
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+std::atomic<bool> Profiler::mEnabled{ true };
+
+namespace
+{
+	struct Event
+	{
+		std::atomic<const char*> Name{ nullptr };
+		std::atomic<std::int64_t> Start{ 0 };
+		std::atomic<std::int64_t> End{ 0 };
+	};
+
+	// One thread's ring.  Events [Written - EventCapacity, Written) are complete; a
+	// writer claims event n by raising Claimed to n + 1 before it touches the slot, so
+	// a reader can tell which slots changed under it.  Relaxed atomics on x86 are plain
+	// loads and stores.
+	struct ThreadBuffer
+	{
+		std::unique_ptr<Event[]> Events{ new Event[Profiler::EventCapacity] };
+		std::atomic<std::uint64_t> Claimed{ 0 };
+		std::atomic<std::uint64_t> Written{ 0 };
+		std::string Name;
+		unsigned Id = 0;
+	};
+
+	struct Registry
+	{
+		std::mutex Lock;
+
+		// Now() and the Clock when the first thread registered, for the tick rate.
+		std::int64_t FirstTick = 0;
+		Profiler::Clock::time_point FirstTime;
+
+		// Never freed, so a thread's zones outlive it until they are written.
+		std::vector<std::unique_ptr<ThreadBuffer>> Buffers;
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	thread_local ThreadBuffer* tBuffer = nullptr;
+
+	ThreadBuffer* CurrentBuffer()
+	{
+		if (tBuffer == nullptr)
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.Lock);
+
+			if (registry.Buffers.empty())
+			{
+				registry.FirstTick = Profiler::Now();
+				registry.FirstTime = Profiler::Clock::now();
+			}
+
+			registry.Buffers.push_back(std::make_unique<ThreadBuffer>());
+			tBuffer = registry.Buffers.back().get();
+			tBuffer->Id = (unsigned)registry.Buffers.size();
+			tBuffer->Name = "Thread " + std::to_string(tBuffer->Id);
+		}
+		return tBuffer;
+	}
+
+	struct CopiedEvent
+	{
+		const char* Name;
+		std::int64_t Start;
+		std::int64_t End;
+	};
+
+	void WriteEscaped(std::ostream& out, const char* text)
+	{
+		for (; *text != '\0'; ++text)
+		{
+			const unsigned char c = (unsigned char)*text;
+			if (c == '"' || c == '\\')
+				out << '\\' << (char)c;
+			else if (c < 0x20)
+				out << ' ';
+			else
+				out << (char)c;
+		}
+	}
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = CurrentBuffer();
+
+	std::lock_guard<std::mutex> lock(GetRegistry().Lock);
+	buffer->Name = name;
+}
+
+void Profiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(GetRegistry().Lock);
+	for (auto& buffer : GetRegistry().Buffers)
+	{
+		buffer->Claimed.store(0, std::memory_order_relaxed);
+		buffer->Written.store(0, std::memory_order_relaxed);
+	}
+}
+
+void Profiler::Record(const char* name, std::int64_t start, std::int64_t end)
+{
+	ThreadBuffer* buffer = CurrentBuffer();
+
+	const std::uint64_t n = buffer->Written.load(std::memory_order_relaxed);
+	buffer->Claimed.store(n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Event& event = buffer->Events[n & (EventCapacity - 1)];
+	event.Name.store(name, std::memory_order_relaxed);
+	event.Start.store(start, std::memory_order_relaxed);
+	event.End.store(end, std::memory_order_relaxed);
+
+	buffer->Written.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out)
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Lock);
+
+	// Copy every ring first, then keep the events no writer reached during the copy.
+	std::vector<std::vector<CopiedEvent>> copies(registry.Buffers.size());
+	std::int64_t origin = INT64_MAX;
+	for (size_t b = 0; b < registry.Buffers.size(); ++b)
+	{
+		ThreadBuffer& buffer = *registry.Buffers[b];
+
+		const std::uint64_t end = buffer.Written.load(std::memory_order_acquire);
+		const std::uint64_t begin = end > EventCapacity ? end - EventCapacity : 0;
+
+		std::vector<CopiedEvent>& copy = copies[b];
+		copy.resize((size_t)(end - begin));
+		for (std::uint64_t n = begin; n < end; ++n)
+		{
+			const Event& event = buffer.Events[n & (EventCapacity - 1)];
+			copy[(size_t)(n - begin)] = { event.Name.load(std::memory_order_relaxed),
+				event.Start.load(std::memory_order_relaxed), event.End.load(std::memory_order_relaxed) };
+		}
+
+		// A slot whose new event was claimed before this fence may have been read
+		// half written.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const std::uint64_t claimed = buffer.Claimed.load(std::memory_order_relaxed);
+		const std::uint64_t firstValid = claimed > EventCapacity ? claimed - EventCapacity : 0;
+		if (firstValid > begin)
+			copy.erase(copy.begin(), copy.begin() + (size_t)std::min(firstValid - begin, end - begin));
+
+		for (const CopiedEvent& event : copy)
+			origin = std::min(origin, event.Start);
+	}
+
+	double microsecondsPerTick = 1e6 * Clock::period::num / Clock::period::den;
+#if defined(PROFILER_X86)
+	const std::int64_t ticks = Now() - registry.FirstTick;
+	const double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - registry.FirstTime).count();
+	if (ticks > 0)
+		microsecondsPerTick = microseconds / ticks;
+#endif
+
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision(3);
+	out.setf(std::ios::fixed, std::ios::floatfield);
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const char* separator = "\n";
+	for (size_t b = 0; b < registry.Buffers.size(); ++b)
+	{
+		const ThreadBuffer& buffer = *registry.Buffers[b];
+
+		out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.Id
+			<< ",\"args\":{\"name\":\"";
+		WriteEscaped(out, buffer.Name.c_str());
+		out << "\"}}";
+		separator = ",\n";
+
+		for (const CopiedEvent& event : copies[b])
+		{
+			out << separator << "{\"name\":\"";
+			WriteEscaped(out, event.Name);
+			out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.Id
+				<< ",\"ts\":" << (event.Start - origin) * microsecondsPerTick
+				<< ",\"dur\":" << (event.End - event.Start) * microsecondsPerTick << "}";
+		}
+	}
+	out << "\n]}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	WriteChromeTrace(file);
+	return (bool)file;
+}
@@ -0,0 +1,104 @@
+//***************************************************************************************
+// Profiler.h
+//
+// A scoped CPU profiler.  PROFILE_ZONE("name") times the rest of the enclosing scope;
+// zones nest like the scopes that hold them.  The name must outlive the profiler, as
+// a string literal does.
+//
+// Every thread records its zones into a ring buffer of its own, which only it writes,
+// so recording takes no locks: two reads of the clock and a few stores.  On x86 the
+// clock is the time stamp counter, which reads several times faster than
+// std::chrono::steady_clock, and the trace converts it at the rate it kept against
+// steady_clock since the first zone.  The ring keeps the last EventCapacity zones of
+// each thread.
+// WriteChromeTrace() can run at any time from any thread; it copies what each ring
+// holds and leaves out the zones a thread overwrote meanwhile.  The output is the
+// Chrome trace event JSON, which chrome://tracing and ui.perfetto.dev open.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PROFILER_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Zones kept per thread; a power of two.
+	static const std::uint32_t EventCapacity = 1 << 16;
+
+	// Records the time from its construction to its destruction, if the profiler was
+	// enabled when it was constructed.
+	class Zone
+	{
+	public:
+		explicit Zone(const char* name)
+			: mName(Enabled() ? name : nullptr), mStart(mName != nullptr ? Now() : 0)
+		{
+		}
+
+		Zone(const Zone& rhs) = delete;
+		Zone& operator=(const Zone& rhs) = delete;
+
+		~Zone()
+		{
+			if (mName != nullptr)
+				Record(mName, mStart, Now());
+		}
+
+	private:
+		const char* mName;
+		std::int64_t mStart;
+	};
+
+public:
+	// Recording starts enabled.
+	static void SetEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+	static bool Enabled() { return mEnabled.load(std::memory_order_relaxed); }
+
+	// Names the calling thread in the trace; unnamed threads are "Thread n".
+	static void SetThreadName(const char* name);
+
+	// Drops every zone recorded so far.  Not concurrently with recording threads.
+	static void Clear();
+
+	// Writes the zones the rings hold as complete ("X") events, with times in
+	// microseconds from the earliest.
+	static void WriteChromeTrace(std::ostream& out);
+
+	// Writes the same to a file; returns false if the file cannot be written.
+	static bool WriteChromeTrace(const std::string& path);
+
+	// Ticks of the time stamp counter on x86, of Clock elsewhere.
+	static std::int64_t Now()
+	{
+#if defined(PROFILER_X86)
+		return (std::int64_t)__rdtsc();
+#else
+		return Clock::now().time_since_epoch().count();
+#endif
+	}
+
+private:
+	static void Record(const char* name, std::int64_t start, std::int64_t end);
+
+	static std::atomic<bool> mEnabled;
+};
@@ -1,11 +1,16 @@
 #pragma once
+#include <cassert>
 #include <unordered_map>
 #include <string>
 #include <vector>
 
 #include "d3dx12.h"
 #include "d3dUtil.h"
+#include "ContentHash.h"
 #include "GeometryGenerator.h"
+#include "Parallel.h"
+#include "TexturePacker.h"
+#include "TextureStreamer.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -17,6 +22,26 @@ enum ShaderType
 
 class Render
 {
+public:
+	// What the content hashing in SetGeometry and SetTexture avoided loading.
+	struct DeduplicationStats
+	{
+		UINT Geometries = 0;
+		UINT64 GeometryBytes = 0;	// vertex and index buffer bytes
+		UINT Textures = 0;
+		UINT64 TextureBytes = 0;	// file bytes
+	};
+
+	// One entry of CreateShaders().
+	struct ShaderDesc
+	{
+		std::string Name;
+		std::wstring Path;
+		std::string EntryPoint;
+		std::string Target;
+		const D3D_SHADER_MACRO* Defines = nullptr;
+	};
+
 public:
 	Render()
 	{
@@ -49,7 +74,35 @@ public:
 		std::vector<std::uint16_t> indices = md.GetIndices16();
 		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
-		auto geo = std::make_unique<MeshGeometry>();
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = 0;
+
+		// Identical meshes share one set of buffers; the name becomes another draw
+		// argument of the existing geometry.
+		std::uint64_t hash = ContentHash::Hash64(vertices.data(), vbByteSize);
+		hash = ContentHash::Combine(hash, indices.data(), ibByteSize);
+
+		auto match = geometryHashMap.find(hash);
+		if (match != geometryHashMap.end())
+		{
+			std::shared_ptr<MeshGeometry> existing = match->second.lock();
+			if (existing != nullptr &&
+				existing->VertexBufferByteSize == vbByteSize && existing->IndexBufferByteSize == ibByteSize &&
+				memcmp(existing->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize) == 0 &&
+				memcmp(existing->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize) == 0)
+			{
+				existing->DrawArgs[name] = submesh;
+				geometryMap[name] = existing;
+
+				dedupStats.Geometries++;
+				dedupStats.GeometryBytes += vbByteSize + ibByteSize;
+				return;
+			}
+		}
+
+		auto geo = std::make_shared<MeshGeometry>();
 		geo->Name = name;
 
 		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
@@ -69,16 +122,72 @@ public:
 		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 		geo->IndexBufferByteSize = ibByteSize;
 
+		geo->DrawArgs[name] = submesh;
+
+		geometryHashMap[hash] = geo;
+		geometryMap[name] = std::move(geo);
+	}
+
+	// The engine Vertex for GeometryGenerator's Write* functions.
+	using GeneratorLayout = GeometryGenerator::VertexLayout<Vertex, &Vertex::Pos, &Vertex::Normal, &Vertex::TexC, &Vertex::TangentU>;
+
+	// Builds a mesh in one pass straight into upload memory: write(Vertex*, Index*)
+	// fills size.VertexCount vertices and size.IndexCount indices, for example through
+	// GeometryGenerator::WriteSphere<GeneratorLayout>.  Index is std::uint16_t, or
+	// std::uint32_t for meshes of more than 0x10000 vertices, so 'write' must take
+	// either (a generic lambda does).  Both go into one upload buffer.  No CPU copy is
+	// kept, so these meshes are not shared through the content hash.
+	template<typename WriteMesh>
+	void SetGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* gcl, std::string name,
+		GeometryGenerator::MeshSize size, WriteMesh write)
+	{
+		const bool wideIndices = size.VertexCount > 0x10000;
+		const UINT indexSize = wideIndices ? sizeof(std::uint32_t) : sizeof(std::uint16_t);
+
+		const UINT vbByteSize = size.VertexCount * sizeof(Vertex);
+		const UINT ibByteSize = size.IndexCount * indexSize;
+
+		ComPtr<ID3D12Resource> uploader = d3dUtil::CreateUploadBuffer(device, vbByteSize + ibByteSize);
+
+		// Upload memory is write-combined; the generators only write to it.
+		BYTE* mapped = nullptr;
+		D3D12_RANGE noRead = { 0, 0 };
+		ThrowIfFailed(uploader->Map(0, &noRead, reinterpret_cast<void**>(&mapped)));
+		if (wideIndices)
+			write(reinterpret_cast<Vertex*>(mapped), reinterpret_cast<std::uint32_t*>(mapped + vbByteSize));
+		else
+			write(reinterpret_cast<Vertex*>(mapped), reinterpret_cast<std::uint16_t*>(mapped + vbByteSize));
+		uploader->Unmap(0, nullptr);
+
+		auto geo = std::make_shared<MeshGeometry>();
+		geo->Name = name;
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device, gcl, uploader.Get(), 0, vbByteSize);
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device, gcl, uploader.Get(), vbByteSize, ibByteSize);
+		geo->VertexBufferUploader = uploader;
+		geo->IndexBufferUploader = uploader;
+
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexFormat = wideIndices ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
+
 		SubmeshGeometry submesh;
-		submesh.IndexCount = (UINT)indices.size();
+		submesh.IndexCount = size.IndexCount;
 		submesh.StartIndexLocation = 0;
 		submesh.BaseVertexLocation = 0;
-
 		geo->DrawArgs[name] = submesh;
 
 		geometryMap[name] = std::move(geo);
 	}
 
+	// Drops the name.  Buffers shared with other names stay until the last of them is
+	// released, so only call this once the GPU no longer draws the geometry.
+	void ReleaseGeometry(std::string name)
+	{
+		geometryMap.erase(name);
+	}
+
 	MeshGeometry* GetGeometry(std::string name)
 	{
 		if (geometryMap.find(name) != geometryMap.end())
@@ -89,27 +198,57 @@ public:
 #pragma endregion
 
 #pragma region Texture
-	void SetTexture(ID3D12Device* device, ID3D12GraphicsCommandList* gcl, std::string name, std::wstring path)
+	void SetTexture(ID3D12Device* device, ID3D12GraphicsCommandList* gcl, std::string name, std::wstring path,
+		unsigned int loadFlags = DirectX::DDS_LOADER_MIP_AUTOGEN)
 	{
-		auto texture = std::make_unique<Texture>();
-		texture->Name = name;
-		texture->Filename = path;
+		AddTexture(nullptr, device, gcl, name, path, loadFlags);
+	}
 
-		//  DDS 
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(
-			device,
-			gcl,
-			texture->Filename.c_str(),
-			texture->Resource,
-			texture->UploadHeap)
-		);
+	// The streamer keeps the resource and writes its descriptors; textures it can not
+	// stream (arrays, cube maps, single level) are loaded whole as above.
+	void SetTexture(TextureStreamer& streamer, ID3D12Device* device, ID3D12GraphicsCommandList* gcl, std::string name, std::wstring path,
+		unsigned int loadFlags = DirectX::DDS_LOADER_MIP_AUTOGEN)
+	{
+		AddTexture(&streamer, device, gcl, name, path, loadFlags);
+	}
 
-		//    
-		textureMap.push_back(std::move(texture));
+	// Drops the reference 'name' holds; a name that was released already, or never
+	// added, is ignored.  The last reference frees a texture that was loaded whole
+	// (streamed textures stay with the streamer); its slot in the texture map is kept so
+	// the heap indices of the others do not move.  Only call once the GPU no longer
+	// samples it.
+	void ReleaseTexture(std::string name)
+	{
+		auto alias = textureAliasMap.find(name);
+		if (alias == textureAliasMap.end())
+			return;
+
+		const int index = alias->second;
+		textureAliasMap.erase(alias);
+
+		Texture* texture = textureMap[index].get();
+		assert(texture->RefCount > 0);
+		if (--texture->RefCount > 0)
+			return;
+
+		textureHashMap.erase(texture->Hash);
+		texture->Resource = nullptr;
+		texture->UploadHeap = nullptr;
+	}
+
+	// Records the array and slice a TexturePacker put the texture in.  Materials that
+	// use it index the packed array table instead of the texture map.
+	void SetPackedTexture(std::string name, int arrayIndex, UINT slice)
+	{
+		packedTextureMap[name] = { arrayIndex, slice };
 	}
 
 	Texture* GetTexture(std::string name)
 	{
+		auto alias = textureAliasMap.find(name);
+		if (alias != textureAliasMap.end())
+			return textureMap[alias->second].get();
+
 		for (int i = 0; i < textureMap.size(); ++i)
 			if (textureMap[i]->Name == name)
 				return textureMap[i].get();
@@ -119,6 +258,10 @@ public:
 
 	int GetTextureIndex(std::string name)
 	{
+		auto alias = textureAliasMap.find(name);
+		if (alias != textureAliasMap.end())
+			return alias->second;
+
 		for (int i = 0; i < textureMap.size(); ++i)
 			if (textureMap[i]->Name == name)
 				return i;
@@ -126,6 +269,21 @@ public:
 		return -1;
 	}
 
+	// Heap index (or packed array index) and slice (-1 if not packed) for a material map.
+	void ResolveTexture(const std::string& name, int& index, int& slice)
+	{
+		auto packed = packedTextureMap.find(name);
+		if (packed != packedTextureMap.end())
+		{
+			index = packed->second.first;
+			slice = (int)packed->second.second;
+			return;
+		}
+
+		index = GetTextureIndex(name);
+		slice = -1;
+	}
+
 	std::vector<std::unique_ptr<Texture>>& GetTextureMap()
 	{
 		return textureMap;
@@ -135,6 +293,11 @@ public:
 	{
 		return textureMap.size();
 	}
+
+	const DeduplicationStats& GetDeduplicationStats()const
+	{
+		return dedupStats;
+	}
 #pragma endregion
 
 #pragma region Material
@@ -151,8 +314,8 @@ public:
 			material->FresnelR0 = DirectX::XMFLOAT3(fre_x, fre_y, fre_z);
 			material->Roughness = roughness;
 			material->MatCBIndex = materialMap[name].get()->MatCBIndex;
-			material->DiffuseSrvHeapIndex = GetTextureIndex(texname);
-			material->NormalSrvHeapIndex = GetTextureIndex(norname);
+			ResolveTexture(texname, material->DiffuseSrvHeapIndex, material->DiffuseSrvSlice);
+			ResolveTexture(norname, material->NormalSrvHeapIndex, material->NormalSrvSlice);
 			materialMap[name] = std::move(material);
 		}
 		else
@@ -163,8 +326,8 @@ public:
 			material->FresnelR0 = DirectX::XMFLOAT3(fre_x, fre_y, fre_z);
 			material->Roughness = roughness;
 			material->MatCBIndex = materialMap.size();
-			material->DiffuseSrvHeapIndex = GetTextureIndex(texname);
-			material->NormalSrvHeapIndex = GetTextureIndex(norname);
+			ResolveTexture(texname, material->DiffuseSrvHeapIndex, material->DiffuseSrvSlice);
+			ResolveTexture(norname, material->NormalSrvHeapIndex, material->NormalSrvSlice);
 			materialMap[name] = std::move(material);
 		}
 	}
@@ -195,6 +358,21 @@ public:
 		//mShaders["standardVS"] = d3dUtil::CompileShader(L"Default.hlsl", nullptr, "VS", "vs_5_1");
 	}
 
+	// Compiles the shaders on all cores.  Touches nothing but the shader map, so it may
+	// run on a worker thread while the rest of the start-up work goes on.  Rethrows the
+	// first compile error once every shader has been tried, and then adds none of them.
+	void CreateShaders(const std::vector<ShaderDesc>& shaders)
+	{
+		std::vector<ComPtr<ID3DBlob>> bytecode(shaders.size());
+		Parallel::TryEach(shaders.size(), [&](size_t i)
+		{
+			bytecode[i] = d3dUtil::CompileShader(shaders[i].Path, shaders[i].Defines, shaders[i].EntryPoint, shaders[i].Target);
+		});
+
+		for (size_t i = 0; i < shaders.size(); ++i)
+			shaderMap[shaders[i].Name] = bytecode[i];
+	}
+
 	D3D12_SHADER_BYTECODE GetShaderBytecode(std::string name)
 	{
 		return {
@@ -210,14 +388,76 @@ public:
 #pragma endregion
 
 private:
-	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> geometryMap;
+	std::unordered_map<std::string, std::shared_ptr<MeshGeometry>> geometryMap;
+	std::unordered_map<std::uint64_t, std::weak_ptr<MeshGeometry>> geometryHashMap;
 	std::vector<std::unique_ptr<Texture>> textureMap;
+	std::unordered_map<std::string, int> textureAliasMap;
+	std::unordered_map<std::uint64_t, int> textureHashMap;
+	DeduplicationStats dedupStats;
+	std::unordered_map<std::string, std::pair<int, UINT>> packedTextureMap;
 	std::unordered_map<std::string, std::unique_ptr<Material>> materialMap;
 
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> shaderMap;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> psoMap;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+	void AddTexture(TextureStreamer* streamer, ID3D12Device* device, ID3D12GraphicsCommandList* gcl,
+		const std::string& name, const std::wstring& path, unsigned int loadFlags)
+	{
+		// A file already loaded with the same flags, under any name, is shared.  The
+		// hash and size stand in for the bytes, so the other file is not read again.
+		// A new file is mapped once: the hash, the streamer and the loader all read the
+		// same view.
+		MappedFile file;
+		if (!file.Open(path.c_str()))
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+		const std::uint64_t fileSize = file.Size();
+		std::uint64_t hash = ContentHash::Hash64(file.Data(), (size_t)fileSize);
+		hash = ContentHash::Combine(hash, &loadFlags, sizeof(loadFlags));
+
+		auto match = textureHashMap.find(hash);
+		if (match != textureHashMap.end() && textureMap[match->second]->FileSize == fileSize)
+		{
+			textureAliasMap[name] = match->second;
+			textureMap[match->second]->RefCount++;
+
+			dedupStats.Textures++;
+			dedupStats.TextureBytes += fileSize;
+			return;
+		}
+
+		auto texture = std::make_unique<Texture>();
+		texture->Name = name;
+		texture->Filename = path;
+		texture->Hash = hash;
+		texture->FileSize = fileSize;
+		texture->RefCount = 1;
+
+		if (streamer != nullptr)
+			texture->StreamId = streamer->AddTexture(gcl, path, file, (UINT)textureMap.size(), loadFlags);
+
+		if (texture->StreamId < 0)
+		{
+			//  DDS 
+			ThrowIfFailed(DirectX::CreateDDSTextureFromMemory12Ex(
+				device,
+				gcl,
+				file.Data(),
+				(size_t)fileSize,
+				texture->Resource,
+				texture->UploadHeap,
+				loadFlags)
+			);
+		}
+
+		textureHashMap[hash] = (int)textureMap.size();
+		textureAliasMap[name] = (int)textureMap.size();
+
+		//    
+		textureMap.push_back(std::move(texture));
+	}
+
 	void InitializeMaterialMap()
 	{
 		//SetMaterial("default", "", 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
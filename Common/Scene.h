@@ -5,6 +5,7 @@
 
 #include "Camera.h"
 #include "GameObject.h"
+#include "Profiler.h"
 
 class Scene
 {
@@ -23,6 +24,8 @@ public:
 
 	void Update(const GameTimer& gt)
 	{
+		PROFILE_ZONE("Scene::Update");
+
 		//     
 		for (auto it : GetAllGameObjects())
 			if (it.second != nullptr)
@@ -35,6 +38,8 @@ public:
 
 	void RenderUpdate()
 	{
+		PROFILE_ZONE("Scene::RenderUpdate");
+
 		//     
 		for (auto it : GetAllGameObjects())
 			if (it.second != nullptr)
@@ -0,0 +1,201 @@
+//***************************************************************************************
+// TangentSpace.cpp
+//***************************************************************************************
+
+#include "TangentSpace.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Vertices per task.
+	const size_t VertexGrain = 4096;
+
+	struct Vec3
+	{
+		float x, y, z;
+	};
+
+	inline Vec3 Sub(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline Vec3 Scale(float s, const Vec3& a) { return { s * a.x, s * a.y, s * a.z }; }
+	inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	// MikkTSpace's test for a usable length or area.
+	inline bool NotZero(float value)
+	{
+		return std::fabs(value) > FLT_MIN;
+	}
+
+	// The part of v in the plane of the unit normal n, normalized when it is not zero.
+	inline Vec3 ProjectNormalized(const Vec3& v, const Vec3& n)
+	{
+		Vec3 projected = Sub(v, Scale(Dot(n, v), n));
+		const float length = std::sqrt(Dot(projected, projected));
+		return NotZero(length) ? Scale(1.0f / length, projected) : projected;
+	}
+
+	class VertexReader
+	{
+	public:
+		VertexReader(const std::uint8_t* vertices, const TangentSpace::VertexFormat& format)
+			: mVertices(vertices), mFormat(format)
+		{
+		}
+
+		Vec3 Position(std::uint32_t index)const { return Read3(index, mFormat.PositionOffset); }
+		Vec3 Normal(std::uint32_t index)const { return Read3(index, mFormat.NormalOffset); }
+
+		void TexCoord(std::uint32_t index, float uv[2])const
+		{
+			std::memcpy(uv, mVertices + (size_t)index * mFormat.Stride + mFormat.TexCoordOffset, 2 * sizeof(float));
+		}
+
+	private:
+		Vec3 Read3(std::uint32_t index, std::uint32_t offset)const
+		{
+			Vec3 v;
+			std::memcpy(&v, mVertices + (size_t)index * mFormat.Stride + offset, sizeof(v));
+			return v;
+		}
+
+	private:
+		const std::uint8_t* mVertices;
+		TangentSpace::VertexFormat mFormat;
+	};
+
+	// Adds corner c of triangle 'tri' to the vertex's sums of angle-weighted tangents
+	// and angle-weighted orientations.
+	void AccumulateCorner(const VertexReader& reader, const std::uint32_t* tri, int c, Vec3& tangentSum,
+		float& orientationSum)
+	{
+		const Vec3 p[3] = { reader.Position(tri[0]), reader.Position(tri[1]), reader.Position(tri[2]) };
+		float uv[3][2];
+		reader.TexCoord(tri[0], uv[0]);
+		reader.TexCoord(tri[1], uv[1]);
+		reader.TexCoord(tri[2], uv[2]);
+
+		// The direction of increasing u on the triangle, from the edge vectors in object
+		// and texture space.  A triangle with no area in texture space has none and is
+		// left out, as MikkTSpace does.
+		const Vec3 d1 = Sub(p[1], p[0]);
+		const Vec3 d2 = Sub(p[2], p[0]);
+		const float t21x = uv[1][0] - uv[0][0], t21y = uv[1][1] - uv[0][1];
+		const float t31x = uv[2][0] - uv[0][0], t31y = uv[2][1] - uv[0][1];
+
+		const float signedAreaSTx2 = t21x * t31y - t21y * t31x;
+		if (!NotZero(signedAreaSTx2))
+			return;
+
+		const float orientation = signedAreaSTx2 > 0.0f ? 1.0f : -1.0f;
+
+		Vec3 os = Sub(Scale(t31y, d1), Scale(t21y, d2));
+		const float lengthOs = std::sqrt(Dot(os, os));
+		if (NotZero(lengthOs))
+			os = Scale(orientation / lengthOs, os);
+
+		const Vec3 n = reader.Normal(tri[c]);
+
+		// The angle at the corner, measured in the plane of the normal.
+		const Vec3 e1 = ProjectNormalized(Sub(p[(c + 2) % 3], p[c]), n);
+		const Vec3 e2 = ProjectNormalized(Sub(p[(c + 1) % 3], p[c]), n);
+		const float angle = std::acos(std::min(std::max(Dot(e1, e2), -1.0f), 1.0f));
+
+		const Vec3 tangent = ProjectNormalized(os, n);
+
+		tangentSum.x += angle * tangent.x;
+		tangentSum.y += angle * tangent.y;
+		tangentSum.z += angle * tangent.z;
+		orientationSum += angle * orientation;
+	}
+}
+
+void TangentSpace::PerpendicularTangent(const float normal[3], float tangent[3])
+{
+	const float nx = normal[0], ny = normal[1], nz = normal[2];
+	float t[3];
+	if (std::fabs(ny) < 1.0f - 0.001f)
+	{
+		// cross((0,1,0), n)
+		t[0] = nz; t[1] = 0.0f; t[2] = -nx;
+	}
+	else
+	{
+		// cross(n, (0,0,1))
+		t[0] = ny; t[1] = -nx; t[2] = 0.0f;
+	}
+
+	float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+	if (length > 0.0f)
+	{
+		tangent[0] = t[0] / length;
+		tangent[1] = t[1] / length;
+		tangent[2] = t[2] / length;
+	}
+	else
+	{
+		tangent[0] = tangent[1] = tangent[2] = 0.0f;
+	}
+}
+
+void TangentSpace::Generate(void* vertices, std::uint32_t vertexCount, const VertexFormat& format,
+	const std::uint32_t* indices, size_t indexCount, float* bitangentSigns, unsigned maxThreads)
+{
+	std::uint8_t* vertexBytes = static_cast<std::uint8_t*>(vertices);
+	const VertexReader reader(vertexBytes, format);
+
+	const size_t cornerCount = indexCount / 3 * 3;
+
+	// The corners of every vertex, in index order: cornerStart[v] to cornerStart[v + 1]
+	// in 'corners'.
+	std::vector<std::uint32_t> cornerStart((size_t)vertexCount + 1, 0);
+	for (size_t k = 0; k < cornerCount; ++k)
+		++cornerStart[indices[k] + 1];
+	for (size_t v = 0; v < vertexCount; ++v)
+		cornerStart[v + 1] += cornerStart[v];
+
+	std::vector<std::uint32_t> corners(cornerCount);
+	{
+		std::vector<std::uint32_t> next(cornerStart.begin(), cornerStart.end() - 1);
+		for (size_t k = 0; k < cornerCount; ++k)
+			corners[next[indices[k]]++] = (std::uint32_t)k;
+	}
+
+	Parallel::For(vertexCount, VertexGrain, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; ++v)
+		{
+			Vec3 sum = { 0.0f, 0.0f, 0.0f };
+			float orientation = 0.0f;
+			for (std::uint32_t i = cornerStart[v]; i < cornerStart[v + 1]; ++i)
+			{
+				const std::uint32_t k = corners[i];
+				AccumulateCorner(reader, indices + k / 3 * 3, (int)(k % 3), sum, orientation);
+			}
+
+			float tangent[3];
+			const float length = std::sqrt(Dot(sum, sum));
+			if (NotZero(length))
+			{
+				tangent[0] = sum.x / length;
+				tangent[1] = sum.y / length;
+				tangent[2] = sum.z / length;
+			}
+			else
+			{
+				float normal[3];
+				std::memcpy(normal, vertexBytes + v * format.Stride + format.NormalOffset, sizeof(normal));
+				PerpendicularTangent(normal, tangent);
+			}
+
+			std::memcpy(vertexBytes + v * format.Stride + format.TangentOffset, tangent, sizeof(tangent));
+
+			if (bitangentSigns != nullptr)
+				bitangentSigns[v] = orientation < 0.0f ? -1.0f : 1.0f;
+		}
+	}, maxThreads);
+}
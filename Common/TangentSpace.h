@@ -0,0 +1,47 @@
+//***************************************************************************************
+// TangentSpace.h
+//
+// Per-vertex tangents for normal mapping, computed from the positions, normals and
+// texture coordinates of an indexed triangle list the way MikkTSpace does: each
+// triangle's texture-space s direction is projected onto the plane of the vertex
+// normal and weighted by the triangle's angle at the vertex, and the bitangent sign
+// is the orientation of the triangle in texture space.  A baker using MikkTSpace
+// gives the same tangents, except where a vertex is shared by triangles of both
+// orientations (a mirror seam that MikkTSpace splits into two vertices); there the
+// vertex takes the orientation with more angle behind it.
+//
+// The corners of each vertex are listed first, in index order, and then every vertex
+// sums its own corners on whichever thread gets it, so no atomics or per-thread buffers
+// are needed and the sums are added in the same order on any number of cores: the
+// output is the same bit for bit.  Vertices without a usable triangle (no texture
+// coordinates, or only degenerate ones) get PerpendicularTangent().
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace TangentSpace
+{
+	// Byte offsets of the attributes in an interleaved vertex: float3 position, float3
+	// unit normal, float2 texture coordinates and the float3 tangent to write.
+	struct VertexFormat
+	{
+		std::uint32_t Stride;
+		std::uint32_t PositionOffset;
+		std::uint32_t NormalOffset;
+		std::uint32_t TexCoordOffset;
+		std::uint32_t TangentOffset;
+	};
+
+	// Writes a unit tangent into every vertex, and, if bitangentSigns is not null, the
+	// sign b such that bitangent = b * cross(normal, tangent).  Every index must be
+	// below vertexCount.  maxThreads = 0 uses every core.
+	void Generate(void* vertices, std::uint32_t vertexCount, const VertexFormat& format,
+		const std::uint32_t* indices, size_t indexCount, float* bitangentSigns = nullptr, unsigned maxThreads = 0);
+
+	// A unit vector perpendicular to the normal: cross((0, 1, 0), n), or cross(n, (0, 0, 1))
+	// when n is close to the y axis.
+	void PerpendicularTangent(const float normal[3], float tangent[3]);
+}
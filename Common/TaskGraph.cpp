@@ -0,0 +1,234 @@
+//***************************************************************************************
+// TaskGraph.cpp
+//***************************************************************************************
+
+#include "TaskGraph.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::Add(const std::string& name, Lane lane, std::function<void()> work,
+	std::initializer_list<TaskId> dependencies)
+{
+	const TaskId id = mTasks.size();
+
+	Task task;
+	task.Name = name;
+	task.TaskLane = lane;
+	task.Work = std::move(work);
+
+	for (TaskId dependency : dependencies)
+	{
+		// Depending only on earlier tasks keeps the graph acyclic.
+		assert(dependency < id);
+		mTasks[dependency].Dependents.push_back(id);
+		++task.DependencyCount;
+	}
+
+	mTasks.push_back(std::move(task));
+	return id;
+}
+
+void TaskGraph::Run()
+{
+	using Clock = std::chrono::steady_clock;
+
+	JobSystem& jobs = JobSystem::Default();
+	const size_t numTasks = mTasks.size();
+
+	mTimings.assign(numTasks, Timing());
+	for (size_t i = 0; i < numTasks; ++i)
+	{
+		mTimings[i].Name = mTasks[i].Name;
+		mTimings[i].TaskLane = mTasks[i].TaskLane;
+	}
+
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	// Ready main tasks run lowest id first; ready worker tasks go to the pool as they
+	// become ready.
+	std::priority_queue<TaskId, std::vector<TaskId>, std::greater<TaskId>> mainReady;
+
+	std::vector<size_t> remaining(numTasks);
+	size_t queued = 0;		// worker tasks given to the pool and not yet started
+	size_t finished = 0;
+	size_t running = 0;
+	std::exception_ptr error;
+
+	// The threads that ran tasks, in the order they ran their first; the calling thread
+	// is 0.
+	std::vector<std::thread::id> threads(1, std::this_thread::get_id());
+	auto threadIndex = [&]()
+	{
+		const std::thread::id id = std::this_thread::get_id();
+		auto found = std::find(threads.begin(), threads.end(), id);
+		if (found != threads.end())
+			return (unsigned)(found - threads.begin());
+
+		threads.push_back(id);
+		return (unsigned)threads.size() - 1;
+	};
+
+	const Clock::time_point start = Clock::now();
+	auto elapsedMs = [&]()
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	// Declared after everything its jobs use, so that on the way out it is destroyed,
+	// and waits for them, first.
+	JobSystem::TaskGroup group(jobs);
+
+	// Called with the lock held.
+	std::function<void(TaskId)> makeReady;
+
+	// Called with the lock held; runs the task without it.
+	auto execute = [&](TaskId id, std::unique_lock<std::mutex>& lock)
+	{
+		++running;
+		Timing& timing = mTimings[id];
+		timing.Thread = threadIndex();
+		lock.unlock();
+
+		timing.StartMs = elapsedMs();
+
+		std::exception_ptr taskError;
+		try
+		{
+			mTasks[id].Work();
+		}
+		catch (...)
+		{
+			taskError = std::current_exception();
+		}
+
+		timing.EndMs = elapsedMs();
+
+		lock.lock();
+		--running;
+		++finished;
+
+		if (taskError)
+		{
+			if (!error)
+				error = taskError;
+		}
+		else
+		{
+			for (TaskId dependent : mTasks[id].Dependents)
+				if (--remaining[dependent] == 0)
+					makeReady(dependent);
+		}
+
+		wake.notify_all();
+	};
+
+	makeReady = [&](TaskId id)
+	{
+		if (mTasks[id].TaskLane == Lane::Main)
+		{
+			mainReady.push(id);
+			return;
+		}
+
+		++queued;
+		group.Run([&, id]()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			--queued;
+			if (!error)
+				execute(id, lock);
+		});
+	};
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		for (TaskId id = 0; id < numTasks; ++id)
+		{
+			remaining[id] = mTasks[id].DependencyCount;
+			if (remaining[id] == 0)
+				makeReady(id);
+		}
+
+		auto isDone = [&]() { return finished == numTasks || (error && running == 0); };
+		for (;;)
+		{
+			if (isDone())
+				break;
+
+			if (!error && !mainReady.empty())
+			{
+				TaskId id = mainReady.top();
+				mainReady.pop();
+				execute(id, lock);
+				continue;
+			}
+
+			// Help with the worker tasks, or wait until there is something to do.  Another
+			// thread that waits on the pool may take a queued task, so this one looks
+			// again whenever tasks are queued, even if the pool has no workers.
+			lock.unlock();
+			const bool ranJob = jobs.RunOne();
+			lock.lock();
+
+			if (!ranJob)
+				wake.wait(lock, [&]() { return isDone() || (!error && (!mainReady.empty() || queued > 0)); });
+		}
+
+		mThreadCount = (unsigned)threads.size();
+	}
+
+	// Worker tasks still queued after a failure see the error and return.
+	group.Wait();
+
+	mTotalMs = elapsedMs();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+std::string TaskGraph::Report(const std::string& title)const
+{
+	double taskMs = 0.0;
+	for (const Timing& timing : mTimings)
+		taskMs += timing.EndMs - timing.StartMs;
+
+	char line[256];
+	std::snprintf(line, sizeof(line), "%s: %zu tasks in %.1f ms on %u threads (%.1f ms of task time)\n",
+		title.c_str(), mTimings.size(), mTotalMs, mThreadCount, taskMs);
+	std::string report = line;
+
+	std::vector<const Timing*> byStart;
+	for (const Timing& timing : mTimings)
+		byStart.push_back(&timing);
+	std::stable_sort(byStart.begin(), byStart.end(), [](const Timing* a, const Timing* b)
+	{
+		return a->StartMs < b->StartMs;
+	});
+
+	for (const Timing* timing : byStart)
+	{
+		char thread[24];
+		if (timing->Thread == 0)
+			std::snprintf(thread, sizeof(thread), "main");
+		else
+			std::snprintf(thread, sizeof(thread), "worker %u", timing->Thread);
+
+		std::snprintf(line, sizeof(line), "  %8.1f ms +%8.1f ms  %-9s  %s\n",
+			timing->StartMs, timing->EndMs - timing->StartMs, thread, timing->Name.c_str());
+		report += line;
+	}
+
+	return report;
+}
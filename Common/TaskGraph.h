@@ -0,0 +1,84 @@
+//***************************************************************************************
+// TaskGraph.h
+//
+// Runs a small graph of coarse tasks (application start-up: file reads, shader
+// compilation, mesh generation, resource creation) on JobSystem::Default().
+//
+// Add() tasks with the ids of the tasks they wait for; a task can only depend on tasks
+// added before it, so the graph can not have cycles.  Worker tasks are queued on the
+// pool as soon as they are ready and run on any of its threads, or on the thread that
+// calls Run() while it has no main task to run.  Main tasks run on that thread, one at
+// a time and, among those that are ready, in the order they were added.  Work that
+// records into a command list or touches other single-threaded state belongs on the
+// main lane.
+//
+// Run() records when each task started and finished; Report() formats the timings for
+// the debug output.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+class TaskGraph
+{
+public:
+	using TaskId = size_t;
+
+	enum class Lane
+	{
+		Worker,
+		Main
+	};
+
+	struct Timing
+	{
+		std::string Name;
+		Lane TaskLane = Lane::Worker;
+		unsigned Thread = 0;		// 0 is the thread that called Run()
+		double StartMs = 0.0;		// from the start of Run()
+		double EndMs = 0.0;
+	};
+
+public:
+	TaskGraph() = default;
+	TaskGraph(const TaskGraph& rhs) = delete;
+	TaskGraph& operator=(const TaskGraph& rhs) = delete;
+	~TaskGraph() = default;
+
+	TaskId Add(const std::string& name, Lane lane, std::function<void()> work,
+		std::initializer_list<TaskId> dependencies = {});
+
+	// Runs every task and returns when all have finished.  If a task throws, no further
+	// tasks are started and the first exception is rethrown once the running ones have
+	// finished.
+	void Run();
+
+	// Timings in the order the tasks were added.  Tasks skipped after a failure keep
+	// zero times.  Threads other than the caller are numbered from 1 in the order they
+	// ran their first task.
+	const std::vector<Timing>& GetTimings()const { return mTimings; }
+	double GetTotalMs()const { return mTotalMs; }
+
+	// One line per task, ordered by start time, after a summary line.
+	std::string Report(const std::string& title)const;
+
+private:
+	struct Task
+	{
+		std::string Name;
+		Lane TaskLane;
+		std::function<void()> Work;
+		std::vector<TaskId> Dependents;
+		size_t DependencyCount = 0;
+	};
+
+	std::vector<Task> mTasks;
+	std::vector<Timing> mTimings;
+	double mTotalMs = 0.0;
+	unsigned mThreadCount = 1;
+};
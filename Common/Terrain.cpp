@@ -0,0 +1,338 @@
+//***************************************************************************************
+// Terrain.cpp
+//***************************************************************************************
+
+#include "Terrain.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+struct Terrain::SelectContext
+{
+	XMFLOAT3 Eye;
+	const Frustum* ViewFrustum;
+	std::vector<Node>* Nodes;
+};
+
+Terrain::Frustum Terrain::FrustumFromMatrix(const XMFLOAT4X4& viewProj)
+{
+	// Gribb and Hartmann: with row vectors, clip = p * M, and each plane is a sum or
+	// difference of the matrix columns.
+	auto column = [&](int j)
+	{
+		return XMFLOAT4(viewProj.m[0][j], viewProj.m[1][j], viewProj.m[2][j], viewProj.m[3][j]);
+	};
+	auto add = [](const XMFLOAT4& a, const XMFLOAT4& b, float sign)
+	{
+		return XMFLOAT4(a.x + sign * b.x, a.y + sign * b.y, a.z + sign * b.z, a.w + sign * b.w);
+	};
+
+	const XMFLOAT4 x = column(0);
+	const XMFLOAT4 y = column(1);
+	const XMFLOAT4 z = column(2);
+	const XMFLOAT4 w = column(3);
+
+	Frustum frustum;
+	frustum.Planes[0] = add(w, x, +1.0f);	// left
+	frustum.Planes[1] = add(w, x, -1.0f);	// right
+	frustum.Planes[2] = add(w, y, +1.0f);	// bottom
+	frustum.Planes[3] = add(w, y, -1.0f);	// top
+	frustum.Planes[4] = z;					// near
+	frustum.Planes[5] = add(w, z, -1.0f);	// far
+	return frustum;
+}
+
+void Terrain::Build(const Heightfield& heightfield, const Settings& settings)
+{
+	assert(heightfield.Width() >= 2 && heightfield.Depth() >= 2);
+	assert(settings.PatchSize >= 2 && settings.PatchSize <= 128);
+	assert((settings.PatchSize & (settings.PatchSize - 1)) == 0);
+
+	mPatchSize = settings.PatchSize;
+	mOriginX = heightfield.OriginX();
+	mOriginZ = heightfield.OriginZ();
+	mHeightScale = heightfield.HeightScale();
+	mHeightOffset = heightfield.HeightOffset();
+
+	const uint32 width = heightfield.Width();
+	const uint32 depth = heightfield.Depth();
+	const uint32 cellsX = width - 1;
+	const uint32 cellsZ = depth - 1;
+
+	uint32 lodCount = settings.LodCount;
+	if (lodCount == 0)
+	{
+		lodCount = 1;
+		while (((std::uint64_t)mPatchSize << (lodCount - 1)) < std::max(cellsX, cellsZ) && lodCount < MaxLodCount)
+			++lodCount;
+	}
+	if (lodCount > MaxLodCount)
+		lodCount = MaxLodCount;
+
+	mLevels.assign(lodCount, Level());
+	for (uint32 l = 0; l < lodCount; ++l)
+	{
+		const std::uint64_t nodeCells = (std::uint64_t)mPatchSize << l;
+
+		Level& level = mLevels[l];
+		level.NodesX = (uint32)((cellsX + nodeCells - 1) / nodeCells);
+		level.NodesZ = (uint32)((cellsZ + nodeCells - 1) / nodeCells);
+		level.NodeSize = nodeCells * heightfield.Spacing();
+		level.HeightRange.resize((size_t)level.NodesX * level.NodesZ * 2);
+	}
+
+	// Level 0 from the samples, including the ones on the far edges of each node.
+	{
+		Level& level = mLevels[0];
+		const uint16* samples = heightfield.Samples();
+
+		Parallel::For(level.NodesZ, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t nz = begin; nz < end; ++nz)
+			{
+				const uint32 z0 = (uint32)nz * mPatchSize;
+				const uint32 z1 = std::min(z0 + mPatchSize, depth - 1);
+
+				for (uint32 nx = 0; nx < level.NodesX; ++nx)
+				{
+					const uint32 x0 = nx * mPatchSize;
+					const uint32 x1 = std::min(x0 + mPatchSize, width - 1);
+
+					uint16 minSample = 0xFFFF;
+					uint16 maxSample = 0;
+					for (uint32 z = z0; z <= z1; ++z)
+					{
+						const uint16* row = samples + (size_t)z * width;
+						for (uint32 x = x0; x <= x1; ++x)
+						{
+							minSample = std::min(minSample, row[x]);
+							maxSample = std::max(maxSample, row[x]);
+						}
+					}
+
+					uint16* range = &level.HeightRange[(nz * level.NodesX + nx) * 2];
+					range[0] = minSample;
+					range[1] = maxSample;
+				}
+			}
+		});
+	}
+
+	// Each coarser level from the up to four children of each node.
+	for (uint32 l = 1; l < lodCount; ++l)
+	{
+		const Level& children = mLevels[l - 1];
+		Level& level = mLevels[l];
+
+		for (uint32 nz = 0; nz < level.NodesZ; ++nz)
+		{
+			for (uint32 nx = 0; nx < level.NodesX; ++nx)
+			{
+				uint16 minSample = 0xFFFF;
+				uint16 maxSample = 0;
+				for (uint32 cz = 2 * nz; cz < std::min(2 * nz + 2, children.NodesZ); ++cz)
+				{
+					for (uint32 cx = 2 * nx; cx < std::min(2 * nx + 2, children.NodesX); ++cx)
+					{
+						const uint16* child = &children.HeightRange[((size_t)cz * children.NodesX + cx) * 2];
+						minSample = std::min(minSample, child[0]);
+						maxSample = std::max(maxSample, child[1]);
+					}
+				}
+
+				uint16* range = &level.HeightRange[((size_t)nz * level.NodesX + nx) * 2];
+				range[0] = minSample;
+				range[1] = maxSample;
+			}
+		}
+	}
+
+	// The distance bands.  Where level l meets level l + 1, the level-l vertices are
+	// at most LodDistance(l) plus a level-l node diagonal from the eye, and those of
+	// level l + 1 must not have started to morph yet; the bands are widened until they
+	// can not have.
+	const float morphStartRatio = std::min(std::max(settings.MorphStartRatio, 0.05f), 0.95f);
+
+	float previous = 0.0f;
+	for (uint32 l = 0; l < lodCount; ++l)
+	{
+		Level& level = mLevels[l];
+		if (l == 0)
+		{
+			level.Distance = settings.FinestLodDistance;
+		}
+		else
+		{
+			const Level& finer = mLevels[l - 1];
+
+			uint32 heightRange = 0;
+			for (size_t i = 0; i < finer.HeightRange.size(); i += 2)
+				heightRange = std::max<uint32>(heightRange, finer.HeightRange[i + 1] - finer.HeightRange[i]);
+
+			const float height = heightRange * mHeightScale;
+			const float diagonal = std::sqrt(2.0f * finer.NodeSize * finer.NodeSize + height * height);
+			level.Distance = std::max(previous * settings.LodDistanceRatio, previous + diagonal / morphStartRatio);
+		}
+
+		level.MorphStart = previous + (level.Distance - previous) * morphStartRatio;
+		previous = level.Distance;
+	}
+}
+
+void Terrain::Select(const XMFLOAT3& eye, const Frustum& frustum, std::vector<Node>& nodes)const
+{
+	PROFILE_ZONE("Terrain::Select");
+
+	nodes.clear();
+	if (mLevels.empty())
+		return;
+
+	SelectContext context;
+	context.Eye = eye;
+	context.ViewFrustum = &frustum;
+	context.Nodes = &nodes;
+
+	const uint32 top = LodCount() - 1;
+	for (uint32 z = 0; z < mLevels[top].NodesZ; ++z)
+		for (uint32 x = 0; x < mLevels[top].NodesX; ++x)
+			SelectNode(context, top, x, z, false);
+}
+
+// Returns false when the node is beyond its level's distance band, so that the
+// parent draws the area itself.
+bool Terrain::SelectNode(SelectContext& context, uint32 level, uint32 x, uint32 z, bool insideFrustum)const
+{
+	Node node = MakeNode(level, x, z);
+
+	if (!IsInRange(context.Eye, node, mLevels[level].Distance))
+		return false;
+
+	// Handled, with nothing to draw.
+	if (!insideFrustum)
+	{
+		Visibility visibility = TestBox(*context.ViewFrustum, node);
+		if (visibility == Visibility::Outside)
+			return true;
+
+		insideFrustum = visibility == Visibility::Inside;
+	}
+
+	if (level == 0 || !IsInRange(context.Eye, node, mLevels[level - 1].Distance))
+	{
+		context.Nodes->push_back(node);
+		return true;
+	}
+
+	// Children beyond the finer band are drawn as quadrants of this node; children
+	// past the edge of the heightfield are not drawn at all.
+	const Level& children = mLevels[level - 1];
+
+	uint32 quadrantMask = 0;
+	for (uint32 q = 0; q < 4; ++q)
+	{
+		const uint32 cx = 2 * x + (q & 1);
+		const uint32 cz = 2 * z + (q >> 1);
+		if (cx >= children.NodesX || cz >= children.NodesZ)
+			continue;
+
+		if (!SelectNode(context, level - 1, cx, cz, insideFrustum))
+			quadrantMask |= 1u << q;
+	}
+
+	if (quadrantMask != 0)
+	{
+		node.QuadrantMask = quadrantMask;
+		context.Nodes->push_back(node);
+	}
+
+	return true;
+}
+
+Terrain::Node Terrain::MakeNode(uint32 level, uint32 x, uint32 z)const
+{
+	const Level& lod = mLevels[level];
+	const uint16* range = &lod.HeightRange[((size_t)z * lod.NodesX + x) * 2];
+
+	Node node;
+	node.X = mOriginX + x * lod.NodeSize;
+	node.Z = mOriginZ + z * lod.NodeSize;
+	node.Size = lod.NodeSize;
+	node.MinY = mHeightOffset + range[0] * mHeightScale;
+	node.MaxY = mHeightOffset + range[1] * mHeightScale;
+	node.Level = level;
+	node.QuadrantMask = AllQuadrants;
+	return node;
+}
+
+Terrain::Visibility Terrain::TestBox(const Frustum& frustum, const Node& box)
+{
+	Visibility visibility = Visibility::Inside;
+	for (const XMFLOAT4& plane : frustum.Planes)
+	{
+		// The corners furthest along and furthest against the plane normal.
+		const float farX = plane.x >= 0.0f ? box.X + box.Size : box.X;
+		const float farY = plane.y >= 0.0f ? box.MaxY : box.MinY;
+		const float farZ = plane.z >= 0.0f ? box.Z + box.Size : box.Z;
+		if (plane.x * farX + plane.y * farY + plane.z * farZ + plane.w < 0.0f)
+			return Visibility::Outside;
+
+		const float nearX = plane.x >= 0.0f ? box.X : box.X + box.Size;
+		const float nearY = plane.y >= 0.0f ? box.MinY : box.MaxY;
+		const float nearZ = plane.z >= 0.0f ? box.Z : box.Z + box.Size;
+		if (plane.x * nearX + plane.y * nearY + plane.z * nearZ + plane.w < 0.0f)
+			visibility = Visibility::Intersecting;
+	}
+
+	return visibility;
+}
+
+bool Terrain::IsInRange(const XMFLOAT3& eye, const Node& box, float distance)
+{
+	const float dx = std::max(std::max(box.X - eye.x, eye.x - (box.X + box.Size)), 0.0f);
+	const float dy = std::max(std::max(box.MinY - eye.y, eye.y - box.MaxY), 0.0f);
+	const float dz = std::max(std::max(box.Z - eye.z, eye.z - (box.Z + box.Size)), 0.0f);
+	return dx * dx + dy * dy + dz * dz <= distance * distance;
+}
+
+void Terrain::BuildPatch(uint32 patchSize, std::vector<XMFLOAT2>& vertices, std::vector<uint16>& indices)
+{
+	const uint32 n = patchSize + 1;
+	assert(n * n <= 0x10000);
+
+	vertices.resize(n * n);
+	for (uint32 z = 0; z < n; ++z)
+		for (uint32 x = 0; x < n; ++x)
+			vertices[z * n + x] = XMFLOAT2((float)x / patchSize, (float)z / patchSize);
+
+	// Same winding as GeometryGenerator::CreateGrid, whose rows run the other way.
+	const uint32 half = patchSize / 2;
+	indices.resize(4 * QuadrantIndexCount(patchSize));
+
+	size_t k = 0;
+	for (uint32 q = 0; q < 4; ++q)
+	{
+		const uint32 x0 = (q & 1) * half;
+		const uint32 z0 = (q >> 1) * half;
+
+		for (uint32 z = z0; z < z0 + half; ++z)
+		{
+			for (uint32 x = x0; x < x0 + half; ++x)
+			{
+				indices[k] = (uint16)((z + 1) * n + x);
+				indices[k + 1] = (uint16)((z + 1) * n + x + 1);
+				indices[k + 2] = (uint16)(z * n + x);
+
+				indices[k + 3] = (uint16)(z * n + x);
+				indices[k + 4] = (uint16)((z + 1) * n + x + 1);
+				indices[k + 5] = (uint16)(z * n + x + 1);
+
+				k += 6;
+			}
+		}
+	}
+}
@@ -0,0 +1,146 @@
+//***************************************************************************************
+// Terrain.h
+//
+// Continuous distance-dependent level of detail (CDLOD) for a Heightfield.
+//
+// The heightfield is covered by a quadtree of nodes.  A level-0 node spans PatchSize
+// x PatchSize heightfield cells, and each level up doubles the side.  Every node is
+// drawn with the same (PatchSize + 1)^2 vertex patch, scaled to the node, and the
+// vertex shader reads the heights from the heightfield.  The quadtree only keeps the
+// height range of each node (two 16-bit values), so a 16k x 16k heightfield needs
+// about 1.4 MB of it with 32-cell patches.
+//
+// Level l is drawn out to LodDistance(l) from the eye.  Select() walks down from the
+// roots and stops at the first level whose distance band contains a node, or at the
+// quadrants of it that are beyond the next finer band; nodes outside the frustum are
+// skipped.  The work depends on the number of nodes drawn, not the heightfield size.
+//
+// Between MorphStart(l) and MorphEnd(l) == LodDistance(l) the shader moves the odd
+// vertices of a level-l patch onto the even ones, so the patch has become the level
+// l + 1 grid by the time the next level takes over: there is no popping, and
+// neighbouring nodes, which are at most one level apart, meet without cracks.  Build()
+// widens the distance bands where the requested ones are too narrow to guarantee that.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Heightfield.h"
+
+class Terrain
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	static const uint32 MaxLodCount = 16;
+	static const uint32 AllQuadrants = 0xF;
+
+	struct Settings
+	{
+		// Cells along each side of the patch; a power of two from 2 to 128.
+		uint32 PatchSize = 32;
+
+		// Levels of detail.  0 uses enough levels for one root node to cover the
+		// heightfield; fewer leave a grid of root nodes.
+		uint32 LodCount = 0;
+
+		// Level 0 is drawn out to FinestLodDistance, and each coarser level
+		// LodDistanceRatio times as far as the one before.
+		float FinestLodDistance = 16.0f;
+		float LodDistanceRatio = 2.0f;
+
+		// Fraction of each level's distance band after which its vertices start to
+		// morph.
+		float MorphStartRatio = 0.66f;
+	};
+
+	// A node chosen by Select().  Quadrant q covers the x half (q & 1) and the z half
+	// (q >> 1) of the node; QuadrantMask has a bit for each quadrant to draw.
+	struct Node
+	{
+		float X = 0.0f;			// world xz of the corner with the smallest coordinates
+		float Z = 0.0f;
+		float Size = 0.0f;
+		float MinY = 0.0f;
+		float MaxY = 0.0f;
+		uint32 Level = 0;
+		uint32 QuadrantMask = AllQuadrants;
+	};
+
+	// World-space planes (a, b, c, d), with a point p inside when
+	// a * p.x + b * p.y + c * p.z + d >= 0 for all six.
+	struct Frustum
+	{
+		DirectX::XMFLOAT4 Planes[6];
+	};
+
+public:
+	Terrain() = default;
+	Terrain(const Terrain& rhs) = delete;
+	Terrain& operator=(const Terrain& rhs) = delete;
+	~Terrain() = default;
+
+	// The planes of a row-vector view-projection matrix with a [0, 1] depth range.
+	static Frustum FrustumFromMatrix(const DirectX::XMFLOAT4X4& viewProj);
+
+	// Builds the quadtree's height ranges on all cores.  No reference to the
+	// heightfield is kept.
+	void Build(const Heightfield& heightfield, const Settings& settings);
+
+	// Replaces nodes with the ones to draw for an eye at 'eye'.  Nothing beyond
+	// LodDistance(LodCount() - 1) is drawn.
+	void Select(const DirectX::XMFLOAT3& eye, const Frustum& frustum, std::vector<Node>& nodes)const;
+
+	uint32 PatchSize()const { return mPatchSize; }
+	uint32 LodCount()const { return (uint32)mLevels.size(); }
+	float LodDistance(uint32 level)const { return mLevels[level].Distance; }
+	float MorphStart(uint32 level)const { return mLevels[level].MorphStart; }
+	float MorphEnd(uint32 level)const { return mLevels[level].Distance; }
+
+	// The patch every node is drawn with: (patchSize + 1)^2 vertices over [0, 1]^2 in
+	// rows of increasing z, and the triangles of quadrant q in indices
+	// [q * QuadrantIndexCount(), (q + 1) * QuadrantIndexCount()).
+	static void BuildPatch(uint32 patchSize, std::vector<DirectX::XMFLOAT2>& vertices, std::vector<uint16>& indices);
+	static uint32 QuadrantIndexCount(uint32 patchSize) { return (patchSize / 2) * (patchSize / 2) * 6; }
+
+private:
+	struct Level
+	{
+		uint32 NodesX = 0;
+		uint32 NodesZ = 0;
+		float NodeSize = 0.0f;
+		float Distance = 0.0f;
+		float MorphStart = 0.0f;
+
+		// Minimum and maximum sample of each node, row by row.
+		std::vector<uint16> HeightRange;
+	};
+
+	enum class Visibility
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	struct SelectContext;
+
+	bool SelectNode(SelectContext& context, uint32 level, uint32 x, uint32 z, bool insideFrustum)const;
+	Node MakeNode(uint32 level, uint32 x, uint32 z)const;
+
+	static Visibility TestBox(const Frustum& frustum, const Node& box);
+	static bool IsInRange(const DirectX::XMFLOAT3& eye, const Node& box, float distance);
+
+private:
+	uint32 mPatchSize = 32;
+	float mOriginX = 0.0f;
+	float mOriginZ = 0.0f;
+	float mHeightScale = 1.0f;
+	float mHeightOffset = 0.0f;
+
+	std::vector<Level> mLevels;
+};
@@ -0,0 +1,231 @@
+//***************************************************************************************
+// TexturePacker.cpp
+//***************************************************************************************
+
+#include "TexturePacker.h"
+#include "MappedFile.h"
+#include "ContentHash.h"
+
+using Microsoft::WRL::ComPtr;
+
+void TexturePacker::Add(const std::string& name, const std::wstring& filename, unsigned int loadFlags)
+{
+	Entry entry;
+	entry.Name = name;
+	entry.Filename = filename;
+	entry.LoadFlags = loadFlags;
+	mEntries.push_back(std::move(entry));
+}
+
+void TexturePacker::Build(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, UINT maxArrays, UINT minGroupSize)
+{
+	struct Group
+	{
+		D3D12_RESOURCE_DESC Desc;
+		unsigned int LoadFlags;
+		std::vector<size_t> Members;
+	};
+
+	std::vector<Group> groups;
+
+	// Entries whose file and flags match an earlier entry take its slice instead of
+	// their own.
+	std::vector<MappedFile> files(mEntries.size());
+	std::vector<size_t> duplicateOf(mEntries.size(), SIZE_MAX);
+	std::unordered_map<std::uint64_t, size_t> hashes;
+	mDuplicateBytes = 0;
+
+	// Group by the layout in the file header.  Textures with the same layout and load
+	// flags come out of the loader with the same layout too, so nothing has to be
+	// loaded to decide what can share an array.
+	for (size_t i = 0; i < mEntries.size(); ++i)
+	{
+		Entry& entry = mEntries[i];
+		entry.Array = -1;
+		entry.Slice = 0;
+
+		// Files that can not be read are left to the caller's loader, which reports them.
+		MappedFile& file = files[i];
+		if (!file.Open(entry.Filename.c_str()))
+			continue;
+
+		std::uint64_t hash = ContentHash::Hash64(file.Data(), (size_t)file.Size());
+		hash = ContentHash::Combine(hash, &entry.LoadFlags, sizeof(entry.LoadFlags));
+
+		auto match = hashes.find(hash);
+		if (match != hashes.end())
+		{
+			const MappedFile& other = files[match->second];
+			if (other.Size() == file.Size() && memcmp(other.Data(), file.Data(), (size_t)file.Size()) == 0)
+			{
+				duplicateOf[i] = match->second;
+				continue;
+			}
+		}
+		else
+		{
+			hashes[hash] = i;
+		}
+
+		D3D12_RESOURCE_DESC desc;
+		bool isCubeMap = false;
+		if (FAILED(DirectX::GetDDSTextureLayout12(file.Data(), (size_t)file.Size(), &desc, nullptr, 0, &isCubeMap)))
+			continue;
+
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || desc.DepthOrArraySize != 1 || isCubeMap)
+			continue;
+
+		auto group = std::find_if(groups.begin(), groups.end(), [&](const Group& g)
+		{
+			return g.Desc.Format == desc.Format && g.Desc.Width == desc.Width && g.Desc.Height == desc.Height &&
+				g.Desc.MipLevels == desc.MipLevels && g.LoadFlags == entry.LoadFlags;
+		});
+
+		if (group == groups.end())
+		{
+			groups.push_back({ desc, entry.LoadFlags, {} });
+			group = groups.end() - 1;
+		}
+
+		group->Members.push_back(i);
+	}
+
+	minGroupSize = std::max(minGroupSize, 2u);
+
+	for (const Group& group : groups)
+	{
+		if (group.Members.size() < minGroupSize || mArrays.size() >= maxArrays)
+			continue;
+
+		const UINT numSlices = (UINT)std::min<size_t>(group.Members.size(), D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION);
+
+		std::vector<ComPtr<ID3D12Resource>> sources(numSlices);
+		for (UINT slice = 0; slice < numSlices; ++slice)
+		{
+			const Entry& entry = mEntries[group.Members[slice]];
+
+			ComPtr<ID3D12Resource> uploadHeap;
+			ThrowIfFailed(DirectX::CreateDDSTextureFromFile12Ex(device, cmdList, entry.Filename.c_str(),
+				sources[slice], uploadHeap, entry.LoadFlags));
+
+			mStaging.push_back(sources[slice]);
+			mStaging.push_back(uploadHeap);
+		}
+
+		D3D12_RESOURCE_DESC arrayDesc = sources[0]->GetDesc();
+		for (UINT slice = 1; slice < numSlices; ++slice)
+		{
+			D3D12_RESOURCE_DESC desc = sources[slice]->GetDesc();
+			if (desc.Format != arrayDesc.Format || desc.Width != arrayDesc.Width ||
+				desc.Height != arrayDesc.Height || desc.MipLevels != arrayDesc.MipLevels)
+				ThrowIfFailed(E_UNEXPECTED);
+		}
+		arrayDesc.DepthOrArraySize = (UINT16)numSlices;
+
+		ComPtr<ID3D12Resource> textureArray;
+		ThrowIfFailed(device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&arrayDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&textureArray)));
+
+		// The loader leaves each source ready for shaders; the copies need them as sources.
+		std::vector<D3D12_RESOURCE_BARRIER> barriers;
+		for (auto& source : sources)
+			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(source.Get(),
+				D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+		cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+		const UINT arrayIndex = (UINT)mArrays.size();
+		for (UINT slice = 0; slice < numSlices; ++slice)
+		{
+			for (UINT mip = 0; mip < arrayDesc.MipLevels; ++mip)
+			{
+				CD3DX12_TEXTURE_COPY_LOCATION dest(textureArray.Get(),
+					D3D12CalcSubresource(mip, slice, 0, arrayDesc.MipLevels, numSlices));
+				CD3DX12_TEXTURE_COPY_LOCATION src(sources[slice].Get(), mip);
+				cmdList->CopyTextureRegion(&dest, 0, 0, 0, &src, nullptr);
+			}
+
+			Entry& entry = mEntries[group.Members[slice]];
+			entry.Array = (int)arrayIndex;
+			entry.Slice = slice;
+		}
+
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(textureArray.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+		mArrays.push_back(textureArray);
+	}
+
+	for (size_t i = 0; i < mEntries.size(); ++i)
+	{
+		if (duplicateOf[i] == SIZE_MAX)
+			continue;
+
+		mEntries[i].Array = mEntries[duplicateOf[i]].Array;
+		mEntries[i].Slice = mEntries[duplicateOf[i]].Slice;
+
+		// Unpacked duplicates are loaded, and shared, by the caller.
+		if (mEntries[i].Array >= 0)
+			mDuplicateBytes += files[i].Size();
+	}
+}
+
+void TexturePacker::ReleaseStaging()
+{
+	mStaging.clear();
+}
+
+void TexturePacker::WriteSrvs(ID3D12Device* device, CD3DX12_CPU_DESCRIPTOR_HANDLE first, UINT descriptorSize, UINT numSlots)const
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE handle = first;
+	for (UINT i = 0; i < numSlots; ++i)
+	{
+		if (i < mArrays.size())
+		{
+			D3D12_RESOURCE_DESC desc = mArrays[i]->GetDesc();
+			srvDesc.Format = desc.Format;
+			srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+			srvDesc.Texture2DArray.ArraySize = desc.DepthOrArraySize;
+			device->CreateShaderResourceView(mArrays[i].Get(), &srvDesc, handle);
+		}
+		else
+		{
+			srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			srvDesc.Texture2DArray.MipLevels = 1;
+			srvDesc.Texture2DArray.ArraySize = 1;
+			device->CreateShaderResourceView(nullptr, &srvDesc, handle);
+		}
+
+		handle.Offset(1, descriptorSize);
+	}
+}
+
+const TexturePacker::Entry* TexturePacker::Find(const std::string& name)const
+{
+	for (const Entry& entry : mEntries)
+		if (entry.Name == name)
+			return &entry;
+
+	return nullptr;
+}
+
+UINT TexturePacker::GetPackedCount()const
+{
+	UINT count = 0;
+	for (const Entry& entry : mEntries)
+		if (entry.Array >= 0)
+			++count;
+
+	return count;
+}
@@ -0,0 +1,73 @@
+//***************************************************************************************
+// TexturePacker.h
+//
+// Packs 2D DDS textures of the same size, format and mip count into Texture2DArrays,
+// so materials that differ only in their maps differ only by an array slice.
+//
+// Add() every candidate, then Build().  Build reads the DDS headers and groups the
+// textures whose layout and load flags match; each group with at least minGroupSize
+// members is loaded, processed by the usual DDS_LOADER_* options, and copied on the
+// GPU into the slices of one array.  The rest are left unpacked for the caller to load
+// as ordinary textures (GetEntries() reports which is which).  Entries with the same
+// file contents and flags as an earlier one share its slice.
+//
+// An atlas would save the array but breaks wrap addressing and bleeds neighbouring
+// cells into the lower mips, which sphere and tiling maps can not afford.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class TexturePacker
+{
+public:
+	struct Entry
+	{
+		std::string Name;
+		std::wstring Filename;
+		unsigned int LoadFlags = DirectX::DDS_LOADER_DEFAULT;
+
+		// Array index and slice after Build(), or Array == -1 if not packed.
+		int Array = -1;
+		UINT Slice = 0;
+	};
+
+public:
+	TexturePacker() = default;
+	TexturePacker(const TexturePacker& rhs) = delete;
+	TexturePacker& operator=(const TexturePacker& rhs) = delete;
+	~TexturePacker() = default;
+
+	void Add(const std::string& name, const std::wstring& filename,
+		unsigned int loadFlags = DirectX::DDS_LOADER_MIP_AUTOGEN);
+
+	// Records the loads and copies on cmdList.  At most maxArrays arrays are built;
+	// groups beyond that stay unpacked.  Call ReleaseStaging() once cmdList has
+	// executed.
+	void Build(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, UINT maxArrays, UINT minGroupSize = 2);
+
+	// Frees the standalone textures and upload heaps the arrays were copied from.
+	void ReleaseStaging();
+
+	// Writes one Texture2DArray SRV per array from 'first' on, then null array SRVs up
+	// to numSlots.
+	void WriteSrvs(ID3D12Device* device, CD3DX12_CPU_DESCRIPTOR_HANDLE first, UINT descriptorSize, UINT numSlots)const;
+
+	const std::vector<Entry>& GetEntries()const { return mEntries; }
+	const Entry* Find(const std::string& name)const;
+
+	UINT GetArrayCount()const { return (UINT)mArrays.size(); }
+	ID3D12Resource* GetArray(UINT index)const { return mArrays[index].Get(); }
+
+	// Textures packed by the last Build(), and the file bytes of the packed entries
+	// that share another entry's slice.
+	UINT GetPackedCount()const;
+	UINT64 GetDuplicateBytes()const { return mDuplicateBytes; }
+
+private:
+	std::vector<Entry> mEntries;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mArrays;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mStaging;
+	UINT64 mDuplicateBytes = 0;
+};
@@ -0,0 +1,677 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+
+#include <cmath>
+
+using Microsoft::WRL::ComPtr;
+
+// Streamed textures stay readable both by shaders and as the source of the copy that
+// rebuilds them, so no barrier is needed on the old resource.
+static const D3D12_RESOURCE_STATES gResidentTextureState =
+	D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_COPY_SOURCE;
+
+static const UINT gNoSlot = UINT(-1);
+
+static bool IsBlockCompressed(DXGI_FORMAT format)
+{
+	return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+		(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+TextureStreamer::TextureStreamer(ID3D12Device* device, UINT64 budgetBytes, UINT tailSize, UINT numWorkers)
+{
+	md3dDevice = device;
+	mBudget = budgetBytes;
+	mTailSize = tailSize > 0 ? tailSize : 1;
+
+	if (numWorkers == 0)
+	{
+		UINT hardwareThreads = std::thread::hardware_concurrency();
+		numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		numWorkers = std::min(numWorkers, 4u);
+	}
+
+	for (UINT i = 0; i < numWorkers; ++i)
+		mWorkers.emplace_back(&TextureStreamer::WorkerMain, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		mStop = true;
+	}
+	mQueueCondition.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker.join();
+
+	for (LoadCompletion* c = PopAllCompletions(); c != nullptr;)
+	{
+		LoadCompletion* next = c->Next;
+		delete c;
+		c = next;
+	}
+
+	for (LoadCompletion* c : mDeferred)
+		delete c;
+}
+
+int TextureStreamer::AddTexture(ID3D12GraphicsCommandList* cmdList, const std::wstring& filename, UINT srvIndex,
+	unsigned int loadFlags)
+{
+	MappedFile file;
+	if (!file.Open(filename.c_str()))
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+	return AddTexture(cmdList, filename, file, srvIndex, loadFlags);
+}
+
+int TextureStreamer::AddTexture(ID3D12GraphicsCommandList* cmdList, const std::wstring& filename, MappedFile& file,
+	UINT srvIndex, unsigned int loadFlags)
+{
+	auto tex = std::make_unique<StreamedTexture>();
+	tex->Filename = filename;
+
+	ThrowIfFailed(DirectX::GetDDSTextureLayout12(file.Data(), static_cast<size_t>(file.Size()),
+		&tex->Desc, nullptr, 0, &tex->IsCubeMap));
+
+	// Only single 2D textures with a mip chain are streamed; the caller loads the rest.
+	if (tex->Desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D ||
+		tex->Desc.DepthOrArraySize != 1 || tex->IsCubeMap || tex->Desc.MipLevels < 2)
+	{
+		return -1;
+	}
+
+	tex->File = std::move(file);
+
+	tex->Mips.resize(tex->Desc.MipLevels);
+	ThrowIfFailed(DirectX::GetDDSTextureLayout12(tex->File.Data(), static_cast<size_t>(tex->File.Size()),
+		&tex->Desc, tex->Mips.data(), tex->Mips.size()));
+
+	tex->SourceFormat = tex->Desc.Format;
+	tex->LoadFlags = loadFlags;
+	DXGI_FORMAT bcFormat = DirectX::GetDDSCompressedFormat12(tex->Desc.Format, tex->Desc.Width, tex->Desc.Height, loadFlags);
+	if (bcFormat != DXGI_FORMAT_UNKNOWN)
+		tex->Desc.Format = bcFormat;
+
+	// The tail starts at the first level that fits in mTailSize.  Block-compressed
+	// resources must start at a level whose size is a multiple of the block size.
+	for (UINT mip = 0; mip < tex->Desc.MipLevels; ++mip)
+	{
+		if (!CanStartAt(*tex, mip))
+			continue;
+
+		tex->TailMip = mip;
+
+		UINT64 width = std::max<UINT64>(tex->Desc.Width >> mip, 1);
+		UINT height = std::max<UINT>(tex->Desc.Height >> mip, 1);
+		if (width <= mTailSize && height <= mTailSize)
+			break;
+	}
+
+	tex->ResidentMip = tex->TailMip;
+	tex->DesiredMip = tex->TailMip;
+	tex->SrvIndex = srvIndex;
+
+	D3D12_RESOURCE_DESC desc = MipRangeDesc(*tex, tex->TailMip);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&tex->Resource)));
+
+	const UINT numMips = desc.MipLevels;
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numMips);
+	std::vector<UINT> numRows(numMips);
+	std::vector<UINT64> rowSizes(numMips);
+	UINT64 uploadSize = 0;
+	md3dDevice->GetCopyableFootprints(&desc, 0, numMips, 0,
+		layouts.data(), numRows.data(), rowSizes.data(), &uploadSize);
+
+	ComPtr<ID3D12Resource> upload;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&upload)));
+
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(upload->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+	for (UINT i = 0; i < numMips; ++i)
+	{
+		ThrowIfFailed(CopyMip(*tex, tex->TailMip + i, mappedData + layouts[i].Offset,
+			layouts[i].Footprint.RowPitch, numRows[i], rowSizes[i]));
+
+		CD3DX12_TEXTURE_COPY_LOCATION dst(tex->Resource.Get(), i);
+		CD3DX12_TEXTURE_COPY_LOCATION src(upload.Get(), layouts[i]);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+	upload->Unmap(0, nullptr);
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(tex->Resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, gResidentTextureState));
+
+	mRetired.push_back({ mLastFrameFence + 1, upload, gNoSlot });
+
+	tex->ResidentBytes = AllocationSize(*tex, tex->TailMip);
+	mResidentBytes += tex->ResidentBytes;
+
+	mTextures.push_back(std::move(tex));
+	return (int)mTextures.size() - 1;
+}
+
+void TextureStreamer::BindDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE heapStart, UINT descriptorSize,
+	UINT firstSpareSlot, UINT numSpareSlots)
+{
+	mhCpuHeapStart = heapStart;
+	mDescriptorSize = descriptorSize;
+
+	mFreeSlots.clear();
+	for (UINT i = numSpareSlots; i > 0; --i)
+		mFreeSlots.push_back(firstSpareSlot + i - 1);
+
+	for (auto& tex : mTextures)
+		WriteSrv(*tex, tex->SrvIndex);
+}
+
+void TextureStreamer::RequestResolution(int id, float texels)
+{
+	StreamedTexture& tex = *mTextures[id];
+	tex.RequestedTexels = std::max(tex.RequestedTexels, texels);
+	tex.LastUsedFrame = mFrame;
+}
+
+const std::vector<TextureStreamer::SrvRemap>& TextureStreamer::Update(ID3D12CommandQueue* queue,
+	UINT64 frameFence, UINT64 completedFence)
+{
+	mRemaps.clear();
+	mFrameFence = frameFence;
+	mCompletedFence = completedFence;
+
+	// Release resources and descriptor slots the GPU has finished with.
+	for (auto it = mRetired.begin(); it != mRetired.end();)
+	{
+		if (it->Fence <= completedFence)
+		{
+			if (it->SrvIndex != gNoSlot)
+				mFreeSlots.push_back(it->SrvIndex);
+			it = mRetired.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// Apply finished loads, oldest first.
+	std::vector<LoadCompletion*> ready;
+	ready.swap(mDeferred);
+	for (LoadCompletion* c = PopAllCompletions(); c != nullptr;)
+	{
+		LoadCompletion* next = c->Next;
+		ready.push_back(c);
+		c = next;
+	}
+
+	for (LoadCompletion* c : ready)
+	{
+		StreamedTexture& tex = *mTextures[c->Id];
+
+		if (FAILED(c->Result))
+		{
+			// Keep what is resident and stop asking for finer levels.
+			tex.FinestMip = tex.ResidentMip;
+			::OutputDebugStringW((L"TextureStreamer: failed to load mips of " + tex.Filename + L"\n").c_str());
+		}
+		else
+		{
+			// A texture is never evicted while its load is in flight.
+			assert(c->EndMip == tex.ResidentMip);
+
+			if (!Rebuild(tex, c->FirstMip, c))
+			{
+				// Every spare descriptor is still in use by the GPU; try next frame.
+				mDeferred.push_back(c);
+				continue;
+			}
+		}
+
+		tex.LoadInFlight = false;
+		--mLoadsInFlight;
+		mPendingBytes -= c->Bytes;
+		delete c;
+	}
+
+	// Pick the level each texture needs from this frame's requests.
+	for (auto& tex : mTextures)
+	{
+		tex->DesiredMip = DesiredMipFor(*tex);
+		tex->Priority = tex->RequestedTexels / float(std::max<UINT64>(tex->Desc.Width >> tex->ResidentMip, 1));
+		tex->RequestedTexels = 0.0f;
+	}
+
+	// The budget may have been lowered since the last frame.
+	if (mResidentBytes + mPendingBytes > mBudget)
+		EvictLeastRecentlyUsed(mResidentBytes + mPendingBytes - mBudget, nullptr);
+
+	// Queue loads for the blurriest textures first.
+	std::vector<int> wanted;
+	for (int i = 0; i < (int)mTextures.size(); ++i)
+	{
+		const StreamedTexture& tex = *mTextures[i];
+		if (!tex.LoadInFlight && tex.DesiredMip < tex.ResidentMip)
+			wanted.push_back(i);
+	}
+
+	std::sort(wanted.begin(), wanted.end(), [this](int a, int b)
+	{
+		return mTextures[a]->Priority > mTextures[b]->Priority;
+	});
+
+	bool queued = false;
+	for (int id : wanted)
+	{
+		if (mLoadsInFlight >= mMaxLoadsInFlight)
+			break;
+
+		StreamedTexture& tex = *mTextures[id];
+
+		UINT firstMip = tex.DesiredMip;
+		UINT64 cost = AllocationSize(tex, firstMip) - tex.ResidentBytes;
+
+		if (mResidentBytes + mPendingBytes + cost > mBudget)
+			EvictLeastRecentlyUsed(mResidentBytes + mPendingBytes + cost - mBudget, &tex);
+
+		// Settle for coarser levels if eviction could not make enough room.
+		while (firstMip < tex.ResidentMip && mResidentBytes + mPendingBytes + cost > mBudget)
+		{
+			do
+			{
+				++firstMip;
+			} while (firstMip < tex.ResidentMip && !CanStartAt(tex, firstMip));
+
+			if (firstMip < tex.ResidentMip)
+				cost = AllocationSize(tex, firstMip) - tex.ResidentBytes;
+		}
+
+		if (firstMip >= tex.ResidentMip)
+			continue;
+
+		tex.LoadInFlight = true;
+		++mLoadsInFlight;
+		mPendingBytes += cost;
+
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
+			mRequests.push({ &tex, id, firstMip, tex.ResidentMip, tex.Priority, cost });
+		}
+		queued = true;
+	}
+
+	if (queued)
+		mQueueCondition.notify_all();
+
+	// Submit the rebuild copies ahead of the frame that samples the new resources.
+	if (mRecording)
+	{
+		ThrowIfFailed(mCommandList->Close());
+		ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+		queue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+		mRecording = false;
+	}
+
+	mLastFrameFence = frameFence;
+	++mFrame;
+
+	return mRemaps;
+}
+
+void TextureStreamer::SetBudget(UINT64 budgetBytes)
+{
+	mBudget = budgetBytes;
+}
+
+UINT64 TextureStreamer::GetBudget()const
+{
+	return mBudget;
+}
+
+UINT64 TextureStreamer::GetResidentBytes()const
+{
+	return mResidentBytes;
+}
+
+ID3D12Resource* TextureStreamer::GetResource(int id)const
+{
+	return mTextures[id]->Resource.Get();
+}
+
+UINT TextureStreamer::GetSrvIndex(int id)const
+{
+	return mTextures[id]->SrvIndex;
+}
+
+UINT TextureStreamer::GetResidentMip(int id)const
+{
+	return mTextures[id]->ResidentMip;
+}
+
+void TextureStreamer::WorkerMain()
+{
+	for (;;)
+	{
+		LoadRequest request;
+		{
+			std::unique_lock<std::mutex> lock(mQueueMutex);
+			mQueueCondition.wait(lock, [this] { return mStop || !mRequests.empty(); });
+			if (mStop)
+				return;
+
+			request = mRequests.top();
+			mRequests.pop();
+		}
+
+		auto completion = new LoadCompletion();
+		completion->Id = request.Id;
+		completion->FirstMip = request.FirstMip;
+		completion->EndMip = request.EndMip;
+		completion->Bytes = request.Bytes;
+
+		LoadMips(request, *completion);
+		PushCompletion(completion);
+	}
+}
+
+void TextureStreamer::LoadMips(const LoadRequest& request, LoadCompletion& completion)
+{
+	// Only immutable texture state is read here: the description, the mapping and the
+	// per-mip pointers into it.
+	const StreamedTexture& tex = *request.Texture;
+	const UINT numMips = request.EndMip - request.FirstMip;
+
+	// The footprints of the first numMips subresources match the resource Rebuild
+	// creates for the same first mip.
+	D3D12_RESOURCE_DESC desc = MipRangeDesc(tex, request.FirstMip);
+
+	std::vector<UINT> numRows(numMips);
+	std::vector<UINT64> rowSizes(numMips);
+	UINT64 uploadSize = 0;
+	completion.Layouts.resize(numMips);
+	md3dDevice->GetCopyableFootprints(&desc, 0, numMips, 0,
+		completion.Layouts.data(), numRows.data(), rowSizes.data(), &uploadSize);
+
+	completion.Result = md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&completion.Upload));
+	if (FAILED(completion.Result))
+		return;
+
+	BYTE* mappedData = nullptr;
+	completion.Result = completion.Upload->Map(0, nullptr, reinterpret_cast<void**>(&mappedData));
+	if (FAILED(completion.Result))
+		return;
+
+	// Reading the mapped file here is what pages it in, so the I/O happens on this thread.
+	for (UINT i = 0; i < numMips && SUCCEEDED(completion.Result); ++i)
+	{
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = completion.Layouts[i];
+		completion.Result = CopyMip(tex, request.FirstMip + i, mappedData + layout.Offset,
+			layout.Footprint.RowPitch, numRows[i], rowSizes[i]);
+	}
+
+	completion.Upload->Unmap(0, nullptr);
+}
+
+HRESULT TextureStreamer::CopyMip(const StreamedTexture& tex, UINT mip, BYTE* dest, UINT64 rowPitch,
+	UINT numRows, UINT64 rowSize)const
+{
+	// Textures compressed on load are encoded straight into the upload memory.
+	if (tex.SourceFormat != tex.Desc.Format)
+	{
+		return DirectX::CompressDDSSubresource12(tex.Mips[mip], tex.SourceFormat,
+			std::max<UINT64>(tex.Desc.Width >> mip, 1), std::max<UINT>(tex.Desc.Height >> mip, 1),
+			tex.LoadFlags, dest, static_cast<size_t>(rowPitch));
+	}
+
+	D3D12_MEMCPY_DEST memcpyDest = { dest, static_cast<SIZE_T>(rowPitch), static_cast<SIZE_T>(rowPitch) * numRows };
+	MemcpySubresource(&memcpyDest, &tex.Mips[mip], static_cast<SIZE_T>(rowSize), numRows, 1);
+	return S_OK;
+}
+
+void TextureStreamer::PushCompletion(LoadCompletion* completion)
+{
+	LoadCompletion* head = mCompleted.load(std::memory_order_relaxed);
+	do
+	{
+		completion->Next = head;
+	} while (!mCompleted.compare_exchange_weak(head, completion,
+		std::memory_order_release, std::memory_order_relaxed));
+}
+
+TextureStreamer::LoadCompletion* TextureStreamer::PopAllCompletions()
+{
+	// Taking the whole stack at once means there is no ABA problem on the consumer side.
+	LoadCompletion* list = mCompleted.exchange(nullptr, std::memory_order_acquire);
+
+	// The stack is newest first; reverse it so loads are applied in completion order.
+	LoadCompletion* ordered = nullptr;
+	while (list != nullptr)
+	{
+		LoadCompletion* next = list->Next;
+		list->Next = ordered;
+		ordered = list;
+		list = next;
+	}
+
+	return ordered;
+}
+
+D3D12_RESOURCE_DESC TextureStreamer::MipRangeDesc(const StreamedTexture& tex, UINT firstMip)const
+{
+	D3D12_RESOURCE_DESC desc = tex.Desc;
+	desc.Width = std::max<UINT64>(tex.Desc.Width >> firstMip, 1);
+	desc.Height = std::max<UINT>(tex.Desc.Height >> firstMip, 1);
+	desc.MipLevels = static_cast<UINT16>(tex.Desc.MipLevels - firstMip);
+	return desc;
+}
+
+UINT64 TextureStreamer::AllocationSize(const StreamedTexture& tex, UINT firstMip)const
+{
+	D3D12_RESOURCE_DESC desc = MipRangeDesc(tex, firstMip);
+	return md3dDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+bool TextureStreamer::CanStartAt(const StreamedTexture& tex, UINT mip)const
+{
+	if (mip == 0 || !IsBlockCompressed(tex.Desc.Format))
+		return true;
+
+	UINT64 width = tex.Desc.Width >> mip;
+	UINT height = tex.Desc.Height >> mip;
+	return width > 0 && height > 0 && (width % 4) == 0 && (height % 4) == 0;
+}
+
+UINT TextureStreamer::DesiredMipFor(const StreamedTexture& tex)const
+{
+	UINT mip = tex.TailMip;
+
+	if (tex.RequestedTexels > 0.0f)
+	{
+		// One texel per pixel: every halving of the needed size drops one level.
+		float ratio = float(tex.Desc.Width) / tex.RequestedTexels;
+		mip = ratio > 1.0f ? static_cast<UINT>(std::floor(std::log2(ratio))) : 0;
+		mip = std::min(mip, tex.TailMip);
+	}
+
+	mip = std::max(mip, tex.FinestMip);
+	while (mip > 0 && !CanStartAt(tex, mip))
+		--mip;
+
+	return mip;
+}
+
+ID3D12GraphicsCommandList* TextureStreamer::BeginCommands()
+{
+	if (mRecording)
+		return mCommandList.Get();
+
+	ComPtr<ID3D12CommandAllocator> allocator;
+	if (!mAllocators.empty() && mAllocators.front().first <= mCompletedFence)
+	{
+		allocator = mAllocators.front().second;
+		mAllocators.pop_front();
+		ThrowIfFailed(allocator->Reset());
+	}
+	else
+	{
+		ThrowIfFailed(md3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(allocator.GetAddressOf())));
+	}
+
+	if (mCommandList == nullptr)
+	{
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			allocator.Get(), nullptr, IID_PPV_ARGS(mCommandList.GetAddressOf())));
+	}
+	else
+	{
+		ThrowIfFailed(mCommandList->Reset(allocator.Get(), nullptr));
+	}
+
+	mAllocators.push_back({ mFrameFence, allocator });
+	mRecording = true;
+
+	return mCommandList.Get();
+}
+
+bool TextureStreamer::Rebuild(StreamedTexture& tex, UINT newFirstMip, const LoadCompletion* loaded)
+{
+	if (mFreeSlots.empty())
+		return false;
+
+	D3D12_RESOURCE_DESC desc = MipRangeDesc(tex, newFirstMip);
+
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+
+	ID3D12GraphicsCommandList* cmdList = BeginCommands();
+
+	// Levels that stay resident are copied on the GPU from the old resource.
+	for (UINT mip = std::max(newFirstMip, tex.ResidentMip); mip < tex.Desc.MipLevels; ++mip)
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(), mip - newFirstMip);
+		CD3DX12_TEXTURE_COPY_LOCATION src(tex.Resource.Get(), mip - tex.ResidentMip);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+
+	// Newly loaded levels come from the worker's upload buffer.
+	if (loaded != nullptr)
+	{
+		for (UINT mip = loaded->FirstMip; mip < loaded->EndMip; ++mip)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(), mip - newFirstMip);
+			CD3DX12_TEXTURE_COPY_LOCATION src(loaded->Upload.Get(), loaded->Layouts[mip - loaded->FirstMip]);
+			cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+
+		mRetired.push_back({ mFrameFence, loaded->Upload, gNoSlot });
+	}
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, gResidentTextureState));
+
+	// Frames already submitted keep reading the old resource through the old slot.
+	UINT slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+
+	mRetired.push_back({ mFrameFence, tex.Resource, tex.SrvIndex });
+	mRemaps.push_back({ tex.SrvIndex, slot });
+
+	mResidentBytes -= tex.ResidentBytes;
+	tex.ResidentBytes = AllocationSize(tex, newFirstMip);
+	mResidentBytes += tex.ResidentBytes;
+
+	tex.Resource = resource;
+	tex.ResidentMip = newFirstMip;
+	tex.SrvIndex = slot;
+
+	WriteSrv(tex, slot);
+
+	return true;
+}
+
+UINT64 TextureStreamer::EvictLeastRecentlyUsed(UINT64 bytesNeeded, const StreamedTexture* keep)
+{
+	// Only levels finer than what the texture currently needs are candidates.
+	std::vector<StreamedTexture*> candidates;
+	for (auto& tex : mTextures)
+	{
+		if (tex.get() != keep && !tex->LoadInFlight && tex->ResidentMip < tex->DesiredMip)
+			candidates.push_back(tex.get());
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		return a->LastUsedFrame < b->LastUsedFrame;
+	});
+
+	UINT64 freed = 0;
+	for (StreamedTexture* tex : candidates)
+	{
+		if (freed >= bytesNeeded)
+			break;
+
+		// Drop levels one at a time until enough is freed, then rebuild once.
+		UINT target = tex->ResidentMip;
+		UINT64 size = tex->ResidentBytes;
+		while (target < tex->DesiredMip && freed + (tex->ResidentBytes - size) < bytesNeeded)
+		{
+			do
+			{
+				++target;
+			} while (target < tex->DesiredMip && !CanStartAt(*tex, target));
+
+			size = AllocationSize(*tex, target);
+		}
+
+		UINT64 before = tex->ResidentBytes;
+		if (!Rebuild(*tex, target, nullptr))
+			break;
+
+		freed += before - tex->ResidentBytes;
+	}
+
+	return freed;
+}
+
+void TextureStreamer::WriteSrv(const StreamedTexture& tex, UINT slot)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = tex.Desc.Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = tex.Desc.MipLevels - tex.ResidentMip;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mhCpuHeapStart, (INT)slot, mDescriptorSize);
+	md3dDevice->CreateShaderResourceView(tex.Resource.Get(), &srvDesc, handle);
+}
@@ -0,0 +1,208 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Streams the mip chains of 2D DDS textures under a GPU memory budget.
+//
+// AddTexture maps the file and uploads only the mip tail (every level no larger than
+// tailSize), so the texture can be sampled from the first frame.  Each frame the app
+// reports how many texels it needs across each texture (RequestResolution).  Update()
+// then queues finer levels for the worker threads and evicts the least recently used
+// levels when the budget would be exceeded.
+//
+// Workers copy mip data from the mapped file into an upload buffer and push the
+// result onto a lock-free completion stack.  Update() drains the stack on the render
+// thread and rebuilds each texture with the new resident range.  It records the
+// copies on its own command list, which runs on the queue ahead of the frame.
+//
+// A rebuilt texture gets a new SRV in a spare descriptor slot, because frames still in
+// flight read the old one.  Update() returns the (old, new) slot pairs so materials can
+// be repointed.  Old resources and slots are released once the GPU passes the frame
+// fence that last used them.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "d3dUtil.h"
+#include "MappedFile.h"
+
+class TextureStreamer
+{
+public:
+	struct SrvRemap
+	{
+		UINT OldIndex;
+		UINT NewIndex;
+	};
+
+public:
+	// numWorkers == 0 picks hardware_concurrency() - 1, clamped to [1, 4].
+	TextureStreamer(ID3D12Device* device, UINT64 budgetBytes, UINT tailSize = 64, UINT numWorkers = 0);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	// Maps the file and uploads the mip tail through cmdList.  srvIndex is the
+	// descriptor slot the texture starts in.  The fence value signalled after cmdList
+	// executes must be greater than the last frameFence passed to Update().  Returns
+	// the stream id, or -1 for cube maps, arrays, volumes and textures without a mip
+	// chain, which the caller should load whole.  loadFlags takes the
+	// DDS_LOADER_COMPRESS_* options; compressed textures are encoded as each level is
+	// streamed in.
+	int AddTexture(ID3D12GraphicsCommandList* cmdList, const std::wstring& filename, UINT srvIndex,
+		unsigned int loadFlags = DirectX::DDS_LOADER_DEFAULT);
+
+	// The same for a file the caller has mapped already.  A streamed texture takes the
+	// mapping over; on -1 'file' is left open, so the caller loads from the same view.
+	int AddTexture(ID3D12GraphicsCommandList* cmdList, const std::wstring& filename, MappedFile& file,
+		UINT srvIndex, unsigned int loadFlags = DirectX::DDS_LOADER_DEFAULT);
+
+	// Writes the initial SRV of every texture and hands over the spare slots used when
+	// a texture is rebuilt.  Call after all textures are added.
+	void BindDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE heapStart, UINT descriptorSize,
+		UINT firstSpareSlot, UINT numSpareSlots);
+
+	// Records a use of the texture this frame that needs 'texels' texels across its
+	// width.  Multiple requests in one frame keep the largest.
+	void RequestResolution(int id, float texels);
+
+	// Once per frame on the render thread.  frameFence is the value signalled at the
+	// end of this frame; completedFence is the fence's current completed value.
+	const std::vector<SrvRemap>& Update(ID3D12CommandQueue* queue, UINT64 frameFence, UINT64 completedFence);
+
+	void SetBudget(UINT64 budgetBytes);
+	UINT64 GetBudget()const;
+	UINT64 GetResidentBytes()const;
+
+	ID3D12Resource* GetResource(int id)const;
+	UINT GetSrvIndex(int id)const;
+	UINT GetResidentMip(int id)const;
+
+private:
+	struct StreamedTexture
+	{
+		std::wstring Filename;
+		MappedFile File;
+
+		// Description of the full chain and one entry per mip, pointing into File.
+		D3D12_RESOURCE_DESC Desc;
+		std::vector<D3D12_SUBRESOURCE_DATA> Mips;
+		bool IsCubeMap = false;
+
+		// Format of the data in File; differs from Desc.Format when it is compressed
+		// on upload.
+		DXGI_FORMAT SourceFormat = DXGI_FORMAT_UNKNOWN;
+		unsigned int LoadFlags = 0;
+
+		UINT TailMip = 0;
+		UINT FinestMip = 0;
+		UINT ResidentMip = 0;
+		UINT DesiredMip = 0;
+		UINT64 ResidentBytes = 0;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		UINT SrvIndex = 0;
+
+		float RequestedTexels = 0.0f;
+		float Priority = 0.0f;
+		UINT64 LastUsedFrame = 0;
+		bool LoadInFlight = false;
+	};
+
+	struct LoadRequest
+	{
+		StreamedTexture* Texture;
+		int Id;
+		UINT FirstMip;
+		UINT EndMip;
+		float Priority;
+		UINT64 Bytes;
+
+		bool operator<(const LoadRequest& rhs)const { return Priority < rhs.Priority; }
+	};
+
+	// Intrusive node of the lock-free completion stack.
+	struct LoadCompletion
+	{
+		LoadCompletion* Next = nullptr;
+		int Id = -1;
+		UINT FirstMip = 0;
+		UINT EndMip = 0;
+		UINT64 Bytes = 0;
+		HRESULT Result = S_OK;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Upload;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Layouts;
+	};
+
+	struct RetiredItem
+	{
+		UINT64 Fence;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		UINT SrvIndex;
+	};
+
+private:
+	void WorkerMain();
+	void LoadMips(const LoadRequest& request, LoadCompletion& completion);
+	HRESULT CopyMip(const StreamedTexture& tex, UINT mip, BYTE* dest, UINT64 rowPitch, UINT numRows, UINT64 rowSize)const;
+	void PushCompletion(LoadCompletion* completion);
+	LoadCompletion* PopAllCompletions();
+
+	D3D12_RESOURCE_DESC MipRangeDesc(const StreamedTexture& tex, UINT firstMip)const;
+	UINT64 AllocationSize(const StreamedTexture& tex, UINT firstMip)const;
+	bool CanStartAt(const StreamedTexture& tex, UINT mip)const;
+	UINT DesiredMipFor(const StreamedTexture& tex)const;
+
+	ID3D12GraphicsCommandList* BeginCommands();
+	bool Rebuild(StreamedTexture& tex, UINT newFirstMip, const LoadCompletion* loaded);
+	UINT64 EvictLeastRecentlyUsed(UINT64 bytesNeeded, const StreamedTexture* keep);
+	void WriteSrv(const StreamedTexture& tex, UINT slot);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+
+	UINT64 mBudget = 0;
+	UINT mTailSize = 64;
+	UINT mMaxLoadsInFlight = 4;
+
+	std::vector<std::unique_ptr<StreamedTexture>> mTextures;
+	UINT64 mResidentBytes = 0;
+	UINT64 mPendingBytes = 0;
+	UINT mLoadsInFlight = 0;
+	UINT64 mFrame = 0;
+	UINT64 mFrameFence = 0;
+	UINT64 mCompletedFence = 0;
+	UINT64 mLastFrameFence = 0;
+
+	// Descriptors.
+	CD3DX12_CPU_DESCRIPTOR_HANDLE mhCpuHeapStart;
+	UINT mDescriptorSize = 0;
+	std::vector<UINT> mFreeSlots;
+	std::vector<SrvRemap> mRemaps;
+
+	// Resources and slots waiting for the GPU.
+	std::deque<RetiredItem> mRetired;
+
+	// Completions that could not be applied yet (no free descriptor slot).
+	std::vector<LoadCompletion*> mDeferred;
+
+	// Command recording for rebuilds.
+	std::deque<std::pair<UINT64, Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>> mAllocators;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
+	bool mRecording = false;
+
+	// Worker side.
+	std::vector<std::thread> mWorkers;
+	std::mutex mQueueMutex;
+	std::condition_variable mQueueCondition;
+	std::priority_queue<LoadRequest> mRequests;
+	bool mStop = false;
+
+	std::atomic<LoadCompletion*> mCompleted{ nullptr };
+};
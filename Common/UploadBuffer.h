@@ -50,6 +50,13 @@ public:
         return mUploadBuffer.Get();
     }
 
+    // The mapped memory, for filling many elements in place.  It is write-combined:
+    // write it in order and never read it back.
+    BYTE* MappedData()const
+    {
+        return mMappedData;
+    }
+
     void CopyData(int elementIndex, const T& data)
     {
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "d3dApp.h"
+#include "Profiler.h"
 #include <WindowsX.h>
 
 using Microsoft::WRL::ComPtr;
@@ -86,6 +87,7 @@ int D3DApp::Run()
  
 	//  
 	_GlobalTimer.Reset();
+	Profiler::SetThreadName("Main");
 
 	while (msg.message != WM_QUIT)
 	{
@@ -102,9 +104,16 @@ int D3DApp::Run()
 
 			if( !mAppPaused )
 			{
+				PROFILE_ZONE("Frame");
 				CalculateFrameStats();
-				GameLoop(_GlobalTimer);
-                Draw(_GlobalTimer);
+				{
+					PROFILE_ZONE("GameLoop");
+					GameLoop(_GlobalTimer);
+				}
+				{
+					PROFILE_ZONE("Draw");
+					Draw(_GlobalTimer);
+				}
 			}
 			else
 			{
@@ -121,6 +121,20 @@ public:
         UINT64 byteSize,
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+    // An upload heap buffer the CPU fills through Map() before copying it on the GPU.
+    static Microsoft::WRL::ComPtr<ID3D12Resource> CreateUploadBuffer(
+        ID3D12Device* device,
+        UINT64 byteSize);
+
+    // Like the above, but copies byteSize bytes at uploadOffset of an upload buffer the
+    // caller has already written.  Several default buffers can share one upload buffer.
+    static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+        ID3D12Device* device,
+        ID3D12GraphicsCommandList* cmdList,
+        ID3D12Resource* uploadBuffer,
+        UINT64 uploadOffset,
+        UINT64 byteSize);
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
@@ -250,6 +264,11 @@ struct Material
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
+	// Slice within the texture array at the index above when the map was packed by
+	// TexturePacker, otherwise -1.
+	int DiffuseSrvSlice = -1;
+	int NormalSrvSlice = -1;
+
 	// Dirty flag indicating the material has changed and we need to update the constant buffer.
 	// Because we have a material constant buffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify a material we should set 
@@ -272,6 +291,15 @@ struct Texture
 
 	Microsoft::WRL::ComPtr<ID3D12Resource> Resource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap = nullptr;
+
+	// Id in the TextureStreamer that owns the resource, or -1 if loaded whole.
+	int StreamId = -1;
+
+	// Hash of the file contents and load flags, the size of the file, and the number
+	// of names sharing the texture.
+	std::uint64_t Hash = 0;
+	std::uint64_t FileSize = 0;
+	int RefCount = 0;
 };
 
 #ifndef ThrowIfFailed
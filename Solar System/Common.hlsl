@@ -26,22 +26,29 @@ struct MaterialData
 	float4x4 MatTransform;
 	uint     DiffuseMapIndex;
 	uint     NormalMapIndex;
-	uint     MatPad1;
-	uint     MatPad2;
+	uint     DiffuseMapSlice;
+	uint     NormalMapSlice;
 };
 
+// Map slice of a material whose map index refers to gTextureMaps.
+#define NO_TEXTURE_SLICE 0xffffffff
+
 TextureCube gCubeMap : register(t0);
 Texture2D gShadowMap : register(t1);
 Texture2D gSsaoMap   : register(t2);
 
 // An array of textures, which is only supported in shader model 5.1+.  Unlike Texture2DArray, the textures
 // in this array can be different sizes and formats, making it more flexible than texture arrays.
-Texture2D gTextureMaps[10] : register(t3);
+Texture2D gTextureMaps[50] : register(t3);
 
 // Put in space1, so the texture array does not overlap with these resources.  
 // The texture array will occupy registers t0, t1, ..., t3 in space0. 
 StructuredBuffer<MaterialData> gMaterialData : register(t0, space1);
 
+// Same-size maps packed into arrays by TexturePacker; a material map with a slice
+// other than NO_TEXTURE_SLICE indexes these.
+Texture2DArray gTextureArrays[8] : register(t0, space2);
+
 
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
@@ -51,6 +58,14 @@ SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 SamplerComparisonState gsamShadow : register(s6);
 
+float4 SampleMaterialMap(uint mapIndex, uint mapSlice, float2 texC)
+{
+	if (mapSlice == NO_TEXTURE_SLICE)
+		return gTextureMaps[mapIndex].Sample(gsamAnisotropicWrap, texC);
+
+	return gTextureArrays[mapIndex].Sample(gsamAnisotropicWrap, float3(texC, mapSlice));
+}
+
 // Constant data that varies per frame.
 cbuffer cbPerObject : register(b0)
 {
@@ -98,6 +113,10 @@ float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, floa
 	// Uncompress each component from [0,1] to [-1,1].
 	float3 normalT = 2.0f*normalMapSample - 1.0f;
 
+	// Rebuild z from x and y, so two-channel (BC5) normal maps, which sample z as 0,
+	// work the same as full RGB ones.
+	normalT.z = sqrt(saturate(1.0f - dot(normalT.xy, normalT.xy)));
+
 	// Build orthonormal basis.
 	float3 N = unitNormalW;
 	float3 T = normalize(tangentW - dot(tangentW, N)*N);
@@ -3,13 +3,19 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../Common/JobSystem.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
 
 using namespace DirectX;
 
+namespace
+{
+	// Rows per job in the simulation step and the normal pass.
+	const size_t RowGrain = 8;
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
 	mNumRows = m;
@@ -96,8 +102,9 @@ void Waves::Update(float dt)
 	if (t >= mTimeStep)
 	{
 		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows-1; ++i)
+		JobSystem::Default().ParallelFor(mNumRows - 2, RowGrain, [this](size_t begin, size_t end)
+		{
+			for (int i = 1 + (int)begin; i < 1 + (int)end; ++i)
 			{
 				for (int j = 1; j < mNumCols - 1; ++j)
 				{
@@ -118,7 +125,8 @@ void Waves::Update(float dt)
 							mCurrSolution[i * mNumCols + j + 1].y +
 							mCurrSolution[i * mNumCols + j - 1].y);
 				}
-			});
+			}
+		});
 
 		// We just overwrote the previous buffer with the new data, so
 		// this data needs to become the current solution and the old
@@ -130,8 +138,9 @@ void Waves::Update(float dt)
 		//
 		// Compute normals using finite difference scheme.
 		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			//for(int i = 1; i < mNumRows - 1; ++i)
+		JobSystem::Default().ParallelFor(mNumRows - 2, RowGrain, [this](size_t begin, size_t end)
+		{
+			for (int i = 1 + (int)begin; i < 1 + (int)end; ++i)
 			{
 				for (int j = 1; j < mNumCols - 1; ++j)
 				{
@@ -150,7 +159,8 @@ void Waves::Update(float dt)
 					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
 					XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
 				}
-			});
+			}
+		});
 	}
 }
 
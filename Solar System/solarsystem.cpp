@@ -4,6 +4,7 @@
 #include "../Common/GeometryGenerator.h"
 #include "FrameResource.h"
 
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <map>
@@ -25,6 +26,9 @@
 #include "Universe.h"
 #include "Particle.h"
 #include "Ssao.h"
+#include "TaskGraph.h"
+#include "MappedFile.h"
+#include "Profiler.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -35,9 +39,17 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Size of the texture descriptor table (t3 onwards), of the packed texture array table
+// that follows it in the heap (t0, space2), and the GPU memory the streamed textures
+// may use.
+const UINT gTextureTableSize = 50;
+const UINT gTextureArrayTableSize = 8;
+const UINT64 gTextureStreamingBudget = 96ull * 1024 * 1024;
+
 void InitializeGameObjects(Scene&);
 void InitializeGeometry(ID3D12Device*, ID3D12GraphicsCommandList*, Render&);
-void InitializeTextures(ID3D12Device*, ID3D12GraphicsCommandList*, Render&);
+void PrefetchTextures();
+void InitializeTextures(ID3D12Device*, ID3D12GraphicsCommandList*, Render&, TextureStreamer&, TexturePacker&);
 void InitializeMaterials(Render&);
 
 class MyEngine : public D3DApp
@@ -61,6 +73,7 @@ private:
 	virtual void OnMouseMove(WPARAM btnState, int x, int y) override;
 
 	void UpdateObjectCBs(const GameTimer& Time);
+	void UpdateTextureStreaming(const GameTimer& Time);
 	void UpdateMaterialBuffer(const GameTimer& Time);
 	void UpdateShadowTransform(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& Time);
@@ -70,6 +83,7 @@ private:
 	void BuildRootSignature();
 	void BuildSsaoRootSignature();
 	void BuildDescriptorHeaps();
+	void BuildTextureStreaming();
 	void InitializeShaders();
 	void BuildPSOs();
 	void BuildFrameResources();
@@ -115,9 +129,15 @@ private:
 	Scene scene;				//  
 	Render render;				//   
 
+	// Texture mips streamed on demand, and the streams each material samples.
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	std::unique_ptr<TexturePacker> mTexturePacker;
+	std::unordered_map<const Material*, std::vector<int>> mMaterialStreamIds;
+
 	bool _isWireframe = false;	//    
 	bool _isShadowDebug = false;
 	bool _isSsaoDebug = false;
+	bool _traceKeyDown = false;	// F7 writes the profiler trace on press
 
 #pragma region Shadow Mapping + SSAO
 	std::unique_ptr<ShadowMap> mShadowMap;
@@ -214,6 +234,8 @@ MyEngine::~MyEngine()
 
 bool MyEngine::Initialize()
 {
+	auto start = std::chrono::steady_clock::now();
+
 	if (!D3DApp::Initialize())
 		return false;
 
@@ -230,21 +252,50 @@ bool MyEngine::Initialize()
 
 
 
-	InitializeGeometry(_Device.Get(), _GraphicsCommandList.Get(), render); // TODO  
-	InitializeTextures(_Device.Get(), _GraphicsCommandList.Get(), render); // TODO  
-	InitializeMaterials(render);
-	InitializeGameObjects(scene);
-
-	BuildRootSignature();
-	BuildSsaoRootSignature();
-	BuildDescriptorHeaps();
+	mTextureStreamer = std::make_unique<TextureStreamer>(_Device.Get(), gTextureStreamingBudget);
+	mTexturePacker = std::make_unique<TexturePacker>();
 
-	BuildRenderItems();
-	BuildFrameResources();
+	// The rest of the start-up runs as a task graph.  Worker tasks read files, compile
+	// shaders and build game objects.  Whatever records into the command list or goes
+	// through Render, which is not thread-safe, stays on the main lane; compiling
+	// touches only Render's shader map.
+	using Lane = TaskGraph::Lane;
+	TaskGraph startup;
 
+	auto prefetchTextures = startup.Add("Prefetch textures", Lane::Worker, [&]() { PrefetchTextures(); });
+	auto shaders = startup.Add("Compile shaders", Lane::Worker, [&]() { InitializeShaders(); });
+	auto gameObjects = startup.Add("Game objects", Lane::Worker, [&]() { InitializeGameObjects(scene); });
 
-	InitializeShaders();
-	BuildPSOs();
+	auto rootSignatures = startup.Add("Root signatures", Lane::Main, [&]()
+	{
+		BuildRootSignature();
+		BuildSsaoRootSignature();
+	});
+	auto geometry = startup.Add("Geometry", Lane::Main, [&]()
+	{
+		InitializeGeometry(_Device.Get(), _GraphicsCommandList.Get(), render);
+	});
+	auto textures = startup.Add("Load textures", Lane::Main, [&]()
+	{
+		InitializeTextures(_Device.Get(), _GraphicsCommandList.Get(), render, *mTextureStreamer, *mTexturePacker);
+	}, { prefetchTextures });
+	auto materials = startup.Add("Materials", Lane::Main, [&]() { InitializeMaterials(render); }, { textures });
+	auto descriptorHeaps = startup.Add("Descriptor heaps", Lane::Main, [&]() { BuildDescriptorHeaps(); }, { textures });
+	startup.Add("Texture streaming", Lane::Main, [&]() { BuildTextureStreaming(); }, { materials, descriptorHeaps });
+	startup.Add("Render items", Lane::Main, [&]() { BuildRenderItems(); }, { geometry, materials, gameObjects });
+	startup.Add("Frame resources", Lane::Main, [&]() { BuildFrameResources(); }, { materials, gameObjects });
+	startup.Add("Pipeline states", Lane::Main, [&]() { BuildPSOs(); }, { shaders, rootSignatures });
+
+	startup.Run();
+	OutputDebugStringA(startup.Report("Start-up").c_str());
+
+	// Meshes and texture files with identical contents are loaded once; report the savings.
+	const auto& dedup = render.GetDeduplicationStats();
+	std::wstring dedupText = L"Shared " + std::to_wstring(dedup.Geometries) + L" duplicate meshes (" +
+		std::to_wstring(dedup.GeometryBytes) + L" bytes) and " + std::to_wstring(dedup.Textures) +
+		L" duplicate textures (" + std::to_wstring(dedup.TextureBytes + mTexturePacker->GetDuplicateBytes()) +
+		L" file bytes)\n";
+	OutputDebugString(dedupText.c_str());
 
 	mSsao->SetPSOs(mPSOs["ssao"].Get(), mPSOs["ssaoBlur"].Get());
 
@@ -255,8 +306,14 @@ bool MyEngine::Initialize()
 
 	// Wait until initialization is complete.
 	FlushCommandQueue();
+	mTexturePacker->ReleaseStaging();
 	OnResize();
 
+	// Everything up to the first frame; the graph report above breaks down the CPU side.
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::wstring startupText = L"Initialized in " + std::to_wstring(ms) + L" ms\n";
+	OutputDebugString(startupText.c_str());
+
 	return true;
 }
 
@@ -286,6 +343,11 @@ void MyEngine::GameLoop(const GameTimer& gt)
 	if (GameInput::IsKeyPressed(KEYBOARD_F4)) _isShadowDebug = false;
 	if (GameInput::IsKeyPressed(KEYBOARD_F5)) _isSsaoDebug = true;
 	if (GameInput::IsKeyPressed(KEYBOARD_F6)) _isSsaoDebug = false;
+
+	const bool traceKeyDown = GameInput::IsKeyPressed(KEYBOARD_F7);
+	if (traceKeyDown && !_traceKeyDown)
+		Profiler::WriteChromeTrace("trace.json");
+	_traceKeyDown = traceKeyDown;
 	
 	//  Update     
 	scene.Update(gt);
@@ -318,6 +380,7 @@ void MyEngine::GameLoop(const GameTimer& gt)
 	}
 
 	UpdateObjectCBs(gt);
+	UpdateTextureStreaming(gt);
 	UpdateMaterialBuffer(gt);
 	UpdateShadowTransform(gt);
 	UpdateMainPassCB(gt);
@@ -507,6 +570,8 @@ void MyEngine::OnMouseMove(WPARAM btnState, int x, int y)
 //        
 void MyEngine::UpdateObjectCBs(const GameTimer& Time)
 {
+	PROFILE_ZONE("UpdateObjectCBs");
+
 	//   
 	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
 
@@ -537,6 +602,71 @@ void MyEngine::UpdateObjectCBs(const GameTimer& Time)
 	}
 }
 
+void MyEngine::UpdateTextureStreaming(const GameTimer& Time)
+{
+	Camera* camera = scene.GetMainCamera();
+	if (camera != nullptr)
+	{
+		XMFLOAT3 eye = camera->GetPosition3f();
+
+		// Screen pixels covered by one unit of size at distance one.
+		float pixelsPerUnit = 0.5f * _ClientHeight / tanf(0.5f * camera->GetFovY());
+
+		for (auto& it : scene.GetAllGameObjects())
+		{
+			GameObject* go = it.second;
+			RenderItem* ri = go->ri.get();
+
+			auto streams = mMaterialStreamIds.find(ri->Mat);
+			if (streams == mMaterialStreamIds.end())
+				continue;
+
+			// Anything that is not a sphere (sky, platform) asks for full resolution.
+			float texels = FLT_MAX;
+			if (go->Type == PrimitiveType::Sphere)
+			{
+				float radius = std::max(go->Transform.Scale.X, std::max(go->Transform.Scale.Y, go->Transform.Scale.Z));
+				float dx = ri->World._41 - eye.x;
+				float dy = ri->World._42 - eye.y;
+				float dz = ri->World._43 - eye.z;
+				float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+				// The texture wraps around the sphere, so the visible half spans half its width.
+				if (distance > radius)
+					texels = 2.0f * (2.0f * radius * pixelsPerUnit / distance);
+			}
+
+			for (int id : streams->second)
+				mTextureStreamer->RequestResolution(id, texels);
+		}
+	}
+
+	// Copies for loads and evictions are submitted ahead of this frame's command list.
+	const auto& remaps = mTextureStreamer->Update(_CommandQueue.Get(), _CurrentFenceIndex + 1, _Fence->GetCompletedValue());
+
+	// Rebuilt textures live in new descriptor slots; repoint the materials using them.
+	for (const auto& remap : remaps)
+	{
+		for (auto& e : render.GetMaterialMap())
+		{
+			Material* mat = e.second.get();
+			bool changed = false;
+			if (mat->DiffuseSrvSlice < 0 && mat->DiffuseSrvHeapIndex == (int)remap.OldIndex)
+			{
+				mat->DiffuseSrvHeapIndex = (int)remap.NewIndex;
+				changed = true;
+			}
+			if (mat->NormalSrvSlice < 0 && mat->NormalSrvHeapIndex == (int)remap.OldIndex)
+			{
+				mat->NormalSrvHeapIndex = (int)remap.NewIndex;
+				changed = true;
+			}
+			if (changed)
+				mat->NumFramesDirty = gNumFrameResources;
+		}
+	}
+}
+
 void MyEngine::UpdateMaterialBuffer(const GameTimer& Time)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
@@ -556,6 +686,8 @@ void MyEngine::UpdateMaterialBuffer(const GameTimer& Time)
 			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
 			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
 			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+			matData.DiffuseMapSlice = mat->DiffuseSrvSlice < 0 ? NoTextureSlice : (UINT)mat->DiffuseSrvSlice;
+			matData.NormalMapSlice = mat->NormalSrvSlice < 0 ? NoTextureSlice : (UINT)mat->NormalSrvSlice;
 
 			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
 
@@ -742,8 +874,10 @@ void MyEngine::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE texTable0;
 	texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 0);
 
-	CD3DX12_DESCRIPTOR_RANGE texTable1;
-	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 50, 3, 0);	// 25 is count of textures
+	// The packed texture arrays (t0, space2) follow the texture table in the heap.
+	CD3DX12_DESCRIPTOR_RANGE texTable1[2];
+	texTable1[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, gTextureTableSize, 3, 0);
+	texTable1[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, gTextureArrayTableSize, 0, 2);
 
 	//     ,     
 	CD3DX12_ROOT_PARAMETER slotRootParameter[5];
@@ -753,7 +887,7 @@ void MyEngine::BuildRootSignature()
 	slotRootParameter[1].InitAsConstantBufferView(1);
 	slotRootParameter[2].InitAsShaderResourceView(0, 1);
 	slotRootParameter[3].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
-	slotRootParameter[4].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[4].InitAsDescriptorTable(_countof(texTable1), texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	//   
 	auto staticSamplers = GetStaticSamplers();
@@ -867,7 +1001,7 @@ void MyEngine::BuildDescriptorHeaps()
 {
 	//    SRV
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = render.GetTextureMap().size() * 3;		//   LoadTexture
+	srvHeapDesc.NumDescriptors = std::max<UINT>((UINT)render.GetTextureMap().size() * 3, gTextureTableSize + gTextureArrayTableSize);		//   LoadTexture
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(_Device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -883,6 +1017,13 @@ void MyEngine::BuildDescriptorHeaps()
 
 	for (int i = 0; i < render.GetTextureMap().size(); ++i)
 	{
+		// Streamed textures get their descriptors from the streamer.
+		if (render.GetTextureMap()[i]->StreamId >= 0)
+		{
+			hDescriptor.Offset(1, _DescriptorSizeCSU);
+			continue;
+		}
+
 		srvDesc.Format = render.GetTextureMap()[i]->Resource->GetDesc().Format;
 		srvDesc.Texture2D.MipLevels = render.GetTextureMap()[i]->Resource->GetDesc().MipLevels;
 		_Device->CreateShaderResourceView(render.GetTextureMap()[i]->Resource.Get(), &srvDesc, hDescriptor);
@@ -937,6 +1078,36 @@ void MyEngine::BuildDescriptorHeaps()
 		GetRtv(_SwapChainBufferCount),
 		_DescriptorSizeCSU,
 		_DescriptorSizeRTV);
+
+	// The rest of the texture table holds the slots streamed textures move to when rebuilt.
+	UINT firstSpareSlot = mNullTexSrvIndex2 + 1;
+	UINT numSpareSlots = gTextureTableSize > firstSpareSlot ? gTextureTableSize - firstSpareSlot : 0;
+	mTextureStreamer->BindDescriptors(
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart()),
+		_DescriptorSizeCSU,
+		firstSpareSlot,
+		numSpareSlots);
+
+	mTexturePacker->WriteSrvs(_Device.Get(), GetCpuSrv(gTextureTableSize), _DescriptorSizeCSU, gTextureArrayTableSize);
+}
+
+void MyEngine::BuildTextureStreaming()
+{
+	// Materials still hold the initial texture indices here, which are the texture map indices.
+	auto& textures = render.GetTextureMap();
+	for (auto& e : render.GetMaterialMap())
+	{
+		Material* mat = e.second.get();
+		for (int i = 0; i < (int)textures.size(); ++i)
+		{
+			if (textures[i]->StreamId < 0)
+				continue;
+
+			if ((mat->DiffuseSrvSlice < 0 && mat->DiffuseSrvHeapIndex == i) ||
+				(mat->NormalSrvSlice < 0 && mat->NormalSrvHeapIndex == i))
+				mMaterialStreamIds[mat].push_back(textures[i]->StreamId);
+		}
+	}
 }
 
 void MyEngine::BuildPSOs()
@@ -1262,6 +1433,8 @@ void MyEngine::BuildRenderItems()
 
 void MyEngine::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
+	PROFILE_ZONE("DrawRenderItems");
+
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
 	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
@@ -1285,6 +1458,8 @@ void MyEngine::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 
 void MyEngine::DrawSceneToShadowMap()
 {
+	PROFILE_ZONE("DrawSceneToShadowMap");
+
 	_GraphicsCommandList->RSSetViewports(1, &mShadowMap->Viewport());
 	_GraphicsCommandList->RSSetScissorRects(1, &mShadowMap->ScissorRect());
 
@@ -1319,6 +1494,8 @@ void MyEngine::DrawSceneToShadowMap()
 
 void MyEngine::DrawNormalsAndDepth()
 {
+	PROFILE_ZONE("DrawNormalsAndDepth");
+
 	_GraphicsCommandList->RSSetViewports(1, &_ScreenViewport);
 	_GraphicsCommandList->RSSetScissorRects(1, &_ScissorRect);
 
@@ -1449,43 +1626,101 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> MyEngine::GetStaticSamplers()
 }
 
 #pragma region  
+// The meshes are generated straight into their upload buffers, with whichever index
+// type SetGeometry picks for their size.
 void InitializeGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* gcl, Render& render)
 {
-	GeometryGenerator geoGen;
-	render.SetGeometry(device, gcl, "SphereGeo",	geoGen.CreateSphere(1.0f, 32, 32));
-	render.SetGeometry(device, gcl, "SkysphereGeo", geoGen.CreateSkysphere(1.0f, 32, 32));
-	render.SetGeometry(device, gcl, "GridGeo",		geoGen.CreateGrid(5.0f, 5.0f, 60, 60));
-	render.SetGeometry(device, gcl, "DebugQuadRD",	geoGen.CreateQuad(0.5f, -0.5f, 0.5f, 0.5f, 0.0f));
-	render.SetGeometry(device, gcl, "DebugQuadLD",	geoGen.CreateQuad(-1.0f, -0.5f, 0.5f, 0.5f, 0.0f));
+	using Layout = Render::GeneratorLayout;
+
+	render.SetGeometry(device, gcl, "SphereGeo", GeometryGenerator::SphereSize(32, 32),
+		[](Vertex* v, auto* i) { GeometryGenerator::WriteSphere<Layout>(1.0f, 32, 32, v, i); });
+	render.SetGeometry(device, gcl, "SkysphereGeo", GeometryGenerator::SkysphereSize(32, 32),
+		[](Vertex* v, auto* i) { GeometryGenerator::WriteSkysphere<Layout>(1.0f, 32, 32, v, i); });
+	render.SetGeometry(device, gcl, "GridGeo", GeometryGenerator::GridSize(60, 60),
+		[](Vertex* v, auto* i) { GeometryGenerator::WriteGrid<Layout>(5.0f, 5.0f, 60, 60, v, i); });
+	render.SetGeometry(device, gcl, "DebugQuadRD", GeometryGenerator::QuadSize(),
+		[](Vertex* v, auto* i) { GeometryGenerator::WriteQuad<Layout>(0.5f, -0.5f, 0.5f, 0.5f, 0.0f, v, i); });
+	render.SetGeometry(device, gcl, "DebugQuadLD", GeometryGenerator::QuadSize(),
+		[](Vertex* v, auto* i) { GeometryGenerator::WriteQuad<Layout>(-1.0f, -0.5f, 0.5f, 0.5f, 0.0f, v, i); });
 }
 
-void InitializeTextures(ID3D12Device* device, ID3D12GraphicsCommandList* gcl, Render& render)
+const unsigned int gNormalMapFlags = DirectX::DDS_LOADER_COMPRESS_BC5 | DirectX::DDS_LOADER_MIP_AUTOGEN | DirectX::DDS_LOADER_MIP_NORMAL_MAP;
+const unsigned int gSpriteFlags = DirectX::DDS_LOADER_MIP_AUTOGEN | DirectX::DDS_LOADER_MIP_ALPHA_COVERAGE;
+
+// Texture files in load order.  Planet maps of the same size share a texture array, so
+// the planet materials differ only by slice; packable maps left without a partner are
+// streamed like the rest.
+struct TextureSource
 {
-	render.SetTexture(device, gcl,			"UniverseDiffuseMap",		L"../Textures/SolarSystem/MilkyWayColor.dds");
-	render.SetTexture(device, gcl,			"SunDiffuseMap",			L"../Textures/SolarSystem/SunColor.dds");
-	render.SetTexture(device, gcl,			"MercuryDiffuseMap",		L"../Textures/SolarSystem/MercuryColor.dds");
-	render.SetTexture(device, gcl,			"VenusDiffuseMap",			L"../Textures/SolarSystem/VenusColor.dds");
-	render.SetTexture(device, gcl,			"EarthDiffuseMap",			L"../Textures/SolarSystem/EarthColor.dds");
-	render.SetTexture(device, gcl,			"MoonDiffuseMap",			L"../Textures/SolarSystem/MoonColor.dds");
-	render.SetTexture(device, gcl,			"MarsDiffuseMap",			L"../Textures/SolarSystem/MarsColor.dds");
-	render.SetTexture(device, gcl,			"JupiterDiffuseMap",		L"../Textures/SolarSystem/JupiterColor.dds");
-	render.SetTexture(device, gcl,			"SaturnDiffuseMap",			L"../Textures/SolarSystem/SaturnColor.dds");
-	render.SetTexture(device, gcl,			"UranusDiffuseMap",			L"../Textures/SolarSystem/UranusColor.dds");
-	render.SetTexture(device, gcl,			"NeptuneDiffuseMap",		L"../Textures/SolarSystem/NeptuneColor.dds");
-	render.SetTexture(device, gcl,			"sprite",					L"../Textures/SolarSystem/treeArray2.dds");
-	render.SetTexture(device, gcl,			"ds",						L"../Textures/SolarSystem/ds2.dds");
-
-	render.SetTexture(device, gcl,			"MercuryNormalMap",			L"../Textures/SolarSystem/Mercury_NRM.dds");
-	render.SetTexture(device, gcl,			"VenusNormalMap",			L"../Textures/SolarSystem/Venus_NRM.dds");
-	render.SetTexture(device, gcl,			"EarthNormalMap",			L"../Textures/SolarSystem/Earth_Normal.dds");
-	render.SetTexture(device, gcl,			"MoonNormalMap",			L"../Textures/SolarSystem/Moon_NRM.dds");
-	render.SetTexture(device, gcl,			"MarsNormalMap",			L"../Textures/SolarSystem/Mars_NRM.dds");
-	render.SetTexture(device, gcl,			"NeutralNormalMap",			L"../Textures/SolarSystem/neutral.dds");
-
-	render.SetTexture(device, gcl,			"dds",						L"../Textures/SolarSystem/dds2.dds");
-
-	render.SetTexture(device, gcl,			"debugDiffuseMap",			L"../Textures/tile.dds");
-	render.SetTexture(device, gcl,			"debugNormalMap",			L"../Textures/tile_nmap.dds");
+	const char* Name;
+	const wchar_t* Filename;
+	unsigned int LoadFlags;
+	bool Packable;
+};
+
+const TextureSource gTextureSources[] =
+{
+	{ "UniverseDiffuseMap",		L"../Textures/SolarSystem/MilkyWayColor.dds",	DirectX::DDS_LOADER_MIP_AUTOGEN,	false },
+	{ "SunDiffuseMap",			L"../Textures/SolarSystem/SunColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	false },
+
+	{ "MercuryDiffuseMap",		L"../Textures/SolarSystem/MercuryColor.dds",	DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "VenusDiffuseMap",		L"../Textures/SolarSystem/VenusColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "EarthDiffuseMap",		L"../Textures/SolarSystem/EarthColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "MoonDiffuseMap",			L"../Textures/SolarSystem/MoonColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "MarsDiffuseMap",			L"../Textures/SolarSystem/MarsColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "JupiterDiffuseMap",		L"../Textures/SolarSystem/JupiterColor.dds",	DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "SaturnDiffuseMap",		L"../Textures/SolarSystem/SaturnColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "UranusDiffuseMap",		L"../Textures/SolarSystem/UranusColor.dds",		DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+	{ "NeptuneDiffuseMap",		L"../Textures/SolarSystem/NeptuneColor.dds",	DirectX::DDS_LOADER_MIP_AUTOGEN,	true },
+
+	{ "MercuryNormalMap",		L"../Textures/SolarSystem/Mercury_NRM.dds",		gNormalMapFlags,					true },
+	{ "VenusNormalMap",			L"../Textures/SolarSystem/Venus_NRM.dds",		gNormalMapFlags,					true },
+	{ "EarthNormalMap",			L"../Textures/SolarSystem/Earth_Normal.dds",	gNormalMapFlags,					true },
+	{ "MoonNormalMap",			L"../Textures/SolarSystem/Moon_NRM.dds",		gNormalMapFlags,					true },
+	{ "MarsNormalMap",			L"../Textures/SolarSystem/Mars_NRM.dds",		gNormalMapFlags,					true },
+
+	{ "sprite",					L"../Textures/SolarSystem/treeArray2.dds",		gSpriteFlags,						false },
+	{ "ds",						L"../Textures/SolarSystem/ds2.dds",				DirectX::DDS_LOADER_MIP_AUTOGEN,	false },
+
+	{ "NeutralNormalMap",		L"../Textures/SolarSystem/neutral.dds",			gNormalMapFlags,					false },
+
+	{ "dds",					L"../Textures/SolarSystem/dds2.dds",			gNormalMapFlags,					false },
+
+	{ "debugDiffuseMap",		L"../Textures/tile.dds",						DirectX::DDS_LOADER_MIP_AUTOGEN,	false },
+	{ "debugNormalMap",			L"../Textures/tile_nmap.dds",					gNormalMapFlags,					false },
+};
+
+// Runs on a worker while the main thread builds root signatures and uploads meshes, so
+// the loaders below find the files in the page cache.
+void PrefetchTextures()
+{
+	Parallel::For(_countof(gTextureSources), 1, [](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			MappedFile file;
+			if (file.Open(gTextureSources[i].Filename))
+				file.Prefetch();
+		}
+	});
+}
+
+void InitializeTextures(ID3D12Device* device, ID3D12GraphicsCommandList* gcl, Render& render, TextureStreamer& streamer, TexturePacker& packer)
+{
+	for (const TextureSource& source : gTextureSources)
+		if (source.Packable)
+			packer.Add(source.Name, source.Filename, source.LoadFlags);
+
+	packer.Build(device, gcl, gTextureArrayTableSize);
+
+	for (const TextureSource& source : gTextureSources)
+	{
+		const TexturePacker::Entry* entry = source.Packable ? packer.Find(source.Name) : nullptr;
+		if (entry != nullptr && entry->Array >= 0)
+			render.SetPackedTexture(entry->Name, entry->Array, entry->Slice);
+		else
+			render.SetTexture(streamer, device, gcl, source.Name, source.Filename, source.LoadFlags);
+	}
 }
 
 void InitializeMaterials(Render& render)
@@ -1558,37 +1793,39 @@ void MyEngine::InitializeShaders()
 		NULL, NULL
 	};
 
-	render.CreateShader("defaultVS",				L"Default.hlsl",		"VS",		"vs_5_1");
-	render.CreateShader("defaultPS",				L"Default.hlsl",		"PS",		"ps_5_1");
+	render.CreateShaders({
+		{ "defaultVS",				L"Default.hlsl",		"VS",		"vs_5_1" },
+		{ "defaultPS",				L"Default.hlsl",		"PS",		"ps_5_1" },
 
-	render.CreateShader("shadowVS",					L"Shadows.hlsl",		"VS",		"vs_5_1");
-	render.CreateShader("shadowOpaquePS",			L"Shadows.hlsl",		"PS",		"ps_5_1");
-	render.CreateShader("shadowAlphaTestedPS",		L"Shadows.hlsl",		"PS",		"ps_5_1",		alphaTestDefines);
+		{ "shadowVS",				L"Shadows.hlsl",		"VS",		"vs_5_1" },
+		{ "shadowOpaquePS",			L"Shadows.hlsl",		"PS",		"ps_5_1" },
+		{ "shadowAlphaTestedPS",	L"Shadows.hlsl",		"PS",		"ps_5_1",		alphaTestDefines },
 
-	render.CreateShader("debugVS",					L"ShadowDebug.hlsl",	"VS",		"vs_5_1");
-	render.CreateShader("debugPS",					L"ShadowDebug.hlsl",	"PS",		"ps_5_1");
+		{ "debugVS",				L"ShadowDebug.hlsl",	"VS",		"vs_5_1" },
+		{ "debugPS",				L"ShadowDebug.hlsl",	"PS",		"ps_5_1" },
 
-	render.CreateShader("drawNormalsVS",			L"DrawNormals.hlsl",	"VS",		"vs_5_1");
-	render.CreateShader("drawNormalsPS",			L"DrawNormals.hlsl",	"PS",		"ps_5_1");
+		{ "drawNormalsVS",			L"DrawNormals.hlsl",	"VS",		"vs_5_1" },
+		{ "drawNormalsPS",			L"DrawNormals.hlsl",	"PS",		"ps_5_1" },
 
-	render.CreateShader("ssaoVS",					L"Ssao.hlsl",			"VS",		"vs_5_1");
-	render.CreateShader("ssaoPS",					L"Ssao.hlsl",			"PS",		"ps_5_1");
+		{ "ssaoVS",					L"Ssao.hlsl",			"VS",		"vs_5_1" },
+		{ "ssaoPS",					L"Ssao.hlsl",			"PS",		"ps_5_1" },
 
-	render.CreateShader("ssaoBlurVS",				L"SsaoBlur.hlsl",		"VS",		"vs_5_1");
-	render.CreateShader("ssaoBlurPS",				L"SsaoBlur.hlsl",		"PS",		"ps_5_1");
+		{ "ssaoBlurVS",				L"SsaoBlur.hlsl",		"VS",		"vs_5_1" },
+		{ "ssaoBlurPS",				L"SsaoBlur.hlsl",		"PS",		"ps_5_1" },
 
-	render.CreateShader("skyVS",					L"Sky.hlsl",			"VS",		"vs_5_1");
-	render.CreateShader("skyPS",					L"Sky.hlsl",			"PS",		"ps_5_1");
+		{ "skyVS",					L"Sky.hlsl",			"VS",		"vs_5_1" },
+		{ "skyPS",					L"Sky.hlsl",			"PS",		"ps_5_1" },
 
-	render.CreateShader("shadowQuadPS",				L"ShadowQuad.hlsl",		"PS",		"ps_5_1");
-	render.CreateShader("shadowQuadVS",				L"ShadowQuad.hlsl",		"VS",		"vs_5_1");
+		{ "shadowQuadPS",			L"ShadowQuad.hlsl",		"PS",		"ps_5_1" },
+		{ "shadowQuadVS",			L"ShadowQuad.hlsl",		"VS",		"vs_5_1" },
 
-	render.CreateShader("ssaoQuadVS",				L"SsaoQuad.hlsl",		"VS",		"vs_5_1");
-	render.CreateShader("ssaoQuadPS",				L"SsaoQuad.hlsl",		"PS",		"ps_5_1");
+		{ "ssaoQuadVS",				L"SsaoQuad.hlsl",		"VS",		"vs_5_1" },
+		{ "ssaoQuadPS",				L"SsaoQuad.hlsl",		"PS",		"ps_5_1" },
 
-	render.CreateShader("billboardVS",				L"TreeSprite.hlsl",		"VS",		"vs_5_1");
-	render.CreateShader("billboardGS",				L"TreeSprite.hlsl",		"GS",		"gs_5_1");
-	render.CreateShader("billboardPS",				L"TreeSprite.hlsl",		"PS",		"ps_5_1");
+		{ "billboardVS",			L"TreeSprite.hlsl",		"VS",		"vs_5_1" },
+		{ "billboardGS",			L"TreeSprite.hlsl",		"GS",		"gs_5_1" },
+		{ "billboardPS",			L"TreeSprite.hlsl",		"PS",		"ps_5_1" },
+	});
 
 	mTreeSpriteInputLayout =
 	{
@@ -0,0 +1,249 @@
+//***************************************************************************************
+// main.cpp
+//
+// JobBenchmark: measures how the JobSystem scales from one thread to every hardware
+// thread, next to a loop that starts its threads on every call (as Parallel::For did
+// before it moved onto the pool).
+//
+//   JobBenchmark [max threads]
+//
+// For each thread count it first checks that ParallelFor rethrows what a chunk throws,
+// from the calling thread or a worker, and returns only once no chunk is running; it
+// exits with 1 if not.  Then it times three workloads:
+//   stencil  - a 2048 x 2048 wave step, 16 rows per chunk (bandwidth bound)
+//   compute  - 1M points of a polynomial iterated 64 times, 4096 points per chunk
+//   graph    - 4096 tiny jobs in chains of 16, run as a TaskGroup graph
+// and prints the best of several runs with the speed-up over one thread.
+//
+// Needs only the standard library; on Linux:
+//   g++ -O2 -std=c++17 -pthread Tools/JobBenchmark/main.cpp Common/JobSystem.cpp
+//***************************************************************************************
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../../Common/JobSystem.h"
+#include "../../Common/Parallel.h"
+
+namespace
+{
+	const size_t GridSize = 2048;
+	const size_t StencilGrain = 16;
+	const size_t ComputeCount = 1 << 20;
+	const size_t ComputeGrain = 4096;
+	const int ComputeIterations = 64;
+	const int ChainCount = 256;
+	const int ChainLength = 16;
+	const int Repeats = 5;
+
+	const size_t CheckCount = 1024;
+	const size_t CheckGrain = 8;
+	const int CheckRounds = 200;
+
+	// The baseline: numThreads threads started for the call, taking chunks in turn.
+	template<typename Body>
+	void SpawnFor(size_t count, size_t grain, const Body& body, unsigned numThreads)
+	{
+		const size_t numChunks = (count + grain - 1) / grain;
+		std::atomic<size_t> nextChunk(0);
+		auto worker = [&]()
+		{
+			for (;;)
+			{
+				size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= numChunks)
+					return;
+
+				size_t begin = chunk * grain;
+				body(begin, std::min(begin + grain, count));
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < numThreads; ++i)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	// Throws from the chunk holding item 'thrower': item 0 is in the chunk the calling
+	// thread keeps, the others are mostly stolen.  ParallelFor must rethrow, and no
+	// chunk may still be running when it returns.
+	bool CheckExceptions(JobSystem& jobs)
+	{
+		for (int round = 0; round < CheckRounds; ++round)
+		{
+			for (size_t thrower : { (size_t)0, CheckCount / 2 + 3, CheckCount - 1 })
+			{
+				std::atomic<int> running(0);
+				bool caught = false;
+				try
+				{
+					jobs.ParallelFor(CheckCount, CheckGrain, [&](size_t begin, size_t end)
+					{
+						running.fetch_add(1);
+						volatile float x = 0.0f;
+						for (size_t i = begin; i < end; ++i)
+							for (int k = 0; k < 256; ++k)
+								x = x * 0.5f + 1.0f;
+						running.fetch_sub(1);
+
+						if (thrower >= begin && thrower < end)
+							throw std::runtime_error("chunk failed");
+					});
+				}
+				catch (const std::runtime_error&)
+				{
+					caught = true;
+				}
+
+				if (!caught || running.load() != 0)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Calls run() Repeats times and returns the fastest in milliseconds.
+	double BestOf(const std::function<void()>& run)
+	{
+		double best = 1e30;
+		for (int r = 0; r < Repeats; ++r)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	void StencilRows(std::vector<float>& prev, const std::vector<float>& curr, size_t begin, size_t end)
+	{
+		for (size_t i = begin + 1; i < end + 1; ++i)
+		{
+			const float* c = &curr[i * GridSize];
+			float* p = &prev[i * GridSize];
+			for (size_t j = 1; j < GridSize - 1; ++j)
+				p[j] = -0.9f * p[j] + 1.6f * c[j] + 0.1f * (c[j - GridSize] + c[j + GridSize] + c[j - 1] + c[j + 1]);
+		}
+	}
+
+	void ComputePoints(std::vector<float>& values, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			float x = values[i];
+			for (int k = 0; k < ComputeIterations; ++k)
+				x = x * (0.999f - 0.25f * x) + 0.001f;
+			values[i] = x;
+		}
+	}
+
+	struct Row
+	{
+		unsigned Threads;
+		double Stencil;
+		double Compute;
+		double Graph;
+	};
+
+	void PrintTable(const char* title, const std::vector<Row>& rows, bool withGraph)
+	{
+		std::printf("\n%s\n", title);
+		std::printf("threads   stencil ms  x       compute ms  x     %s\n", withGraph ? "  graph ms    x" : "");
+		for (const Row& row : rows)
+		{
+			std::printf("%7u   %10.2f  %-6.2f  %10.2f  %-6.2f", row.Threads,
+				row.Stencil, rows[0].Stencil / row.Stencil,
+				row.Compute, rows[0].Compute / row.Compute);
+			if (withGraph)
+				std::printf("  %10.2f  %-6.2f", row.Graph, rows[0].Graph / row.Graph);
+			std::printf("\n");
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned maxThreads = argc > 1 ? (unsigned)std::atoi(argv[1]) : Parallel::HardwareThreads();
+	maxThreads = std::max(maxThreads, 1u);
+
+	std::vector<float> prev(GridSize * GridSize, 0.0f);
+	std::vector<float> curr(GridSize * GridSize, 0.0f);
+	for (size_t i = 0; i < curr.size(); i += 97)
+		curr[i] = 1.0f;
+
+	std::vector<float> values(ComputeCount);
+	for (size_t i = 0; i < values.size(); ++i)
+		values[i] = (float)(i % 1000) / 1000.0f;
+
+	std::vector<Row> jobRows;
+	std::vector<Row> parallelRows;
+
+	for (unsigned threads = 1; threads <= maxThreads; ++threads)
+	{
+		JobSystem jobs(threads - 1);
+
+		if (!CheckExceptions(jobs))
+		{
+			std::printf("ParallelFor lost an exception or returned early with %u threads\n", threads);
+			return 1;
+		}
+
+		Row row = { threads, 0.0, 0.0, 0.0 };
+		row.Stencil = BestOf([&]()
+		{
+			jobs.ParallelFor(GridSize - 2, StencilGrain, [&](size_t begin, size_t end) { StencilRows(prev, curr, begin, end); });
+		});
+		row.Compute = BestOf([&]()
+		{
+			jobs.ParallelFor(ComputeCount, ComputeGrain, [&](size_t begin, size_t end) { ComputePoints(values, begin, end); });
+		});
+		row.Graph = BestOf([&]()
+		{
+			std::atomic<unsigned> sum(0);
+			JobSystem::TaskGroup group(jobs);
+			for (int c = 0; c < ChainCount; ++c)
+			{
+				JobSystem::Task previous = group.Run([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); });
+				for (int k = 1; k < ChainLength; ++k)
+					previous = group.Run([&sum]() { sum.fetch_add(1, std::memory_order_relaxed); }, { previous });
+			}
+			group.Wait();
+		});
+		jobRows.push_back(row);
+
+		Row baseline = { threads, 0.0, 0.0, 0.0 };
+		baseline.Stencil = BestOf([&]()
+		{
+			SpawnFor(GridSize - 2, StencilGrain, [&](size_t begin, size_t end) { StencilRows(prev, curr, begin, end); }, threads);
+		});
+		baseline.Compute = BestOf([&]()
+		{
+			SpawnFor(ComputeCount, ComputeGrain, [&](size_t begin, size_t end) { ComputePoints(values, begin, end); }, threads);
+		});
+		parallelRows.push_back(baseline);
+	}
+
+	std::printf("%u hardware threads\n", Parallel::HardwareThreads());
+	PrintTable("JobSystem", jobRows, true);
+	PrintTable("Threads per call", parallelRows, false);
+
+	// Keep the results alive.
+	float check = 0.0f;
+	for (size_t i = 0; i < values.size(); i += 4096)
+		check += values[i] + prev[i];
+	std::printf("\n(checksum %g)\n", check);
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+//***************************************************************************************
+// main.cpp
+//
+// MeshConverter: turns the text models of the book samples (Models/skull.txt,
+// Models/car.txt) into MeshFile binaries the samples map and upload directly.
+//
+//   MeshConverter <input.txt> <output.mesh> [submesh name]
+//   MeshConverter <input.mesh> <output.mesh>
+//
+// The submesh name defaults to the input file name without directory and extension.
+// A .mesh input is read back and written again with its tangents regenerated from its
+// texture coordinates (MeshFile::GenerateTangents), for binaries exported without them.
+// After writing, the output is opened again to validate it, and the time to parse the
+// text is printed next to the time to open the binary and read through its data.
+//***************************************************************************************
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "../../Common/MeshFile.h"
+
+namespace
+{
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool EndsWith(const std::string& text, const char* suffix)
+	{
+		size_t length = std::strlen(suffix);
+		return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+	}
+
+	std::string DefaultSubmeshName(const std::string& path)
+	{
+		size_t begin = path.find_last_of("/\\");
+		begin = begin == std::string::npos ? 0 : begin + 1;
+		size_t end = path.find_last_of('.');
+		if (end == std::string::npos || end < begin)
+			end = path.size();
+		return path.substr(begin, end - begin);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::printf("usage: MeshConverter <input.txt> <output.mesh> [submesh name]\n");
+		std::printf("       MeshConverter <input.mesh> <output.mesh>\n");
+		return 1;
+	}
+
+	const char* input = argv[1];
+	const char* output = argv[2];
+	const std::string submeshName = argc > 3 ? argv[3] : DefaultSubmeshName(input);
+
+	if (submeshName.size() >= MeshFile::MaxNameLength)
+	{
+		std::printf("submesh name '%s' is longer than %u characters\n", submeshName.c_str(), MeshFile::MaxNameLength - 1);
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	MeshFile::Mesh mesh;
+	if (EndsWith(input, ".mesh"))
+	{
+		MeshFile::View source;
+		if (!source.Open(input))
+		{
+			std::printf("failed to read %s\n", input);
+			return 1;
+		}
+		MeshFile::ReadMesh(source, mesh);
+
+		if (!MeshFile::GenerateTangents(mesh))
+		{
+			std::printf("%s has no stream with positions, normals, texture coordinates and tangents\n", input);
+			return 1;
+		}
+	}
+	else if (!MeshFile::ImportLegacyText(input, submeshName, mesh))
+	{
+		std::printf("failed to read %s\n", input);
+		return 1;
+	}
+	double parseTime = Milliseconds(start);
+
+	if (!MeshFile::Write(output, mesh))
+	{
+		std::printf("failed to write %s\n", output);
+		return 1;
+	}
+
+	// Reading every byte stands in for the copy into the upload heap.
+	start = std::chrono::steady_clock::now();
+	MeshFile::View view;
+	if (!view.Open(output))
+	{
+		std::printf("%s did not validate after writing\n", output);
+		return 1;
+	}
+
+	unsigned checksum = 0;
+	const MeshFile::FileHeader& header = view.Header();
+	for (std::uint32_t s = 0; s < header.StreamCount; ++s)
+	{
+		const unsigned char* data = static_cast<const unsigned char*>(view.StreamData(s));
+		for (std::uint64_t i = 0; i < view.Stream(s).Size; ++i)
+			checksum += data[i];
+	}
+	const unsigned char* indices = static_cast<const unsigned char*>(view.IndexData());
+	for (std::uint64_t i = 0; i < view.IndexDataSize(); ++i)
+		checksum += indices[i];
+	double openTime = Milliseconds(start);
+
+	std::printf("%s: %u vertices, %u indices (%u-bit), %llu bytes\n", output, header.VertexCount, header.IndexCount,
+		header.IndexSize * 8, (unsigned long long)header.FileSize);
+	std::printf("bounds (%g %g %g) - (%g %g %g)\n", header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2],
+		header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2]);
+	std::printf("import and tangents %.2f ms, binary open and read %.2f ms (checksum %08x)\n", parseTime, openTime, checksum);
+
+	return 0;
+}